@@ -0,0 +1,375 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*
+ * Benchmarks which drive the library over a socketpair against the
+ * synthetic responses of a #fake_server.  Run all of them with "meson test
+ * --benchmark", or a single one with "bench NAME".
+ */
+
+#include "fake_server.h"
+#include "capture.h"
+
+#include <mpd/client.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum {
+	ALBUMART_SIZE = 4 * 1024 * 1024,
+	ALBUMART_CHUNK = 8192,
+};
+
+struct bench_server {
+	struct fake_server *server;
+
+	int fd;
+
+	pthread_t thread;
+};
+
+struct bench_scenario {
+	const char *name;
+
+	/**
+	 * The command whose latency histogram is reported.
+	 */
+	const char *command;
+
+	/**
+	 * What one item is: a song, a tag value, a binary chunk ...
+	 */
+	const char *unit;
+
+	unsigned iterations;
+
+	/**
+	 * Sizes the catalog of the fake server.
+	 */
+	void (*configure)(struct fake_server_config *config);
+
+	/**
+	 * Runs one iteration.
+	 *
+	 * @return the number of items received, or 0 on error
+	 */
+	unsigned (*run)(struct mpd_connection *c);
+};
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void *
+bench_server_run(void *arg)
+{
+	struct bench_server *s = arg;
+	fake_server_handle(s->server, s->fd);
+	return NULL;
+}
+
+static unsigned
+run_listallinfo(struct mpd_connection *c)
+{
+	if (!mpd_send_list_all_meta(c, NULL))
+		return 0;
+
+	unsigned n = 0;
+	struct mpd_entity *entity;
+	while ((entity = mpd_recv_entity(c)) != NULL) {
+		if (mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG)
+			++n;
+		mpd_entity_free(entity);
+	}
+
+	return mpd_response_finish(c) ? n : 0;
+}
+
+static bool
+count_songs(mpd_unused const char *name, mpd_unused size_t name_length,
+	    mpd_unused const char *value, mpd_unused size_t value_length,
+	    int token, void *ctx)
+{
+	unsigned *n = ctx;
+	if (token == MPD_PAIR_TOKEN_FILE)
+		++*n;
+	return true;
+}
+
+static unsigned
+run_listallinfo_pairs(struct mpd_connection *c)
+{
+	if (!mpd_send_list_all_meta(c, NULL))
+		return 0;
+
+	unsigned n = 0;
+	return mpd_recv_pairs(c, count_songs, &n) &&
+		mpd_response_finish(c) ? n : 0;
+}
+
+static unsigned
+run_listallinfo_table(struct mpd_connection *c)
+{
+	static const enum mpd_tag_type tags[] = {
+		MPD_TAG_ARTIST, MPD_TAG_ALBUM, MPD_TAG_TITLE,
+	};
+
+	if (!mpd_send_list_all_meta(c, NULL))
+		return 0;
+
+	struct mpd_song_table *table = mpd_song_table_new(tags, 3);
+	if (table == NULL)
+		return 0;
+
+	unsigned n = mpd_recv_song_table(c, table) &&
+		mpd_response_finish(c)
+		? mpd_song_table_get_length(table)
+		: 0;
+	mpd_song_table_free(table);
+	return n;
+}
+
+static unsigned
+run_playlistinfo(struct mpd_connection *c)
+{
+	if (!mpd_send_list_queue_meta(c))
+		return 0;
+
+	unsigned n = 0;
+	struct mpd_song *song;
+	while ((song = mpd_recv_song(c)) != NULL) {
+		++n;
+		mpd_song_free(song);
+	}
+
+	return mpd_response_finish(c) ? n : 0;
+}
+
+static unsigned
+run_status(struct mpd_connection *c)
+{
+	enum { STORM = 1000 };
+
+	for (unsigned i = 0; i < STORM; ++i) {
+		struct mpd_status *status = mpd_run_status(c);
+		if (status == NULL)
+			return 0;
+		mpd_status_free(status);
+	}
+
+	return STORM;
+}
+
+static unsigned
+run_albumart(struct mpd_connection *c)
+{
+	static char buffer[ALBUMART_CHUNK];
+	unsigned offset = 0, n = 0;
+
+	while (offset < ALBUMART_SIZE) {
+		int nbytes = mpd_run_albumart(c, "Artist 0/Album 0/cover.jpg",
+					      offset, buffer, sizeof(buffer));
+		if (nbytes <= 0)
+			return 0;
+
+		offset += (unsigned)nbytes;
+		++n;
+	}
+
+	return n;
+}
+
+static unsigned
+run_list(struct mpd_connection *c)
+{
+	if (!mpd_search_db_tags(c, MPD_TAG_ARTIST) ||
+	    !mpd_search_commit(c))
+		return 0;
+
+	unsigned n = 0;
+	struct mpd_pair *pair;
+	while ((pair = mpd_recv_pair_tag(c, MPD_TAG_ARTIST)) != NULL) {
+		++n;
+		mpd_return_pair(c, pair);
+	}
+
+	return mpd_response_finish(c) ? n : 0;
+}
+
+static void
+configure_listallinfo(struct fake_server_config *config)
+{
+	config->database_size = 100000;
+}
+
+static void
+configure_playlistinfo(struct fake_server_config *config)
+{
+	config->queue_length = 50000;
+}
+
+static void
+configure_albumart(struct fake_server_config *config)
+{
+	config->albumart_size = ALBUMART_SIZE;
+}
+
+static void
+configure_list(struct fake_server_config *config)
+{
+	config->tag_count = 200000;
+}
+
+static const struct bench_scenario scenarios[] = {
+	{ "listallinfo", "listallinfo", "songs", 5,
+	  configure_listallinfo, run_listallinfo },
+	{ "listallinfo_pairs", "listallinfo", "songs", 5,
+	  configure_listallinfo, run_listallinfo_pairs },
+	{ "listallinfo_table", "listallinfo", "songs", 5,
+	  configure_listallinfo, run_listallinfo_table },
+	{ "playlistinfo", "playlistinfo", "songs", 10,
+	  configure_playlistinfo, run_playlistinfo },
+	{ "status", "status", "responses", 20,
+	  NULL, run_status },
+	{ "albumart", "albumart", "chunks", 5,
+	  configure_albumart, run_albumart },
+	{ "list", "list", "values", 5,
+	  configure_list, run_list },
+};
+
+static void
+print_report(const struct bench_scenario *scenario,
+	     const struct mpd_metrics *m, double duration, unsigned long items)
+{
+	uint64_t p50 = 0, p99 = 0;
+	for (unsigned i = 0; i < mpd_metrics_get_num_commands(m); ++i) {
+		if (strcmp(mpd_metrics_get_command_name(m, i),
+			   scenario->command) == 0) {
+			p50 = mpd_metrics_get_command_latency(m, i, 50);
+			p99 = mpd_metrics_get_command_latency(m, i, 99);
+		}
+	}
+
+	const double lines = (double)mpd_metrics_get(m, MPD_METRIC_LINES);
+	const double bytes =
+		(double)mpd_metrics_get(m, MPD_METRIC_BYTES_RECEIVED);
+	const double objects =
+		(double)mpd_metrics_get(m, MPD_METRIC_OBJECTS);
+
+	printf("%s: %lu %s in %.3f s\n"
+	       "  %.0f lines/s, %.0f %s/s, %.1f MB/s\n"
+	       "  %.2f objects per item\n"
+	       "  %s latency p50 %llu us, p99 %llu us\n",
+	       scenario->name, items, scenario->unit, duration,
+	       lines / duration, (double)items / duration, scenario->unit,
+	       bytes / duration / 1e6,
+	       objects / (double)items,
+	       scenario->command,
+	       (unsigned long long)p50, (unsigned long long)p99);
+}
+
+static bool
+run_scenario(const struct bench_scenario *scenario)
+{
+	/* start with an empty catalog, and generate only the part
+	   which is used */
+	struct fake_server_config config;
+	memset(&config, 0, sizeof(config));
+	if (scenario->configure != NULL)
+		scenario->configure(&config);
+
+	struct test_capture tc;
+	struct mpd_connection *c = test_capture_init(&tc);
+	if (c == NULL)
+		return false;
+
+	struct bench_server server = {
+		.server = fake_server_new(&config),
+		.fd = tc.fd,
+	};
+
+	if (server.server == NULL ||
+	    !mpd_connection_enable_metrics(c) ||
+	    pthread_create(&server.thread, NULL,
+			   bench_server_run, &server) != 0) {
+		mpd_connection_free(c);
+		test_capture_deinit(&tc);
+		if (server.server != NULL)
+			fake_server_free(server.server);
+		return false;
+	}
+
+	unsigned long items = 0;
+	bool success = true;
+
+	const double start = now();
+	for (unsigned i = 0; i < scenario->iterations; ++i) {
+		const unsigned n = scenario->run(c);
+		if (n == 0) {
+			fprintf(stderr, "%s: %s\n", scenario->name,
+				mpd_connection_get_error_message(c));
+			success = false;
+			break;
+		}
+
+		items += n;
+	}
+	const double duration = now() - start;
+
+	struct mpd_metrics *m = mpd_connection_get_metrics(c);
+
+	/* closing the client side makes the server thread exit */
+	mpd_connection_free(c);
+	pthread_join(server.thread, NULL);
+	test_capture_deinit(&tc);
+	fake_server_free(server.server);
+
+	if (m == NULL)
+		return false;
+
+	if (success)
+		print_report(scenario, m, duration, items);
+
+	mpd_metrics_free(m);
+	return success;
+}
+
+int
+main(int argc, char **argv)
+{
+	/* the server thread must not be killed if the client
+	   disconnects early */
+	signal(SIGPIPE, SIG_IGN);
+
+	const size_t n = sizeof(scenarios) / sizeof(scenarios[0]);
+	bool success = true;
+
+	if (argc < 2) {
+		for (size_t i = 0; i < n; ++i)
+			success = run_scenario(&scenarios[i]) && success;
+		return success ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		size_t j = 0;
+		while (j < n && strcmp(argv[i], scenarios[j].name) != 0)
+			++j;
+
+		if (j == n) {
+			fprintf(stderr, "Unknown benchmark: %s\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+
+		success = run_scenario(&scenarios[j]) && success;
+	}
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,650 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "fake_server.h"
+#include "generator.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+enum {
+	/**
+	 * The maximum number of arguments of a command, including
+	 * the command name.
+	 */
+	FAKE_MAX_ARGS = 16,
+
+	/**
+	 * The default "binarylimit".
+	 */
+	FAKE_BINARY_LIMIT = 8192,
+
+	/**
+	 * When limiting the bandwidth, write at most this many bytes
+	 * at a time.
+	 */
+	FAKE_BANDWIDTH_CHUNK = 4096,
+};
+
+/**
+ * The result of a session operation.
+ */
+enum fake_status {
+	/**
+	 * A line was read, or the operation was completed.
+	 */
+	FAKE_OK,
+
+	/**
+	 * No line was received within the timeout.
+	 */
+	FAKE_TIMEOUT,
+
+	/**
+	 * The client has disconnected.
+	 */
+	FAKE_CLOSED,
+
+	/**
+	 * An I/O or protocol error has occurred.
+	 */
+	FAKE_ERROR,
+};
+
+struct fake_server {
+	struct fake_server_config config;
+
+	/**
+	 * The pre-generated response bodies.
+	 */
+	struct bench_buffer database, queue, current, status, tags;
+
+	/**
+	 * The "lsinfo" response for the root directory: one
+	 * "directory" line per artist.
+	 */
+	struct bench_buffer root;
+
+	/**
+	 * The offsets of the artists' subtrees in #database;
+	 * n_artists+1 elements.
+	 */
+	size_t *artists;
+	unsigned n_artists;
+};
+
+struct fake_session {
+	const struct fake_server *server;
+
+	int fd;
+
+	size_t binary_limit;
+
+	/**
+	 * Received data; the unprocessed part is between
+	 * #input_start and #input_end.
+	 */
+	char input[4096];
+	size_t input_start, input_end;
+
+	/**
+	 * The response which is being assembled, see
+	 * fake_session_flush().
+	 */
+	struct bench_buffer output;
+};
+
+void
+fake_server_config_init(struct fake_server_config *config)
+{
+	memset(config, 0, sizeof(*config));
+	config->database_size = 10000;
+	config->queue_length = 1000;
+	config->tag_count = 1000;
+	config->albumart_size = 256 * 1024;
+}
+
+/**
+ * Finds the subtree of each artist directory in the generated
+ * database (which is sorted by artist) for "lsinfo" and
+ * "listallinfo" on a directory.
+ */
+static bool
+fake_server_index_artists(struct fake_server *server)
+{
+	static const char prefix[] = "directory: Artist ";
+	const size_t prefix_length = sizeof(prefix) - 1;
+
+	const char *data = server->database.data;
+	const size_t size = server->database.size;
+	size_t capacity = 0;
+
+	server->artists = NULL;
+	server->n_artists = 0;
+
+	unsigned last = UINT32_MAX;
+	for (size_t offset = 0; offset < size;) {
+		const char *line = data + offset;
+		const char *newline = memchr(line, '\n', size - offset);
+		const size_t next = newline != NULL
+			? (size_t)(newline + 1 - data)
+			: size;
+
+		if (next - offset > prefix_length &&
+		    memcmp(line, prefix, prefix_length) == 0) {
+			const unsigned artist =
+				strtoul(line + prefix_length, NULL, 10);
+			if (artist != last) {
+				if (server->n_artists + 1 >= capacity) {
+					capacity = capacity > 0
+						? capacity * 2 : 64;
+					size_t *artists =
+						realloc(server->artists,
+							capacity * sizeof(*artists));
+					if (artists == NULL) {
+						free(server->artists);
+						return false;
+					}
+
+					server->artists = artists;
+				}
+
+				server->artists[server->n_artists++] = offset;
+				bench_buffer_printf(&server->root,
+						    "directory: Artist %u\n",
+						    artist);
+				last = artist;
+			}
+		}
+
+		offset = next;
+	}
+
+	if (server->artists != NULL)
+		server->artists[server->n_artists] = size;
+	return true;
+}
+
+struct fake_server *
+fake_server_new(const struct fake_server_config *config)
+{
+	struct fake_server *server = malloc(sizeof(*server));
+	if (server == NULL)
+		return NULL;
+
+	server->config = *config;
+
+	bench_buffer_init(&server->database);
+	bench_generate_songs(&server->database, config->database_size, false);
+
+	bench_buffer_init(&server->queue);
+	bench_generate_songs(&server->queue, config->queue_length, true);
+
+	bench_buffer_init(&server->root);
+	if (!fake_server_index_artists(server)) {
+		bench_buffer_deinit(&server->database);
+		bench_buffer_deinit(&server->queue);
+		bench_buffer_deinit(&server->root);
+		free(server);
+		return NULL;
+	}
+
+	bench_buffer_init(&server->current);
+	if (config->queue_length > 0)
+		bench_generate_songs(&server->current, 1, true);
+
+	bench_buffer_init(&server->status);
+	bench_generate_status(&server->status, config->queue_length);
+
+	bench_buffer_init(&server->tags);
+	bench_generate_tags(&server->tags, config->tag_count);
+
+	return server;
+}
+
+void
+fake_server_free(struct fake_server *server)
+{
+	bench_buffer_deinit(&server->database);
+	bench_buffer_deinit(&server->queue);
+	bench_buffer_deinit(&server->current);
+	bench_buffer_deinit(&server->status);
+	bench_buffer_deinit(&server->tags);
+	bench_buffer_deinit(&server->root);
+	free(server->artists);
+	free(server);
+}
+
+static void
+sleep_us(uint64_t us)
+{
+	if (us == 0)
+		return;
+
+	struct timespec ts = {
+		.tv_sec = (time_t)(us / 1000000),
+		.tv_nsec = (long)(us % 1000000) * 1000,
+	};
+
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+	}
+}
+
+static bool
+write_full(int fd, const char *data, size_t size)
+{
+	while (size > 0) {
+		ssize_t nbytes = write(fd, data, size);
+		if (nbytes < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data += nbytes;
+		size -= (size_t)nbytes;
+	}
+
+	return true;
+}
+
+/**
+ * Reads the next line from the client.
+ *
+ * @param timeout_ms the timeout in milliseconds, or -1 to wait
+ * forever
+ * @param line_r on #FAKE_OK, receives the null-terminated line
+ * (without the newline), which is valid until the next call
+ */
+static enum fake_status
+fake_session_read_line(struct fake_session *s, int timeout_ms, char **line_r)
+{
+	const struct fake_server_config *config = &s->server->config;
+
+	while (true) {
+		char *start = s->input + s->input_start;
+		char *newline = memchr(start, '\n',
+				       s->input_end - s->input_start);
+		if (newline != NULL) {
+			*newline = 0;
+			s->input_start = (size_t)(newline + 1 - s->input);
+			*line_r = start;
+			return FAKE_OK;
+		}
+
+		s->input_end -= s->input_start;
+		memmove(s->input, start, s->input_end);
+		s->input_start = 0;
+
+		if (s->input_end == sizeof(s->input))
+			/* line too long */
+			return FAKE_ERROR;
+
+		if (timeout_ms >= 0) {
+			struct pollfd pfd = {
+				.fd = s->fd,
+				.events = POLLIN,
+			};
+
+			int ret = poll(&pfd, 1, timeout_ms);
+			if (ret == 0)
+				return FAKE_TIMEOUT;
+			if (ret < 0 && errno != EINTR)
+				return FAKE_ERROR;
+		}
+
+		sleep_us(config->read_delay_us);
+
+		size_t max_size = sizeof(s->input) - s->input_end;
+		if (config->read_size > 0 && max_size > config->read_size)
+			max_size = config->read_size;
+
+		ssize_t nbytes = read(s->fd, s->input + s->input_end,
+				      max_size);
+		if (nbytes < 0) {
+			if (errno == EINTR)
+				continue;
+			return FAKE_ERROR;
+		}
+
+		if (nbytes == 0)
+			return FAKE_CLOSED;
+
+		s->input_end += (size_t)nbytes;
+	}
+}
+
+/**
+ * Sends the assembled response, applying the configured latency,
+ * bandwidth limit and fragmentation.
+ */
+static enum fake_status
+fake_session_flush(struct fake_session *s)
+{
+	const struct fake_server_config *config = &s->server->config;
+
+	sleep_us(config->latency_us);
+
+	const char *p = s->output.data;
+	size_t remaining = s->output.size;
+
+	while (remaining > 0) {
+		size_t size = remaining;
+		if (config->fragment_size > 0 && size > config->fragment_size)
+			size = config->fragment_size;
+		else if (config->bandwidth > 0 && size > FAKE_BANDWIDTH_CHUNK)
+			size = FAKE_BANDWIDTH_CHUNK;
+
+		if (config->bandwidth > 0)
+			sleep_us((uint64_t)size * 1000000 / config->bandwidth);
+
+		if (!write_full(s->fd, p, size))
+			return FAKE_ERROR;
+
+		p += size;
+		remaining -= size;
+	}
+
+	bench_buffer_clear(&s->output);
+	return FAKE_OK;
+}
+
+/**
+ * Splits a command line into words, unquoting and unescaping them in
+ * place.
+ *
+ * @return the number of words
+ */
+static unsigned
+fake_split(char *line, char **argv, unsigned max_args)
+{
+	unsigned argc = 0;
+	char *p = line;
+
+	while (argc < max_args) {
+		while (*p == ' ')
+			++p;
+
+		if (*p == 0)
+			break;
+
+		char *dest = p;
+		argv[argc++] = p;
+
+		if (*p == '"') {
+			++p;
+			while (*p != 0 && *p != '"') {
+				if (*p == '\\' && p[1] != 0)
+					++p;
+				*dest++ = *p++;
+			}
+
+			if (*p == '"')
+				++p;
+		} else {
+			while (*p != 0 && *p != ' ')
+				*dest++ = *p++;
+		}
+
+		const char separator = *p;
+		*dest = 0;
+		if (separator != 0)
+			++p;
+	}
+
+	return argc;
+}
+
+static bool
+fake_session_ack(struct fake_session *s, unsigned code, unsigned index,
+		 const char *command, const char *message)
+{
+	bench_buffer_printf(&s->output, "ACK [%u@%u] {%s} %s\n",
+			    code, index, command, message);
+	return false;
+}
+
+static void
+fake_session_append(struct fake_session *s, const struct bench_buffer *body)
+{
+	bench_buffer_append(&s->output, body->data, body->size);
+}
+
+/**
+ * The commands reported by "commands".
+ */
+static const char *const fake_commands[] = {
+	"albumart", "binarylimit", "clearerror", "close",
+	"command_list_begin", "command_list_end", "command_list_ok_begin",
+	"commands", "currentsong", "idle", "list", "listallinfo", "lsinfo",
+	"noidle", "notcommands", "password", "ping", "playlistinfo",
+	"protocol", "readpicture", "status", "tagtypes", "urlhandlers",
+	NULL
+};
+
+/**
+ * Executes a simple command and appends its response body to the
+ * output buffer.
+ *
+ * @param index the position within the command list
+ * @return false if the command has failed (and an "ACK" was
+ * appended)
+ */
+static bool
+fake_session_command(struct fake_session *s, char *line, unsigned index)
+{
+	const struct fake_server *server = s->server;
+
+	char *argv[FAKE_MAX_ARGS];
+	const unsigned argc = fake_split(line, argv, FAKE_MAX_ARGS);
+	if (argc == 0)
+		return fake_session_ack(s, 5, index, "", "No command given");
+
+	const char *command = argv[0];
+
+	if (strcmp(command, "status") == 0)
+		fake_session_append(s, &server->status);
+	else if (strcmp(command, "currentsong") == 0)
+		fake_session_append(s, &server->current);
+	else if (strcmp(command, "playlistinfo") == 0)
+		fake_session_append(s, &server->queue);
+	else if (strcmp(command, "listallinfo") == 0 ||
+		 strcmp(command, "lsinfo") == 0) {
+		if (argc < 2 || *argv[1] == 0 || strcmp(argv[1], "/") == 0) {
+			fake_session_append(s,
+					    strcmp(command, "listallinfo") == 0
+					    ? &server->database
+					    : &server->root);
+			return true;
+		}
+
+		/* the generated subtrees are "Artist N" with
+		   "Artist N/Album M" below */
+		const char *name = argv[1];
+		if (strncmp(name, "Artist ", 7) != 0 ||
+		    strchr(name, '/') != NULL ||
+		    strcmp(command, "listallinfo") != 0)
+			return fake_session_ack(s, 50, index, command,
+						"No such directory");
+
+		const unsigned long artist = strtoul(name + 7, NULL, 10);
+		if (artist >= server->n_artists)
+			return fake_session_ack(s, 50, index, command,
+						"No such directory");
+
+		const size_t begin = server->artists[artist];
+		const size_t end = server->artists[artist + 1];
+		bench_buffer_append(&s->output,
+				    server->database.data + begin,
+				    end - begin);
+	}
+	else if (strcmp(command, "list") == 0)
+		fake_session_append(s, &server->tags);
+	else if (strcmp(command, "albumart") == 0 ||
+		 strcmp(command, "readpicture") == 0) {
+		if (argc != 3)
+			return fake_session_ack(s, 2, index, command,
+						"wrong number of arguments");
+
+		if (server->config.albumart_size == 0)
+			return fake_session_ack(s, 50, index, command,
+						"No file exists");
+
+		bench_generate_binary(&s->output,
+				      server->config.albumart_size,
+				      strtoul(argv[2], NULL, 10),
+				      s->binary_limit);
+	} else if (strcmp(command, "binarylimit") == 0) {
+		if (argc != 2)
+			return fake_session_ack(s, 2, index, command,
+						"wrong number of arguments");
+
+		s->binary_limit = strtoul(argv[1], NULL, 10);
+		if (s->binary_limit < 64)
+			s->binary_limit = 64;
+	} else if (strcmp(command, "commands") == 0) {
+		for (const char *const*i = fake_commands; *i != NULL; ++i)
+			bench_buffer_printf(&s->output, "command: %s\n", *i);
+	} else if (strcmp(command, "ping") != 0 &&
+		   strcmp(command, "noidle") != 0 &&
+		   strcmp(command, "notcommands") != 0 &&
+		   strcmp(command, "urlhandlers") != 0 &&
+		   strcmp(command, "password") != 0 &&
+		   strcmp(command, "tagtypes") != 0 &&
+		   strcmp(command, "protocol") != 0 &&
+		   strcmp(command, "clearerror") != 0)
+		return fake_session_ack(s, 5, index, command,
+					"unknown command");
+
+	return true;
+}
+
+static enum fake_status
+fake_session_idle(struct fake_session *s)
+{
+	const unsigned interval = s->server->config.idle_interval_ms;
+
+	char *line;
+	enum fake_status status =
+		fake_session_read_line(s, interval > 0 ? (int)interval : -1,
+				       &line);
+	switch (status) {
+	case FAKE_OK:
+		/* like MPD, disconnect on anything but "noidle" */
+		if (strcmp(line, "noidle") != 0)
+			return FAKE_ERROR;
+		break;
+
+	case FAKE_TIMEOUT:
+		bench_buffer_printf(&s->output, "changed: player\n");
+		break;
+
+	case FAKE_CLOSED:
+	case FAKE_ERROR:
+		return status;
+	}
+
+	bench_buffer_printf(&s->output, "OK\n");
+	return fake_session_flush(s);
+}
+
+static enum fake_status
+fake_session_command_list(struct fake_session *s, bool list_ok)
+{
+	/* the null-terminated commands, one after another */
+	struct bench_buffer commands;
+	bench_buffer_init(&commands);
+
+	char *line;
+	enum fake_status status;
+	while ((status = fake_session_read_line(s, -1, &line)) == FAKE_OK &&
+	       strcmp(line, "command_list_end") != 0)
+		bench_buffer_append(&commands, line, strlen(line) + 1);
+
+	if (status == FAKE_OK) {
+		unsigned index = 0;
+		bool success = true;
+
+		for (size_t i = 0; i < commands.size;) {
+			/* fake_split() modifies the command in place */
+			char *command = commands.data + i;
+			i += strlen(command) + 1;
+
+			if (!fake_session_command(s, command, index++)) {
+				success = false;
+				break;
+			}
+
+			if (list_ok)
+				bench_buffer_printf(&s->output, "list_OK\n");
+		}
+
+		if (success)
+			bench_buffer_printf(&s->output, "OK\n");
+
+		status = fake_session_flush(s);
+	}
+
+	bench_buffer_deinit(&commands);
+	return status;
+}
+
+static enum fake_status
+fake_session_step(struct fake_session *s)
+{
+	char *line;
+	enum fake_status status = fake_session_read_line(s, -1, &line);
+	if (status != FAKE_OK)
+		return status;
+
+	if (strcmp(line, "close") == 0)
+		return FAKE_CLOSED;
+
+	if (strcmp(line, "idle") == 0 || strncmp(line, "idle ", 5) == 0)
+		return fake_session_idle(s);
+
+	if (strcmp(line, "command_list_begin") == 0)
+		return fake_session_command_list(s, false);
+
+	if (strcmp(line, "command_list_ok_begin") == 0)
+		return fake_session_command_list(s, true);
+
+	if (fake_session_command(s, line, 0))
+		bench_buffer_printf(&s->output, "OK\n");
+
+	return fake_session_flush(s);
+}
+
+bool
+fake_server_handle(struct fake_server *server, int fd)
+{
+	struct fake_session s = {
+		.server = server,
+		.fd = fd,
+		.binary_limit = FAKE_BINARY_LIMIT,
+	};
+
+	bench_buffer_init(&s.output);
+
+	enum fake_status status;
+	do {
+		status = fake_session_step(&s);
+	} while (status == FAKE_OK);
+
+	bench_buffer_deinit(&s.output);
+	return status == FAKE_CLOSED;
+}
+
+bool
+fake_server_serve(struct fake_server *server, int fd)
+{
+	static const char welcome[] = "OK MPD 0.24.0\n";
+
+	return write_full(fd, welcome, sizeof(welcome) - 1) &&
+		fake_server_handle(server, fd);
+}
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef BENCH_FAKE_SERVER_H
+#define BENCH_FAKE_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * The catalog and the network impairments of a #fake_server.
+ */
+struct fake_server_config {
+	/**
+	 * The number of songs returned by "listallinfo".
+	 */
+	unsigned database_size;
+
+	/**
+	 * The number of songs returned by "playlistinfo".
+	 */
+	unsigned queue_length;
+
+	/**
+	 * The number of distinct values returned by "list".
+	 */
+	unsigned tag_count;
+
+	/**
+	 * The size of the picture returned by "albumart".
+	 */
+	size_t albumart_size;
+
+	/**
+	 * The delay before each response is sent, in microseconds.
+	 */
+	unsigned latency_us;
+
+	/**
+	 * Limits the response bandwidth [bytes per second]; 0 means
+	 * unlimited.
+	 */
+	unsigned bandwidth;
+
+	/**
+	 * Split responses into write() calls of at most this many
+	 * bytes; 0 means no fragmentation.
+	 */
+	size_t fragment_size;
+
+	/**
+	 * Emulate a slow reader: the delay before each read() in
+	 * microseconds.
+	 */
+	unsigned read_delay_us;
+
+	/**
+	 * The maximum number of bytes per read(); 0 means the whole
+	 * input buffer.
+	 */
+	size_t read_size;
+
+	/**
+	 * If non-zero, "idle" reports "changed: player" after this
+	 * many milliseconds; otherwise it waits for "noidle".
+	 */
+	unsigned idle_interval_ms;
+};
+
+/**
+ * A fake MPD server which answers a subset of the protocol (idle,
+ * status, currentsong, playlistinfo, listallinfo, lsinfo, list, albumart,
+ * binarylimit, commands, ping and command lists) with responses from a
+ * generated catalog.
+ *
+ * One instance may serve many connections concurrently.
+ */
+struct fake_server;
+
+void
+fake_server_config_init(struct fake_server_config *config);
+
+/**
+ * Creates a server and generates its catalog.
+ *
+ * @return the new server, or NULL on out of memory
+ */
+struct fake_server *
+fake_server_new(const struct fake_server_config *config);
+
+void
+fake_server_free(struct fake_server *server);
+
+/**
+ * Sends the welcome line and serves the client on the given socket
+ * until it disconnects or sends "close".  The socket is not closed.
+ *
+ * @return true if the client has disconnected normally, false on
+ * I/O error
+ */
+bool
+fake_server_serve(struct fake_server *server, int fd);
+
+/**
+ * Like fake_server_serve(), but does not send a welcome line,
+ * e.g. because the client connection was created with
+ * mpd_connection_new_async().
+ */
+bool
+fake_server_handle(struct fake_server *server, int fd);
+
+#endif
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*
+ * A stand-in MPD server with a generated catalog and injectable
+ * network impairments, for load and latency testing of clients.
+ */
+
+#include "fake_server.h"
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct fakempd_client {
+	struct fake_server *server;
+
+	int fd;
+};
+
+static void
+usage(const char *argv0)
+{
+	fprintf(stderr,
+		"Usage: %s [OPTIONS]\n"
+		"  -p PORT      listen on this TCP port on localhost (default 6600)\n"
+		"  -s PATH      listen on this local socket instead\n"
+		"  -n SONGS     number of songs in the database\n"
+		"  -q SONGS     length of the queue\n"
+		"  -t VALUES    number of distinct tag values\n"
+		"  -a BYTES     size of the album art\n"
+		"  -l USEC      latency of each response\n"
+		"  -b BYTES     response bandwidth per second\n"
+		"  -f BYTES     split responses into writes of this size\n"
+		"  -r USEC      delay before each read (slow reader)\n"
+		"  -R BYTES     maximum size of each read\n"
+		"  -i MSEC      report an idle event after this interval\n",
+		argv0);
+}
+
+static int
+listen_tcp(unsigned port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	const int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons((uint16_t)port);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(fd, (const struct sockaddr *)&sin, sizeof(sin)) < 0 ||
+	    listen(fd, 64) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int
+listen_local(const char *path)
+{
+	struct sockaddr_un sun;
+	if (strlen(path) >= sizeof(sun.sun_path))
+		return -1;
+
+	int fd = socket(AF_LOCAL, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_LOCAL;
+	strcpy(sun.sun_path, path);
+
+	unlink(path);
+	if (bind(fd, (const struct sockaddr *)&sun, sizeof(sun)) < 0 ||
+	    listen(fd, 64) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void *
+client_run(void *arg)
+{
+	struct fakempd_client *client = arg;
+
+	fake_server_serve(client->server, client->fd);
+	close(client->fd);
+	free(client);
+	return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct fake_server_config config;
+	fake_server_config_init(&config);
+
+	unsigned port = 6600;
+	const char *path = NULL;
+
+	int option;
+	while ((option = getopt(argc, argv, "p:s:n:q:t:a:l:b:f:r:R:i:")) != -1) {
+		const unsigned long value =
+			optarg != NULL ? strtoul(optarg, NULL, 10) : 0;
+
+		switch (option) {
+		case 'p':
+			port = (unsigned)value;
+			break;
+
+		case 's':
+			path = optarg;
+			break;
+
+		case 'n':
+			config.database_size = (unsigned)value;
+			break;
+
+		case 'q':
+			config.queue_length = (unsigned)value;
+			break;
+
+		case 't':
+			config.tag_count = (unsigned)value;
+			break;
+
+		case 'a':
+			config.albumart_size = value;
+			break;
+
+		case 'l':
+			config.latency_us = (unsigned)value;
+			break;
+
+		case 'b':
+			config.bandwidth = (unsigned)value;
+			break;
+
+		case 'f':
+			config.fragment_size = value;
+			break;
+
+		case 'r':
+			config.read_delay_us = (unsigned)value;
+			break;
+
+		case 'R':
+			config.read_size = value;
+			break;
+
+		case 'i':
+			config.idle_interval_ms = (unsigned)value;
+			break;
+
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind < argc) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	const int listen_fd = path != NULL
+		? listen_local(path)
+		: listen_tcp(port);
+	if (listen_fd < 0) {
+		perror("Failed to listen");
+		return EXIT_FAILURE;
+	}
+
+	struct fake_server *server = fake_server_new(&config);
+	if (server == NULL) {
+		fputs("Out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	while (true) {
+		const int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0) {
+			perror("accept() failed");
+			continue;
+		}
+
+		struct fakempd_client *client = malloc(sizeof(*client));
+		if (client == NULL) {
+			close(fd);
+			continue;
+		}
+
+		client->server = server;
+		client->fd = fd;
+
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, client_run, client) != 0) {
+			close(fd);
+			free(client);
+			continue;
+		}
+
+		pthread_detach(thread);
+	}
+}
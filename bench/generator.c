@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "generator.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+	/**
+	 * The number of songs in each generated album.
+	 */
+	SONGS_PER_ALBUM = 12,
+
+	ALBUMS_PER_ARTIST = 4,
+};
+
+static const char *const genres[] = {
+	"Rock", "Jazz", "Electronic", "Classical", "Hip-Hop", "Folk",
+};
+
+void
+bench_buffer_init(struct bench_buffer *b)
+{
+	b->data = NULL;
+	b->size = b->capacity = 0;
+}
+
+void
+bench_buffer_deinit(struct bench_buffer *b)
+{
+	free(b->data);
+}
+
+void
+bench_buffer_clear(struct bench_buffer *b)
+{
+	b->size = 0;
+}
+
+static void
+bench_buffer_reserve(struct bench_buffer *b, size_t size)
+{
+	if (b->size + size <= b->capacity)
+		return;
+
+	size_t capacity = b->capacity > 0 ? b->capacity : 4096;
+	while (capacity < b->size + size)
+		capacity *= 2;
+
+	char *data = realloc(b->data, capacity);
+	if (data == NULL) {
+		fputs("Out of memory\n", stderr);
+		abort();
+	}
+
+	b->data = data;
+	b->capacity = capacity;
+}
+
+void
+bench_buffer_append(struct bench_buffer *b, const void *data, size_t size)
+{
+	bench_buffer_reserve(b, size);
+	memcpy(b->data + b->size, data, size);
+	b->size += size;
+}
+
+void
+bench_buffer_printf(struct bench_buffer *b, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	int length = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+
+	bench_buffer_reserve(b, (size_t)length + 1);
+
+	va_start(ap, fmt);
+	vsnprintf(b->data + b->size, (size_t)length + 1, fmt, ap);
+	va_end(ap);
+
+	b->size += (size_t)length;
+}
+
+void
+bench_generate_songs(struct bench_buffer *b, unsigned n, bool queue)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		const unsigned track = i % SONGS_PER_ALBUM + 1;
+		const unsigned album = i / SONGS_PER_ALBUM;
+		const unsigned artist = album / ALBUMS_PER_ARTIST;
+
+		if (!queue && track == 1)
+			bench_buffer_printf(b,
+					    "directory: Artist %u/Album %u\n"
+					    "Last-Modified: 2024-03-01T12:00:00Z\n",
+					    artist, album);
+
+		bench_buffer_printf(b,
+				    "file: Artist %u/Album %u/%02u - Title %u.flac\n"
+				    "Last-Modified: 2024-03-01T12:%02u:%02uZ\n"
+				    "Format: 44100:16:2\n"
+				    "Artist: Artist %u\n"
+				    "AlbumArtist: Artist %u\n"
+				    "Title: Title %u\n"
+				    "Album: Album %u\n"
+				    "Track: %u\n"
+				    "Date: %u\n"
+				    "Genre: %s\n"
+				    "Time: %u\n"
+				    "duration: %u.%03u\n",
+				    artist, album, track, i,
+				    i / 60 % 60, i % 60,
+				    artist, artist, i, album, track,
+				    1960 + album % 60,
+				    genres[album % (sizeof(genres) / sizeof(genres[0]))],
+				    120 + i % 300, 120 + i % 300, i % 1000);
+
+		if (queue)
+			bench_buffer_printf(b, "Pos: %u\nId: %u\n", i, i + 1);
+	}
+}
+
+void
+bench_generate_status(struct bench_buffer *b, unsigned queue_length)
+{
+	bench_buffer_printf(b,
+			    "volume: 80\n"
+			    "repeat: 0\n"
+			    "random: 1\n"
+			    "single: 0\n"
+			    "consume: 0\n"
+			    "partition: default\n"
+			    "playlist: 1234\n"
+			    "playlistlength: %u\n"
+			    "mixrampdb: 0\n"
+			    "state: play\n"
+			    "song: 0\n"
+			    "songid: 1\n"
+			    "time: 97:215\n"
+			    "elapsed: 96.872\n"
+			    "bitrate: 1024\n"
+			    "duration: 215.227\n"
+			    "audio: 44100:16:2\n"
+			    "nextsong: 1\n"
+			    "nextsongid: 2\n",
+			    queue_length);
+}
+
+void
+bench_generate_tags(struct bench_buffer *b, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		bench_buffer_printf(b, "Artist: Artist %u\n", i);
+}
+
+void
+bench_generate_binary(struct bench_buffer *b, size_t total,
+		      size_t offset, size_t chunk_size)
+{
+	if (offset > total)
+		offset = total;
+	if (chunk_size > total - offset)
+		chunk_size = total - offset;
+
+	bench_buffer_printf(b, "size: %zu\nbinary: %zu\n", total, chunk_size);
+
+	bench_buffer_reserve(b, chunk_size);
+	for (size_t i = 0; i < chunk_size; ++i)
+		b->data[b->size + i] = (char)((offset + i) * 31);
+	b->size += chunk_size;
+
+	bench_buffer_append(b, "\n", 1);
+}
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef BENCH_GENERATOR_H
+#define BENCH_GENERATOR_H
+
+#include <mpd/compiler.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A growing buffer which holds a synthetic MPD response.
+ */
+struct bench_buffer {
+	char *data;
+
+	size_t size, capacity;
+};
+
+void
+bench_buffer_init(struct bench_buffer *b);
+
+void
+bench_buffer_deinit(struct bench_buffer *b);
+
+void
+bench_buffer_clear(struct bench_buffer *b);
+
+void
+bench_buffer_append(struct bench_buffer *b, const void *data, size_t size);
+
+mpd_printf(2, 3)
+void
+bench_buffer_printf(struct bench_buffer *b, const char *fmt, ...);
+
+/*
+ * The following functions append the body of a response, without the
+ * final "OK".
+ */
+
+/**
+ * Generates a song list like the one of "listallinfo" (with
+ * "directory" lines between the albums) or "playlistinfo" (with "Pos"
+ * and "Id" attributes).
+ */
+void
+bench_generate_songs(struct bench_buffer *b, unsigned n, bool queue);
+
+/**
+ * Generates a "status" response.
+ */
+void
+bench_generate_status(struct bench_buffer *b, unsigned queue_length);
+
+/**
+ * Generates a "list Artist" response with distinct values.
+ */
+void
+bench_generate_tags(struct bench_buffer *b, unsigned n);
+
+/**
+ * Generates one chunk of an "albumart" response: the total size and
+ * the binary chunk at the given offset.
+ */
+void
+bench_generate_binary(struct bench_buffer *b, size_t total,
+		      size_t offset, size_t chunk_size);
+
+#endif
@@ -0,0 +1,683 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*
+ * Replays a trace recorded with mpd_async_trace_open() through the
+ * response parsers at full speed, and reports per command how much
+ * time was spent waiting for the server and how much CPU time the
+ * client needs for parsing.
+ *
+ * Usage: mpdreplay [-n ITERATIONS] TRACE
+ */
+
+#include "generator.h"
+#include "itrace.h"
+
+#include <mpd/client.h>
+#include <mpd/parser.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+enum {
+	REPLAY_NAME_SIZE = 32,
+
+	REPLAY_MAX_COMMANDS = 64,
+};
+
+/**
+ * A command which was sent to MPD.
+ */
+struct replay_command {
+	char name[REPLAY_NAME_SIZE];
+
+	/**
+	 * When the command was sent [microseconds since the start of
+	 * the trace].
+	 */
+	uint64_t time;
+};
+
+/**
+ * A block of received data.
+ */
+struct replay_chunk {
+	/**
+	 * The offset of the first byte in the received stream.
+	 */
+	size_t offset;
+
+	uint64_t time;
+};
+
+struct replay_trace {
+	/**
+	 * All received data, concatenated.
+	 */
+	struct bench_buffer received;
+
+	struct replay_chunk *chunks;
+	size_t num_chunks;
+
+	struct replay_command *commands;
+	size_t num_commands;
+};
+
+/**
+ * Statistics of all responses to one command name.
+ */
+struct replay_stats {
+	char name[REPLAY_NAME_SIZE];
+
+	unsigned long count, lines, objects;
+
+	uint64_t bytes;
+
+	/**
+	 * The sum of the durations from sending a command until the
+	 * first byte of its response [microseconds].
+	 */
+	uint64_t server_us;
+
+	/**
+	 * The sum of the durations from the first to the last byte of
+	 * a response [microseconds].
+	 */
+	uint64_t transfer_us;
+
+	/**
+	 * The parser CPU time, summed over all iterations
+	 * [nanoseconds].
+	 */
+	uint64_t parse_ns;
+};
+
+/**
+ * Turns response pairs into objects with the mpd_*_begin() and
+ * mpd_*_feed() functions of the library.
+ */
+struct replay_parser {
+	/**
+	 * Creates an object from its first pair.
+	 *
+	 * @return the object, or NULL if this pair does not begin one
+	 */
+	void *(*begin)(const struct mpd_pair *pair);
+
+	/**
+	 * @return false if the pair belongs to the next object
+	 */
+	bool (*feed)(void *object, const struct mpd_pair *pair);
+
+	void (*free)(void *object);
+};
+
+static void *
+entity_begin(const struct mpd_pair *pair)
+{
+	return mpd_entity_begin(pair);
+}
+
+static bool
+entity_feed(void *object, const struct mpd_pair *pair)
+{
+	return mpd_entity_feed(object, pair);
+}
+
+static void
+entity_free(void *object)
+{
+	mpd_entity_free(object);
+}
+
+static void *
+song_begin(const struct mpd_pair *pair)
+{
+	return mpd_song_begin(pair);
+}
+
+static bool
+song_feed(void *object, const struct mpd_pair *pair)
+{
+	return mpd_song_feed(object, pair);
+}
+
+static void
+song_free(void *object)
+{
+	mpd_song_free(object);
+}
+
+static void *
+output_begin(const struct mpd_pair *pair)
+{
+	return mpd_output_begin(pair);
+}
+
+static bool
+output_feed(void *object, const struct mpd_pair *pair)
+{
+	return mpd_output_feed(object, pair);
+}
+
+static void
+output_free(void *object)
+{
+	mpd_output_free(object);
+}
+
+static void *
+status_begin(const struct mpd_pair *pair)
+{
+	struct mpd_status *status = mpd_status_begin();
+	if (status != NULL)
+		mpd_status_feed(status, pair);
+	return status;
+}
+
+static bool
+status_feed(void *object, const struct mpd_pair *pair)
+{
+	mpd_status_feed(object, pair);
+	return true;
+}
+
+static void
+status_free(void *object)
+{
+	mpd_status_free(object);
+}
+
+static void *
+stats_begin(const struct mpd_pair *pair)
+{
+	struct mpd_stats *stats = mpd_stats_begin();
+	if (stats != NULL)
+		mpd_stats_feed(stats, pair);
+	return stats;
+}
+
+static bool
+stats_feed(void *object, const struct mpd_pair *pair)
+{
+	mpd_stats_feed(object, pair);
+	return true;
+}
+
+static void
+stats_free(void *object)
+{
+	mpd_stats_free(object);
+}
+
+static const struct replay_parser entity_parser = {
+	entity_begin, entity_feed, entity_free,
+};
+
+static const struct replay_parser song_parser = {
+	song_begin, song_feed, song_free,
+};
+
+static const struct replay_parser output_parser = {
+	output_begin, output_feed, output_free,
+};
+
+static const struct replay_parser status_parser = {
+	status_begin, status_feed, status_free,
+};
+
+static const struct replay_parser stats_parser = {
+	stats_begin, stats_feed, stats_free,
+};
+
+static const struct {
+	const char *command;
+	const struct replay_parser *parser;
+} replay_parsers[] = {
+	{ "listallinfo", &entity_parser },
+	{ "lsinfo", &entity_parser },
+	{ "listall", &entity_parser },
+	{ "playlistinfo", &song_parser },
+	{ "playlistid", &song_parser },
+	{ "plchanges", &song_parser },
+	{ "currentsong", &song_parser },
+	{ "find", &song_parser },
+	{ "search", &song_parser },
+	{ "playlistfind", &song_parser },
+	{ "playlistsearch", &song_parser },
+	{ "listplaylistinfo", &song_parser },
+	{ "outputs", &output_parser },
+	{ "status", &status_parser },
+	{ "stats", &stats_parser },
+};
+
+/**
+ * Returns the object parser for the response of a command, or NULL
+ * if only the pairs are parsed.
+ */
+static const struct replay_parser *
+replay_find_parser(const char *command)
+{
+	for (size_t i = 0; i < sizeof(replay_parsers) / sizeof(replay_parsers[0]); ++i)
+		if (strcmp(replay_parsers[i].command, command) == 0)
+			return replay_parsers[i].parser;
+
+	return NULL;
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void *
+grow(void *array, size_t n, size_t size)
+{
+	/* grow in powers of two */
+	if (n > 0 && (n & (n - 1)) != 0)
+		return array;
+
+	void *p = realloc(array, (n > 0 ? n * 2 : 1) * size);
+	if (p == NULL) {
+		fputs("Out of memory\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	return p;
+}
+
+static void
+replay_add_command(struct replay_trace *trace, const char *line,
+		   uint64_t time)
+{
+	trace->commands = grow(trace->commands, trace->num_commands,
+			       sizeof(*trace->commands));
+
+	struct replay_command *command =
+		&trace->commands[trace->num_commands++];
+	size_t length = strcspn(line, " ");
+	if (length >= sizeof(command->name))
+		length = sizeof(command->name) - 1;
+	memcpy(command->name, line, length);
+	command->name[length] = 0;
+	command->time = time;
+}
+
+/**
+ * Splits the sent data into commands.  A command list counts as one
+ * command, and "noidle" does not have a response of its own.
+ */
+static void
+replay_parse_sent(struct replay_trace *trace, struct bench_buffer *pending,
+		  bool *in_list, uint64_t time)
+{
+	char *line = pending->data, *end = pending->data + pending->size;
+	char *newline;
+
+	while ((newline = memchr(line, '\n', (size_t)(end - line))) != NULL) {
+		*newline = 0;
+
+		if (*in_list) {
+			if (strcmp(line, "command_list_end") == 0) {
+				*in_list = false;
+				replay_add_command(trace, "command_list", time);
+			}
+		} else if (strcmp(line, "command_list_begin") == 0 ||
+			   strcmp(line, "command_list_ok_begin") == 0)
+			*in_list = true;
+		else if (strcmp(line, "noidle") != 0)
+			replay_add_command(trace, line, time);
+
+		line = newline + 1;
+	}
+
+	const size_t rest = (size_t)(end - line);
+	memmove(pending->data, line, rest);
+	pending->size = rest;
+}
+
+static bool
+read_varint(const unsigned char **p, const unsigned char *end, uint64_t *value_r)
+{
+	uint64_t value = 0;
+
+	for (unsigned shift = 0; *p < end && shift < 64; shift += 7) {
+		const unsigned char b = *(*p)++;
+		value |= (uint64_t)(b & 0x7f) << shift;
+		if ((b & 0x80) == 0) {
+			*value_r = value;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool
+replay_load(struct replay_trace *trace, const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		perror(path);
+		return false;
+	}
+
+	struct bench_buffer data;
+	bench_buffer_init(&data);
+
+	char buffer[65536];
+	size_t nbytes;
+	while ((nbytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		bench_buffer_append(&data, buffer, nbytes);
+	fclose(file);
+
+	const size_t magic_length = sizeof(MPD_TRACE_MAGIC) - 1;
+	if (data.size < magic_length ||
+	    memcmp(data.data, MPD_TRACE_MAGIC, magic_length) != 0) {
+		fprintf(stderr, "%s: not a trace file\n", path);
+		bench_buffer_deinit(&data);
+		return false;
+	}
+
+	const unsigned char *p = (const unsigned char *)data.data + magic_length;
+	const unsigned char *const end =
+		(const unsigned char *)data.data + data.size;
+
+	struct bench_buffer pending;
+	bench_buffer_init(&pending);
+	bool in_list = false;
+	uint64_t time = 0;
+
+	while (p < end) {
+		const unsigned char direction = *p++;
+		uint64_t delta, length;
+		if (!read_varint(&p, end, &delta) ||
+		    !read_varint(&p, end, &length) ||
+		    length > (uint64_t)(end - p)) {
+			fprintf(stderr, "%s: truncated trace\n", path);
+			break;
+		}
+
+		time += delta;
+
+		if (direction == MPD_TRACE_SENT) {
+			bench_buffer_append(&pending, p, (size_t)length);
+			replay_parse_sent(trace, &pending, &in_list, time);
+		} else if (direction == MPD_TRACE_RECEIVED) {
+			trace->chunks = grow(trace->chunks, trace->num_chunks,
+					     sizeof(*trace->chunks));
+			trace->chunks[trace->num_chunks].offset =
+				trace->received.size;
+			trace->chunks[trace->num_chunks].time = time;
+			++trace->num_chunks;
+
+			bench_buffer_append(&trace->received, p,
+					    (size_t)length);
+		}
+
+		p += length;
+	}
+
+	bench_buffer_deinit(&pending);
+	bench_buffer_deinit(&data);
+	return true;
+}
+
+/**
+ * Returns the time when the byte at the given offset of the received
+ * stream arrived.
+ */
+static uint64_t
+replay_time_of(const struct replay_trace *trace, size_t offset)
+{
+	size_t low = 0, high = trace->num_chunks;
+
+	/* find the last chunk which begins at or before the offset */
+	while (high - low > 1) {
+		const size_t middle = (low + high) / 2;
+		if (trace->chunks[middle].offset <= offset)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	return trace->chunks[low].time;
+}
+
+static struct replay_stats *
+replay_find_stats(struct replay_stats *stats, unsigned *num_stats,
+		  const char *name)
+{
+	for (unsigned i = 0; i < *num_stats; ++i)
+		if (strcmp(stats[i].name, name) == 0)
+			return &stats[i];
+
+	if (*num_stats >= REPLAY_MAX_COMMANDS)
+		/* the last slot collects all others */
+		return &stats[REPLAY_MAX_COMMANDS - 1];
+
+	struct replay_stats *s = &stats[(*num_stats)++];
+	memset(s, 0, sizeof(*s));
+	snprintf(s->name, sizeof(s->name), "%s", name);
+	return s;
+}
+
+/**
+ * Parses one response starting at *pos_p.
+ *
+ * @return false if the trace ends before the response is complete
+ */
+static bool
+replay_response(struct mpd_parser *parser, const struct replay_parser *rp,
+		char *data, size_t size, size_t *pos_p,
+		unsigned long *lines_r, unsigned long *objects_r)
+{
+	size_t pos = *pos_p;
+	void *object = NULL;
+	unsigned long lines = 0, objects = 0;
+	bool complete = false;
+
+	while (!complete && pos < size) {
+		char *line = data + pos;
+		char *newline = memchr(line, '\n', size - pos);
+		if (newline == NULL)
+			break;
+
+		*newline = 0;
+		pos = (size_t)(newline + 1 - data);
+		++lines;
+
+		switch (mpd_parser_feed(parser, line)) {
+		case MPD_PARSER_MALFORMED:
+		case MPD_PARSER_ERROR:
+			complete = true;
+			break;
+
+		case MPD_PARSER_SUCCESS:
+			complete = !mpd_parser_is_discrete(parser);
+			break;
+
+		case MPD_PARSER_PAIR: {
+			const struct mpd_pair pair = {
+				.name = mpd_parser_get_name(parser),
+				.value = mpd_parser_get_value(parser),
+			};
+
+			if (strcmp(pair.name, "binary") == 0) {
+				/* skip the binary chunk and its newline */
+				pos += strtoul(pair.value, NULL, 10) + 1;
+				if (pos > size)
+					pos = size;
+				break;
+			}
+
+			if (rp == NULL)
+				break;
+
+			if (object != NULL && rp->feed(object, &pair))
+				break;
+
+			if (object != NULL)
+				rp->free(object);
+
+			object = rp->begin(&pair);
+			if (object != NULL)
+				++objects;
+			break;
+		}
+		}
+	}
+
+	if (object != NULL)
+		rp->free(object);
+
+	*pos_p = pos;
+	*lines_r = lines;
+	*objects_r = objects;
+	return complete;
+}
+
+/**
+ * Parses all responses once.
+ *
+ * @param first is this the first iteration?  Only then the counters
+ * and the latencies from the trace are accumulated
+ */
+static void
+replay_run(const struct replay_trace *trace, char *data,
+	   struct replay_stats *stats, unsigned *num_stats, bool first)
+{
+	const size_t size = trace->received.size;
+	memcpy(data, trace->received.data, size);
+
+	struct mpd_parser *parser = mpd_parser_new();
+	if (parser == NULL)
+		return;
+
+	size_t pos = 0;
+	if (size >= 7 && memcmp(data, "OK MPD ", 7) == 0) {
+		/* skip the welcome line */
+		const char *newline = memchr(data, '\n', size);
+		pos = newline != NULL ? (size_t)(newline + 1 - data) : size;
+	}
+
+	for (size_t i = 0; pos < size; ++i) {
+		const struct replay_command *command =
+			i < trace->num_commands ? &trace->commands[i] : NULL;
+		const char *name = command != NULL ? command->name : "(unknown)";
+
+		const size_t start = pos;
+		unsigned long lines, objects;
+
+		const uint64_t t0 = now_ns();
+		const bool complete =
+			replay_response(parser, replay_find_parser(name),
+					data, size, &pos, &lines, &objects);
+		const uint64_t t1 = now_ns();
+
+		if (!complete)
+			/* truncated trace */
+			break;
+
+		struct replay_stats *s = replay_find_stats(stats, num_stats,
+							   name);
+		s->parse_ns += t1 - t0;
+
+		if (!first)
+			continue;
+
+		++s->count;
+		s->lines += lines;
+		s->objects += objects;
+		s->bytes += pos - start;
+
+		const uint64_t first_byte = replay_time_of(trace, start);
+		const uint64_t last_byte = replay_time_of(trace, pos - 1);
+		if (command != NULL && first_byte >= command->time)
+			s->server_us += first_byte - command->time;
+		s->transfer_us += last_byte - first_byte;
+	}
+
+	mpd_parser_free(parser);
+}
+
+static void
+print_stats(const struct replay_stats *stats, unsigned num_stats,
+	    unsigned iterations)
+{
+	printf("%-20s %8s %10s %10s %9s %12s %12s %12s\n",
+	       "command", "count", "bytes", "lines", "objects",
+	       "server ms", "transfer ms", "parse ms");
+
+	for (unsigned i = 0; i < num_stats; ++i) {
+		const struct replay_stats *s = &stats[i];
+		printf("%-20s %8lu %10llu %10lu %9lu %12.3f %12.3f %12.3f\n",
+		       s->name, s->count, (unsigned long long)s->bytes,
+		       s->lines, s->objects,
+		       (double)s->server_us / 1e3,
+		       (double)s->transfer_us / 1e3,
+		       (double)s->parse_ns / 1e6 / iterations);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned iterations = 1;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:")) != -1) {
+		switch (option) {
+		case 'n':
+			iterations = (unsigned)strtoul(optarg, NULL, 10);
+			if (iterations == 0)
+				iterations = 1;
+			break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-n ITERATIONS] TRACE\n",
+				argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind + 1 != argc) {
+		fprintf(stderr, "Usage: %s [-n ITERATIONS] TRACE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	struct replay_trace trace = {
+		.chunks = NULL,
+	};
+	bench_buffer_init(&trace.received);
+
+	if (!replay_load(&trace, argv[optind]))
+		return EXIT_FAILURE;
+
+	char *data = malloc(trace.received.size + 1);
+	if (data == NULL) {
+		fputs("Out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	static struct replay_stats stats[REPLAY_MAX_COMMANDS];
+	unsigned num_stats = 0;
+
+	for (unsigned i = 0; i < iterations; ++i)
+		replay_run(&trace, data, stats, &num_stats, i == 0);
+
+	print_stats(stats, num_stats, iterations);
+
+	free(data);
+	free(trace.chunks);
+	free(trace.commands);
+	bench_buffer_deinit(&trace.received);
+	return EXIT_SUCCESS;
+}
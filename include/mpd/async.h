@@ -205,6 +205,40 @@ mpd_async_recv_line(struct mpd_async *async);
 size_t
 mpd_async_recv_raw(struct mpd_async *async, void *dest, size_t length);
 
+/**
+ * Starts recording all data sent and received on this connection,
+ * with monotonic time stamps, to a trace file.  A trace can be
+ * analyzed offline with the "mpdreplay" tool, which feeds it through
+ * the response parsers and separates server latency from client CPU
+ * time.
+ *
+ * If a trace file was already open, it is closed.  Write errors are
+ * ignored.  The trace file is closed by mpd_async_trace_close() or
+ * mpd_async_free().
+ *
+ * To trace a #mpd_connection, pass the object returned by
+ * mpd_connection_get_async().
+ *
+ * @param async the connection
+ * @param path the path of the trace file, which is created or
+ * truncated
+ * @return true on success, false if the file could not be created
+ * (errno is set)
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_async_trace_open(struct mpd_async *async, const char *path);
+
+/**
+ * Stops recording and closes the trace file opened by
+ * mpd_async_trace_open().  Does nothing if no trace is open.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_async_trace_close(struct mpd_async *async);
+
 #ifdef __cplusplus
 }
 #endif
@@ -243,6 +243,33 @@ bool
 mpd_run_reset_tag_types(struct mpd_connection *connection,
 			 const enum mpd_tag_type *types, unsigned n);
 
+/**
+ * Restricts the tags in the response to the next command to the
+ * specified tag types (a "projection"), e.g. to shrink a
+ * "playlistinfo" or "find" response for a list view which shows only
+ * a few columns.
+ *
+ * The next command is sent in a command list together with
+ * "tagtypes" commands which switch to the projection and back to the
+ * tag types configured with the other functions in this header, so
+ * this costs no extra round trip.  If the projection equals the
+ * current tag types, nothing is switched.  If the command fails,
+ * the tag types are restored before the following command.
+ *
+ * This has no effect inside a command list, on "idle" and on MPD
+ * versions older than 0.21.
+ *
+ * @param connection the connection to MPD
+ * @param types an array of tag types to be included in the response
+ * @param n the number of tag types in the array (may be 0)
+ * @return true on success, false on error
+ *
+ * @since libmpdclient 2.27, MPD 0.21
+ */
+bool
+mpd_set_tag_projection(struct mpd_connection *connection,
+		       const enum mpd_tag_type *types, unsigned n);
+
 /**
  * Requests a list of enabled protocol features.
  * Use mpd_recv_protocol_feature_pair() to obtain the list of
@@ -28,14 +28,18 @@
 #include "binary.h"
 #include "capabilities.h"
 #include "connection.h"
+#include "crawl.h"
 #include "database.h"
+#include "decoder.h"
 #include "directory.h"
 #include "entity.h"
 #include "feature.h"
+#include "filter.h"
 #include "fingerprint.h"
 #include "idle.h"
 #include "list.h"
 #include "message.h"
+#include "metrics.h"
 #include "mixer.h"
 #include "mount.h"
 #include "neighbor.h"
@@ -43,21 +47,29 @@
 #include "pair.h"
 #include "partition.h"
 #include "password.h"
+#include "pipeline.h"
 #include "player.h"
 #include "playlist.h"
 #include "queue.h"
+#include "queue_view.h"
 #include "readpicture.h"
 #include "recv.h"
 #include "replay_gain.h"
 #include "response.h"
 #include "search.h"
+#include "search_cursor.h"
+#include "search_index.h"
 #include "send.h"
+#include "server_capabilities.h"
 #include "settings.h"
 #include "song.h"
+#include "song_sort.h"
+#include "song_table.h"
 #include "stats.h"
 #include "status.h"
 #include "sticker.h"
 #include "stringnormalization.h"
+#include "tag_tree.h"
 
 /* this is a generated header and may be installed in a different
    filesystem tree, therefore we can't use just "version.h" */
@@ -17,6 +17,9 @@
 #include <stdbool.h>
 
 struct mpd_async;
+struct mpd_settings;
+struct mpd_status;
+struct mpd_song;
 
 /**
  * \struct mpd_connection
@@ -76,7 +79,10 @@ extern "C" {
  *
  * @param host the server's host name, IP address or Unix socket path.
  * If the resolver returns more than one IP address for a host name,
- * this functions tries all of them until one accepts the connection.
+ * this functions tries all of them until one accepts the connection;
+ * since libmpdclient 2.27, the attempts are staggered and overlap
+ * ("Happy Eyeballs", RFC 8305), and resolver results are cached for
+ * one minute.
  * `NULL` is allowed here, which will connect to the default host
  * (using the `MPD_HOST` environment variable if present).
  * @param port the TCP port to connect to, 0 for default port (using
@@ -113,6 +119,25 @@ mpd_malloc
 struct mpd_connection *
 mpd_connection_new_async(struct mpd_async *async, const char *welcome);
 
+/**
+ * Opens a new connection to a MPD server, like mpd_connection_new(),
+ * but with a #mpd_settings object, which may contain a connection
+ * setup profile (see mpd_settings_set_tag_types() and others).  The
+ * profile is sent in one command list together with the connection,
+ * which saves one round trip per command.
+ *
+ * @param settings the settings created with mpd_settings_new(); the
+ * connection takes ownership, and it is freed by
+ * mpd_connection_free() (or by this function on out-of-memory)
+ * @return a mpd_connection object (which may have failed to connect),
+ * or `NULL` on out-of-memory
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_connection *
+mpd_connection_new_settings(struct mpd_settings *settings);
+
 /**
  * Close the connection and free all memory.
  *
@@ -129,6 +154,36 @@ void mpd_connection_free(struct mpd_connection *connection);
 const struct mpd_settings *
 mpd_connection_get_settings(const struct mpd_connection *connection);
 
+/**
+ * Returns the response to "status" which was received while
+ * connecting, if mpd_settings_set_initial_state() was enabled.  The
+ * caller takes ownership and must free it with mpd_status_free();
+ * subsequent calls return NULL.
+ *
+ * @param connection the connection to MPD
+ * @return the status, or NULL if none is available
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_status *
+mpd_connection_take_initial_status(struct mpd_connection *connection);
+
+/**
+ * Returns the response to "currentsong" which was received while
+ * connecting, if mpd_settings_set_initial_state() was enabled.  The
+ * caller takes ownership and must free it with mpd_song_free();
+ * subsequent calls return NULL.
+ *
+ * @param connection the connection to MPD
+ * @return the current song, or NULL if there is none
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_song *
+mpd_connection_take_initial_song(struct mpd_connection *connection);
+
 /**
  * Enables (or disables) TCP keepalives.
  *
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * Fetching the whole database over several connections.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_CRAWL_H
+#define MPD_CRAWL_H
+
+#include <stdbool.h>
+
+struct mpd_connection;
+struct mpd_song_table;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Receives all songs of the database (like "listallinfo") and
+ * appends them to a #mpd_song_table.
+ *
+ * The top-level directories are listed with "lsinfo" on the given
+ * connection; then their subtrees are fetched with "listallinfo" on
+ * up to #n_connections connections at the same time, each one
+ * received and parsed in its own thread.  The additional connections
+ * are opened with the host, port, timeout and password of the given
+ * connection and are closed before this function returns; on these,
+ * only the tags which have a column in the table are enabled.  If
+ * an additional connection cannot be opened, the others take over
+ * its share.
+ *
+ * The songs are appended in the same order as with "listallinfo".
+ *
+ * @param connection the connection to MPD
+ * @param n_connections the maximum number of connections, including
+ * the given one; 0 or 1 sends a single "listallinfo"
+ * @param table the table to append to
+ * @return true on success, false on error (errors on additional
+ * connections are copied to the given one); on error, the table may
+ * contain some of the songs
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_crawl_database(struct mpd_connection *connection,
+		   unsigned n_connections,
+		   struct mpd_song_table *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
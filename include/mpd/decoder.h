@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * A resumable response parser for users of the #mpd_async API.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_DECODER_H
+#define MPD_DECODER_H
+
+#include "error.h"
+#include "protocol.h"
+#include "compiler.h"
+
+#include <stdbool.h>
+
+struct mpd_song;
+struct mpd_entity;
+struct mpd_output;
+struct mpd_status;
+struct mpd_stats;
+
+/**
+ * The kind of objects a #mpd_decoder builds from the response.
+ */
+enum mpd_decoder_type {
+	/**
+	 * Songs, directories and playlists, e.g. from "lsinfo" or
+	 * "listallinfo"; use mpd_decoder_take_entity().
+	 */
+	MPD_DECODER_ENTITY,
+
+	/**
+	 * Songs, e.g. from "playlistinfo", "find" or "currentsong";
+	 * use mpd_decoder_take_song().
+	 */
+	MPD_DECODER_SONG,
+
+	/**
+	 * Audio outputs from "outputs"; use
+	 * mpd_decoder_take_output().
+	 */
+	MPD_DECODER_OUTPUT,
+
+	/**
+	 * The response of "status"; use mpd_decoder_take_status().
+	 */
+	MPD_DECODER_STATUS,
+
+	/**
+	 * The response of "stats"; use mpd_decoder_take_stats().
+	 */
+	MPD_DECODER_STATS,
+};
+
+enum mpd_decoder_result {
+	/**
+	 * The line has been consumed, and the response continues.
+	 */
+	MPD_DECODER_MORE,
+
+	/**
+	 * MPD has sent "list_OK": the response of one command in a
+	 * command list is complete.  The decoder continues with the
+	 * next command's response; call mpd_decoder_begin() first if
+	 * its type differs.
+	 */
+	MPD_DECODER_NEXT,
+
+	/**
+	 * MPD has sent "OK": the response is complete.
+	 */
+	MPD_DECODER_DONE,
+
+	/**
+	 * MPD has sent "ACK", or the response was malformed.  Use
+	 * mpd_decoder_get_error() for details.
+	 */
+	MPD_DECODER_ERROR,
+};
+
+/**
+ * \struct mpd_decoder
+ *
+ * This object parses a response line by line, without ever blocking,
+ * and builds the same objects as the mpd_recv_*() functions.  It is
+ * meant for event loops which drive a #mpd_async object (or any
+ * other transport) and want to process many responses concurrently.
+ *
+ *     struct mpd_decoder *decoder = mpd_decoder_new(MPD_DECODER_SONG);
+ *     mpd_async_send_command(async, "playlistinfo", NULL);
+ *
+ *     // whenever the socket is readable:
+ *     mpd_async_io(async, MPD_ASYNC_EVENT_READ);
+ *     char *line;
+ *     while ((line = mpd_async_recv_line(async)) != NULL) {
+ *         enum mpd_decoder_result result =
+ *             mpd_decoder_feed(decoder, line);
+ *
+ *         struct mpd_song *song;
+ *         while ((song = mpd_decoder_take_song(decoder)) != NULL)
+ *             handle_song(song);
+ *
+ *         if (result != MPD_DECODER_MORE)
+ *             break;
+ *     }
+ *
+ * Objects are built incrementally; an object becomes available as
+ * soon as the first line of the next one (or the end of the
+ * response) has been fed.  It must be obtained with the
+ * mpd_decoder_take_*() function matching the decoder type before
+ * the next line is fed, or it will be discarded.
+ */
+struct mpd_decoder;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Allocates a new #mpd_decoder object.
+ *
+ * @param type the kind of response which will be fed
+ * @return the object, or NULL on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_decoder *
+mpd_decoder_new(enum mpd_decoder_type type);
+
+/**
+ * Frees a #mpd_decoder object, including all objects which have not
+ * been taken yet.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_decoder_free(struct mpd_decoder *decoder);
+
+/**
+ * Prepares the decoder for a new response (or for the next response
+ * in a command list).  Objects which have not been taken yet are
+ * discarded, and the error is cleared.
+ *
+ * @param decoder the #mpd_decoder object
+ * @param type the kind of response which will be fed
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_decoder_begin(struct mpd_decoder *decoder, enum mpd_decoder_type type);
+
+/**
+ * Feeds one response line (without the trailing newline character),
+ * e.g. one returned by mpd_async_recv_line().  The decoder copies
+ * everything it needs, so the line may be freed after this call; it
+ * may however be modified during the call.
+ *
+ * Must not be called after #MPD_DECODER_DONE or #MPD_DECODER_ERROR
+ * has been returned, until mpd_decoder_begin() is called.
+ *
+ * @param decoder the #mpd_decoder object
+ * @param line a line received from the MPD server
+ * @return the state of the response
+ *
+ * @since libmpdclient 2.27
+ */
+enum mpd_decoder_result
+mpd_decoder_feed(struct mpd_decoder *decoder, char *line);
+
+/**
+ * Takes the next complete entity from a #MPD_DECODER_ENTITY decoder.
+ * The caller must free it with mpd_entity_free().
+ *
+ * @return an entity, or NULL if none is available yet
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_entity *
+mpd_decoder_take_entity(struct mpd_decoder *decoder);
+
+/**
+ * Takes the next complete song from a #MPD_DECODER_SONG decoder.  The
+ * caller must free it with mpd_song_free().
+ *
+ * @return a song, or NULL if none is available yet
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_song *
+mpd_decoder_take_song(struct mpd_decoder *decoder);
+
+/**
+ * Takes the next complete output from a #MPD_DECODER_OUTPUT decoder.
+ * The caller must free it with mpd_output_free().
+ *
+ * @return an output, or NULL if none is available yet
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_output *
+mpd_decoder_take_output(struct mpd_decoder *decoder);
+
+/**
+ * Takes the status from a #MPD_DECODER_STATUS decoder.  It is
+ * available after the response is complete.  The caller must free
+ * it with mpd_status_free().
+ *
+ * @return the status, or NULL if it is not available yet
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_status *
+mpd_decoder_take_status(struct mpd_decoder *decoder);
+
+/**
+ * Takes the statistics from a #MPD_DECODER_STATS decoder.  They are
+ * available after the response is complete.  The caller must free
+ * them with mpd_stats_free().
+ *
+ * @return the statistics, or NULL if they are not available yet
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_stats *
+mpd_decoder_take_stats(struct mpd_decoder *decoder);
+
+/**
+ * Returns the error code after mpd_decoder_feed() has returned
+ * #MPD_DECODER_ERROR, or #MPD_ERROR_SUCCESS.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+enum mpd_error
+mpd_decoder_get_error(const struct mpd_decoder *decoder);
+
+/**
+ * Returns the human readable error message, see
+ * mpd_connection_get_error_message().  Only valid if
+ * mpd_decoder_get_error() returns an error code.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const char *
+mpd_decoder_get_error_message(const struct mpd_decoder *decoder);
+
+/**
+ * Returns the error code sent by MPD.  Only valid if
+ * mpd_decoder_get_error() returns #MPD_ERROR_SERVER.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+enum mpd_server_error
+mpd_decoder_get_server_error(const struct mpd_decoder *decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
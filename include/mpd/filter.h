@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * Client-side evaluation of MPD filter expressions.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_FILTER_H
+#define MPD_FILTER_H
+
+#include "compiler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct mpd_song;
+struct mpd_song_table;
+
+/**
+ * \struct mpd_filter
+ *
+ * A compiled filter expression (see
+ * https://mpd.readthedocs.io/en/latest/protocol.html#filters) which
+ * can be evaluated locally, e.g. on a cached #mpd_song_table for
+ * type-ahead filtering without a round trip to MPD.
+ *
+ * Supported are tag and "file" comparisons with "==", "!=",
+ * "contains", "starts_with", "=~", "!~" and their "_cs"/"_ci" and
+ * negated variants, "any", "base", "modified-since", "added-since",
+ * "prio >=", "!" and "AND".  "AudioFormat" is not supported.
+ *
+ * Case folding is limited to ASCII; other characters are compared
+ * exactly.  Regular expressions are POSIX extended regular
+ * expressions, not PCRE.
+ */
+struct mpd_filter;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Parses a filter expression.
+ *
+ * @param expression the expression, e.g. "((Artist == 'Foo') AND
+ * (Title contains 'bar'))"
+ * @param fold_case the default for operators without a "_cs"/"_ci"
+ * suffix: true for "search" semantics, false for "find" semantics
+ * @return the new filter, or NULL on error (errno is EINVAL on a
+ * syntax error or an unsupported expression, ENOMEM on out of
+ * memory)
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_filter *
+mpd_filter_new(const char *expression, bool fold_case);
+
+/**
+ * Frees a filter.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_filter_free(struct mpd_filter *filter);
+
+/**
+ * Does the song match the filter?
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+bool
+mpd_filter_match(const struct mpd_filter *filter,
+		 const struct mpd_song *song);
+
+/**
+ * Finds all rows of a #mpd_song_table which match the filter.  Tags
+ * without a column in the table are treated as absent.
+ *
+ * @param rows receives the indices of the matching rows in ascending
+ * order; it must have room for mpd_song_table_get_length() elements
+ * @param n_threads the maximum number of threads to use; 0 or 1
+ * scans in the calling thread; large tables are split into
+ * contiguous ranges, one per thread
+ * @return the number of matching rows
+ *
+ * @since libmpdclient 2.27
+ */
+unsigned
+mpd_filter_scan(const struct mpd_filter *filter,
+		const struct mpd_song_table *table,
+		uint32_t *rows, unsigned n_threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
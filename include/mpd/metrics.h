@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * Performance counters and latency histograms of a connection.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_METRICS_H
+#define MPD_METRICS_H
+
+#include "compiler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct mpd_connection;
+
+/**
+ * The counters of a #mpd_metrics object.
+ */
+enum mpd_metric {
+	/**
+	 * The number of bytes sent to MPD.
+	 */
+	MPD_METRIC_BYTES_SENT,
+
+	/**
+	 * The number of bytes received from MPD.
+	 */
+	MPD_METRIC_BYTES_RECEIVED,
+
+	/**
+	 * The number of send() and sendmsg() system calls.
+	 */
+	MPD_METRIC_SEND_CALLS,
+
+	/**
+	 * The number of recv() system calls.
+	 */
+	MPD_METRIC_RECV_CALLS,
+
+	/**
+	 * The number of select() system calls.
+	 */
+	MPD_METRIC_SELECT_CALLS,
+
+	/**
+	 * The number of response lines received.
+	 */
+	MPD_METRIC_LINES,
+
+	/**
+	 * The number of objects (songs, entities, outputs, status
+	 * ...) returned by the mpd_recv_*() functions.  This is not
+	 * the number of heap allocations: each object may consist of
+	 * several of them.
+	 */
+	MPD_METRIC_OBJECTS,
+
+	/**
+	 * The number of bytes moved inside the input and output
+	 * buffers to make room for new data.
+	 */
+	MPD_METRIC_BUFFER_MOVED,
+
+	/**
+	 * The number of counters; this is not a valid counter.
+	 */
+	MPD_METRIC_COUNT
+};
+
+/**
+ * \struct mpd_metrics
+ *
+ * A snapshot of the performance counters of a #mpd_connection,
+ * obtained with mpd_connection_get_metrics().
+ *
+ * Additionally, it contains a latency histogram for each command name
+ * which was sent: the time from flushing the command until the end of
+ * its response was received.  The histogram buckets have a relative
+ * width of 12.5%, from one microsecond to more than 19 hours.
+ */
+struct mpd_metrics;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Enables collecting performance counters on this connection.
+ * Metrics are disabled by default, and then cost nothing but a
+ * pointer check.
+ *
+ * @param connection the connection to MPD
+ * @return true on success, false on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_connection_enable_metrics(struct mpd_connection *connection);
+
+/**
+ * Obtains a copy of the current performance counters.
+ *
+ * @param connection the connection to MPD
+ * @return a #mpd_metrics object which must be freed with
+ * mpd_metrics_free(), or NULL if metrics are not enabled (or on out
+ * of memory)
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_metrics *
+mpd_connection_get_metrics(const struct mpd_connection *connection);
+
+/**
+ * Frees a #mpd_metrics object.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_metrics_free(struct mpd_metrics *metrics);
+
+/**
+ * Returns the value of a counter.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+uint64_t
+mpd_metrics_get(const struct mpd_metrics *metrics, enum mpd_metric metric);
+
+/**
+ * Returns the number of distinct commands which have a latency
+ * histogram.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+unsigned
+mpd_metrics_get_num_commands(const struct mpd_metrics *metrics);
+
+/**
+ * Returns the name of a command.
+ *
+ * @param i the index of the command, less than
+ * mpd_metrics_get_num_commands()
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const char *
+mpd_metrics_get_command_name(const struct mpd_metrics *metrics, unsigned i);
+
+/**
+ * Returns the number of responses of a command which have been
+ * received completely.
+ *
+ * @param i the index of the command, less than
+ * mpd_metrics_get_num_commands()
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+uint64_t
+mpd_metrics_get_command_count(const struct mpd_metrics *metrics, unsigned i);
+
+/**
+ * Returns a round-trip latency percentile of a command.
+ *
+ * @param i the index of the command, less than
+ * mpd_metrics_get_num_commands()
+ * @param percentile a number between 0 and 100, e.g. 99.9
+ * @return the latency in microseconds (the upper bound of the
+ * histogram bucket), or 0 if there are no samples
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+uint64_t
+mpd_metrics_get_command_latency(const struct mpd_metrics *metrics,
+				unsigned i, double percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * A queue which allows submitting commands from several threads,
+ * while one thread owns the #mpd_connection and executes them.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_PIPELINE_H
+#define MPD_PIPELINE_H
+
+#include "compiler.h"
+
+#include <stdbool.h>
+#include <stdarg.h>
+
+struct mpd_connection;
+
+/**
+ * \struct mpd_pipeline
+ *
+ * A multi-producer single-consumer queue of MPD commands.  Any
+ * thread may call mpd_pipeline_submit() at any time without locking;
+ * exactly one thread (the one which owns the #mpd_connection) calls
+ * mpd_pipeline_run(), which sends all pending commands in one command
+ * list and invokes the completion callbacks in submission order.
+ *
+ * Example:
+ *
+ *     // any thread
+ *     mpd_pipeline_submit(pipeline, on_status, ctx, "status", NULL);
+ *
+ *     // the I/O thread
+ *     if (!mpd_pipeline_run(pipeline, conn))
+ *         handle_error(conn);
+ */
+struct mpd_pipeline;
+
+/**
+ * Called by mpd_pipeline_run() when the response of a command is
+ * available.  The connection is positioned at the beginning of this
+ * command's response, and the callback may use the mpd_recv_*()
+ * functions to parse it.  It must not call mpd_response_finish() or
+ * mpd_response_next(), and it must return all pairs it has obtained
+ * with mpd_recv_pair().  Unparsed lines are skipped after the
+ * callback returns.
+ *
+ * If the command has failed, mpd_connection_get_error() returns the
+ * error while the callback runs.  If #connection is NULL, the command
+ * was discarded by mpd_pipeline_free() without being executed.
+ *
+ * @param connection the connection to MPD, or NULL
+ * @param ctx the opaque pointer passed to mpd_pipeline_submit()
+ */
+typedef void (*mpd_pipeline_callback)(struct mpd_connection *connection,
+				      void *ctx);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Allocates a new, empty #mpd_pipeline object.
+ *
+ * @return the object, or NULL on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_pipeline *
+mpd_pipeline_new(void);
+
+/**
+ * Frees a #mpd_pipeline object.  The callbacks of commands which are
+ * still pending are invoked with a NULL connection.  No other thread
+ * may use the object while this function runs.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_pipeline_free(struct mpd_pipeline *pipeline);
+
+/**
+ * Appends a command to the pipeline.  This function is thread-safe
+ * and lock-free; it may be called concurrently from any number of
+ * threads, and concurrently with mpd_pipeline_run().
+ *
+ * @param pipeline the #mpd_pipeline object
+ * @param callback a function which parses the response, or NULL to
+ * discard it
+ * @param ctx an opaque pointer passed to the callback
+ * @param command the command name, followed by arguments, terminated
+ * by NULL.  The arguments should be of type 'const char *'
+ * @return true on success, false on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_sentinel
+bool
+mpd_pipeline_submit(struct mpd_pipeline *pipeline,
+		    mpd_pipeline_callback callback, void *ctx,
+		    const char *command, ...);
+
+/**
+ * Like mpd_pipeline_submit(), but takes a va_list.
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_pipeline_submit_v(struct mpd_pipeline *pipeline,
+		      mpd_pipeline_callback callback, void *ctx,
+		      const char *command, va_list args);
+
+/**
+ * Executes all commands which have been submitted so far.  They are
+ * sent as one or more command lists, and their callbacks are invoked
+ * in submission order.  This function must only be called by one
+ * thread at a time.
+ *
+ * If a command fails with a server error, its callback sees the
+ * error; the error is cleared afterwards, and the commands which
+ * were submitted after it are sent again in the next command list.
+ *
+ * @param pipeline the #mpd_pipeline object
+ * @param connection the connection to MPD; it must not be receiving
+ * a response or sending a command list
+ * @return true on success, false if the connection has failed (the
+ * callbacks of the commands in the failed command list are invoked
+ * with the error, all others stay in the pipeline)
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_pipeline_run(struct mpd_pipeline *pipeline,
+		 struct mpd_connection *connection);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
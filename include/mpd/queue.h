@@ -883,6 +883,109 @@ mpd_send_range_id(struct mpd_connection *connection, unsigned id,
 bool
 mpd_run_range_id(struct mpd_connection *connection, unsigned id,
 		 float start, float end);
+
+/**
+ * Appends many songs to the queue ("addid" for each URI).  The
+ * commands are sent in command lists of a bounded size.  If MPD
+ * rejects one URI, the error is recorded for this item, and the
+ * following items are sent in the next command list.
+ *
+ * @param connection the connection to MPD
+ * @param uris an array of URIs
+ * @param n the number of elements in #uris
+ * @param ids_r an array of #n elements (may be NULL) which receives
+ * the id of each new song, or -1 if this URI was rejected
+ * @return the number of songs which were added, or -1 if the
+ * connection has failed (the contents of #ids_r are undefined then)
+ *
+ * @since libmpdclient 2.27
+ */
+int
+mpd_run_add_id_multi(struct mpd_connection *connection,
+		     const char *const *uris, unsigned n, int *ids_r);
+
+/**
+ * Like mpd_run_add_id_multi(), but inserts the songs at the
+ * specified position (in the given order).
+ *
+ * @param connection the connection to MPD
+ * @param uris an array of URIs
+ * @param n the number of elements in #uris
+ * @param to the position of the first new song
+ * @param ids_r an array of #n elements (may be NULL) which receives
+ * the id of each new song, or -1 if this URI was rejected
+ * @return the number of songs which were added, or -1 if the
+ * connection has failed
+ *
+ * @since libmpdclient 2.27
+ */
+int
+mpd_run_add_id_multi_to(struct mpd_connection *connection,
+			const char *const *uris, unsigned n, unsigned to,
+			int *ids_r);
+
+/**
+ * Deletes many songs from the queue ("deleteid" for each id), see
+ * mpd_run_add_id_multi() for how the commands are sent.
+ *
+ * @param connection the connection to MPD
+ * @param ids an array of song ids
+ * @param n the number of elements in #ids
+ * @param success_r an array of #n elements (may be NULL) which
+ * receives the result of each item
+ * @return the number of songs which were deleted, or -1 if the
+ * connection has failed
+ *
+ * @since libmpdclient 2.27
+ */
+int
+mpd_run_delete_id_multi(struct mpd_connection *connection,
+			const unsigned *ids, unsigned n, bool *success_r);
+
+/**
+ * Moves many songs ("moveid" for each id), see
+ * mpd_run_add_id_multi() for how the commands are sent.  The moves
+ * are executed in array order.
+ *
+ * To apply a permutation, pass the ids in their new order and NULL
+ * as #to: song ids[i] is then moved to position i, which leaves the
+ * first #n queue entries in the order of #ids.
+ *
+ * @param connection the connection to MPD
+ * @param ids an array of song ids
+ * @param to an array of #n destination positions, or NULL
+ * @param n the number of elements in #ids
+ * @param success_r an array of #n elements (may be NULL) which
+ * receives the result of each item
+ * @return the number of songs which were moved, or -1 if the
+ * connection has failed
+ *
+ * @since libmpdclient 2.27
+ */
+int
+mpd_run_move_id_multi(struct mpd_connection *connection,
+		      const unsigned *ids, const unsigned *to, unsigned n,
+		      bool *success_r);
+
+/**
+ * Changes the priority of many songs ("prioid" for each id), see
+ * mpd_run_add_id_multi() for how the commands are sent.
+ *
+ * @param connection the connection to MPD
+ * @param priority a number between 0 and 255
+ * @param ids an array of song ids
+ * @param n the number of elements in #ids
+ * @param success_r an array of #n elements (may be NULL) which
+ * receives the result of each item
+ * @return the number of songs which were changed, or -1 if the
+ * connection has failed
+ *
+ * @since libmpdclient 2.27
+ */
+int
+mpd_run_prio_id_multi(struct mpd_connection *connection, unsigned priority,
+		      const unsigned *ids, unsigned n, bool *success_r);
+
 #ifdef __cplusplus
 }
 #endif
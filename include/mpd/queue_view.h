@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * Keeping a window of the queue up to date.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_QUEUE_VIEW_H
+#define MPD_QUEUE_VIEW_H
+
+#include "compiler.h"
+
+#include <stdbool.h>
+
+struct mpd_connection;
+struct mpd_song;
+
+/**
+ * \struct mpd_queue_view
+ *
+ * A cache of the songs at some positions of the queue: the rows
+ * which are visible in a user interface, plus a margin before and
+ * after them, so scrolling does not need to wait for MPD.  Unlike a
+ * full mirror of the queue, its size does not depend on the length
+ * of the queue.
+ *
+ * Scrolling (mpd_queue_view_set_visible()) fetches only the rows
+ * which were not cached yet.  After an #MPD_IDLE_QUEUE event,
+ * mpd_queue_view_update() fetches the rows of the window which have
+ * changed ("plchanges" limited to the window) together with the
+ * queue length in one command list.
+ */
+struct mpd_queue_view;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Creates an empty view.  It is synchronized by the first call to
+ * mpd_queue_view_set_visible() or mpd_queue_view_update().
+ *
+ * @param margin the number of rows to prefetch before and after the
+ * visible rows
+ * @return the new view, or NULL on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_queue_view *
+mpd_queue_view_new(unsigned margin);
+
+/**
+ * Frees a view and all songs in it.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_queue_view_free(struct mpd_queue_view *view);
+
+/**
+ * Sets the visible range of positions and fetches the rows of the
+ * new window which are not cached yet; rows which have left the
+ * window are freed.
+ *
+ * The range may exceed the end of the queue; the window is clipped
+ * to the queue length of the last update.
+ *
+ * @param connection the connection to MPD
+ * @param start the first visible position
+ * @param end the end of the visible range (exclusive)
+ * @return true on success, false on error
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_queue_view_set_visible(struct mpd_queue_view *view,
+			   struct mpd_connection *connection,
+			   unsigned start, unsigned end);
+
+/**
+ * Synchronizes the view with the queue: fetches the queue version
+ * and length ("status") and the rows of the window which have changed
+ * since the last update.  Call this after mpd_recv_idle() has
+ * returned #MPD_IDLE_QUEUE (i.e. the "playlist" event).
+ *
+ * On error, the cached rows are discarded, because they may be
+ * partially updated; the next call fetches the whole window again.
+ *
+ * @param connection the connection to MPD
+ * @return true on success, false on error
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_queue_view_update(struct mpd_queue_view *view,
+		      struct mpd_connection *connection);
+
+/**
+ * @return the queue length as of the last update
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+unsigned
+mpd_queue_view_get_length(const struct mpd_queue_view *view);
+
+/**
+ * @return the queue version as of the last update, or 0 if the view
+ * has not been synchronized yet or the last update has failed
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+unsigned
+mpd_queue_view_get_version(const struct mpd_queue_view *view);
+
+/**
+ * Returns the song at a position of the queue.  The song is owned by
+ * the view and is freed when it leaves the window or changes.
+ *
+ * @return the song, or NULL if the position is not cached
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const struct mpd_song *
+mpd_queue_view_get_song(const struct mpd_queue_view *view,
+			unsigned position);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
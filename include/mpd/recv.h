@@ -13,6 +13,7 @@
 #define MPD_RECV_H
 
 #include "compiler.h"
+#include "tag.h"
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -20,6 +21,52 @@
 struct mpd_pair;
 struct mpd_connection;
 
+/**
+ * Well-known pair names, passed to #mpd_pair_handler as "token".
+ * Tokens below #MPD_PAIR_TOKEN_FILE are tag types (#mpd_tag_type).
+ * The values of this enum are fixed; they do not move when tag types
+ * or tokens are added, so a tag type which an application does not
+ * know yet (a value between #MPD_TAG_COUNT and #MPD_PAIR_TOKEN_FILE)
+ * or a new token (between #MPD_PAIR_TOKEN_FILE and
+ * #MPD_PAIR_TOKEN_OTHER) can be treated like #MPD_PAIR_TOKEN_OTHER.
+ *
+ * @since libmpdclient 2.27
+ */
+enum mpd_pair_token {
+	MPD_PAIR_TOKEN_FILE = 0x1000,
+	MPD_PAIR_TOKEN_DIRECTORY,
+	MPD_PAIR_TOKEN_PLAYLIST,
+	MPD_PAIR_TOKEN_LAST_MODIFIED,
+	MPD_PAIR_TOKEN_ADDED,
+	MPD_PAIR_TOKEN_TIME,
+	MPD_PAIR_TOKEN_DURATION,
+	MPD_PAIR_TOKEN_RANGE,
+	MPD_PAIR_TOKEN_FORMAT,
+	MPD_PAIR_TOKEN_POS,
+	MPD_PAIR_TOKEN_ID,
+	MPD_PAIR_TOKEN_PRIO,
+
+	/**
+	 * Any other name.  New tokens are added before this one.
+	 */
+	MPD_PAIR_TOKEN_OTHER = 0x1fff,
+};
+
+/**
+ * Callback for mpd_recv_pairs().  The name and the value point into
+ * the input buffer and are only valid during this call; both are
+ * null-terminated, but the lengths are known already.
+ *
+ * @param token a #mpd_tag_type or a #mpd_pair_token value
+ * @param ctx the pointer passed to mpd_recv_pairs()
+ * @return true to continue, false to stop receiving pairs
+ *
+ * @since libmpdclient 2.27
+ */
+typedef bool (*mpd_pair_handler)(const char *name, size_t name_length,
+				 const char *value, size_t value_length,
+				 int token, void *ctx);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -56,6 +103,29 @@ mpd_malloc
 struct mpd_pair *
 mpd_recv_pair_named(struct mpd_connection *connection, const char *name);
 
+/**
+ * Receives all pairs of the current response (up to the next
+ * "list_OK" in a command list) and passes each one to a handler.
+ * Unlike mpd_recv_pair(), this neither requires mpd_return_pair()
+ * nor a strlen() call, and the well-known names are already
+ * identified, so applications can build their own data structures
+ * without #mpd_song or #mpd_entity.
+ *
+ * If the handler stops early, the rest of the response can be
+ * discarded with mpd_response_finish().
+ *
+ * @param connection the connection to MPD
+ * @param handler the function which is invoked for each pair
+ * @param ctx an opaque pointer passed to the handler
+ * @return true on success (including a handler which stopped early),
+ * false on error
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_recv_pairs(struct mpd_connection *connection,
+	       mpd_pair_handler handler, void *ctx);
+
 /**
  * Indicates that the pair object is not needed anymore, and can be
  * freed.  You must free the previous #mpd_pair object before calling
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * Page through large database search results.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_SEARCH_CURSOR_H
+#define MPD_SEARCH_CURSOR_H
+
+#include "compiler.h"
+
+#include <stdbool.h>
+
+struct mpd_connection;
+struct mpd_song;
+
+/**
+ * \struct mpd_search_cursor
+ *
+ * Walks through the result of a database search ("find" or "search")
+ * one page at a time, using the "window" parameter.  This is meant
+ * for user interfaces which display a scrolling list of a huge
+ * result.
+ *
+ * After a page has been received, the request for the following page
+ * is sent right away, and its response is only read when that page
+ * is requested.  Thus, the server's response travels over the network
+ * while the caller displays the current page.  Recently used pages
+ * are cached, so scrolling back does not need a round trip.
+ *
+ * While a prefetch is pending, the connection is busy: call
+ * mpd_search_cursor_sync() before sending other commands.
+ *
+ *     struct mpd_search_cursor *cursor =
+ *         mpd_search_cursor_new(false, "(Artist contains 'queen')",
+ *                               "Title", false, 100);
+ *     unsigned length;
+ *     struct mpd_song *const *songs =
+ *         mpd_search_cursor_get_page(cursor, conn, 0, &length);
+ */
+struct mpd_search_cursor;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Allocates a new #mpd_search_cursor object.  This does not send
+ * anything to MPD.
+ *
+ * @param exact if true, uses "find", else "search"
+ * @param expression the filter expression, see
+ * mpd_search_add_expression()
+ * @param sort the name of the sort tag, or NULL for MPD's default
+ * order
+ * @param descending sort in reverse order?
+ * @param page_size the number of songs per page (non-zero)
+ * @return the object, or NULL on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_search_cursor *
+mpd_search_cursor_new(bool exact, const char *expression,
+		      const char *sort, bool descending,
+		      unsigned page_size);
+
+/**
+ * Frees a #mpd_search_cursor object and all cached pages.  If a
+ * prefetch is pending, its response is left unread on the
+ * connection; call mpd_search_cursor_sync() or mpd_response_finish()
+ * to get rid of it.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_search_cursor_free(struct mpd_search_cursor *cursor);
+
+/**
+ * Returns a page of the search result.  Unless it is cached, it is
+ * received from MPD (or requested first, if it has not been
+ * prefetched).  Afterwards, the next page is prefetched.
+ *
+ * @param cursor the #mpd_search_cursor object
+ * @param connection the connection to MPD
+ * @param index the zero-based page number
+ * @param length_r receives the number of songs in the page; it is
+ * smaller than the page size for the last page, and zero past the end
+ * @return an array of songs owned by the cursor, valid until the next
+ * call on the cursor; NULL on error
+ *
+ * @since libmpdclient 2.27
+ */
+struct mpd_song *const *
+mpd_search_cursor_get_page(struct mpd_search_cursor *cursor,
+			   struct mpd_connection *connection,
+			   unsigned index, unsigned *length_r);
+
+/**
+ * Returns the total number of songs matching the expression, as
+ * reported by "count" (or "searchcount" if the cursor is not exact).
+ * The value is cached after the first call, and it allows
+ * mpd_search_cursor_get_page() to skip the prefetch after the last
+ * page.
+ *
+ * @param cursor the #mpd_search_cursor object
+ * @param connection the connection to MPD
+ * @return the number of songs, or -1 on error
+ *
+ * @since libmpdclient 2.27
+ */
+int
+mpd_search_cursor_get_total(struct mpd_search_cursor *cursor,
+			    struct mpd_connection *connection);
+
+/**
+ * Receives the response of a pending prefetch into the cache, so the
+ * connection may be used for other commands.
+ *
+ * @param cursor the #mpd_search_cursor object
+ * @param connection the connection to MPD
+ * @return true on success, false on error
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_search_cursor_sync(struct mpd_search_cursor *cursor,
+		       struct mpd_connection *connection);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
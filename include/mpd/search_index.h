@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * An in-memory index for type-ahead search on cached metadata.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_SEARCH_INDEX_H
+#define MPD_SEARCH_INDEX_H
+
+#include "compiler.h"
+#include "tag.h"
+
+#include <stdbool.h>
+
+struct mpd_song;
+
+/**
+ * \struct mpd_search_index
+ *
+ * An inverted index over some tags of a set of songs which answers
+ * substring ("contains") and prefix ("starts_with") queries locally,
+ * without sending "search" to MPD on every keystroke.
+ *
+ * Songs are added one by one, e.g. from mpd_recv_song() or the songs
+ * of mpd_recv_entity(), and are identified by their URI.  Matching
+ * ignores ASCII case.
+ *
+ * Substring queries use a trigram index; prefix queries use sorted
+ * per-tag value arrays which are rebuilt on the first prefix query
+ * after a modification.
+ *
+ * This object is not thread-safe, not even for concurrent queries.
+ */
+struct mpd_search_index;
+
+/**
+ * The kind of query for mpd_search_index_query().
+ */
+enum mpd_search_index_mode {
+	/**
+	 * The query string appears anywhere in a tag value.
+	 */
+	MPD_SEARCH_INDEX_CONTAINS,
+
+	/**
+	 * A tag value begins with the query string.
+	 */
+	MPD_SEARCH_INDEX_STARTS_WITH,
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Creates an empty index.
+ *
+ * @param tags the tag types to be indexed
+ * @param n the number of tag types
+ * @return the new index, or NULL on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_search_index *
+mpd_search_index_new(const enum mpd_tag_type *tags, unsigned n);
+
+/**
+ * Frees an index.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_search_index_free(struct mpd_search_index *index);
+
+/**
+ * Adds a song to the index.  A song with the same URI which is
+ * already in the index is replaced.
+ *
+ * @return true on success, false on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_search_index_add(struct mpd_search_index *index,
+		     const struct mpd_song *song);
+
+/**
+ * Removes a song from the index.
+ *
+ * @return true if the song was found and removed
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_search_index_remove(struct mpd_search_index *index, const char *uri);
+
+/**
+ * Begins a full update of the index, e.g. after a
+ * #MPD_IDLE_DATABASE event: re-add all songs with
+ * mpd_search_index_add() (unchanged songs are cheap to re-add) and
+ * then call mpd_search_index_end_update().
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_search_index_begin_update(struct mpd_search_index *index);
+
+/**
+ * Finishes a full update: removes all songs which were not added
+ * since mpd_search_index_begin_update().
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_search_index_end_update(struct mpd_search_index *index);
+
+/**
+ * @return the number of songs in the index
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+unsigned
+mpd_search_index_get_length(const struct mpd_search_index *index);
+
+/**
+ * Looks up songs.
+ *
+ * @param tag the tag to search in, or #MPD_TAG_UNKNOWN to search in
+ * all indexed tags
+ * @param mode the kind of query
+ * @param query the query string
+ * @param uris receives the URIs of the matching songs; they remain
+ * valid until the index is modified or freed
+ * @param max the maximum number of results
+ * @return the number of URIs written to #uris
+ *
+ * @since libmpdclient 2.27
+ */
+unsigned
+mpd_search_index_query(struct mpd_search_index *index,
+		       enum mpd_tag_type tag,
+		       enum mpd_search_index_mode mode,
+		       const char *query,
+		       const char **uris, unsigned max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
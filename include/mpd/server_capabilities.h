@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * A process-wide cache of what a server supports.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_SERVER_CAPABILITIES_H
+#define MPD_SERVER_CAPABILITIES_H
+
+#include "compiler.h"
+#include "feature.h"
+#include "stringnormalization.h"
+#include "tag.h"
+
+#include <stdbool.h>
+
+struct mpd_connection;
+
+/**
+ * \struct mpd_server_capabilities
+ *
+ * An immutable snapshot of the responses to "commands",
+ * "notcommands", "urlhandlers", "tagtypes", "protocol available" and
+ * "stringnormalization available".
+ *
+ * Snapshots are cached per server address, password and server
+ * version, and shared by all connections of the process (also across
+ * threads).  Only the first connection to a server queries it; all
+ * others get the cached snapshot without a round trip.  When the
+ * server reports a different version (e.g. after an upgrade), the
+ * snapshot is queried again.
+ *
+ * Since this is about the server and not about one connection, the
+ * tag types are those from "tagtypes available" (MPD 0.24), or
+ * else those of "tagtypes" on a connection which has all tag types
+ * enabled.
+ */
+struct mpd_server_capabilities;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Returns the capabilities of the server this connection is
+ * connected to, either from the cache or by querying it with one
+ * command list.
+ *
+ * The cache is keyed by host, port, password (of the
+ * #mpd_settings) and server version.  Connections created with
+ * mpd_connection_new_async() have no address, and connections which
+ * have sent another password with mpd_send_password() may have
+ * different permissions, so their capabilities are always queried
+ * and never cached.  The same applies to connections to MPD older
+ * than 0.24 which have disabled tag types (e.g. with
+ * mpd_send_clear_tag_types() or mpd_settings_set_tag_types()); their
+ * snapshot contains only the enabled tag types.
+ *
+ * @param connection the connection to MPD; it must not be in the
+ * middle of a command
+ * @return a new reference, which must be released with
+ * mpd_server_capabilities_unref(), or NULL on error
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_server_capabilities *
+mpd_server_capabilities_get(struct mpd_connection *connection);
+
+/**
+ * Releases a reference obtained with mpd_server_capabilities_get().
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_server_capabilities_unref(struct mpd_server_capabilities *capabilities);
+
+/**
+ * Discards all cached snapshots, e.g. after the server configuration
+ * has changed.  References which are still held remain valid.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_server_capabilities_flush(void);
+
+/**
+ * Returns the sorted list of commands which this client is allowed to
+ * execute ("commands").
+ *
+ * @param n_r receives the number of commands
+ *
+ * @since libmpdclient 2.27
+ */
+const char *const *
+mpd_server_capabilities_get_commands(const struct mpd_server_capabilities *capabilities,
+				     unsigned *n_r);
+
+/**
+ * Returns the sorted list of commands which this client is not
+ * allowed to execute ("notcommands").
+ *
+ * @param n_r receives the number of commands
+ *
+ * @since libmpdclient 2.27
+ */
+const char *const *
+mpd_server_capabilities_get_disallowed_commands(const struct mpd_server_capabilities *capabilities,
+						unsigned *n_r);
+
+/**
+ * Returns the sorted list of URL schemes supported by the server
+ * ("urlhandlers").
+ *
+ * @param n_r receives the number of URL schemes
+ *
+ * @since libmpdclient 2.27
+ */
+const char *const *
+mpd_server_capabilities_get_url_schemes(const struct mpd_server_capabilities *capabilities,
+					unsigned *n_r);
+
+/**
+ * Is this client allowed to execute the specified command?
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+bool
+mpd_server_capabilities_has_command(const struct mpd_server_capabilities *capabilities,
+				    const char *command);
+
+/**
+ * Does the server support the specified URL scheme (e.g. "http://")?
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+bool
+mpd_server_capabilities_has_url_scheme(const struct mpd_server_capabilities *capabilities,
+				       const char *scheme);
+
+/**
+ * Does the server support the specified tag type?
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+bool
+mpd_server_capabilities_has_tag_type(const struct mpd_server_capabilities *capabilities,
+				     enum mpd_tag_type type);
+
+/**
+ * Does the server support the specified protocol feature?  Always
+ * false for MPD older than 0.24.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+bool
+mpd_server_capabilities_has_protocol_feature(const struct mpd_server_capabilities *capabilities,
+					     enum mpd_protocol_feature feature);
+
+/**
+ * Does the server support the specified string normalization option?
+ * Always false for MPD older than 0.25.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+bool
+mpd_server_capabilities_has_stringnormalization(const struct mpd_server_capabilities *capabilities,
+						enum mpd_stringnormalization_option option);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -13,6 +13,9 @@
 #ifndef MPD_SETTINGS_H
 #define MPD_SETTINGS_H
 
+#include "tag.h"
+#include "feature.h"
+
 #include <stdbool.h>
 
 /**
@@ -91,6 +94,133 @@ mpd_settings_get_timeout_ms(const struct mpd_settings *settings);
 const char *
 mpd_settings_get_password(const struct mpd_settings *settings);
 
+/*
+ * The following functions configure a connection setup profile: the
+ * commands which are sent in one command list right after the socket
+ * is connected, without waiting for the welcome message.  This saves
+ * one round trip per command.  Use mpd_connection_new_settings() to
+ * connect with a profile.
+ *
+ * The caller must only configure commands which the server
+ * supports.  If the server rejects one of them, the connection is left
+ * with that server error, and the remaining commands are not executed.
+ *
+ * The profile applies to all alternative settings (e.g. the default
+ * TCP host which is tried if the default local socket fails).
+ */
+
+/**
+ * Clears the list of tag types after connecting, and enables the
+ * specified ones ("tagtypes clear" and "tagtypes enable").
+ *
+ * @param types an array of tag types to enable
+ * @param n the number of tag types in the array; 0 disables all tags
+ * @return true on success, false if out of memory
+ *
+ * @since libmpdclient 2.27, MPD 0.21
+ */
+bool
+mpd_settings_set_tag_types(struct mpd_settings *settings,
+			   const enum mpd_tag_type *types, unsigned n);
+
+/**
+ * Returns the tag types configured with mpd_settings_set_tag_types().
+ *
+ * @param n_r receives the number of tag types
+ * @return the array of tag types, or NULL if the tag types are not
+ * part of the profile
+ *
+ * @since libmpdclient 2.27
+ */
+const enum mpd_tag_type *
+mpd_settings_get_tag_types(const struct mpd_settings *settings, unsigned *n_r);
+
+/**
+ * Clears the list of protocol features after connecting, and enables
+ * the specified ones ("protocol clear" and "protocol enable").
+ *
+ * @param features an array of protocol features to enable
+ * @param n the number of features in the array
+ * @return true on success, false if out of memory
+ *
+ * @since libmpdclient 2.27, MPD 0.24
+ */
+bool
+mpd_settings_set_protocol_features(struct mpd_settings *settings,
+				   const enum mpd_protocol_feature *features,
+				   unsigned n);
+
+/**
+ * Returns the protocol features configured with
+ * mpd_settings_set_protocol_features().
+ *
+ * @param n_r receives the number of features
+ * @return the array of features, or NULL if the features are not
+ * part of the profile
+ *
+ * @since libmpdclient 2.27
+ */
+const enum mpd_protocol_feature *
+mpd_settings_get_protocol_features(const struct mpd_settings *settings,
+				   unsigned *n_r);
+
+/**
+ * Sends "binarylimit" after connecting.
+ *
+ * @param limit the maximum binary chunk size, or 0 to not send
+ * "binarylimit"
+ *
+ * @since libmpdclient 2.27, MPD 0.22.4
+ */
+void
+mpd_settings_set_binary_limit(struct mpd_settings *settings, unsigned limit);
+
+/**
+ * @since libmpdclient 2.27
+ */
+unsigned
+mpd_settings_get_binary_limit(const struct mpd_settings *settings);
+
+/**
+ * Sends "status" and "currentsong" after connecting; their responses
+ * can be obtained with mpd_connection_take_initial_status() and
+ * mpd_connection_take_initial_song().
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_settings_set_initial_state(struct mpd_settings *settings, bool enable);
+
+/**
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_settings_get_initial_state(const struct mpd_settings *settings);
+
+/**
+ * Enables TCP Fast Open for TCP connections, where the operating
+ * system supports it (Linux 4.11 and newer).  The setup profile is
+ * then sent together with the SYN packet if the client holds a Fast
+ * Open cookie of the server.
+ *
+ * Note that errors which would normally be reported by connect()
+ * (e.g. "connection refused") are only noticed when the first data
+ * is exchanged, and no alternative settings are tried then.  For
+ * this reason, Fast Open is not used if the host name resolves to
+ * more than one address; those are connected to one after another
+ * (RFC 8305 "Happy Eyeballs") instead.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_settings_set_fast_open(struct mpd_settings *settings, bool enable);
+
+/**
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_settings_get_fast_open(const struct mpd_settings *settings);
+
 #ifdef __cplusplus
 }
 #endif
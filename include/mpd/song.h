@@ -14,6 +14,7 @@
 #include "compiler.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <time.h>
 
 struct mpd_pair;
@@ -236,6 +237,82 @@ mpd_malloc
 struct mpd_song *
 mpd_recv_song(struct mpd_connection *connection);
 
+/**
+ * Serializes a list of songs into a compact binary "song batch",
+ * e.g. for a cache file or for passing songs to another process.
+ *
+ * The format is versioned and position independent: all references
+ * are offsets, so the buffer may be written to a file and mmap()ed
+ * later.  Integers are stored in host byte order; a batch written on
+ * a host with a different byte order is rejected by
+ * mpd_song_batch_check().
+ *
+ * @param songs the songs to be serialized
+ * @param n the number of songs
+ * @param buffer the destination buffer, aligned to 8 bytes; may be
+ * NULL if size is 0
+ * @param size the size of the buffer
+ * @return the size of the batch in bytes; if this is larger than
+ * size, nothing was written, and the caller should try again with a
+ * larger buffer; 0 if the batch would be larger than 4 GiB
+ *
+ * @since libmpdclient 2.27
+ */
+size_t
+mpd_song_serialize_batch(const struct mpd_song *const *songs, unsigned n,
+			 void *buffer, size_t size);
+
+/**
+ * Validates a song batch created by mpd_song_serialize_batch().  This
+ * must be called once before using mpd_song_batch_get(), because the
+ * latter does not check anything.
+ *
+ * @param buffer the batch, aligned to 8 bytes
+ * @param size the size of the buffer
+ * @param n_r receives the number of songs in the batch
+ * @return true if the batch is valid and was created by a compatible
+ * version of libmpdclient on a host with the same byte order
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_song_batch_check(const void *buffer, size_t size, unsigned *n_r);
+
+/**
+ * Creates a #mpd_song object from a song in a batch which was
+ * validated with mpd_song_batch_check().
+ *
+ * @param buffer the batch
+ * @param i the index of the song, less than the number of songs
+ * @return the new #mpd_song object, or NULL on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_song *
+mpd_song_batch_get(const void *buffer, unsigned i);
+
+/**
+ * Serializes one song; this is a shortcut for
+ * mpd_song_serialize_batch() with one song.
+ *
+ * @since libmpdclient 2.27
+ */
+size_t
+mpd_song_serialize(const struct mpd_song *song, void *buffer, size_t size);
+
+/**
+ * Deserializes a buffer created by mpd_song_serialize().
+ *
+ * @return the new #mpd_song object, or NULL if the buffer is not a
+ * valid batch with exactly one song, or on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_song *
+mpd_song_deserialize(const void *buffer, size_t size);
+
 #ifdef __cplusplus
 }
 #endif
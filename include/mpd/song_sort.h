@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * Client-side sorting of song lists.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_SONG_SORT_H
+#define MPD_SONG_SORT_H
+
+#include "tag.h"
+
+#include <stdbool.h>
+
+struct mpd_song;
+
+/**
+ * One key of a multi-key sort.
+ */
+struct mpd_song_sort_key {
+	/**
+	 * The tag to sort by, or #MPD_TAG_UNKNOWN to sort by URI.
+	 */
+	enum mpd_tag_type tag;
+
+	/**
+	 * Sort in descending order?
+	 */
+	bool descending;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sorts an array of songs by several keys, e.g. artist, album, disc
+ * and track, without a round trip to MPD (whose "sort" supports only
+ * one tag).
+ *
+ * A collation key is computed once for each distinct value:
+ *
+ * - the "*Sort" variant of a tag is preferred (e.g. "ArtistSort"
+ *   for #MPD_TAG_ARTIST), and "AlbumArtist" falls back to "Artist"
+ * - ASCII case and the diacritics of Latin letters are ignored
+ * - "Track" and "Disc" are compared as numbers ("3/12" is 3)
+ * - missing tags are empty strings, which sort first
+ *
+ * Only the first value of a multi-value tag is used.  The sort is
+ * stable: songs with equal keys keep their order.
+ *
+ * @param songs the songs to be sorted in place
+ * @param n the number of songs
+ * @param keys the sort keys, most significant first
+ * @param n_keys the number of sort keys
+ * @param n_threads the maximum number of threads to use; 0 or 1
+ * sorts in the calling thread
+ * @return true on success, false on out of memory (the array is
+ * unmodified)
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_song_sort(struct mpd_song **songs, unsigned n,
+	      const struct mpd_song_sort_key *keys, unsigned n_keys,
+	      unsigned n_threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
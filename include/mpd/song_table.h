@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * A columnar ("structure of arrays") container for large song lists.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_SONG_TABLE_H
+#define MPD_SONG_TABLE_H
+
+#include "compiler.h"
+#include "tag.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct mpd_connection;
+
+/**
+ * \struct mpd_song_table
+ *
+ * An alternative to a list of #mpd_song objects: each attribute is
+ * stored in one array ("column") with one element per song ("row"),
+ * which makes scanning, sorting and filtering hundreds of thousands
+ * of songs cheap.
+ *
+ * Strings (URIs and tag values) are stored in one shared heap and
+ * referenced by their offset.  Tag values are interned: equal values
+ * have equal offsets, so they can be compared and grouped without
+ * strcmp().  The offset 0 refers to an empty string and means "no
+ * value".  Only the first value of a multi-value tag is stored.
+ *
+ * Numeric columns mirror the attributes of #mpd_song; 0 means
+ * unknown.
+ */
+struct mpd_song_table;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Creates an empty table.
+ *
+ * @param tags the tag types which get a column; all others are
+ * ignored
+ * @param n the number of tag types
+ * @return the new table, or NULL on out of memory
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_song_table *
+mpd_song_table_new(const enum mpd_tag_type *tags, unsigned n);
+
+/**
+ * Frees a table and all of its columns.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_song_table_free(struct mpd_song_table *table);
+
+/**
+ * Removes all rows, but keeps the memory allocated for reuse.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_song_table_clear(struct mpd_song_table *table);
+
+/**
+ * Receives all songs of the current response (e.g. to "listallinfo",
+ * "playlistinfo" or "find") and appends them to the table.
+ * Directories and playlists are skipped.  Call mpd_response_finish()
+ * afterwards.
+ *
+ * @param connection the connection to MPD
+ * @param table the table to append to
+ * @return true on success, false on error (including out of memory,
+ * which is reported as #MPD_ERROR_OOM)
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_recv_song_table(struct mpd_connection *connection,
+		    struct mpd_song_table *table);
+
+/**
+ * Parses a response which is already in memory (e.g. a
+ * "listallinfo" response from a trace, a cache file or a bulk read)
+ * and appends its songs to the table, like mpd_recv_song_table().
+ *
+ * Large buffers are split at record boundaries (lines beginning with
+ * "file:", "directory:" or "playlist:") into chunks which are parsed
+ * in parallel; the songs are appended in their original order.
+ *
+ * "OK" and "list_OK" lines are skipped.
+ *
+ * @param table the table to append to
+ * @param data the response text
+ * @param length the length of the response text in bytes
+ * @param n_threads the maximum number of threads to use; 0 or 1
+ * parses in the calling thread
+ * @return true on success, false on error (errno is EINVAL on a
+ * malformed line or an "ACK" line, ENOMEM on out of memory); on
+ * error, the table may contain some of the songs
+ *
+ * @since libmpdclient 2.27
+ */
+bool
+mpd_song_table_parse(struct mpd_song_table *table,
+		     const char *data, size_t length,
+		     unsigned n_threads);
+
+/**
+ * @return the number of rows (songs)
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+unsigned
+mpd_song_table_get_length(const struct mpd_song_table *table);
+
+/**
+ * Returns the string heap; add an offset from a string column to
+ * obtain a null-terminated string.  The pointer is invalidated when
+ * rows are added.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const char *
+mpd_song_table_get_heap(const struct mpd_song_table *table);
+
+/**
+ * Returns the URI column (heap offsets).
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const uint32_t *
+mpd_song_table_get_uris(const struct mpd_song_table *table);
+
+/**
+ * Returns the column of a tag (interned heap offsets).
+ *
+ * @return the column, or NULL if the table has no column for this tag
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const uint32_t *
+mpd_song_table_get_tags(const struct mpd_song_table *table,
+			enum mpd_tag_type type);
+
+/**
+ * Returns the duration column in milliseconds (see
+ * mpd_song_get_duration_ms()).
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const uint32_t *
+mpd_song_table_get_durations_ms(const struct mpd_song_table *table);
+
+/**
+ * Returns the "Last-Modified" column (POSIX UTC time stamps).
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const int64_t *
+mpd_song_table_get_last_modified(const struct mpd_song_table *table);
+
+/**
+ * Returns the "Added" column (POSIX UTC time stamps).
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const int64_t *
+mpd_song_table_get_added(const struct mpd_song_table *table);
+
+/**
+ * Returns the queue position column.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const uint32_t *
+mpd_song_table_get_positions(const struct mpd_song_table *table);
+
+/**
+ * Returns the queue id column.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const uint32_t *
+mpd_song_table_get_ids(const struct mpd_song_table *table);
+
+/**
+ * Returns the queue priority column.
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const uint32_t *
+mpd_song_table_get_priorities(const struct mpd_song_table *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
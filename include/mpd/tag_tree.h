@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+/*! \file
+ * \brief MPD client library
+ *
+ * A compact tree of grouped tag values.
+ *
+ * Do not include this header directly.  Use mpd/client.h instead.
+ */
+
+#ifndef MPD_TAG_TREE_H
+#define MPD_TAG_TREE_H
+
+#include "compiler.h"
+#include "tag.h"
+
+struct mpd_connection;
+
+/**
+ * \struct mpd_tag_tree
+ *
+ * The response to a grouped "list" command (see
+ * mpd_search_add_group_tag()) as a tree, e.g. "AlbumArtist" →
+ * "Album" → "Date" for "list Date group Album group AlbumArtist".
+ * Each tag type is one level of the tree; the outermost group is
+ * level 0.
+ *
+ * Nodes are addressed by their level and their index within the
+ * level.  The children of a node are a contiguous range of indices on
+ * the next level, sorted by byte value and free of duplicates.  All
+ * tag values are interned in one string heap, and all nodes are
+ * stored in one array, so a tree takes about 12 bytes per node plus
+ * one copy of each distinct value.
+ */
+struct mpd_tag_tree;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Receives the response to a "list" command and builds a tree from
+ * it.  The levels are determined by the order of the tag names in
+ * the response; lines which are not tags are ignored.  Call
+ * mpd_response_finish() afterwards.
+ *
+ * @param connection the connection to MPD
+ * @return the new tree (to be freed with mpd_tag_tree_free()), or
+ * NULL on error (including out of memory, which is reported as
+ * #MPD_ERROR_OOM)
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_malloc
+struct mpd_tag_tree *
+mpd_recv_tag_tree(struct mpd_connection *connection);
+
+/**
+ * Frees a tree.
+ *
+ * @since libmpdclient 2.27
+ */
+void
+mpd_tag_tree_free(struct mpd_tag_tree *tree);
+
+/**
+ * @return the number of levels
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+unsigned
+mpd_tag_tree_get_depth(const struct mpd_tag_tree *tree);
+
+/**
+ * @return the tag type of a level
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+enum mpd_tag_type
+mpd_tag_tree_get_tag(const struct mpd_tag_tree *tree, unsigned level);
+
+/**
+ * @return the number of nodes on a level; the nodes of level 0 are
+ * the children of the (implicit) root
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+unsigned
+mpd_tag_tree_get_length(const struct mpd_tag_tree *tree, unsigned level);
+
+/**
+ * @return the tag value of a node
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+const char *
+mpd_tag_tree_get_value(const struct mpd_tag_tree *tree,
+		       unsigned level, unsigned node);
+
+/**
+ * @param level the level of the node; must not be 0
+ * @return the index of the node's parent on the previous level
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+unsigned
+mpd_tag_tree_get_parent(const struct mpd_tag_tree *tree,
+			unsigned level, unsigned node);
+
+/**
+ * Determines the children of a node.
+ *
+ * @param end_r receives the end index of the children (exclusive)
+ * @return the index of the first child on the next level (equal to
+ * *end_r if the node has no children)
+ *
+ * @since libmpdclient 2.27
+ */
+unsigned
+mpd_tag_tree_get_children(const struct mpd_tag_tree *tree,
+			  unsigned level, unsigned node, unsigned *end_r);
+
+/**
+ * Looks up a child by its value with a binary search.
+ *
+ * @param level the level of the child
+ * @param parent the index of the parent on the previous level
+ * (ignored on level 0)
+ * @param value the value to look for
+ * @return the index of the child, or -1 if there is none
+ *
+ * @since libmpdclient 2.27
+ */
+mpd_pure
+int
+mpd_tag_tree_find(const struct mpd_tag_tree *tree, unsigned level,
+		  unsigned parent, const char *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "arg.h"
+#include "quote.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+enum {
+	/**
+	 * The maximum length of a quoted numeric argument: a range of
+	 * two floats (up to 39 integer digits, a sign, a dot and six
+	 * decimal places each), plus the quotes.
+	 */
+	MPD_ARG_MAX = 128,
+};
+
+static const unsigned long long pow10_table[] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000,
+};
+
+static char *
+format_ull(char *p, unsigned long long value)
+{
+	char buffer[24], *q = buffer + sizeof(buffer);
+
+	do {
+		*--q = (char)('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	const size_t length = buffer + sizeof(buffer) - q;
+	memcpy(p, q, length);
+	return p + length;
+}
+
+static char *
+format_ll(char *p, long long value)
+{
+	if (value < 0) {
+		*p++ = '-';
+		return format_ull(p, -(unsigned long long)value);
+	}
+
+	return format_ull(p, (unsigned long long)value);
+}
+
+/**
+ * Formats a floating point number with a fixed number of decimal
+ * places, like printf("%.3f"), but always with a dot as the decimal
+ * separator.
+ */
+static char *
+format_fixed(char *p, float value, unsigned decimals, bool plus)
+{
+	assert(decimals < sizeof(pow10_table) / sizeof(pow10_table[0]));
+
+	if (isnan(value)) {
+		memcpy(p, "nan", 3);
+		return p + 3;
+	}
+
+	const bool negative = signbit(value);
+	if (negative)
+		*p++ = '-';
+	else if (plus)
+		*p++ = '+';
+
+	if (isinf(value)) {
+		memcpy(p, "inf", 3);
+		return p + 3;
+	}
+
+	const float magnitude = negative ? -value : value;
+	const unsigned long long scale = pow10_table[decimals];
+
+	if ((double)magnitude >= 1e18 / (double)scale) {
+		/* a float this large is an integer; "%.0f" does not
+		   emit a decimal separator, so the locale does not
+		   matter */
+		p += sprintf(p, "%.0f", (double)magnitude);
+		if (decimals > 0) {
+			*p++ = '.';
+			memset(p, '0', decimals);
+			p += decimals;
+		}
+
+		return p;
+	}
+
+	/* split the float into its 24 bit mantissa and a binary
+	   exponent; scaling the mantissa is exact in 64 bit integer
+	   arithmetic, and so is rounding half to even (just like
+	   printf()) */
+	int exponent;
+	const float fraction = frexpf(magnitude, &exponent);
+	const unsigned long long mantissa =
+		(unsigned long long)ldexpf(fraction, 24);
+	exponent -= 24;
+
+	unsigned long long scaled = mantissa * scale;
+	if (exponent >= 0) {
+		scaled <<= exponent;
+	} else if (exponent > -64) {
+		const unsigned shift = (unsigned)-exponent;
+		const unsigned long long remainder =
+			scaled & ((1ULL << shift) - 1);
+		const unsigned long long half = 1ULL << (shift - 1);
+
+		scaled >>= shift;
+		if (remainder > half ||
+		    (remainder == half && (scaled & 1) != 0))
+			++scaled;
+	} else
+		/* less than 2^-40, which rounds to zero */
+		scaled = 0;
+
+	p = format_ull(p, scaled / scale);
+	if (decimals > 0) {
+		*p++ = '.';
+
+		scaled %= scale;
+		for (unsigned i = decimals; i > 0; --i) {
+			p[i - 1] = (char)('0' + scaled % 10);
+			scaled /= 10;
+		}
+
+		p += decimals;
+	}
+
+	return p;
+}
+
+static char *
+format_arg(char *p, const struct mpd_arg *arg)
+{
+	switch (arg->type) {
+	case MPD_ARG_STRING:
+		assert(false);
+		break;
+
+	case MPD_ARG_INT:
+		return format_ll(p, arg->value.i);
+
+	case MPD_ARG_UNSIGNED:
+		return format_ull(p, arg->value.u);
+
+	case MPD_ARG_LONG_LONG:
+		return format_ll(p, arg->value.ll);
+
+	case MPD_ARG_FIXED:
+		return format_fixed(p, arg->value.f, arg->decimals,
+				    arg->plus);
+
+	case MPD_ARG_RANGE:
+		p = format_ull(p, arg->value.range.start);
+		*p++ = ':';
+		/* the special value -1 means "open end" */
+		if (arg->value.range.end != UINT_MAX)
+			p = format_ull(p, arg->value.range.end);
+		return p;
+
+	case MPD_ARG_FRANGE:
+		p = format_fixed(p, arg->value.frange.start, 3, false);
+		*p++ = ':';
+		/* a negative end means "open range" */
+		if (arg->value.frange.end >= 0)
+			p = format_fixed(p, arg->value.frange.end, 3, false);
+		return p;
+	}
+
+	return p;
+}
+
+/**
+ * Formats a quoted number; the buffer must have room for at least
+ * #MPD_ARG_MAX bytes.
+ */
+static char *
+quote_number(char *p, const struct mpd_arg *arg)
+{
+	*p++ = '"';
+	p = format_arg(p, arg);
+	*p++ = '"';
+	return p;
+}
+
+char *
+mpd_arg_quote(char *dest, char *end, const struct mpd_arg *arg)
+{
+	assert(dest != NULL);
+	assert(end != NULL);
+	assert(arg != NULL);
+
+	if (arg->type == MPD_ARG_STRING)
+		return quote(dest, end, arg->value.s);
+
+	/* numbers never need escaping; format them right into the
+	   destination buffer if it can hold the longest one */
+	if (end - dest >= MPD_ARG_MAX)
+		return quote_number(dest, arg);
+
+	/* or else into a temporary buffer which gets copied */
+	char buffer[MPD_ARG_MAX];
+	const size_t length = quote_number(buffer, arg) - buffer;
+	if (length > (size_t)(end - dest))
+		return NULL;
+
+	memcpy(dest, buffer, length);
+	return dest + length;
+}
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_ARG_H
+#define MPD_ARG_H
+
+#include <stdbool.h>
+
+enum mpd_arg_type {
+	MPD_ARG_STRING,
+	MPD_ARG_INT,
+	MPD_ARG_UNSIGNED,
+	MPD_ARG_LONG_LONG,
+
+	/**
+	 * A floating point number with a fixed number of decimal
+	 * places.
+	 */
+	MPD_ARG_FIXED,
+
+	/**
+	 * A range of unsigned integers "START:END"; UINT_MAX as end
+	 * means "open end".
+	 */
+	MPD_ARG_RANGE,
+
+	/**
+	 * A range of floating point numbers "START:END" with three
+	 * decimal places; a negative end means "open end".
+	 */
+	MPD_ARG_FRANGE,
+};
+
+/**
+ * A typed command argument.  It is formatted directly into the
+ * output buffer by mpd_arg_quote(), which avoids temporary buffers
+ * and does not depend on the current locale.
+ */
+struct mpd_arg {
+	enum mpd_arg_type type;
+
+	/**
+	 * For #MPD_ARG_FIXED: the number of decimal places; if
+	 * #plus is set, positive numbers get a '+' sign.
+	 */
+	unsigned char decimals;
+	bool plus;
+
+	union {
+		const char *s;
+		int i;
+		unsigned u;
+		long long ll;
+		float f;
+
+		struct {
+			unsigned start, end;
+		} range;
+
+		struct {
+			float start, end;
+		} frange;
+	} value;
+};
+
+static inline struct mpd_arg
+mpd_arg_s(const char *value)
+{
+	struct mpd_arg arg = { .type = MPD_ARG_STRING, .value.s = value };
+	return arg;
+}
+
+static inline struct mpd_arg
+mpd_arg_i(int value)
+{
+	struct mpd_arg arg = { .type = MPD_ARG_INT, .value.i = value };
+	return arg;
+}
+
+static inline struct mpd_arg
+mpd_arg_u(unsigned value)
+{
+	struct mpd_arg arg = { .type = MPD_ARG_UNSIGNED, .value.u = value };
+	return arg;
+}
+
+static inline struct mpd_arg
+mpd_arg_ll(long long value)
+{
+	struct mpd_arg arg = { .type = MPD_ARG_LONG_LONG, .value.ll = value };
+	return arg;
+}
+
+static inline struct mpd_arg
+mpd_arg_fixed(float value, unsigned decimals, bool plus)
+{
+	struct mpd_arg arg = {
+		.type = MPD_ARG_FIXED,
+		.decimals = (unsigned char)decimals,
+		.plus = plus,
+		.value.f = value,
+	};
+	return arg;
+}
+
+static inline struct mpd_arg
+mpd_arg_range(unsigned start, unsigned end)
+{
+	struct mpd_arg arg = {
+		.type = MPD_ARG_RANGE,
+		.value.range = { start, end },
+	};
+	return arg;
+}
+
+static inline struct mpd_arg
+mpd_arg_frange(float start, float end)
+{
+	struct mpd_arg arg = {
+		.type = MPD_ARG_FRANGE,
+		.value.frange = { start, end },
+	};
+	return arg;
+}
+
+/**
+ * Formats the argument, enclosed in double quotes (like quote()).
+ *
+ * @param dest the destination buffer
+ * @param end the end of the destination buffer (pointer to the first
+ * invalid byte)
+ * @return a pointer to the end of the quoted argument, or NULL if the
+ * buffer is too small
+ */
+char *
+mpd_arg_quote(char *dest, char *end, const struct mpd_arg *arg);
+
+#endif
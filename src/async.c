@@ -2,6 +2,10 @@
 // Copyright The Music Player Daemon Project
 
 #include "iasync.h"
+#include "imetrics.h"
+#include "itrace.h"
+#include "probe.h"
+#include "arg.h"
 #include "buffer.h"
 #include "ierror.h"
 #include "quote.h"
@@ -23,12 +27,26 @@ typedef SSIZE_T ssize_t;
 #endif
 #else
 #  include <sys/socket.h>
+#  include <sys/uio.h>
 #endif
 
 #ifndef MSG_DONTWAIT
 #define MSG_DONTWAIT 0
 #endif
 
+#ifndef MSG_MORE
+#define MSG_MORE 0
+#endif
+
+enum {
+	/**
+	 * The number of #mpd_buffer segments in the output chain.
+	 * Commands are appended to the last segment in use, and all
+	 * of them are flushed with one sendmsg() call.
+	 */
+	MPD_ASYNC_OUTPUT_SEGMENTS = 8,
+};
+
 struct mpd_async {
 	mpd_socket_t fd;
 
@@ -36,9 +54,69 @@ struct mpd_async {
 
 	struct mpd_buffer input;
 
-	struct mpd_buffer output;
+	/**
+	 * A ring of output buffers.  Segments #output_head up to
+	 * (#output_head + #output_count - 1) are in use.
+	 */
+	struct mpd_buffer output[MPD_ASYNC_OUTPUT_SEGMENTS];
+
+	unsigned output_head, output_count;
+
+	/**
+	 * Shall the kernel expect more data after the current output
+	 * buffer (MSG_MORE)?  See mpd_async_set_more().
+	 */
+	bool more;
+
+	/**
+	 * Performance counters owned by the #mpd_connection, or NULL.
+	 */
+	struct mpd_metrics *metrics;
+
+	/**
+	 * Records all I/O if not NULL, see mpd_async_trace_open().
+	 */
+	struct mpd_trace *trace;
+
+	/**
+	 * Has a command been sent, and no response data been received
+	 * since?  Used by the "first_byte" probe.
+	 */
+	bool awaiting_response;
 };
 
+static struct mpd_buffer *
+mpd_async_output_segment(struct mpd_async *async, unsigned i)
+{
+	assert(i < async->output_count);
+
+	return &async->output[(async->output_head + i) %
+			      MPD_ASYNC_OUTPUT_SEGMENTS];
+}
+
+static struct mpd_buffer *
+mpd_async_output_tail(struct mpd_async *async)
+{
+	return mpd_async_output_segment(async, async->output_count - 1);
+}
+
+/**
+ * Returns the number of bytes in the output chain.
+ */
+static size_t
+mpd_async_output_size(const struct mpd_async *async)
+{
+	size_t size = 0;
+
+	for (unsigned i = 0; i < async->output_count; ++i) {
+		unsigned j = (async->output_head + i) %
+			MPD_ASYNC_OUTPUT_SEGMENTS;
+		size += mpd_buffer_size(&async->output[j]);
+	}
+
+	return size;
+}
+
 struct mpd_async *
 mpd_async_new(int fd)
 {
@@ -54,7 +132,13 @@ mpd_async_new(int fd)
 	mpd_error_init(&async->error);
 
 	mpd_buffer_init(&async->input);
-	mpd_buffer_init(&async->output);
+	mpd_buffer_init(&async->output[0]);
+	async->output_head = 0;
+	async->output_count = 1;
+	async->more = false;
+	async->metrics = NULL;
+	async->trace = NULL;
+	async->awaiting_response = false;
 
 	return async;
 }
@@ -64,6 +148,9 @@ mpd_async_free(struct mpd_async *async)
 {
 	assert(async != NULL);
 
+	if (async->trace != NULL)
+		mpd_trace_close(async->trace);
+
 	mpd_socket_close(async->fd);
 	mpd_error_deinit(&async->error);
 	free(async);
@@ -154,7 +241,7 @@ mpd_async_events(const struct mpd_async *async)
 		   read */
 		events |= MPD_ASYNC_EVENT_READ;
 
-	if (mpd_buffer_size(&async->output) > 0)
+	if (mpd_async_output_size(async) > 0)
 		/* there's data in the output buffer: attempt to
 		   write */
 		events |= MPD_ASYNC_EVENT_WRITE;
@@ -162,6 +249,19 @@ mpd_async_events(const struct mpd_async *async)
 	return events;
 }
 
+/**
+ * Accounts for the bytes which mpd_buffer_write() is going to move to
+ * the beginning of the buffer.
+ */
+static void
+mpd_async_count_move(const struct mpd_async *async,
+		     const struct mpd_buffer *buffer)
+{
+	if (buffer->read > 0)
+		mpd_metrics_add(async->metrics, MPD_METRIC_BUFFER_MOVED,
+				mpd_buffer_size(buffer));
+}
+
 static bool
 mpd_async_read(struct mpd_async *async)
 {
@@ -176,8 +276,10 @@ mpd_async_read(struct mpd_async *async)
 	if (room == 0)
 		return true;
 
+	mpd_async_count_move(async, &async->input);
 	nbytes = recv(async->fd, mpd_buffer_write(&async->input), room,
 		      MSG_DONTWAIT);
+	mpd_metrics_add(async->metrics, MPD_METRIC_RECV_CALLS, 1);
 	if (nbytes < 0) {
 		/* I/O error */
 
@@ -195,26 +297,120 @@ mpd_async_read(struct mpd_async *async)
 		return false;
 	}
 
+	mpd_metrics_add(async->metrics, MPD_METRIC_BYTES_RECEIVED,
+			(size_t)nbytes);
+
+	if (async->trace != NULL) {
+		mpd_trace_begin(async->trace, MPD_TRACE_RECEIVED,
+				(size_t)nbytes);
+		mpd_trace_append(async->trace,
+				 mpd_buffer_write(&async->input),
+				 (size_t)nbytes);
+	}
+
+	if (async->awaiting_response) {
+		async->awaiting_response = false;
+		MPD_PROBE1(first_byte, nbytes);
+	}
+
 	mpd_buffer_expand(&async->input, (size_t)nbytes);
 	return true;
 }
 
+/**
+ * Consumes bytes from the beginning of the output chain, and releases
+ * segments which have become empty (except for the last one).
+ */
+static void
+mpd_async_output_consume(struct mpd_async *async, size_t nbytes)
+{
+	while (true) {
+		struct mpd_buffer *buffer = mpd_async_output_segment(async, 0);
+		size_t size = mpd_buffer_size(buffer);
+		if (nbytes < size) {
+			mpd_buffer_consume(buffer, nbytes);
+			return;
+		}
+
+		mpd_buffer_consume(buffer, size);
+		nbytes -= size;
+
+		if (async->output_count == 1) {
+			assert(nbytes == 0);
+			return;
+		}
+
+		async->output_head = (async->output_head + 1) %
+			MPD_ASYNC_OUTPUT_SEGMENTS;
+		--async->output_count;
+	}
+}
+
+/**
+ * Records the first #nbytes of the output chain, which have just
+ * been sent, in the trace file.
+ */
+static void
+mpd_async_trace_sent(struct mpd_async *async, size_t nbytes)
+{
+	mpd_trace_begin(async->trace, MPD_TRACE_SENT, nbytes);
+
+	for (unsigned i = 0; nbytes > 0; ++i) {
+		assert(i < async->output_count);
+
+		struct mpd_buffer *buffer = mpd_async_output_segment(async, i);
+		size_t size = mpd_buffer_size(buffer);
+		if (size > nbytes)
+			size = nbytes;
+
+		mpd_trace_append(async->trace, mpd_buffer_read(buffer), size);
+		nbytes -= size;
+	}
+}
+
 static bool
 mpd_async_write(struct mpd_async *async)
 {
-	size_t size;
 	ssize_t nbytes;
 
 	assert(async != NULL);
 	assert(async->fd != MPD_INVALID_SOCKET);
 	assert(!mpd_error_is_defined(&async->error));
 
-	size = mpd_buffer_size(&async->output);
-	if (size == 0)
+	if (mpd_async_output_size(async) == 0)
 		return true;
 
-	nbytes = send(async->fd, mpd_buffer_read(&async->output), size,
-		      MSG_DONTWAIT);
+	const int flags = MSG_DONTWAIT | (async->more ? MSG_MORE : 0);
+
+#ifdef _WIN32
+	/* no sendmsg() on Windows: send the first segment (it is
+	   never empty while others are in use) */
+	struct mpd_buffer *buffer = mpd_async_output_segment(async, 0);
+	nbytes = send(async->fd, mpd_buffer_read(buffer),
+		      mpd_buffer_size(buffer), flags);
+#else
+	struct iovec iov[MPD_ASYNC_OUTPUT_SEGMENTS];
+	unsigned n = 0;
+
+	for (unsigned i = 0; i < async->output_count; ++i) {
+		struct mpd_buffer *buffer = mpd_async_output_segment(async, i);
+		size_t size = mpd_buffer_size(buffer);
+		if (size == 0)
+			continue;
+
+		iov[n].iov_base = mpd_buffer_read(buffer);
+		iov[n].iov_len = size;
+		++n;
+	}
+
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = n,
+	};
+
+	nbytes = sendmsg(async->fd, &msg, flags);
+#endif
+	mpd_metrics_add(async->metrics, MPD_METRIC_SEND_CALLS, 1);
 	if (nbytes < 0) {
 		/* I/O error */
 
@@ -225,7 +421,13 @@ mpd_async_write(struct mpd_async *async)
 		return false;
 	}
 
-	mpd_buffer_consume(&async->output, (size_t)nbytes);
+	mpd_metrics_add(async->metrics, MPD_METRIC_BYTES_SENT,
+			(size_t)nbytes);
+
+	if (async->trace != NULL)
+		mpd_async_trace_sent(async, (size_t)nbytes);
+
+	mpd_async_output_consume(async, (size_t)nbytes);
 	return true;
 }
 
@@ -264,26 +466,37 @@ mpd_async_io(struct mpd_async *async, enum mpd_async_event events)
 	return true;
 }
 
-bool
-mpd_async_send_command_v(struct mpd_async *async, const char *command,
-			 va_list args)
+/**
+ * The arguments of a command: either a NULL-terminated list of
+ * strings, or an array of typed arguments.
+ */
+struct mpd_async_args {
+	va_list *strings;
+
+	const struct mpd_arg *array;
+	unsigned n;
+};
+
+/**
+ * Formats a command into the given output buffer.
+ *
+ * @return false if the buffer is too small (nothing was committed)
+ */
+static bool
+mpd_async_format_command(const struct mpd_async *async,
+			 struct mpd_buffer *buffer, const char *command,
+			 const struct mpd_async_args *args)
 {
 	size_t room, length;
 	char *dest, *end, *p;
-	const char *arg;
-
-	assert(async != NULL);
-	assert(command != NULL);
 
-	if (mpd_error_is_defined(&async->error))
-		return false;
-
-	room = mpd_buffer_room(&async->output);
+	room = mpd_buffer_room(buffer);
 	length = strlen(command);
 	if (room <= length)
 		return false;
 
-	dest = mpd_buffer_write(&async->output);
+	mpd_async_count_move(async, buffer);
+	dest = mpd_buffer_write(buffer);
 	/* -1 because we reserve space for the \n character */
 	end = dest + room - 1;
 
@@ -294,31 +507,166 @@ mpd_async_send_command_v(struct mpd_async *async, const char *command,
 
 	/* now append all arguments (quoted) */
 
-	while ((arg = va_arg(args, const char *)) != NULL) {
+	va_list strings;
+	if (args->strings != NULL)
+		va_copy(strings, *args->strings);
+
+	for (unsigned i = 0; args->strings != NULL || i < args->n; ++i) {
+		const char *arg = NULL;
+		if (args->strings != NULL &&
+		    (arg = va_arg(strings, const char *)) == NULL)
+			break;
+
 		/* append a space separator */
 
-		if (p >= end)
-			return false;
+		if (p >= end) {
+			p = NULL;
+			break;
+		}
 
 		*p++ = ' ';
 
 		/* quote the argument into the destination buffer */
 
-		p = quote(p, end, arg);
+		p = arg != NULL
+			? quote(p, end, arg)
+			: mpd_arg_quote(p, end, &args->array[i]);
 		assert(p == NULL || (p >= dest && p <= end));
 		if (p == NULL)
-			return false;
+			break;
 	}
 
+	if (args->strings != NULL)
+		va_end(strings);
+
+	if (p == NULL)
+		return false;
 
 	/* append the newline to finish this command */
 
 	*p++ = '\n';
 
-	mpd_buffer_expand(&async->output, p - dest);
+	mpd_buffer_expand(buffer, p - dest);
+	return true;
+}
+
+/**
+ * Appends a command to the output chain, starting a new segment if
+ * the last one is full.
+ */
+static bool
+mpd_async_append_command(struct mpd_async *async, const char *command,
+			 const struct mpd_async_args *args)
+{
+	assert(async != NULL);
+	assert(command != NULL);
+
+	if (mpd_error_is_defined(&async->error))
+		return false;
+
+	if (!mpd_async_format_command(async, mpd_async_output_tail(async),
+				      command, args)) {
+		if (mpd_buffer_size(mpd_async_output_tail(async)) == 0 ||
+		    async->output_count >= MPD_ASYNC_OUTPUT_SEGMENTS)
+			/* the command is too large for one segment,
+			   or the chain is full */
+			return false;
+
+		/* continue in a fresh segment */
+
+		++async->output_count;
+		struct mpd_buffer *tail = mpd_async_output_tail(async);
+		mpd_buffer_init(tail);
+
+		if (!mpd_async_format_command(async, tail, command, args)) {
+			--async->output_count;
+			return false;
+		}
+	}
+
+	async->awaiting_response = true;
+	MPD_PROBE1(command_send, command);
+	return true;
+}
+
+bool
+mpd_async_send_command_v(struct mpd_async *async, const char *command,
+			 va_list args)
+{
+	va_list copy;
+	va_copy(copy, args);
+
+	const struct mpd_async_args a = {
+		.strings = &copy,
+	};
+
+	bool success = mpd_async_append_command(async, command, &a);
+	va_end(copy);
+	return success;
+}
+
+bool
+mpd_async_send_args(struct mpd_async *async, const char *command,
+		    const struct mpd_arg *args, unsigned n)
+{
+	const struct mpd_async_args a = {
+		.array = args,
+		.n = n,
+	};
+
+	return mpd_async_append_command(async, command, &a);
+}
+
+void
+mpd_async_set_metrics(struct mpd_async *async, struct mpd_metrics *metrics)
+{
+	assert(async != NULL);
+
+	async->metrics = metrics;
+}
+
+struct mpd_metrics *
+mpd_async_get_metrics(const struct mpd_async *async)
+{
+	assert(async != NULL);
+
+	return async->metrics;
+}
+
+bool
+mpd_async_trace_open(struct mpd_async *async, const char *path)
+{
+	assert(async != NULL);
+	assert(path != NULL);
+
+	struct mpd_trace *trace = mpd_trace_open(path);
+	if (trace == NULL)
+		return false;
+
+	mpd_async_trace_close(async);
+	async->trace = trace;
 	return true;
 }
 
+void
+mpd_async_trace_close(struct mpd_async *async)
+{
+	assert(async != NULL);
+
+	if (async->trace != NULL) {
+		mpd_trace_close(async->trace);
+		async->trace = NULL;
+	}
+}
+
+void
+mpd_async_set_more(struct mpd_async *async, bool more)
+{
+	assert(async != NULL);
+
+	async->more = more;
+}
+
 bool
 mpd_async_send_command(struct mpd_async *async, const char *command, ...)
 {
@@ -337,6 +685,13 @@ mpd_async_send_command(struct mpd_async *async, const char *command, ...)
 
 char *
 mpd_async_recv_line(struct mpd_async *async)
+{
+	size_t length;
+	return mpd_async_recv_line_n(async, &length);
+}
+
+char *
+mpd_async_recv_line_n(struct mpd_async *async, size_t *length_r)
 {
 	size_t size;
 	char *src, *newline;
@@ -364,7 +719,9 @@ mpd_async_recv_line(struct mpd_async *async)
 	}
 
 	*newline = 0;
+	*length_r = newline - src;
 	mpd_buffer_consume(&async->input, newline + 1 - src);
+	mpd_metrics_add(async->metrics, MPD_METRIC_LINES, 1);
 
 	return src;
 }
@@ -40,6 +40,9 @@ mpd_buffer_init(struct mpd_buffer *buffer)
 static inline void
 mpd_buffer_move(struct mpd_buffer *buffer)
 {
+	if (buffer->read == 0)
+		return;
+
 	memmove(buffer->data, buffer->data + buffer->read,
 		buffer->write - buffer->read);
 
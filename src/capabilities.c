@@ -6,6 +6,7 @@
 #include <mpd/recv.h>
 #include <mpd/response.h>
 #include "internal.h"
+#include "iprojection.h"
 
 #include <assert.h>
 #include <stddef.h>
@@ -76,7 +77,18 @@ mpd_send_tag_types_v(struct mpd_connection *connection,
 
 	buffer[length] = 0;
 
-	return mpd_send_command(connection, buffer, NULL);
+	if (!mpd_send_command(connection, buffer, NULL))
+		return false;
+
+	const uint64_t mask = mpd_tag_mask(types, n);
+	if (strcmp(sub_command, "disable") == 0)
+		connection->tag_types &= ~mask;
+	else if (strcmp(sub_command, "enable") == 0)
+		connection->tag_types |= mask;
+	else
+		connection->tag_types = mask;
+
+	return true;
 }
 
 bool
@@ -112,7 +124,11 @@ mpd_run_enable_tag_types(struct mpd_connection *connection,
 bool
 mpd_send_clear_tag_types(struct mpd_connection *connection)
 {
-	return mpd_send_command(connection, "tagtypes", "clear", NULL);
+	if (!mpd_send_command(connection, "tagtypes", "clear", NULL))
+		return false;
+
+	connection->tag_types = 0;
+	return true;
 }
 
 bool
@@ -125,7 +141,11 @@ mpd_run_clear_tag_types(struct mpd_connection *connection)
 bool
 mpd_send_all_tag_types(struct mpd_connection *connection)
 {
-	return mpd_send_command(connection, "tagtypes", "all", NULL);
+	if (!mpd_send_command(connection, "tagtypes", "all", NULL))
+		return false;
+
+	connection->tag_types = MPD_TAG_MASK_ALL;
+	return true;
 }
 
 bool
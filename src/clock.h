@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_CLOCK_H
+#define MPD_CLOCK_H
+
+#include <stdint.h>
+
+/**
+ * Returns a monotonic time stamp in microseconds.
+ */
+uint64_t
+mpd_clock_now(void);
+
+#endif
@@ -5,6 +5,7 @@
 #include <mpd/send.h>
 #include <mpd/response.h>
 #include "internal.h"
+#include "imetrics.h"
 #include "run.h"
 
 #include <assert.h>
@@ -78,6 +79,8 @@ mpd_recv_message(struct mpd_connection *connection)
 		return NULL;
 	}
 
+	mpd_metrics_add(connection->metrics, MPD_METRIC_OBJECTS, 1);
+
 	while ((pair = mpd_recv_pair(connection)) != NULL &&
 	       mpd_message_feed(message, pair))
 		mpd_return_pair(connection, pair);
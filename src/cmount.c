@@ -6,6 +6,7 @@
 #include <mpd/recv.h>
 #include <mpd/response.h>
 #include "internal.h"
+#include "imetrics.h"
 #include "run.h"
 
 #include <stddef.h>
@@ -33,6 +34,8 @@ mpd_recv_mount(struct mpd_connection *connection)
 		return NULL;
 	}
 
+	mpd_metrics_add(connection->metrics, MPD_METRIC_OBJECTS, 1);
+
 	while ((pair = mpd_recv_pair(connection)) != NULL &&
 	       mpd_mount_feed(mount, pair))
 		mpd_return_pair(connection, pair);
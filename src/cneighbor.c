@@ -6,6 +6,7 @@
 #include <mpd/recv.h>
 #include <mpd/response.h>
 #include "internal.h"
+#include "imetrics.h"
 
 #include <stddef.h>
 
@@ -32,6 +33,8 @@ mpd_recv_neighbor(struct mpd_connection *connection)
 		return NULL;
 	}
 
+	mpd_metrics_add(connection->metrics, MPD_METRIC_OBJECTS, 1);
+
 	while ((pair = mpd_recv_pair(connection)) != NULL &&
 	       mpd_neighbor_feed(neighbor, pair))
 		mpd_return_pair(connection, pair);
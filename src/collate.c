@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "collate.h"
+#include "fold.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The base letters of U+00C0 to U+017F; an empty string means the
+ * character is copied.
+ */
+static const char collate_latin[0x180 - 0xc0][3] = {
+	"a", "a", "a", "a", "a", "a", "ae", "c", /* U+00C0 */
+	"e", "e", "e", "e", "i", "i", "i", "i", /* U+00C8 */
+	"d", "n", "o", "o", "o", "o", "o", "", /* U+00D0 */
+	"o", "u", "u", "u", "u", "y", "th", "ss", /* U+00D8 */
+	"a", "a", "a", "a", "a", "a", "ae", "c", /* U+00E0 */
+	"e", "e", "e", "e", "i", "i", "i", "i", /* U+00E8 */
+	"d", "n", "o", "o", "o", "o", "o", "", /* U+00F0 */
+	"o", "u", "u", "u", "u", "y", "th", "y", /* U+00F8 */
+	"a", "a", "a", "a", "a", "a", "c", "c", /* U+0100 */
+	"c", "c", "c", "c", "c", "c", "d", "d", /* U+0108 */
+	"d", "d", "e", "e", "e", "e", "e", "e", /* U+0110 */
+	"e", "e", "e", "e", "g", "g", "g", "g", /* U+0118 */
+	"g", "g", "g", "g", "h", "h", "h", "h", /* U+0120 */
+	"i", "i", "i", "i", "i", "i", "i", "i", /* U+0128 */
+	"i", "i", "ij", "ij", "j", "j", "k", "k", /* U+0130 */
+	"k", "l", "l", "l", "l", "l", "l", "l", /* U+0138 */
+	"l", "l", "l", "n", "n", "n", "n", "n", /* U+0140 */
+	"n", "n", "n", "n", "o", "o", "o", "o", /* U+0148 */
+	"o", "o", "oe", "oe", "r", "r", "r", "r", /* U+0150 */
+	"r", "r", "s", "s", "s", "s", "s", "s", /* U+0158 */
+	"s", "s", "t", "t", "t", "t", "t", "t", /* U+0160 */
+	"u", "u", "u", "u", "u", "u", "u", "u", /* U+0168 */
+	"u", "u", "u", "u", "w", "w", "y", "y", /* U+0170 */
+	"y", "z", "z", "z", "z", "z", "z", "s", /* U+0178 */
+};
+
+size_t
+mpd_collate_key(char *dest, const char *src)
+{
+	char *p = dest;
+
+	while (*src != 0) {
+		const unsigned char ch = (unsigned char)*src;
+		const unsigned char next = (unsigned char)src[1];
+
+		/* two-byte UTF-8 sequences C3 80 to C5 BF */
+		if (ch >= 0xc3 && ch <= 0xc5 && (next & 0xc0) == 0x80) {
+			const unsigned code =
+				((ch & 0x1fu) << 6) | (next & 0x3fu);
+			const char *base = collate_latin[code - 0xc0];
+			if (*base != 0) {
+				/* the replacement is at most as long as
+				   the sequence */
+				*p++ = base[0];
+				if (base[1] != 0)
+					*p++ = base[1];
+				src += 2;
+				continue;
+			}
+		}
+
+		*p++ = (char)mpd_fold_char(ch);
+		++src;
+	}
+
+	*p = 0;
+	return (size_t)(p - dest);
+}
+
+unsigned
+mpd_collate_number(const char *src)
+{
+	while (*src == ' ')
+		++src;
+
+	if ((unsigned)(*src - '0') >= 10u)
+		return 0;
+
+	return (unsigned)strtoul(src, NULL, 10);
+}
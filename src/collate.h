@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_COLLATE_H
+#define MPD_COLLATE_H
+
+#include <stddef.h>
+
+/**
+ * Converts a string to a collation key: ASCII letters are folded to
+ * lower case, and Latin letters with diacritics (U+00C0 to U+017F)
+ * are replaced with their base letters ("É" becomes "e", "ß" becomes
+ * "ss").  Other characters are copied.  Collation keys can be
+ * compared with strcmp().
+ *
+ * @param dest the destination buffer; the key is never longer than
+ * the source string, so strlen(src)+1 bytes are enough
+ * @return the length of the key (without the null terminator)
+ */
+size_t
+mpd_collate_key(char *dest, const char *src);
+
+/**
+ * Parses the number at the beginning of a "Track" or "Disc" value,
+ * e.g. 3 for "3/12".
+ *
+ * @return the number, or 0 if there is none
+ */
+unsigned
+mpd_collate_number(const char *src);
+
+#endif
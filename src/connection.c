@@ -7,8 +7,17 @@
 #include <mpd/parser.h>
 #include <mpd/password.h>
 #include <mpd/socket.h>
+#include <mpd/metrics.h>
+#include <mpd/binary.h>
+#include <mpd/capabilities.h>
+#include <mpd/list.h>
+#include <mpd/player.h>
+#include <mpd/response.h>
+#include <mpd/song.h>
+#include <mpd/status.h>
 
 #include "resolver.h"
+#include "iprojection.h"
 #include "sync.h"
 #include "socket.h"
 #include "internal.h"
@@ -60,6 +69,10 @@ mpd_parse_welcome(struct mpd_connection *connection, const char *output)
 void
 mpd_connection_sync_error(struct mpd_connection *connection)
 {
+	/* a command list which was being sent is lost; don't keep
+	   the socket corked */
+	mpd_async_set_more(connection->async, false);
+
 	if (mpd_async_copy_error(connection->async, &connection->error)) {
 		/* no error noticed by async: must be a timeout in the
 		   sync.c code */
@@ -68,14 +81,97 @@ mpd_connection_sync_error(struct mpd_connection *connection)
 	}
 }
 
+/**
+ * Sends the commands of the connection setup profile in one command
+ * list.
+ */
+static bool
+mpd_connection_send_profile(struct mpd_connection *connection,
+			    const struct mpd_settings *settings)
+{
+	const char *password = mpd_settings_get_password(settings);
+	unsigned n_types, n_features;
+	const enum mpd_tag_type *types =
+		mpd_settings_get_tag_types(settings, &n_types);
+	const enum mpd_protocol_feature *features =
+		mpd_settings_get_protocol_features(settings, &n_features);
+	const unsigned binary_limit = mpd_settings_get_binary_limit(settings);
+
+	return mpd_command_list_begin(connection, true) &&
+		(password == NULL ||
+		 mpd_send_password(connection, password)) &&
+		(types == NULL ||
+		 (mpd_send_clear_tag_types(connection) &&
+		  (n_types == 0 ||
+		   mpd_send_enable_tag_types(connection, types, n_types)))) &&
+		(features == NULL ||
+		 (mpd_send_clear_protocol_features(connection) &&
+		  (n_features == 0 ||
+		   mpd_send_enable_protocol_features(connection, features,
+						     n_features)))) &&
+		(binary_limit == 0 ||
+		 mpd_send_binarylimit(connection, binary_limit)) &&
+		(!mpd_settings_get_initial_state(settings) ||
+		 (mpd_send_status(connection) &&
+		  mpd_send_current_song(connection))) &&
+		mpd_command_list_end(connection);
+}
+
+/**
+ * Receives the responses to mpd_connection_send_profile().
+ */
+static bool
+mpd_connection_recv_profile(struct mpd_connection *connection,
+			    const struct mpd_settings *settings)
+{
+	unsigned n_types, n_features;
+	const bool types =
+		mpd_settings_get_tag_types(settings, &n_types) != NULL;
+	const bool features =
+		mpd_settings_get_protocol_features(settings,
+						   &n_features) != NULL;
+
+	/* the number of commands with an empty response */
+	unsigned n = (mpd_settings_get_password(settings) != NULL) +
+		(types ? 1 + (n_types > 0) : 0) +
+		(features ? 1 + (n_features > 0) : 0) +
+		(mpd_settings_get_binary_limit(settings) > 0);
+
+	for (unsigned i = 0; i < n; ++i)
+		if (!mpd_response_next(connection))
+			return false;
+
+	if (mpd_settings_get_initial_state(settings)) {
+		connection->initial_status = mpd_recv_status(connection);
+		if (connection->initial_status == NULL ||
+		    !mpd_response_next(connection))
+			return false;
+
+		/* NULL if there is no current song */
+		connection->initial_song = mpd_recv_song(connection);
+		if (mpd_error_is_defined(&connection->error))
+			return false;
+	}
+
+	return mpd_response_finish(connection);
+}
+
 struct mpd_connection *
 mpd_connection_new(const char *host, unsigned port, unsigned timeout_ms)
 {
-	struct mpd_settings *initial_settings =
+	struct mpd_settings *settings =
 		mpd_settings_new(host, port, timeout_ms, NULL, NULL);
-	if (initial_settings == NULL)
+	if (settings == NULL)
 		return NULL;
 
+	return mpd_connection_new_settings(settings);
+}
+
+struct mpd_connection *
+mpd_connection_new_settings(struct mpd_settings *initial_settings)
+{
+	assert(initial_settings != NULL);
+
 	struct mpd_connection *connection = malloc(sizeof(*connection));
 	if (connection == NULL) {
 		mpd_settings_free(initial_settings);
@@ -95,8 +191,16 @@ mpd_connection_new(const char *host, unsigned port, unsigned timeout_ms)
 	connection->parser = NULL;
 	connection->receiving = false;
 	connection->sending_command_list = false;
+	connection->password_sent = false;
 	connection->pair_state = PAIR_STATE_NONE;
 	connection->request = NULL;
+	connection->metrics = NULL;
+	connection->initial_status = NULL;
+	connection->initial_song = NULL;
+	connection->tag_types = MPD_TAG_MASK_ALL;
+	connection->projection_pending = false;
+	connection->projecting = false;
+	connection->tag_types_dirty = false;
 
 	if (!mpd_socket_global_init(&connection->error))
 		return connection;
@@ -106,7 +210,9 @@ mpd_connection_new(const char *host, unsigned port, unsigned timeout_ms)
 
 	fd = mpd_socket_connect(mpd_settings_get_host(settings),
 				mpd_settings_get_port(settings),
-				&connection->timeout, &connection->error);
+				&connection->timeout,
+				mpd_settings_get_fast_open(settings),
+				&connection->error);
 
 	while (fd == MPD_INVALID_SOCKET &&
 	       (settings = mpd_settings_get_next(settings)) != NULL) {
@@ -114,7 +220,9 @@ mpd_connection_new(const char *host, unsigned port, unsigned timeout_ms)
 		mpd_error_clear(&connection->error);
 		fd = mpd_socket_connect(mpd_settings_get_host(settings),
 					mpd_settings_get_port(settings),
-					&connection->timeout, &connection->error);
+					&connection->timeout,
+					mpd_settings_get_fast_open(settings),
+					&connection->error);
 	}
 
 	if (settings == NULL)
@@ -133,6 +241,12 @@ mpd_connection_new(const char *host, unsigned port, unsigned timeout_ms)
 		return connection;
 	}
 
+	/* the setup profile is sent right away, without waiting for
+	   the welcome message; MPD processes it after the welcome */
+	const bool profile = mpd_settings_has_profile(settings);
+	if (profile && !mpd_connection_send_profile(connection, settings))
+		return connection;
+
 	line = mpd_sync_recv_line(connection->async, &connection->timeout);
 	if (line == NULL) {
 		mpd_connection_sync_error(connection);
@@ -143,10 +257,15 @@ mpd_connection_new(const char *host, unsigned port, unsigned timeout_ms)
 
 	if (success) {
 		const char *password = mpd_settings_get_password(settings);
-		if (password != NULL)
+		if (profile)
+			mpd_connection_recv_profile(connection, settings);
+		else if (password != NULL)
 			mpd_run_password(connection, password);
 	}
 
+	/* the password of the settings doesn't count; it is part of
+	   the capabilities cache key */
+	connection->password_sent = false;
 	return connection;
 }
 
@@ -170,8 +289,16 @@ mpd_connection_new_async(struct mpd_async *async, const char *welcome)
 	connection->parser = NULL;
 	connection->receiving = false;
 	connection->sending_command_list = false;
+	connection->password_sent = false;
 	connection->pair_state = PAIR_STATE_NONE;
 	connection->request = NULL;
+	connection->metrics = NULL;
+	connection->initial_status = NULL;
+	connection->initial_song = NULL;
+	connection->tag_types = MPD_TAG_MASK_ALL;
+	connection->projection_pending = false;
+	connection->projecting = false;
+	connection->tag_types_dirty = false;
 
 	if (!mpd_socket_global_init(&connection->error))
 		return connection;
@@ -199,6 +326,15 @@ void mpd_connection_free(struct mpd_connection *connection)
 
 	if (connection->request) free(connection->request);
 
+	if (connection->metrics != NULL)
+		mpd_metrics_free(connection->metrics);
+
+	if (connection->initial_status != NULL)
+		mpd_status_free(connection->initial_status);
+
+	if (connection->initial_song != NULL)
+		mpd_song_free(connection->initial_song);
+
 	mpd_error_deinit(&connection->error);
 
 	if (connection->initial_settings != NULL)
@@ -234,6 +370,26 @@ mpd_connection_set_timeout(struct mpd_connection *connection,
 	connection->timeout.tv_usec = timeout_ms % 1000;
 }
 
+struct mpd_status *
+mpd_connection_take_initial_status(struct mpd_connection *connection)
+{
+	assert(connection != NULL);
+
+	struct mpd_status *status = connection->initial_status;
+	connection->initial_status = NULL;
+	return status;
+}
+
+struct mpd_song *
+mpd_connection_take_initial_song(struct mpd_connection *connection)
+{
+	assert(connection != NULL);
+
+	struct mpd_song *song = connection->initial_song;
+	connection->initial_song = NULL;
+	return song;
+}
+
 int
 mpd_connection_get_fd(const struct mpd_connection *connection)
 {
@@ -6,6 +6,7 @@
 #include <mpd/recv.h>
 #include <mpd/response.h>
 #include "internal.h"
+#include "imetrics.h"
 #include "isend.h"
 #include "run.h"
 
@@ -32,6 +33,8 @@ mpd_recv_output(struct mpd_connection *connection)
 		return NULL;
 	}
 
+	mpd_metrics_add(connection->metrics, MPD_METRIC_OBJECTS, 1);
+
 	while ((pair = mpd_recv_pair(connection)) != NULL &&
 	       mpd_output_feed(output, pair))
 		mpd_return_pair(connection, pair);
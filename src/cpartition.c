@@ -5,6 +5,7 @@
 #include <mpd/send.h>
 #include <mpd/response.h>
 #include "internal.h"
+#include "imetrics.h"
 #include "run.h"
 
 #include <assert.h>
@@ -71,5 +72,10 @@ mpd_recv_partition(struct mpd_connection *connection)
 
 	struct mpd_partition *partition = mpd_partition_new(pair);
 	mpd_return_pair(connection, pair);
+
+	if (partition != NULL)
+		mpd_metrics_add(connection->metrics,
+				MPD_METRIC_OBJECTS, 1);
+
 	return partition;
 }
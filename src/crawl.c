@@ -0,0 +1,373 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "config.h"
+#include <mpd/crawl.h>
+#include <mpd/capabilities.h>
+#include <mpd/connection.h>
+#include <mpd/database.h>
+#include <mpd/password.h>
+#include <mpd/recv.h>
+#include <mpd/response.h>
+#include <mpd/settings.h>
+#include <mpd/song_table.h>
+#include "isong_table.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/**
+ * Receives the "lsinfo" response for the root directory: songs are
+ * appended to the table, directory names are collected.
+ */
+struct crawl_root {
+	struct mpd_song_table_receiver songs;
+
+	char **directories;
+	unsigned n_directories, capacity;
+
+	bool oom;
+};
+
+static bool
+crawl_root_handle_pair(const char *name, size_t name_length,
+		       const char *value, size_t value_length,
+		       int token, void *ctx)
+{
+	struct crawl_root *root = ctx;
+
+	if (token == MPD_PAIR_TOKEN_DIRECTORY) {
+		if (root->n_directories == root->capacity) {
+			const unsigned capacity = root->capacity > 0
+				? root->capacity * 2
+				: 64;
+			char **directories =
+				realloc(root->directories,
+					capacity * sizeof(*directories));
+			if (directories == NULL) {
+				root->oom = true;
+				return false;
+			}
+
+			root->directories = directories;
+			root->capacity = capacity;
+		}
+
+		char *directory = malloc(value_length + 1);
+		if (directory == NULL) {
+			root->oom = true;
+			return false;
+		}
+
+		memcpy(directory, value, value_length);
+		directory[value_length] = 0;
+		root->directories[root->n_directories++] = directory;
+	}
+
+	if (!mpd_song_table_receive_pair(name, name_length,
+					 value, value_length,
+					 token, &root->songs)) {
+		root->oom = true;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Where the songs of one top-level directory were stored.
+ */
+struct crawl_range {
+	const struct mpd_song_table *table;
+	unsigned begin, end;
+};
+
+/**
+ * State shared by all workers.
+ */
+struct crawl {
+	char *const *directories;
+	unsigned n_directories;
+
+	/**
+	 * The index of the next directory to be fetched.
+	 */
+	atomic_uint next;
+
+	/**
+	 * Set by a worker which has failed, to stop the others.
+	 */
+	atomic_bool failed;
+
+	/**
+	 * One element per directory, written by the worker which
+	 * fetched it.
+	 */
+	struct crawl_range *ranges;
+
+	/**
+	 * The settings for opening additional connections.
+	 */
+	const struct mpd_settings *settings;
+
+	enum mpd_tag_type tags[MPD_TAG_COUNT];
+	unsigned n_tags;
+};
+
+struct crawl_worker {
+	struct crawl *crawl;
+
+	struct mpd_connection *connection;
+
+	/**
+	 * The songs fetched by this worker.
+	 */
+	struct mpd_song_table *table;
+
+	/**
+	 * Has a command failed on #connection?
+	 */
+	bool failed;
+};
+
+/**
+ * Fetches directories until all are claimed or a worker has failed.
+ */
+static void
+crawl_worker_run(struct crawl_worker *w)
+{
+	struct crawl *crawl = w->crawl;
+
+	while (!atomic_load_explicit(&crawl->failed, memory_order_relaxed)) {
+		const unsigned i =
+			atomic_fetch_add_explicit(&crawl->next, 1,
+						  memory_order_relaxed);
+		if (i >= crawl->n_directories)
+			break;
+
+		struct crawl_range *range = &crawl->ranges[i];
+		range->table = w->table;
+		range->begin = mpd_song_table_get_length(w->table);
+
+		if (!mpd_send_list_all_meta(w->connection,
+					    crawl->directories[i]) ||
+		    !mpd_recv_song_table(w->connection, w->table) ||
+		    !mpd_response_finish(w->connection)) {
+			w->failed = true;
+			atomic_store_explicit(&crawl->failed, true,
+					      memory_order_relaxed);
+			break;
+		}
+
+		range->end = mpd_song_table_get_length(w->table);
+	}
+}
+
+#ifdef HAVE_PTHREAD
+
+/**
+ * Opens an additional connection with the settings of the caller's
+ * connection and enables only the tags the table stores.
+ *
+ * @return false if the connection is unusable; it is not an error
+ * for the crawl
+ */
+static bool
+crawl_worker_connect(struct crawl_worker *w)
+{
+	const struct crawl *crawl = w->crawl;
+	const struct mpd_settings *settings = crawl->settings;
+
+	w->connection =
+		mpd_connection_new(mpd_settings_get_host(settings),
+				   mpd_settings_get_port(settings),
+				   mpd_settings_get_timeout_ms(settings));
+	if (w->connection == NULL ||
+	    mpd_connection_get_error(w->connection) != MPD_ERROR_SUCCESS)
+		return false;
+
+	const char *password = mpd_settings_get_password(settings);
+	if (password != NULL && !mpd_run_password(w->connection, password))
+		return false;
+
+	if (mpd_connection_cmp_server_version(w->connection, 0, 21, 0) >= 0 &&
+	    (!mpd_run_clear_tag_types(w->connection) ||
+	     (crawl->n_tags > 0 &&
+	      !mpd_run_enable_tag_types(w->connection, crawl->tags,
+					crawl->n_tags))))
+		return false;
+
+	return true;
+}
+
+static void *
+crawl_thread(void *ctx)
+{
+	struct crawl_worker *w = ctx;
+
+	if (crawl_worker_connect(w))
+		crawl_worker_run(w);
+	return NULL;
+}
+
+#endif
+
+/**
+ * Fetches the top-level directories with the given workers; worker 0
+ * uses the caller's connection and runs in the calling thread.
+ */
+static void
+crawl_run(struct crawl_worker *workers, unsigned n_workers)
+{
+#ifdef HAVE_PTHREAD
+	pthread_t *threads = n_workers > 1 &&
+		workers[0].crawl->settings != NULL
+		? malloc((n_workers - 1) * sizeof(*threads))
+		: NULL;
+	unsigned n_started = 0;
+	if (threads != NULL)
+		while (n_started < n_workers - 1 &&
+		       pthread_create(&threads[n_started], NULL,
+				      crawl_thread,
+				      &workers[n_started + 1]) == 0)
+			++n_started;
+#else
+	(void)n_workers;
+#endif
+
+	crawl_worker_run(&workers[0]);
+
+#ifdef HAVE_PTHREAD
+	for (unsigned i = 0; i < n_started; ++i)
+		pthread_join(threads[i], NULL);
+	free(threads);
+#endif
+}
+
+static bool
+crawl_parallel(struct mpd_connection *connection, unsigned n_connections,
+	       struct mpd_song_table *table)
+{
+	struct crawl_root root = {
+		.directories = NULL,
+		.n_directories = 0,
+		.capacity = 0,
+		.oom = false,
+	};
+	mpd_song_table_receiver_init(&root.songs, table);
+
+	bool success = mpd_send_list_meta(connection, NULL) &&
+		mpd_recv_pairs(connection, crawl_root_handle_pair, &root);
+	if (success && root.oom) {
+		mpd_error_code(&connection->error, MPD_ERROR_OOM);
+		success = false;
+	}
+
+	success = success && mpd_response_finish(connection);
+
+	struct crawl crawl = {
+		.directories = root.directories,
+		.n_directories = root.n_directories,
+		.settings = connection->settings,
+	};
+	atomic_init(&crawl.next, 0);
+	atomic_init(&crawl.failed, false);
+	crawl.n_tags = mpd_song_table_copy_tag_types(table, crawl.tags);
+
+	const unsigned n_workers = n_connections < root.n_directories
+		? n_connections
+		: root.n_directories;
+	struct crawl_worker *workers = NULL;
+
+	if (success && n_workers > 0) {
+		crawl.ranges = calloc(root.n_directories,
+				      sizeof(*crawl.ranges));
+		workers = calloc(n_workers, sizeof(*workers));
+		if (crawl.ranges == NULL || workers == NULL) {
+			mpd_error_code(&connection->error, MPD_ERROR_OOM);
+			success = false;
+		}
+
+		for (unsigned i = 0; success && i < n_workers; ++i) {
+			workers[i].crawl = &crawl;
+			workers[i].table = mpd_song_table_new_like(table);
+			if (workers[i].table == NULL) {
+				mpd_error_code(&connection->error,
+					       MPD_ERROR_OOM);
+				success = false;
+			}
+		}
+	}
+
+	if (success && n_workers > 0) {
+		workers[0].connection = connection;
+		crawl_run(workers, n_workers);
+
+		if (workers[0].failed)
+			success = false;
+
+		for (unsigned i = 1; success && i < n_workers; ++i) {
+			if (workers[i].failed) {
+				mpd_error_copy(&connection->error,
+					       &workers[i].connection->error);
+				success = false;
+			}
+		}
+
+		/* the songs of the root directory are already in the
+		   table; append the subtrees in directory order */
+		for (unsigned i = 0; success && i < root.n_directories; ++i) {
+			const struct crawl_range *range = &crawl.ranges[i];
+			if (!mpd_song_table_append(table, range->table,
+						   range->begin, range->end)) {
+				mpd_error_code(&connection->error,
+					       MPD_ERROR_OOM);
+				success = false;
+			}
+		}
+	}
+
+	if (workers != NULL) {
+		for (unsigned i = 0; i < n_workers; ++i) {
+			if (i > 0 && workers[i].connection != NULL)
+				mpd_connection_free(workers[i].connection);
+			if (workers[i].table != NULL)
+				mpd_song_table_free(workers[i].table);
+		}
+
+		free(workers);
+	}
+
+	free(crawl.ranges);
+	for (unsigned i = 0; i < root.n_directories; ++i)
+		free(root.directories[i]);
+	free(root.directories);
+	return success;
+}
+
+bool
+mpd_crawl_database(struct mpd_connection *connection,
+		   unsigned n_connections,
+		   struct mpd_song_table *table)
+{
+	assert(connection != NULL);
+	assert(table != NULL);
+
+#ifndef HAVE_PTHREAD
+	n_connections = 1;
+#endif
+
+	if (n_connections <= 1)
+		return mpd_send_list_all_meta(connection, NULL) &&
+			mpd_recv_song_table(connection, table) &&
+			mpd_response_finish(connection);
+
+	return crawl_parallel(connection, n_connections, table);
+}
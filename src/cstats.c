@@ -10,6 +10,7 @@
 #include <mpd/send.h>
 #include <mpd/recv.h>
 #include "internal.h"
+#include "imetrics.h"
 
 #include <assert.h>
 
@@ -38,6 +39,8 @@ mpd_recv_stats(struct mpd_connection *connection)
 		return NULL;
 	}
 
+	mpd_metrics_add(connection->metrics, MPD_METRIC_OBJECTS, 1);
+
 	/* read and parse all response lines */
 	while ((pair = mpd_recv_pair(connection)) != NULL) {
 		mpd_stats_feed(stats, pair);
@@ -10,6 +10,7 @@
 #include <mpd/send.h>
 #include <mpd/recv.h>
 #include "internal.h"
+#include "imetrics.h"
 #include "run.h"
 
 bool
@@ -33,6 +34,8 @@ mpd_recv_status(struct mpd_connection * connection)
 		return NULL;
 	}
 
+	mpd_metrics_add(connection->metrics, MPD_METRIC_OBJECTS, 1);
+
 	while ((pair = mpd_recv_pair(connection)) != NULL) {
 		mpd_status_feed(status, pair);
 		mpd_return_pair(connection, pair);
@@ -0,0 +1,387 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include <mpd/decoder.h>
+#include <mpd/parser.h>
+#include <mpd/pair.h>
+#include <mpd/song.h>
+#include <mpd/entity.h>
+#include <mpd/output.h>
+#include <mpd/status.h>
+#include <mpd/stats.h>
+#include "ierror.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct mpd_decoder {
+	enum mpd_decoder_type type;
+
+	struct mpd_parser *parser;
+
+	/**
+	 * The object which is being built.
+	 */
+	void *current;
+
+	/**
+	 * The object which is complete, but was not yet taken by
+	 * the caller.
+	 */
+	void *ready;
+
+	/**
+	 * Has "OK" or "ACK" been received?
+	 */
+	bool finished;
+
+	struct mpd_error_info error;
+};
+
+static void
+mpd_decoder_free_object(enum mpd_decoder_type type, void *object)
+{
+	if (object == NULL)
+		return;
+
+	switch (type) {
+	case MPD_DECODER_ENTITY:
+		mpd_entity_free(object);
+		break;
+
+	case MPD_DECODER_SONG:
+		mpd_song_free(object);
+		break;
+
+	case MPD_DECODER_OUTPUT:
+		mpd_output_free(object);
+		break;
+
+	case MPD_DECODER_STATUS:
+		mpd_status_free(object);
+		break;
+
+	case MPD_DECODER_STATS:
+		mpd_stats_free(object);
+		break;
+	}
+}
+
+static void
+mpd_decoder_clear(struct mpd_decoder *decoder)
+{
+	mpd_decoder_free_object(decoder->type, decoder->current);
+	mpd_decoder_free_object(decoder->type, decoder->ready);
+	decoder->current = NULL;
+	decoder->ready = NULL;
+}
+
+struct mpd_decoder *
+mpd_decoder_new(enum mpd_decoder_type type)
+{
+	struct mpd_decoder *decoder = malloc(sizeof(*decoder));
+	if (decoder == NULL)
+		return NULL;
+
+	decoder->parser = mpd_parser_new();
+	if (decoder->parser == NULL) {
+		free(decoder);
+		return NULL;
+	}
+
+	decoder->type = type;
+	decoder->current = NULL;
+	decoder->ready = NULL;
+	decoder->finished = false;
+	mpd_error_init(&decoder->error);
+	return decoder;
+}
+
+void
+mpd_decoder_free(struct mpd_decoder *decoder)
+{
+	assert(decoder != NULL);
+
+	mpd_decoder_clear(decoder);
+	mpd_parser_free(decoder->parser);
+	mpd_error_deinit(&decoder->error);
+	free(decoder);
+}
+
+void
+mpd_decoder_begin(struct mpd_decoder *decoder, enum mpd_decoder_type type)
+{
+	assert(decoder != NULL);
+
+	mpd_decoder_clear(decoder);
+	decoder->type = type;
+	decoder->finished = false;
+	mpd_error_clear(&decoder->error);
+}
+
+/**
+ * Marks the current object as complete.
+ */
+static void
+mpd_decoder_complete(struct mpd_decoder *decoder)
+{
+	assert(decoder->ready == NULL);
+
+	decoder->ready = decoder->current;
+	decoder->current = NULL;
+}
+
+/**
+ * Starts a new object with the given pair, after completing the
+ * previous one.
+ *
+ * @return false on error
+ */
+static bool
+mpd_decoder_start(struct mpd_decoder *decoder, const struct mpd_pair *pair)
+{
+	mpd_decoder_complete(decoder);
+
+	switch (decoder->type) {
+	case MPD_DECODER_ENTITY:
+		decoder->current = mpd_entity_begin(pair);
+		if (decoder->current == NULL) {
+			mpd_error_entity(&decoder->error);
+			return false;
+		}
+
+		break;
+
+	case MPD_DECODER_SONG:
+		decoder->current = mpd_song_begin(pair);
+		if (decoder->current == NULL) {
+			mpd_error_entity(&decoder->error);
+			return false;
+		}
+
+		break;
+
+	case MPD_DECODER_OUTPUT:
+		decoder->current = mpd_output_begin(pair);
+		if (decoder->current == NULL) {
+			mpd_error_code(&decoder->error, MPD_ERROR_OOM);
+			return false;
+		}
+
+		break;
+
+	case MPD_DECODER_STATUS:
+	case MPD_DECODER_STATS:
+		/* these consist of only one object */
+		assert(false);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Creates the status/stats object if it does not exist yet.
+ *
+ * @return false on out of memory
+ */
+static bool
+mpd_decoder_make_single(struct mpd_decoder *decoder)
+{
+	if (decoder->current != NULL)
+		return true;
+
+	decoder->current = decoder->type == MPD_DECODER_STATUS
+		? (void *)mpd_status_begin()
+		: (void *)mpd_stats_begin();
+	if (decoder->current == NULL) {
+		mpd_error_code(&decoder->error, MPD_ERROR_OOM);
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+mpd_decoder_feed_pair(struct mpd_decoder *decoder,
+		      const struct mpd_pair *pair)
+{
+	switch (decoder->type) {
+	case MPD_DECODER_ENTITY:
+		if (decoder->current != NULL &&
+		    mpd_entity_feed(decoder->current, pair))
+			return true;
+
+		return mpd_decoder_start(decoder, pair);
+
+	case MPD_DECODER_SONG:
+		if (strcmp(pair->name, "file") == 0)
+			return mpd_decoder_start(decoder, pair);
+
+		/* ignore pairs before the first song, just like
+		   mpd_recv_song() */
+		if (decoder->current != NULL)
+			mpd_song_feed(decoder->current, pair);
+		return true;
+
+	case MPD_DECODER_OUTPUT:
+		if (strcmp(pair->name, "outputid") == 0)
+			return mpd_decoder_start(decoder, pair);
+
+		if (decoder->current != NULL)
+			mpd_output_feed(decoder->current, pair);
+		return true;
+
+	case MPD_DECODER_STATUS:
+		if (!mpd_decoder_make_single(decoder))
+			return false;
+
+		mpd_status_feed(decoder->current, pair);
+		return true;
+
+	case MPD_DECODER_STATS:
+		if (!mpd_decoder_make_single(decoder))
+			return false;
+
+		mpd_stats_feed(decoder->current, pair);
+		return true;
+	}
+
+	return true;
+}
+
+enum mpd_decoder_result
+mpd_decoder_feed(struct mpd_decoder *decoder, char *line)
+{
+	assert(decoder != NULL);
+	assert(line != NULL);
+	assert(!decoder->finished);
+
+	/* discard the object which the caller did not take */
+	mpd_decoder_free_object(decoder->type, decoder->ready);
+	decoder->ready = NULL;
+
+	switch (mpd_parser_feed(decoder->parser, line)) {
+	case MPD_PARSER_MALFORMED:
+		break;
+
+	case MPD_PARSER_SUCCESS:
+		if ((decoder->type == MPD_DECODER_STATUS ||
+		     decoder->type == MPD_DECODER_STATS) &&
+		    !mpd_decoder_make_single(decoder))
+			break;
+
+		mpd_decoder_complete(decoder);
+
+		if (mpd_parser_is_discrete(decoder->parser))
+			return MPD_DECODER_NEXT;
+
+		decoder->finished = true;
+		return MPD_DECODER_DONE;
+
+	case MPD_PARSER_ERROR: {
+		mpd_decoder_clear(decoder);
+		decoder->finished = true;
+
+		mpd_error_server(&decoder->error,
+				 mpd_parser_get_server_error(decoder->parser),
+				 mpd_parser_get_at(decoder->parser));
+
+		const char *msg = mpd_parser_get_message(decoder->parser);
+		if (msg == NULL)
+			msg = "Unspecified MPD error";
+		mpd_error_message(&decoder->error, msg);
+		return MPD_DECODER_ERROR;
+	}
+
+	case MPD_PARSER_PAIR: {
+		const struct mpd_pair pair = {
+			.name = mpd_parser_get_name(decoder->parser),
+			.value = mpd_parser_get_value(decoder->parser),
+		};
+
+		if (mpd_decoder_feed_pair(decoder, &pair))
+			return MPD_DECODER_MORE;
+
+		break;
+	}
+	}
+
+	if (!mpd_error_is_defined(&decoder->error)) {
+		mpd_error_code(&decoder->error, MPD_ERROR_MALFORMED);
+		mpd_error_message(&decoder->error,
+				  "Failed to parse MPD response");
+	}
+
+	mpd_decoder_clear(decoder);
+	decoder->finished = true;
+	return MPD_DECODER_ERROR;
+}
+
+static void *
+mpd_decoder_take(struct mpd_decoder *decoder, enum mpd_decoder_type type)
+{
+	assert(decoder != NULL);
+	assert(decoder->type == type);
+	(void)type;
+
+	void *object = decoder->ready;
+	decoder->ready = NULL;
+	return object;
+}
+
+struct mpd_entity *
+mpd_decoder_take_entity(struct mpd_decoder *decoder)
+{
+	return mpd_decoder_take(decoder, MPD_DECODER_ENTITY);
+}
+
+struct mpd_song *
+mpd_decoder_take_song(struct mpd_decoder *decoder)
+{
+	return mpd_decoder_take(decoder, MPD_DECODER_SONG);
+}
+
+struct mpd_output *
+mpd_decoder_take_output(struct mpd_decoder *decoder)
+{
+	return mpd_decoder_take(decoder, MPD_DECODER_OUTPUT);
+}
+
+struct mpd_status *
+mpd_decoder_take_status(struct mpd_decoder *decoder)
+{
+	return mpd_decoder_take(decoder, MPD_DECODER_STATUS);
+}
+
+struct mpd_stats *
+mpd_decoder_take_stats(struct mpd_decoder *decoder)
+{
+	return mpd_decoder_take(decoder, MPD_DECODER_STATS);
+}
+
+enum mpd_error
+mpd_decoder_get_error(const struct mpd_decoder *decoder)
+{
+	assert(decoder != NULL);
+
+	return decoder->error.code;
+}
+
+const char *
+mpd_decoder_get_error_message(const struct mpd_decoder *decoder)
+{
+	assert(decoder != NULL);
+
+	return mpd_error_get_message(&decoder->error);
+}
+
+enum mpd_server_error
+mpd_decoder_get_server_error(const struct mpd_decoder *decoder)
+{
+	assert(decoder != NULL);
+	assert(decoder->error.code == MPD_ERROR_SERVER);
+
+	return decoder->error.server;
+}
@@ -5,6 +5,7 @@
 #include <mpd/playlist.h>
 #include <mpd/recv.h>
 #include "internal.h"
+#include "imetrics.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -193,6 +194,8 @@ mpd_recv_entity(struct mpd_connection *connection)
 		return NULL;
 	}
 
+	mpd_metrics_add(connection->metrics, MPD_METRIC_OBJECTS, 1);
+
 	while ((pair = mpd_recv_pair(connection)) != NULL &&
 	       mpd_entity_feed(entity, pair))
 		mpd_return_pair(connection, pair);
@@ -3,6 +3,7 @@
 
 #include <mpd/connection.h>
 #include "internal.h"
+#include "iasync.h"
 
 #include <assert.h>
 
@@ -50,5 +51,11 @@ mpd_connection_clear_error(struct mpd_connection *connection)
 		return false;
 
 	mpd_error_clear(&connection->error);
+
+	/* the caller may abandon a command list after the error; the
+	   next command must not be held back by MSG_MORE */
+	if (connection->async != NULL)
+		mpd_async_set_more(connection->async, false);
+
 	return true;
 }
@@ -0,0 +1,1021 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "config.h"
+#include <mpd/filter.h>
+#include <mpd/song.h>
+#include <mpd/song_table.h>
+#include <mpd/tag.h>
+#include "fold.h"
+#include "iso8601.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_REGEX_H
+#include <regex.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+enum {
+	/**
+	 * Limits the recursion of the parser.
+	 */
+	MPD_FILTER_MAX_DEPTH = 32,
+
+	/**
+	 * Tables smaller than this are always scanned in one thread.
+	 */
+	MPD_FILTER_MIN_ROWS_PER_THREAD = 16384,
+};
+
+enum filter_node_type {
+	FILTER_TAG,
+	FILTER_ANY,
+	FILTER_URI,
+	FILTER_BASE,
+	FILTER_MODIFIED_SINCE,
+	FILTER_ADDED_SINCE,
+	FILTER_PRIO,
+	FILTER_NOT,
+	FILTER_AND,
+};
+
+enum filter_operator {
+	FILTER_EQUALS,
+	FILTER_CONTAINS,
+	FILTER_STARTS_WITH,
+	FILTER_REGEX,
+};
+
+struct filter_node {
+	enum filter_node_type type;
+
+	/**
+	 * The index of this node in the per-scan memo, see
+	 * #filter_scan.
+	 */
+	unsigned index;
+
+	/* FILTER_TAG, FILTER_ANY, FILTER_URI, FILTER_BASE */
+	enum mpd_tag_type tag;
+	enum filter_operator op;
+	bool negated;
+	bool fold_case;
+
+	/**
+	 * The value to compare with; already folded to lower case if
+	 * #fold_case is set.
+	 */
+	char *value;
+	size_t length;
+
+#ifdef HAVE_REGEX_H
+	bool have_regex;
+	regex_t regex;
+#endif
+
+	/* FILTER_MODIFIED_SINCE, FILTER_ADDED_SINCE */
+	int64_t since;
+
+	/* FILTER_PRIO */
+	unsigned prio;
+
+	/* FILTER_NOT, FILTER_AND */
+	struct filter_node **children;
+	unsigned n_children;
+};
+
+struct mpd_filter {
+	struct filter_node *root;
+
+	/**
+	 * The total number of nodes.
+	 */
+	unsigned n_nodes;
+};
+
+static void
+filter_node_free(struct filter_node *node)
+{
+	for (unsigned i = 0; i < node->n_children; ++i)
+		filter_node_free(node->children[i]);
+	free(node->children);
+
+#ifdef HAVE_REGEX_H
+	if (node->have_regex)
+		regfree(&node->regex);
+#endif
+
+	free(node->value);
+	free(node);
+}
+
+void
+mpd_filter_free(struct mpd_filter *filter)
+{
+	assert(filter != NULL);
+
+	if (filter->root != NULL)
+		filter_node_free(filter->root);
+	free(filter);
+}
+
+/*
+ * Parser
+ *
+ */
+
+struct filter_parser {
+	const char *p;
+	struct mpd_filter *filter;
+	bool fold_case;
+
+	/**
+	 * The errno value to be reported after a failure.
+	 */
+	int error;
+};
+
+static void
+filter_skip_space(struct filter_parser *parser)
+{
+	while (*parser->p == ' ' || *parser->p == '\t')
+		++parser->p;
+}
+
+static bool
+filter_is_word_char(char ch)
+{
+	return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+		(ch >= '0' && ch <= '9') || ch == '_' || ch == '-' ||
+		ch == '=' || ch == '!' || ch == '~' || ch == '>';
+}
+
+/**
+ * Reads one word (a name or an operator) into the buffer.
+ */
+static bool
+filter_parse_word(struct filter_parser *parser, char *buffer, size_t size)
+{
+	filter_skip_space(parser);
+
+	size_t length = 0;
+	while (filter_is_word_char(*parser->p)) {
+		if (length + 1 >= size)
+			return false;
+
+		buffer[length++] = *parser->p++;
+	}
+
+	buffer[length] = 0;
+	return length > 0;
+}
+
+/**
+ * Parses a quoted string with backslash escapes.
+ *
+ * @return the unquoted string (allocated with malloc()) or NULL on
+ * error
+ */
+static char *
+filter_parse_string(struct filter_parser *parser, size_t *length_r)
+{
+	filter_skip_space(parser);
+
+	const char quote = *parser->p;
+	if (quote != '\'' && quote != '"')
+		return NULL;
+
+	const char *p = ++parser->p;
+	char *value = malloc(strlen(p) + 1);
+	if (value == NULL) {
+		parser->error = ENOMEM;
+		return NULL;
+	}
+
+	size_t length = 0;
+	while (*p != quote) {
+		if (*p == '\\' && p[1] != 0)
+			++p;
+
+		if (*p == 0) {
+			free(value);
+			return NULL;
+		}
+
+		value[length++] = *p++;
+	}
+
+	value[length] = 0;
+	parser->p = p + 1;
+	*length_r = length;
+	return value;
+}
+
+/**
+ * Parses a time stamp, either ISO8601 or a number of seconds since
+ * the epoch.
+ */
+static bool
+filter_parse_time(const char *value, int64_t *since_r)
+{
+	char *endptr;
+	const unsigned long long t = strtoull(value, &endptr, 10);
+	if (endptr > value && *endptr == 0) {
+		*since_r = (int64_t)t;
+		return true;
+	}
+
+	*since_r = iso8601_datetime_parse(value);
+	return *since_r != 0;
+}
+
+static struct filter_node *
+filter_node_new(struct filter_parser *parser, enum filter_node_type type)
+{
+	struct filter_node *node = calloc(1, sizeof(*node));
+	if (node == NULL) {
+		parser->error = ENOMEM;
+		return NULL;
+	}
+
+	node->type = type;
+	node->index = parser->filter->n_nodes++;
+	return node;
+}
+
+static bool
+filter_node_add_child(struct filter_parser *parser, struct filter_node *node,
+		      struct filter_node *child)
+{
+	struct filter_node **children =
+		realloc(node->children,
+			(node->n_children + 1) * sizeof(*children));
+	if (children == NULL) {
+		parser->error = ENOMEM;
+		filter_node_free(child);
+		return false;
+	}
+
+	node->children = children;
+	node->children[node->n_children++] = child;
+	return true;
+}
+
+/**
+ * Parses an operator such as "==" or "!contains_ci".
+ */
+static bool
+filter_parse_operator(struct filter_node *node, const char *op,
+		      bool fold_case)
+{
+	node->negated = *op == '!';
+
+	static const struct {
+		const char *name;
+		enum filter_operator op;
+		bool negated;
+	} operators[] = {
+		{ "==", FILTER_EQUALS, false },
+		{ "!=", FILTER_EQUALS, true },
+		{ "=~", FILTER_REGEX, false },
+		{ "!~", FILTER_REGEX, true },
+	};
+
+	for (unsigned i = 0; i < sizeof(operators) / sizeof(operators[0]); ++i) {
+		if (strcmp(op, operators[i].name) == 0) {
+			node->op = operators[i].op;
+			node->negated = operators[i].negated;
+			node->fold_case = fold_case;
+			return true;
+		}
+	}
+
+	if (node->negated)
+		++op;
+
+	static const struct {
+		const char *name;
+		enum filter_operator op;
+	} words[] = {
+		{ "eq", FILTER_EQUALS },
+		{ "contains", FILTER_CONTAINS },
+		{ "starts_with", FILTER_STARTS_WITH },
+	};
+
+	for (unsigned i = 0; i < sizeof(words) / sizeof(words[0]); ++i) {
+		const size_t length = strlen(words[i].name);
+		if (strncmp(op, words[i].name, length) != 0)
+			continue;
+
+		const char *suffix = op + length;
+		if (strcmp(suffix, "_cs") == 0)
+			node->fold_case = false;
+		else if (strcmp(suffix, "_ci") == 0)
+			node->fold_case = true;
+		else if (*suffix == 0 && words[i].op != FILTER_EQUALS)
+			node->fold_case = fold_case;
+		else
+			continue;
+
+		node->op = words[i].op;
+		return true;
+	}
+
+	return false;
+}
+
+static bool
+filter_compile_value(struct filter_node *node)
+{
+	if (node->op == FILTER_REGEX) {
+#ifdef HAVE_REGEX_H
+		int flags = REG_EXTENDED | REG_NOSUB;
+		if (node->fold_case)
+			flags |= REG_ICASE;
+
+		if (regcomp(&node->regex, node->value, flags) != 0)
+			return false;
+
+		node->have_regex = true;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	if (node->fold_case)
+		mpd_fold_copy(node->value, node->value, node->length);
+
+	return true;
+}
+
+static struct filter_node *
+filter_parse_expression(struct filter_parser *parser, unsigned depth);
+
+/**
+ * Parses the inside of a parenthesized expression beginning with a
+ * nested expression: either "(EXPR)" or "(EXPR AND EXPR ...)".
+ */
+static struct filter_node *
+filter_parse_and(struct filter_parser *parser, unsigned depth)
+{
+	struct filter_node *first = filter_parse_expression(parser, depth);
+	if (first == NULL)
+		return NULL;
+
+	filter_skip_space(parser);
+	if (*parser->p == ')')
+		return first;
+
+	struct filter_node *node = filter_node_new(parser, FILTER_AND);
+	if (node == NULL) {
+		filter_node_free(first);
+		return NULL;
+	}
+
+	if (!filter_node_add_child(parser, node, first)) {
+		filter_node_free(node);
+		return NULL;
+	}
+
+	char word[8];
+	while (*parser->p != ')') {
+		if (!filter_parse_word(parser, word, sizeof(word)) ||
+		    strcmp(word, "AND") != 0) {
+			filter_node_free(node);
+			return NULL;
+		}
+
+		filter_skip_space(parser);
+		struct filter_node *child =
+			filter_parse_expression(parser, depth);
+		if (child == NULL ||
+		    !filter_node_add_child(parser, node, child)) {
+			filter_node_free(node);
+			return NULL;
+		}
+
+		filter_skip_space(parser);
+	}
+
+	return node;
+}
+
+/**
+ * Parses the inside of a parenthesized expression beginning with a
+ * name: "(NAME OP 'VALUE')" or one of the special forms.
+ */
+static struct filter_node *
+filter_parse_comparison(struct filter_parser *parser)
+{
+	char name[64];
+	if (!filter_parse_word(parser, name, sizeof(name)))
+		return NULL;
+
+	struct filter_node *node;
+	if (strcmp(name, "base") == 0 ||
+	    strcmp(name, "modified-since") == 0 ||
+	    strcmp(name, "added-since") == 0) {
+		node = filter_node_new(parser,
+				       *name == 'b' ? FILTER_BASE
+				       : *name == 'm' ? FILTER_MODIFIED_SINCE
+				       : FILTER_ADDED_SINCE);
+		if (node == NULL)
+			return NULL;
+
+		node->value = filter_parse_string(parser, &node->length);
+		if (node->value == NULL ||
+		    (node->type != FILTER_BASE &&
+		     !filter_parse_time(node->value, &node->since))) {
+			filter_node_free(node);
+			return NULL;
+		}
+
+		return node;
+	}
+
+	char op[24];
+	if (!filter_parse_word(parser, op, sizeof(op)))
+		return NULL;
+
+	if (strcmp(name, "prio") == 0) {
+		filter_skip_space(parser);
+
+		char *endptr;
+		const unsigned long prio = strtoul(parser->p, &endptr, 10);
+		if (strcmp(op, ">=") != 0 || endptr == parser->p)
+			return NULL;
+
+		parser->p = endptr;
+		node = filter_node_new(parser, FILTER_PRIO);
+		if (node != NULL)
+			node->prio = (unsigned)prio;
+		return node;
+	}
+
+	enum mpd_tag_type tag = MPD_TAG_UNKNOWN;
+	enum filter_node_type type;
+	if (strcmp(name, "file") == 0)
+		type = FILTER_URI;
+	else if (strcmp(name, "any") == 0)
+		type = FILTER_ANY;
+	else if ((tag = mpd_tag_name_iparse(name)) != MPD_TAG_UNKNOWN)
+		type = FILTER_TAG;
+	else
+		return NULL;
+
+	node = filter_node_new(parser, type);
+	if (node == NULL)
+		return NULL;
+
+	node->tag = tag;
+	if (!filter_parse_operator(node, op, parser->fold_case)) {
+		filter_node_free(node);
+		return NULL;
+	}
+
+	node->value = filter_parse_string(parser, &node->length);
+	if (node->value == NULL || !filter_compile_value(node)) {
+		filter_node_free(node);
+		return NULL;
+	}
+
+	return node;
+}
+
+static struct filter_node *
+filter_parse_expression(struct filter_parser *parser, unsigned depth)
+{
+	filter_skip_space(parser);
+	if (*parser->p != '(' || ++depth > MPD_FILTER_MAX_DEPTH)
+		return NULL;
+
+	++parser->p;
+	filter_skip_space(parser);
+
+	struct filter_node *node;
+	if (*parser->p == '!' && parser->p[1] != '=' && parser->p[1] != '~') {
+		++parser->p;
+
+		struct filter_node *child =
+			filter_parse_expression(parser, depth);
+		if (child == NULL)
+			return NULL;
+
+		node = filter_node_new(parser, FILTER_NOT);
+		if (node == NULL) {
+			filter_node_free(child);
+			return NULL;
+		}
+
+		if (!filter_node_add_child(parser, node, child)) {
+			filter_node_free(node);
+			return NULL;
+		}
+	} else if (*parser->p == '(')
+		node = filter_parse_and(parser, depth);
+	else
+		node = filter_parse_comparison(parser);
+
+	if (node == NULL)
+		return NULL;
+
+	filter_skip_space(parser);
+	if (*parser->p != ')') {
+		filter_node_free(node);
+		return NULL;
+	}
+
+	++parser->p;
+	return node;
+}
+
+struct mpd_filter *
+mpd_filter_new(const char *expression, bool fold_case)
+{
+	assert(expression != NULL);
+
+	struct mpd_filter *filter = calloc(1, sizeof(*filter));
+	if (filter == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	struct filter_parser parser = {
+		.p = expression,
+		.filter = filter,
+		.fold_case = fold_case,
+		.error = EINVAL,
+	};
+
+	filter->root = filter_parse_expression(&parser, 0);
+	if (filter->root != NULL) {
+		filter_skip_space(&parser);
+		if (*parser.p == 0)
+			return filter;
+	}
+
+	mpd_filter_free(filter);
+	errno = parser.error;
+	return NULL;
+}
+
+/*
+ * Evaluation
+ *
+ */
+
+/**
+ * Compares the beginning of #s with the already folded string
+ * #folded.  Stops at the end of #s.
+ */
+static bool
+filter_fold_prefix(const char *s, const char *folded, size_t length)
+{
+	for (size_t i = 0; i < length; ++i)
+		if (mpd_fold_char((unsigned char)s[i]) != (unsigned char)folded[i])
+			return false;
+
+	return true;
+}
+
+static bool
+filter_fold_contains(const char *s, const char *folded, size_t length)
+{
+	if (length == 0)
+		return true;
+
+	const unsigned char first = (unsigned char)folded[0];
+	for (; *s != 0; ++s)
+		if (mpd_fold_char((unsigned char)*s) == first &&
+		    filter_fold_prefix(s + 1, folded + 1, length - 1))
+			return true;
+
+	return false;
+}
+
+/**
+ * Evaluates the string comparison of a node, ignoring its negation.
+ */
+static bool
+filter_string_match(const struct filter_node *node, const char *s)
+{
+	switch (node->op) {
+	case FILTER_EQUALS:
+		return node->fold_case
+			? filter_fold_prefix(s, node->value, node->length) &&
+			s[node->length] == 0
+			: strcmp(s, node->value) == 0;
+
+	case FILTER_CONTAINS:
+		return node->fold_case
+			? filter_fold_contains(s, node->value, node->length)
+			: strstr(s, node->value) != NULL;
+
+	case FILTER_STARTS_WITH:
+		return node->fold_case
+			? filter_fold_prefix(s, node->value, node->length)
+			: strncmp(s, node->value, node->length) == 0;
+
+	case FILTER_REGEX:
+#ifdef HAVE_REGEX_H
+		return regexec(&node->regex, s, 0, NULL, 0) == 0;
+#else
+		break;
+#endif
+	}
+
+	return false;
+}
+
+/**
+ * Is the URI inside the base directory (or the base itself)?
+ */
+static bool
+filter_base_match(const struct filter_node *node, const char *uri)
+{
+	return node->length == 0 ||
+		(strncmp(uri, node->value, node->length) == 0 &&
+		 (uri[node->length] == 0 || uri[node->length] == '/'));
+}
+
+/**
+ * Returns the tag which MPD uses instead if a song does not have the
+ * specified tag, or #MPD_TAG_UNKNOWN.
+ */
+static enum mpd_tag_type
+filter_tag_fallback(enum mpd_tag_type type)
+{
+	switch (type) {
+	case MPD_TAG_ALBUM_ARTIST:
+	case MPD_TAG_ARTIST_SORT:
+		return MPD_TAG_ARTIST;
+
+	case MPD_TAG_ALBUM_ARTIST_SORT:
+		return MPD_TAG_ALBUM_ARTIST;
+
+	case MPD_TAG_ALBUM_SORT:
+		return MPD_TAG_ALBUM;
+
+	case MPD_TAG_COMPOSER_SORT:
+		return MPD_TAG_COMPOSER;
+
+	default:
+		return MPD_TAG_UNKNOWN;
+	}
+}
+
+/**
+ * Evaluates a tag comparison on one song, ignoring the negation.
+ */
+static bool
+filter_song_tag_match(const struct filter_node *node,
+		      const struct mpd_song *song)
+{
+	enum mpd_tag_type type = node->tag;
+	const char *value;
+
+	while ((value = mpd_song_get_tag(song, type, 0)) == NULL) {
+		type = filter_tag_fallback(type);
+		if (type == MPD_TAG_UNKNOWN)
+			/* MPD compares missing tags as empty strings */
+			return filter_string_match(node, "");
+	}
+
+	unsigned i = 0;
+	do {
+		if (filter_string_match(node, value))
+			return true;
+	} while ((value = mpd_song_get_tag(song, type, ++i)) != NULL);
+
+	return false;
+}
+
+static bool
+filter_song_any_match(const struct filter_node *node,
+		      const struct mpd_song *song)
+{
+	for (unsigned t = 0; t < MPD_TAG_COUNT; ++t) {
+		const char *value;
+		for (unsigned i = 0;
+		     (value = mpd_song_get_tag(song, (enum mpd_tag_type)t,
+					       i)) != NULL;
+		     ++i)
+			if (filter_string_match(node, value))
+				return true;
+	}
+
+	return false;
+}
+
+static bool
+filter_node_match_song(const struct filter_node *node,
+		       const struct mpd_song *song)
+{
+	switch (node->type) {
+	case FILTER_TAG:
+		return filter_song_tag_match(node, song) != node->negated;
+
+	case FILTER_ANY:
+		return filter_song_any_match(node, song) != node->negated;
+
+	case FILTER_URI:
+		return filter_string_match(node, mpd_song_get_uri(song)) !=
+			node->negated;
+
+	case FILTER_BASE:
+		return filter_base_match(node, mpd_song_get_uri(song));
+
+	case FILTER_MODIFIED_SINCE:
+		return mpd_song_get_last_modified(song) >= node->since;
+
+	case FILTER_ADDED_SINCE:
+		return mpd_song_get_added(song) >= node->since;
+
+	case FILTER_PRIO:
+		return mpd_song_get_prio(song) >= node->prio;
+
+	case FILTER_NOT:
+		return !filter_node_match_song(node->children[0], song);
+
+	case FILTER_AND:
+		for (unsigned i = 0; i < node->n_children; ++i)
+			if (!filter_node_match_song(node->children[i], song))
+				return false;
+		return true;
+	}
+
+	return false;
+}
+
+bool
+mpd_filter_match(const struct mpd_filter *filter,
+		 const struct mpd_song *song)
+{
+	assert(filter != NULL);
+	assert(song != NULL);
+
+	return filter_node_match_song(filter->root, song);
+}
+
+/**
+ * The state of scanning a range of a #mpd_song_table.
+ */
+struct filter_scan {
+	const struct mpd_filter *filter;
+	const struct mpd_song_table *table;
+	const char *heap;
+
+	/**
+	 * The columns of all tags, indexed by #mpd_tag_type; NULL if
+	 * the table has no such column.
+	 */
+	const uint32_t *tags[MPD_TAG_COUNT];
+
+	/**
+	 * For each node: the heap offset of the value which was
+	 * compared last, and the result.  Tag values are interned and
+	 * neighbouring rows (e.g. songs of one album) often share
+	 * them, so this saves most comparisons.  NULL if the memo
+	 * could not be allocated.
+	 */
+	uint32_t *memo_offsets;
+	bool *memo_results;
+
+	unsigned begin, end;
+	uint32_t *rows;
+	unsigned n_rows;
+};
+
+static bool
+filter_scan_tag_match(struct filter_scan *scan,
+		      const struct filter_node *node, unsigned row)
+{
+	enum mpd_tag_type type = node->tag;
+	uint32_t offset = 0;
+
+	do {
+		if (scan->tags[type] != NULL)
+			offset = scan->tags[type][row];
+	} while (offset == 0 &&
+		 (type = filter_tag_fallback(type)) != MPD_TAG_UNKNOWN);
+
+	if (scan->memo_offsets == NULL)
+		return filter_string_match(node, scan->heap + offset);
+
+	if (offset != 0 && scan->memo_offsets[node->index] == offset)
+		return scan->memo_results[node->index];
+
+	const bool result = filter_string_match(node, scan->heap + offset);
+	scan->memo_offsets[node->index] = offset;
+	scan->memo_results[node->index] = result;
+	return result;
+}
+
+static bool
+filter_scan_any_match(const struct filter_scan *scan,
+		      const struct filter_node *node, unsigned row)
+{
+	for (unsigned t = 0; t < MPD_TAG_COUNT; ++t) {
+		if (scan->tags[t] == NULL)
+			continue;
+
+		const uint32_t offset = scan->tags[t][row];
+		if (offset != 0 &&
+		    filter_string_match(node, scan->heap + offset))
+			return true;
+	}
+
+	return false;
+}
+
+static bool
+filter_node_match_row(struct filter_scan *scan,
+		      const struct filter_node *node, unsigned row)
+{
+	const struct mpd_song_table *table = scan->table;
+
+	switch (node->type) {
+	case FILTER_TAG:
+		return filter_scan_tag_match(scan, node, row) != node->negated;
+
+	case FILTER_ANY:
+		return filter_scan_any_match(scan, node, row) != node->negated;
+
+	case FILTER_URI:
+		return filter_string_match(node, scan->heap +
+					   mpd_song_table_get_uris(table)[row]) !=
+			node->negated;
+
+	case FILTER_BASE:
+		return filter_base_match(node, scan->heap +
+					 mpd_song_table_get_uris(table)[row]);
+
+	case FILTER_MODIFIED_SINCE:
+		return mpd_song_table_get_last_modified(table)[row] >=
+			node->since;
+
+	case FILTER_ADDED_SINCE:
+		return mpd_song_table_get_added(table)[row] >= node->since;
+
+	case FILTER_PRIO:
+		return mpd_song_table_get_priorities(table)[row] >= node->prio;
+
+	case FILTER_NOT:
+		return !filter_node_match_row(scan, node->children[0], row);
+
+	case FILTER_AND:
+		for (unsigned i = 0; i < node->n_children; ++i)
+			if (!filter_node_match_row(scan, node->children[i], row))
+				return false;
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Scans the rows from #begin to #end and writes the matching row
+ * indices to #rows.
+ */
+static void
+filter_scan_run(struct filter_scan *scan)
+{
+	const struct filter_node *root = scan->filter->root;
+
+	scan->n_rows = 0;
+	for (unsigned row = scan->begin; row < scan->end; ++row)
+		if (filter_node_match_row(scan, root, row))
+			scan->rows[scan->n_rows++] = row;
+}
+
+#ifdef HAVE_PTHREAD
+
+static void *
+filter_scan_thread(void *ctx)
+{
+	filter_scan_run(ctx);
+	return NULL;
+}
+
+#endif
+
+unsigned
+mpd_filter_scan(const struct mpd_filter *filter,
+		const struct mpd_song_table *table,
+		uint32_t *rows, unsigned n_threads)
+{
+	assert(filter != NULL);
+	assert(table != NULL);
+
+	const unsigned length = mpd_song_table_get_length(table);
+	assert(rows != NULL || length == 0);
+
+	if (n_threads < 1)
+		n_threads = 1;
+	if (n_threads > length / MPD_FILTER_MIN_ROWS_PER_THREAD)
+		n_threads = length / MPD_FILTER_MIN_ROWS_PER_THREAD;
+	if (n_threads < 1)
+		n_threads = 1;
+#ifndef HAVE_PTHREAD
+	n_threads = 1;
+#endif
+
+	struct filter_scan prototype = {
+		.filter = filter,
+		.table = table,
+		.heap = mpd_song_table_get_heap(table),
+	};
+
+	for (unsigned t = 0; t < MPD_TAG_COUNT; ++t)
+		prototype.tags[t] =
+			mpd_song_table_get_tags(table, (enum mpd_tag_type)t);
+
+	const size_t memo_size = filter->n_nodes *
+		(sizeof(uint32_t) + sizeof(bool));
+	struct filter_scan *scans = n_threads > 1
+		? malloc(n_threads * sizeof(*scans))
+		: NULL;
+	char *memo = calloc(n_threads, memo_size);
+
+	if (scans == NULL) {
+		/* one thread (or out of memory): scan everything
+		   here, with a memo if possible */
+		if (memo != NULL) {
+			prototype.memo_offsets = (uint32_t *)memo;
+			prototype.memo_results = (bool *)(prototype.memo_offsets +
+							  filter->n_nodes);
+		}
+
+		prototype.begin = 0;
+		prototype.end = length;
+		prototype.rows = rows;
+		filter_scan_run(&prototype);
+
+		free(memo);
+		return prototype.n_rows;
+	}
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		struct filter_scan *scan = &scans[i];
+		*scan = prototype;
+		if (memo != NULL) {
+			scan->memo_offsets =
+				(uint32_t *)(memo + i * memo_size);
+			scan->memo_results =
+				(bool *)(scan->memo_offsets + filter->n_nodes);
+		}
+		scan->begin = (unsigned)((uint64_t)length * i / n_threads);
+		scan->end = (unsigned)((uint64_t)length * (i + 1) / n_threads);
+
+		/* each range writes into its own part of the
+		   destination array; the results are moved together
+		   afterwards */
+		scan->rows = rows + scan->begin;
+	}
+
+#ifdef HAVE_PTHREAD
+	pthread_t *threads = n_threads > 1
+		? malloc((n_threads - 1) * sizeof(*threads))
+		: NULL;
+	unsigned n_started = 0;
+	if (threads != NULL)
+		while (n_started < n_threads - 1 &&
+		       pthread_create(&threads[n_started], NULL,
+				      filter_scan_thread,
+				      &scans[n_started + 1]) == 0)
+			++n_started;
+#else
+	const unsigned n_started = 0;
+#endif
+
+	/* the calling thread scans the first range and all ranges
+	   whose thread could not be started */
+	filter_scan_run(&scans[0]);
+	for (unsigned i = n_started + 1; i < n_threads; ++i)
+		filter_scan_run(&scans[i]);
+
+#ifdef HAVE_PTHREAD
+	for (unsigned i = 0; i < n_started; ++i)
+		pthread_join(threads[i], NULL);
+	free(threads);
+#endif
+
+	unsigned n = scans[0].n_rows;
+	for (unsigned i = 1; i < n_threads; ++i) {
+		memmove(rows + n, scans[i].rows,
+			scans[i].n_rows * sizeof(*rows));
+		n += scans[i].n_rows;
+	}
+
+	free(memo);
+	free(scans);
+	return n;
+}
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_FOLD_H
+#define MPD_FOLD_H
+
+#include <stddef.h>
+
+/*
+ * ASCII case folding for client-side string matching.  Bytes outside
+ * of ASCII (i.e. UTF-8 sequences) are left alone.
+ */
+
+static inline unsigned char
+mpd_fold_char(unsigned char ch)
+{
+	return (unsigned)(ch - 'A') < 26u ? (unsigned char)(ch + ('a' - 'A')) : ch;
+}
+
+/**
+ * Copies and folds #length bytes.
+ */
+static inline void
+mpd_fold_copy(char *dest, const char *src, size_t length)
+{
+	for (size_t i = 0; i < length; ++i)
+		dest[i] = (char)mpd_fold_char((unsigned char)src[i]);
+}
+
+#endif
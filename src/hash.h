@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_HASH_H
+#define MPD_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Calculates the 32 bit FNV-1a hash of #length bytes, for the string
+ * hash tables of the client-side indexes.
+ */
+static inline uint32_t
+mpd_hash_string(const char *s, size_t length)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= (unsigned char)s[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+#endif
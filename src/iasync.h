@@ -7,6 +7,8 @@
 #include <mpd/async.h>
 
 struct mpd_error_info;
+struct mpd_metrics;
+struct mpd_arg;
 
 /**
  * Creates a copy of that object's error condition.
@@ -30,4 +32,46 @@ bool
 mpd_async_set_error(struct mpd_async *async, enum mpd_error error,
 		    const char *error_message);
 
+/**
+ * Attaches performance counters to this object (owned by the
+ * caller), or detaches them if NULL is passed.
+ */
+void
+mpd_async_set_metrics(struct mpd_async *async, struct mpd_metrics *metrics);
+
+struct mpd_metrics *
+mpd_async_get_metrics(const struct mpd_async *async);
+
+/**
+ * Tells the kernel whether more output will follow the data which is
+ * currently buffered (MSG_MORE), e.g. while a command list is being
+ * sent.  This allows it to coalesce the segments of a large command
+ * list into full packets.
+ */
+void
+mpd_async_set_more(struct mpd_async *async, bool more);
+
+/**
+ * Like mpd_async_recv_line(), but also returns the length of the
+ * line, which saves the caller a strlen() call.
+ */
+char *
+mpd_async_recv_line_n(struct mpd_async *async, size_t *length_r);
+
+/**
+ * Appends a command with typed arguments to the output buffer.  The
+ * numbers are formatted right into the buffer, without depending on
+ * the locale.
+ *
+ * @param async the connection
+ * @param command the command name
+ * @param args an array of arguments
+ * @param n the number of arguments
+ * @return true on success, false if the buffer is full or an error has
+ * previously occurred
+ */
+bool
+mpd_async_send_args(struct mpd_async *async, const char *command,
+		    const struct mpd_arg *args, unsigned n);
+
 #endif
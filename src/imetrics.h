@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_IMETRICS_H
+#define MPD_IMETRICS_H
+
+#include <mpd/metrics.h>
+
+#include <stddef.h>
+
+enum {
+	/**
+	 * The maximum number of distinct command names with a
+	 * latency histogram; further commands are not measured.
+	 */
+	MPD_METRICS_MAX_COMMANDS = 64,
+
+	MPD_METRICS_NAME_SIZE = 32,
+
+	/**
+	 * Values below this are exact, and each power of two above
+	 * it is divided into this many sub-buckets.
+	 */
+	MPD_METRICS_SUB_BUCKETS = 8,
+
+	/**
+	 * Enough buckets for latencies up to 2^36 microseconds.
+	 */
+	MPD_METRICS_BUCKETS = (36 - 3 + 1) * MPD_METRICS_SUB_BUCKETS,
+};
+
+struct mpd_metrics_command {
+	char name[MPD_METRICS_NAME_SIZE];
+
+	uint64_t count;
+
+	uint32_t buckets[MPD_METRICS_BUCKETS];
+};
+
+struct mpd_metrics {
+	uint64_t counters[MPD_METRIC_COUNT];
+
+	unsigned num_commands;
+
+	struct mpd_metrics_command *commands[MPD_METRICS_MAX_COMMANDS];
+
+	/**
+	 * The command whose response is being awaited, or NULL.
+	 */
+	struct mpd_metrics_command *pending;
+
+	/**
+	 * The time when #pending was flushed, in microseconds.
+	 */
+	uint64_t pending_start;
+};
+
+/**
+ * Increments a counter.  This is a no-op if metrics are disabled,
+ * i.e. #metrics is NULL.
+ */
+static inline void
+mpd_metrics_add(struct mpd_metrics *metrics, enum mpd_metric metric,
+		uint64_t value)
+{
+	if (metrics != NULL)
+		metrics->counters[metric] += value;
+}
+
+mpd_malloc
+struct mpd_metrics *
+mpd_metrics_new(void);
+
+/**
+ * Starts measuring the latency of a command which has just been
+ * flushed.
+ *
+ * @param command the command line; only the first word is used
+ */
+void
+mpd_metrics_begin_command(struct mpd_metrics *metrics, const char *command);
+
+/**
+ * The response of the command passed to mpd_metrics_begin_command()
+ * has been received completely.
+ */
+void
+mpd_metrics_end_command(struct mpd_metrics *metrics);
+
+#endif
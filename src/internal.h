@@ -8,6 +8,8 @@
 
 #include "ierror.h"
 
+#include <stdint.h>
+
 /* for struct timeval */
 #ifdef _WIN32
 #include <winsock2.h>
@@ -75,6 +77,13 @@ struct mpd_connection {
 	 */
 	bool sending_command_list_ok;
 
+	/**
+	 * Has a password been sent after the connection was set up
+	 * (i.e. other than the one from the #mpd_settings)?  Then the
+	 * permissions may differ from what the settings suggest.
+	 */
+	bool password_sent;
+
 	/**
 	 * Did the caller finish reading one sub response?
 	 * (i.e. list_OK was received, and mpd_recv_pair() has
@@ -129,6 +138,50 @@ struct mpd_connection {
 	 * mpd_search_commit().
 	 */
 	char *request;
+
+	/**
+	 * Performance counters, or NULL if disabled.  See
+	 * mpd_connection_enable_metrics().
+	 */
+	struct mpd_metrics *metrics;
+
+	/**
+	 * The responses to "status" and "currentsong" of the
+	 * connection setup profile, see
+	 * mpd_settings_set_initial_state().  May be NULL.
+	 */
+	struct mpd_status *initial_status;
+	struct mpd_song *initial_song;
+
+	/**
+	 * The tag types enabled by the application (a mask of
+	 * #mpd_tag_type bits), tracked by the mpd_send_*_tag_types()
+	 * functions.  This is what the server has enabled while no
+	 * projected command is in progress.
+	 */
+	uint64_t tag_types;
+
+	/**
+	 * The tag types for the next command, see
+	 * mpd_set_tag_projection().  Only valid if
+	 * #projection_pending is set.
+	 */
+	uint64_t projection;
+
+	bool projection_pending;
+
+	/**
+	 * Is the response to a projected command being received?  If
+	 * it fails, the tag types have not been restored.
+	 */
+	bool projecting;
+
+	/**
+	 * Do the server's tag types differ from #tag_types, because a
+	 * projected command has failed?  Then they are restored
+	 * before the next command.
+	 */
+	bool tag_types_dirty;
 };
 
 /**
@@ -153,4 +206,11 @@ mpd_connection_timeout(const struct mpd_connection *connection)
 const struct mpd_settings *
 mpd_settings_get_next(const struct mpd_settings *settings);
 
+/**
+ * Does this settings object have a connection setup profile, i.e. is
+ * there anything to send besides the password?
+ */
+bool
+mpd_settings_has_profile(const struct mpd_settings *settings);
+
 #endif
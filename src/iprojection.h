@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_IPROJECTION_H
+#define MPD_IPROJECTION_H
+
+#include <mpd/tag.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct mpd_connection;
+
+/**
+ * A set of tag types: bit i stands for the #mpd_tag_type i.
+ */
+#define MPD_TAG_MASK_ALL ((UINT64_C(1) << MPD_TAG_COUNT) - 1)
+
+_Static_assert(MPD_TAG_COUNT <= 64, "tag mask too small");
+
+uint64_t
+mpd_tag_mask(const enum mpd_tag_type *types, unsigned n);
+
+/**
+ * Called by mpd_send_command() before the command is written.  If a
+ * projection is pending (or the server's tag types need to be
+ * restored after a failed projected command), this opens a command
+ * list and switches the tag types.
+ *
+ * @param wrapped_r set to true if mpd_projection_end() must be called
+ * after the command has been written
+ */
+bool
+mpd_projection_begin(struct mpd_connection *connection, const char *command,
+		     bool *wrapped_r);
+
+/**
+ * Restores the application's tag types and closes the command list
+ * opened by mpd_projection_begin().
+ */
+bool
+mpd_projection_end(struct mpd_connection *connection);
+
+#endif
@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_IRECV_H
+#define MPD_IRECV_H
+
+#include <stddef.h>
+
+/**
+ * Maps a pair name to a #mpd_pair_token or a #mpd_tag_type.
+ *
+ * @return the token, or #MPD_PAIR_TOKEN_OTHER
+ */
+int
+mpd_pair_token_parse(const char *name, size_t length);
+
+#endif
@@ -7,6 +7,7 @@
 #include <stdbool.h>
 
 struct mpd_connection;
+struct mpd_arg;
 
 /**
  * Sends a command without arguments to the server, but does not
@@ -16,6 +17,13 @@ struct mpd_connection;
 bool
 mpd_send_command2(struct mpd_connection *connection, const char *command);
 
+/**
+ * Sends a command with typed arguments, see mpd_async_send_args().
+ */
+bool
+mpd_send_args(struct mpd_connection *connection, const char *command,
+	      const struct mpd_arg *args, unsigned n);
+
 bool
 mpd_send_int_command(struct mpd_connection *connection, const char *command,
 		     int arg);
@@ -20,44 +20,24 @@ gmtime_r(const time_t *timep, struct tm *result)
 #endif /* _WIN32 */
 
 /**
- * @return the current time zone offset in seconds
+ * Converts a UTC calendar date to the number of days since
+ * 1970-01-01.  This replaces timegm(), which is a GNU extension;
+ * mktime() is not an option because it is relative to the current
+ * time zone and consults the time zone database on every call.
+ *
+ * The algorithm is from Howard Hinnant's "chrono-Compatible Low-Level
+ * Date Algorithms".
  */
-static time_t
-timezone_offset(void)
+static int64_t
+days_from_civil(int year, int month, int day)
 {
-	const time_t t0 = 1234567890;
-	time_t t = t0;
-	struct tm tm_buffer, *tm;
-
-	tm = gmtime_r(&t, &tm_buffer);
-	if (tm == NULL)
-		return 0;
-
-	/* force the daylight saving time to be off; gmtime_r() should
-	   have set this already */
-	tm->tm_isdst = 0;
-
-	t = mktime(tm);
-	if (t == -1)
-		return 0;
-
-	return t0 - t;
-}
-
-/**
- * Unfortunately, the useful timegm() function is a GNU extension, and
- * mktime() returns a stamp relative to the current time zone.  This
- * function emulates timegm() by subtracting the time zone offset, see
- * timezone_offset().
- */
-static time_t
-timegm_emulation(struct tm *tm)
-{
-	time_t t = mktime(tm);
-	if (t == -1)
-		return 0;
-
-	return t + timezone_offset();
+	year -= month <= 2;
+	const int64_t era = (year >= 0 ? year : year - 399) / 400;
+	const int64_t yoe = year - era * 400;
+	const int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5
+		+ day - 1;
+	const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
 }
 
 time_t
@@ -65,7 +45,6 @@ iso8601_datetime_parse(const char *input)
 {
 	char *endptr;
 	int year, month, day, hour, minute, second;
-	struct tm tm;
 
 	year = strtoimax(input, &endptr, 10);
 	if (year < 1970 || year >= 3000 || *endptr != '-')
@@ -98,18 +77,8 @@ iso8601_datetime_parse(const char *input)
 	    (*endptr != 0 && *endptr != 'Z'))
 		return 0;
 
-	tm.tm_year = year - 1900;
-	tm.tm_mon = month - 1;
-	tm.tm_mday = day;
-	tm.tm_hour = hour;
-	tm.tm_min = minute;
-	tm.tm_sec = second;
-
-	/* force the daylight saving time to be off, same as in
-	   timezone_offset() */
-	tm.tm_isdst = 0;
-
-	return timegm_emulation(&tm);
+	return (time_t)(days_from_civil(year, month, day) * 86400
+			+ hour * 3600 + minute * 60 + second);
 }
 
 bool
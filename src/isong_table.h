@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_ISONG_TABLE_H
+#define MPD_ISONG_TABLE_H
+
+#include <mpd/tag.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct mpd_song_table;
+
+/**
+ * The state of decoding a response into a #mpd_song_table; this
+ * allows other response parsers to feed their pairs into a table.
+ */
+struct mpd_song_table_receiver {
+	struct mpd_song_table *table;
+
+	/**
+	 * Are we inside a song, i.e. do attributes belong to the last
+	 * row?
+	 */
+	bool in_song;
+
+	/**
+	 * Has the last row already received a "duration" value, which
+	 * takes precedence over the rounded "Time"?
+	 */
+	bool precise_duration;
+
+	bool oom;
+};
+
+static inline void
+mpd_song_table_receiver_init(struct mpd_song_table_receiver *r,
+			     struct mpd_song_table *table)
+{
+	r->table = table;
+	r->in_song = false;
+	r->precise_duration = false;
+	r->oom = false;
+}
+
+/**
+ * A #mpd_pair_handler which adds the pair to the table.  Sets
+ * #oom and returns false on out of memory.
+ */
+bool
+mpd_song_table_receive_pair(const char *name, size_t name_length,
+			    const char *value, size_t value_length,
+			    int token, void *ctx);
+
+/**
+ * Writes the tag types which have a column in the table.
+ *
+ * @param tags an array with room for #MPD_TAG_COUNT elements
+ * @return the number of tag types
+ */
+unsigned
+mpd_song_table_copy_tag_types(const struct mpd_song_table *table,
+			      enum mpd_tag_type *tags);
+
+/**
+ * Creates an empty table with the same tag columns.
+ */
+struct mpd_song_table *
+mpd_song_table_new_like(const struct mpd_song_table *table);
+
+/**
+ * Appends a range of rows from a table created with
+ * mpd_song_table_new_like().
+ *
+ * @return false on out of memory (with some of the rows appended)
+ */
+bool
+mpd_song_table_append(struct mpd_song_table *dest,
+		      const struct mpd_song_table *src,
+		      unsigned begin, unsigned end);
+
+#endif
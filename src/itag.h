@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_ITAG_H
+#define MPD_ITAG_H
+
+#include <mpd/tag.h>
+
+#include <stddef.h>
+
+/**
+ * Like mpd_tag_name_parse(), but the name is specified with a length
+ * and does not need to be null-terminated.
+ */
+enum mpd_tag_type
+mpd_tag_name_parse_n(const char *name, size_t length);
+
+#endif
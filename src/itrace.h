@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_ITRACE_H
+#define MPD_ITRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The trace file format: the 8 byte magic #MPD_TRACE_MAGIC, followed
+ * by records.  Each record consists of:
+ *
+ * - one byte: #MPD_TRACE_SENT or #MPD_TRACE_RECEIVED
+ * - a variable-length integer: microseconds since the previous
+ *   record (or since the trace was opened)
+ * - a variable-length integer: the payload length
+ * - the payload
+ *
+ * Variable-length integers are little-endian base 128 (LEB128): 7
+ * bits per byte, and the most significant bit is set on all but the
+ * last byte.
+ */
+
+#define MPD_TRACE_MAGIC "MPDTRC1\n"
+
+enum mpd_trace_direction {
+	MPD_TRACE_SENT = 'S',
+	MPD_TRACE_RECEIVED = 'R',
+};
+
+struct mpd_trace;
+
+/**
+ * Creates a new trace file.
+ *
+ * @return the trace object, or NULL on error (errno is set)
+ */
+struct mpd_trace *
+mpd_trace_open(const char *path);
+
+void
+mpd_trace_close(struct mpd_trace *trace);
+
+/**
+ * Writes the header of a record with the current time stamp.  It
+ * must be followed by mpd_trace_append() calls with exactly
+ * #length bytes.
+ */
+void
+mpd_trace_begin(struct mpd_trace *trace, enum mpd_trace_direction direction,
+		size_t length);
+
+void
+mpd_trace_append(struct mpd_trace *trace, const void *data, size_t length);
+
+#endif
@@ -5,6 +5,7 @@
 #include <mpd/send.h>
 #include "internal.h"
 #include "isend.h"
+#include "iasync.h"
 
 #include <assert.h>
 
@@ -34,6 +35,10 @@ mpd_command_list_begin(struct mpd_connection *connection, bool discrete_ok)
 	connection->command_list_remaining = 0;
 	connection->discrete_finished = false;
 
+	/* the command list will be flushed by
+	   mpd_command_list_end() */
+	mpd_async_set_more(connection->async, true);
+
 	return true;
 }
 
@@ -52,6 +57,7 @@ mpd_command_list_end(struct mpd_connection *connection)
 	}
 
 	connection->sending_command_list = false;
+	mpd_async_set_more(connection->async, false);
 	success = mpd_send_command(connection, "command_list_end", NULL);
 	/* sending_command_list will be cleared when the user requests the
 	   command list response (a function that calls mpd_recv_pair()) */
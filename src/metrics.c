@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "imetrics.h"
+#include "clock.h"
+#include "iasync.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Returns the histogram bucket for a latency: values below
+ * #MPD_METRICS_SUB_BUCKETS have their own bucket, and each power of
+ * two above is split into #MPD_METRICS_SUB_BUCKETS linear
+ * sub-buckets.
+ */
+static unsigned
+mpd_metrics_bucket(uint64_t value)
+{
+	if (value < MPD_METRICS_SUB_BUCKETS)
+		return (unsigned)value;
+
+	unsigned exponent = 63;
+	while ((value >> exponent) == 0)
+		--exponent;
+
+	/* the three bits below the most significant one */
+	const unsigned sub = (unsigned)(value >> (exponent - 3)) &
+		(MPD_METRICS_SUB_BUCKETS - 1);
+	const unsigned bucket = (exponent - 2) * MPD_METRICS_SUB_BUCKETS +
+		sub;
+	return bucket < MPD_METRICS_BUCKETS
+		? bucket
+		: MPD_METRICS_BUCKETS - 1;
+}
+
+/**
+ * Returns the largest value which falls into the given bucket.
+ */
+static uint64_t
+mpd_metrics_bucket_max(unsigned bucket)
+{
+	if (bucket < MPD_METRICS_SUB_BUCKETS)
+		return bucket;
+
+	const unsigned exponent = bucket / MPD_METRICS_SUB_BUCKETS + 2;
+	const unsigned sub = bucket % MPD_METRICS_SUB_BUCKETS;
+	const uint64_t width = (uint64_t)1 << (exponent - 3);
+	return (MPD_METRICS_SUB_BUCKETS + sub) * width + width - 1;
+}
+
+struct mpd_metrics *
+mpd_metrics_new(void)
+{
+	return calloc(1, sizeof(struct mpd_metrics));
+}
+
+static void
+mpd_metrics_free_commands(struct mpd_metrics *metrics)
+{
+	for (unsigned i = 0; i < metrics->num_commands; ++i)
+		free(metrics->commands[i]);
+}
+
+void
+mpd_metrics_free(struct mpd_metrics *metrics)
+{
+	assert(metrics != NULL);
+
+	mpd_metrics_free_commands(metrics);
+	free(metrics);
+}
+
+static struct mpd_metrics_command *
+mpd_metrics_find_command(struct mpd_metrics *metrics,
+			 const char *name, size_t length)
+{
+	if (length >= MPD_METRICS_NAME_SIZE)
+		length = MPD_METRICS_NAME_SIZE - 1;
+
+	for (unsigned i = 0; i < metrics->num_commands; ++i) {
+		struct mpd_metrics_command *command = metrics->commands[i];
+		if (strncmp(command->name, name, length) == 0 &&
+		    command->name[length] == 0)
+			return command;
+	}
+
+	if (metrics->num_commands >= MPD_METRICS_MAX_COMMANDS)
+		return NULL;
+
+	struct mpd_metrics_command *command = calloc(1, sizeof(*command));
+	if (command == NULL)
+		return NULL;
+
+	memcpy(command->name, name, length);
+	metrics->commands[metrics->num_commands++] = command;
+	return command;
+}
+
+void
+mpd_metrics_begin_command(struct mpd_metrics *metrics, const char *command)
+{
+	assert(metrics != NULL);
+	assert(command != NULL);
+
+	metrics->pending =
+		mpd_metrics_find_command(metrics, command,
+					 strcspn(command, " \n"));
+	metrics->pending_start = mpd_clock_now();
+}
+
+void
+mpd_metrics_end_command(struct mpd_metrics *metrics)
+{
+	assert(metrics != NULL);
+
+	struct mpd_metrics_command *command = metrics->pending;
+	if (command == NULL)
+		return;
+
+	metrics->pending = NULL;
+
+	const uint64_t latency = mpd_clock_now() - metrics->pending_start;
+	++command->count;
+	++command->buckets[mpd_metrics_bucket(latency)];
+}
+
+bool
+mpd_connection_enable_metrics(struct mpd_connection *connection)
+{
+	assert(connection != NULL);
+
+	if (connection->metrics != NULL)
+		return true;
+
+	connection->metrics = mpd_metrics_new();
+	if (connection->metrics == NULL)
+		return false;
+
+	if (connection->async != NULL)
+		mpd_async_set_metrics(connection->async, connection->metrics);
+
+	return true;
+}
+
+struct mpd_metrics *
+mpd_connection_get_metrics(const struct mpd_connection *connection)
+{
+	assert(connection != NULL);
+
+	const struct mpd_metrics *src = connection->metrics;
+	if (src == NULL)
+		return NULL;
+
+	struct mpd_metrics *metrics = malloc(sizeof(*metrics));
+	if (metrics == NULL)
+		return NULL;
+
+	memcpy(metrics->counters, src->counters, sizeof(src->counters));
+	metrics->num_commands = 0;
+	metrics->pending = NULL;
+	metrics->pending_start = 0;
+
+	for (unsigned i = 0; i < src->num_commands; ++i) {
+		struct mpd_metrics_command *command =
+			malloc(sizeof(*command));
+		if (command == NULL) {
+			mpd_metrics_free(metrics);
+			return NULL;
+		}
+
+		memcpy(command, src->commands[i], sizeof(*command));
+		metrics->commands[metrics->num_commands++] = command;
+	}
+
+	return metrics;
+}
+
+uint64_t
+mpd_metrics_get(const struct mpd_metrics *metrics, enum mpd_metric metric)
+{
+	assert(metrics != NULL);
+	assert((unsigned)metric < MPD_METRIC_COUNT);
+
+	return metrics->counters[metric];
+}
+
+unsigned
+mpd_metrics_get_num_commands(const struct mpd_metrics *metrics)
+{
+	assert(metrics != NULL);
+
+	return metrics->num_commands;
+}
+
+const char *
+mpd_metrics_get_command_name(const struct mpd_metrics *metrics, unsigned i)
+{
+	assert(metrics != NULL);
+	assert(i < metrics->num_commands);
+
+	return metrics->commands[i]->name;
+}
+
+uint64_t
+mpd_metrics_get_command_count(const struct mpd_metrics *metrics, unsigned i)
+{
+	assert(metrics != NULL);
+	assert(i < metrics->num_commands);
+
+	return metrics->commands[i]->count;
+}
+
+uint64_t
+mpd_metrics_get_command_latency(const struct mpd_metrics *metrics,
+				unsigned i, double percentile)
+{
+	assert(metrics != NULL);
+	assert(i < metrics->num_commands);
+	assert(percentile >= 0 && percentile <= 100);
+
+	const struct mpd_metrics_command *command = metrics->commands[i];
+	if (command->count == 0)
+		return 0;
+
+	/* the number of samples at or below the requested value */
+	uint64_t threshold =
+		(uint64_t)((double)command->count * percentile / 100.0 + 0.5);
+	if (threshold == 0)
+		threshold = 1;
+
+	uint64_t sum = 0;
+	for (unsigned bucket = 0; bucket < MPD_METRICS_BUCKETS; ++bucket) {
+		sum += command->buckets[bucket];
+		if (sum >= threshold)
+			return mpd_metrics_bucket_max(bucket);
+	}
+
+	return mpd_metrics_bucket_max(MPD_METRICS_BUCKETS - 1);
+}
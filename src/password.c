@@ -4,6 +4,7 @@
 #include <mpd/password.h>
 #include <mpd/send.h>
 #include <mpd/response.h>
+#include "internal.h"
 #include "run.h"
 
 #include <stddef.h>
@@ -11,6 +12,7 @@
 bool
 mpd_send_password(struct mpd_connection *connection, const char *password)
 {
+	connection->password_sent = true;
 	return mpd_send_command(connection, "password", password, NULL);
 }
 
@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include <mpd/pipeline.h>
+#include <mpd/send.h>
+#include <mpd/recv.h>
+#include <mpd/list.h>
+#include <mpd/response.h>
+#include <mpd/connection.h>
+#include "internal.h"
+#include "quote.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The maximum number of commands in one command list.  This keeps
+ * the command list well below MPD's "max_command_list_size".
+ */
+enum {
+	MPD_PIPELINE_MAX_BATCH = 256,
+};
+
+/**
+ * The link of the lock-free queue.
+ */
+struct mpd_pipeline_node {
+	/**
+	 * The next node; written by producers, read by the consumer.
+	 */
+	_Atomic(struct mpd_pipeline_node *) next;
+};
+
+struct mpd_pipeline_command {
+	/**
+	 * Must be the first attribute, see mpd_pipeline_pop().
+	 */
+	struct mpd_pipeline_node node;
+
+	/**
+	 * The next command in the consumer's private batch list.
+	 */
+	struct mpd_pipeline_command *batch_next;
+
+	mpd_pipeline_callback callback;
+	void *ctx;
+
+	/**
+	 * The complete command line (without the trailing newline),
+	 * with all arguments quoted.
+	 */
+	char line[];
+};
+
+/**
+ * An intrusive MPSC queue (Dmitry Vyukov's algorithm): producers
+ * exchange #head, the consumer owns #tail.
+ */
+struct mpd_pipeline {
+	_Atomic(struct mpd_pipeline_node *) head;
+
+	struct mpd_pipeline_node *tail;
+
+	/**
+	 * A dummy node which keeps the queue non-empty, so producers
+	 * never need to touch #tail.
+	 */
+	struct mpd_pipeline_node stub;
+};
+
+struct mpd_pipeline *
+mpd_pipeline_new(void)
+{
+	struct mpd_pipeline *pipeline = malloc(sizeof(*pipeline));
+	if (pipeline == NULL)
+		return NULL;
+
+	atomic_init(&pipeline->stub.next, NULL);
+	atomic_init(&pipeline->head, &pipeline->stub);
+	pipeline->tail = &pipeline->stub;
+	return pipeline;
+}
+
+static void
+mpd_pipeline_push(struct mpd_pipeline *pipeline,
+		  struct mpd_pipeline_node *node)
+{
+	atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+
+	struct mpd_pipeline_node *prev =
+		atomic_exchange_explicit(&pipeline->head, node,
+					 memory_order_acq_rel);
+	atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+/**
+ * Dequeues the oldest command.  Must only be called by the consumer.
+ *
+ * @return the command, or NULL if the queue is empty (or a producer
+ * is in the middle of mpd_pipeline_push(); its command will be
+ * returned by a later call)
+ */
+static struct mpd_pipeline_command *
+mpd_pipeline_pop(struct mpd_pipeline *pipeline)
+{
+	struct mpd_pipeline_node *tail = pipeline->tail;
+	struct mpd_pipeline_node *next =
+		atomic_load_explicit(&tail->next, memory_order_acquire);
+
+	if (tail == &pipeline->stub) {
+		if (next == NULL)
+			return NULL;
+
+		pipeline->tail = tail = next;
+		next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	}
+
+	if (next != NULL) {
+		pipeline->tail = next;
+		return (struct mpd_pipeline_command *)tail;
+	}
+
+	if (tail != atomic_load_explicit(&pipeline->head,
+					 memory_order_acquire))
+		return NULL;
+
+	/* "tail" is the last node; re-insert the stub so it can be
+	   detached */
+	mpd_pipeline_push(pipeline, &pipeline->stub);
+
+	next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	if (next == NULL)
+		return NULL;
+
+	pipeline->tail = next;
+	return (struct mpd_pipeline_command *)tail;
+}
+
+void
+mpd_pipeline_free(struct mpd_pipeline *pipeline)
+{
+	assert(pipeline != NULL);
+
+	struct mpd_pipeline_command *command;
+	while ((command = mpd_pipeline_pop(pipeline)) != NULL) {
+		if (command->callback != NULL)
+			command->callback(NULL, command->ctx);
+		free(command);
+	}
+
+	free(pipeline);
+}
+
+bool
+mpd_pipeline_submit_v(struct mpd_pipeline *pipeline,
+		      mpd_pipeline_callback callback, void *ctx,
+		      const char *command, va_list args)
+{
+	assert(pipeline != NULL);
+	assert(command != NULL);
+
+	/* worst case: every character needs to be escaped, plus the
+	   space separator and two quotes */
+	size_t size = strlen(command) + 1;
+	va_list copy;
+	va_copy(copy, args);
+	const char *arg;
+	while ((arg = va_arg(copy, const char *)) != NULL)
+		size += 3 + strlen(arg) * 2;
+	va_end(copy);
+
+	struct mpd_pipeline_command *c = malloc(sizeof(*c) + size);
+	if (c == NULL)
+		return false;
+
+	c->callback = callback;
+	c->ctx = ctx;
+
+	char *p = c->line, *const end = c->line + size;
+	size_t length = strlen(command);
+	memcpy(p, command, length);
+	p += length;
+
+	while ((arg = va_arg(args, const char *)) != NULL) {
+		*p++ = ' ';
+		p = quote(p, end, arg);
+		assert(p != NULL);
+	}
+
+	*p = 0;
+
+	mpd_pipeline_push(pipeline, &c->node);
+	return true;
+}
+
+bool
+mpd_pipeline_submit(struct mpd_pipeline *pipeline,
+		    mpd_pipeline_callback callback, void *ctx,
+		    const char *command, ...)
+{
+	va_list args;
+	va_start(args, command);
+	bool success = mpd_pipeline_submit_v(pipeline, callback, ctx,
+					     command, args);
+	va_end(args);
+	return success;
+}
+
+/**
+ * Invokes the callback of the command and frees it.
+ */
+static void
+mpd_pipeline_complete(struct mpd_pipeline_command *command,
+		      struct mpd_connection *connection)
+{
+	if (command->callback != NULL)
+		command->callback(connection, command->ctx);
+
+	free(command);
+}
+
+/**
+ * Fails all commands in the list with the connection's (fatal) error.
+ */
+static void
+mpd_pipeline_fail(struct mpd_pipeline_command *list,
+		  struct mpd_connection *connection)
+{
+	assert(mpd_error_is_defined(&connection->error));
+
+	while (list != NULL) {
+		struct mpd_pipeline_command *next = list->batch_next;
+		mpd_pipeline_complete(list, connection);
+		list = next;
+	}
+}
+
+/**
+ * Peeks at the response of the next command, so a server error can
+ * be attributed to the command which caused it, and then invokes the
+ * command's callback.
+ */
+static void
+mpd_pipeline_dispatch(struct mpd_pipeline_command *command,
+		      struct mpd_connection *connection)
+{
+	struct mpd_pair *pair = mpd_recv_pair(connection);
+	if (pair != NULL)
+		mpd_enqueue_pair(connection, pair);
+	else if (!mpd_error_is_defined(&connection->error))
+		/* empty response */
+		mpd_enqueue_pair(connection, NULL);
+
+	mpd_pipeline_complete(command, connection);
+
+	if (connection->pair_state == PAIR_STATE_NULL)
+		/* the callback did not consume the enqueued NULL
+		   pair */
+		connection->pair_state = PAIR_STATE_NONE;
+}
+
+bool
+mpd_pipeline_run(struct mpd_pipeline *pipeline,
+		 struct mpd_connection *connection)
+{
+	assert(pipeline != NULL);
+	assert(connection != NULL);
+
+	/* commands which were dequeued but not yet executed */
+	struct mpd_pipeline_command *list = NULL, **tail_r = &list;
+	unsigned n = 0;
+
+	while (true) {
+		struct mpd_pipeline_command *command;
+		while (n < MPD_PIPELINE_MAX_BATCH &&
+		       (command = mpd_pipeline_pop(pipeline)) != NULL) {
+			command->batch_next = NULL;
+			*tail_r = command;
+			tail_r = &command->batch_next;
+			++n;
+		}
+
+		if (list == NULL)
+			return true;
+
+		if (!mpd_command_list_begin(connection, true)) {
+			mpd_pipeline_fail(list, connection);
+			return false;
+		}
+
+		for (command = list; command != NULL;
+		     command = command->batch_next) {
+			if (!mpd_send_command(connection, command->line,
+					      NULL)) {
+				mpd_pipeline_fail(list, connection);
+				return false;
+			}
+		}
+
+		if (!mpd_command_list_end(connection)) {
+			mpd_pipeline_fail(list, connection);
+			return false;
+		}
+
+		while (list != NULL) {
+			command = list;
+			list = command->batch_next;
+			--n;
+
+			mpd_pipeline_dispatch(command, connection);
+
+			if (!mpd_error_is_defined(&connection->error)) {
+				if (list != NULL
+				    ? mpd_response_next(connection)
+				    : mpd_response_finish(connection))
+					continue;
+			}
+
+			if (!mpd_connection_clear_error(connection)) {
+				mpd_pipeline_fail(list, connection);
+				return false;
+			}
+
+			/* MPD has aborted the command list; submit the
+			   rest again */
+			break;
+		}
+
+		if (list == NULL)
+			tail_r = &list;
+	}
+}
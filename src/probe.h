@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PROBE_H
+#define MPD_PROBE_H
+
+#include "config.h" // for HAVE_SDT
+
+/*
+ * Static tracepoints (USDT) of the provider "libmpdclient", which can
+ * be attached with bpftrace, perf or SystemTap.  They are only
+ * compiled in with "meson setup -Dsdt=true", and cost one "nop"
+ * instruction each.  Otherwise, they expand to an empty statement,
+ * and their arguments are not evaluated.
+ */
+
+#ifdef HAVE_SDT
+#include <sys/sdt.h>
+
+#define MPD_PROBE1(name, a) DTRACE_PROBE1(libmpdclient, name, a)
+#else
+#define MPD_PROBE1(name, a) do {} while (0)
+#endif
+
+#endif
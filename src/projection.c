@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include <mpd/capabilities.h>
+#include <mpd/connection.h>
+#include "iprojection.h"
+#include "internal.h"
+#include "sync.h"
+#include "arg.h"
+
+#include <assert.h>
+#include <string.h>
+
+uint64_t
+mpd_tag_mask(const enum mpd_tag_type *types, unsigned n)
+{
+	uint64_t mask = 0;
+	for (unsigned i = 0; i < n; ++i)
+		if (types[i] >= 0 && types[i] < MPD_TAG_COUNT)
+			mask |= UINT64_C(1) << types[i];
+	return mask;
+}
+
+bool
+mpd_set_tag_projection(struct mpd_connection *connection,
+		       const enum mpd_tag_type *types, unsigned n)
+{
+	assert(connection != NULL);
+	assert(types != NULL || n == 0);
+
+	if (mpd_error_is_defined(&connection->error))
+		return false;
+
+	/* "tagtypes all" and "tagtypes clear" need MPD 0.21; older
+	   servers just send all tags */
+	if (mpd_connection_cmp_server_version(connection, 0, 21, 0) < 0)
+		return true;
+
+	connection->projection = mpd_tag_mask(types, n);
+	connection->projection_pending = true;
+	return true;
+}
+
+/**
+ * May this command be wrapped in a command list?
+ */
+static bool
+mpd_projection_allowed(const char *command)
+{
+	return strcmp(command, "idle") != 0 &&
+		strcmp(command, "noidle") != 0 &&
+		strcmp(command, "close") != 0 &&
+		strcmp(command, "command_list_end") != 0;
+}
+
+/**
+ * Writes the commands which switch the server to the specified set
+ * of tag types.
+ */
+static bool
+mpd_projection_switch(struct mpd_connection *connection, uint64_t mask)
+{
+	struct mpd_async *async = connection->async;
+	const struct timeval *tv = mpd_connection_timeout(connection);
+
+	if (mask == MPD_TAG_MASK_ALL)
+		return mpd_sync_send_command(async, tv, "tagtypes", "all",
+					     NULL);
+
+	struct mpd_arg args[1 + MPD_TAG_COUNT];
+	unsigned n = 0;
+
+	/* "reset" saves one line, but it needs MPD 0.24 */
+	const bool reset = mask != 0 &&
+		mpd_connection_cmp_server_version(connection, 0, 24, 0) >= 0;
+	if (!reset &&
+	    !mpd_sync_send_command(async, tv, "tagtypes", "clear", NULL))
+		return false;
+
+	if (mask == 0)
+		return true;
+
+	args[n++] = mpd_arg_s(reset ? "reset" : "enable");
+	for (unsigned i = 0; i < MPD_TAG_COUNT; ++i)
+		if (mask & (UINT64_C(1) << i))
+			args[n++] = mpd_arg_s(mpd_tag_name((enum mpd_tag_type)i));
+
+	return mpd_sync_send_args(async, tv, "tagtypes", args, n);
+}
+
+bool
+mpd_projection_begin(struct mpd_connection *connection, const char *command,
+		     bool *wrapped_r)
+{
+	/* a projection applies to the next command only, even if it
+	   cannot be applied to it */
+	const bool pending = connection->projection_pending;
+	connection->projection_pending = false;
+	*wrapped_r = false;
+
+	if (connection->sending_command_list ||
+	    !mpd_projection_allowed(command))
+		return true;
+
+	const uint64_t mask = pending
+		? connection->projection
+		: connection->tag_types;
+
+	/* skip redundant switches */
+	if (!connection->tag_types_dirty && mask == connection->tag_types)
+		return true;
+
+	if (!mpd_sync_send_command(connection->async,
+				   mpd_connection_timeout(connection),
+				   "command_list_begin", NULL) ||
+	    !mpd_projection_switch(connection, mask)) {
+		mpd_connection_sync_error(connection);
+		return false;
+	}
+
+	connection->tag_types_dirty = false;
+	connection->projecting = mask != connection->tag_types;
+	*wrapped_r = true;
+	return true;
+}
+
+bool
+mpd_projection_end(struct mpd_connection *connection)
+{
+	/* restore in the same command list; if the command fails, this
+	   is skipped by MPD, and mpd_recv_pair() sets
+	   "tag_types_dirty" */
+	return (!connection->projecting ||
+		mpd_projection_switch(connection, connection->tag_types)) &&
+		mpd_sync_send_command(connection->async,
+				      mpd_connection_timeout(connection),
+				      "command_list_end", NULL);
+}
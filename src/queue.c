@@ -5,6 +5,8 @@
 #include <mpd/send.h>
 #include <mpd/recv.h>
 #include <mpd/pair.h>
+#include <mpd/connection.h>
+#include <mpd/list.h>
 #include <mpd/response.h>
 #include <mpd/song.h>
 #include "internal.h"
@@ -605,3 +607,209 @@ mpd_run_range_id(struct mpd_connection *connection, unsigned id,
 		mpd_send_range_id(connection, id, start, end) &&
 		mpd_response_finish(connection);
 }
+
+/**
+ * The maximum number of commands in one command list sent by the
+ * mpd_run_*_multi() functions.  With typical URI lengths, this stays
+ * well below MPD's default "max_command_list_size" (2 MB).
+ */
+enum {
+	MPD_QUEUE_MULTI_CHUNK = 512,
+};
+
+/**
+ * Sends the command for item #i of a mpd_run_*_multi() call.
+ *
+ * @param nth the number of items which will have succeeded before
+ * this one, assuming the previous ones in this command list succeed
+ */
+typedef bool (*mpd_queue_multi_send)(struct mpd_connection *connection,
+				     const void *ctx,
+				     unsigned i, unsigned nth);
+
+/**
+ * Sends #n commands in command lists of at most
+ * #MPD_QUEUE_MULTI_CHUNK commands.  If MPD rejects one, the item is
+ * marked as failed, and the rest of the command list (which MPD has
+ * discarded) is sent again.
+ */
+static int
+mpd_run_multi(struct mpd_connection *connection, unsigned n,
+	      mpd_queue_multi_send send, const void *ctx,
+	      int *ids_r, bool *success_r)
+{
+	unsigned done = 0, ok = 0;
+
+	if (!mpd_run_check(connection))
+		return -1;
+
+	while (done < n) {
+		const unsigned end = n - done > MPD_QUEUE_MULTI_CHUNK
+			? done + MPD_QUEUE_MULTI_CHUNK
+			: n;
+
+		if (!mpd_command_list_begin(connection, true))
+			return -1;
+
+		for (unsigned i = done; i < end; ++i)
+			if (!send(connection, ctx, i, ok + i - done))
+				return -1;
+
+		if (!mpd_command_list_end(connection))
+			return -1;
+
+		unsigned i;
+		for (i = done; i < end; ++i) {
+			if (ids_r != NULL)
+				ids_r[i] = mpd_recv_song_id(connection);
+
+			if (!mpd_response_next(connection))
+				break;
+
+			if (success_r != NULL)
+				success_r[i] = true;
+			++ok;
+		}
+
+		if (i == end) {
+			if (!mpd_response_finish(connection))
+				return -1;
+
+			done = end;
+			continue;
+		}
+
+		/* MPD has rejected item i and discarded the rest of
+		   the command list */
+
+		if (connection->error.code != MPD_ERROR_SERVER ||
+		    !mpd_connection_clear_error(connection))
+			return -1;
+
+		if (ids_r != NULL)
+			ids_r[i] = -1;
+		if (success_r != NULL)
+			success_r[i] = false;
+
+		done = i + 1;
+	}
+
+	return (int)ok;
+}
+
+static bool
+send_add_id(struct mpd_connection *connection, const void *ctx,
+	    unsigned i, mpd_unused unsigned nth)
+{
+	const char *const *uris = ctx;
+
+	return mpd_send_add_id(connection, uris[i]);
+}
+
+int
+mpd_run_add_id_multi(struct mpd_connection *connection,
+		     const char *const *uris, unsigned n, int *ids_r)
+{
+	return mpd_run_multi(connection, n, send_add_id, uris,
+			     ids_r, NULL);
+}
+
+struct add_id_to_ctx {
+	const char *const *uris;
+	unsigned to;
+};
+
+static bool
+send_add_id_to(struct mpd_connection *connection, const void *_ctx,
+	       unsigned i, unsigned nth)
+{
+	const struct add_id_to_ctx *ctx = _ctx;
+
+	return mpd_send_add_id_to(connection, ctx->uris[i], ctx->to + nth);
+}
+
+int
+mpd_run_add_id_multi_to(struct mpd_connection *connection,
+			const char *const *uris, unsigned n, unsigned to,
+			int *ids_r)
+{
+	const struct add_id_to_ctx ctx = {
+		.uris = uris,
+		.to = to,
+	};
+
+	return mpd_run_multi(connection, n, send_add_id_to, &ctx,
+			     ids_r, NULL);
+}
+
+static bool
+send_delete_id(struct mpd_connection *connection, const void *ctx,
+	       unsigned i, mpd_unused unsigned nth)
+{
+	const unsigned *ids = ctx;
+
+	return mpd_send_delete_id(connection, ids[i]);
+}
+
+int
+mpd_run_delete_id_multi(struct mpd_connection *connection,
+			const unsigned *ids, unsigned n, bool *success_r)
+{
+	return mpd_run_multi(connection, n, send_delete_id, ids,
+			     NULL, success_r);
+}
+
+struct move_id_ctx {
+	const unsigned *ids, *to;
+};
+
+static bool
+send_move_id(struct mpd_connection *connection, const void *_ctx,
+	     unsigned i, mpd_unused unsigned nth)
+{
+	const struct move_id_ctx *ctx = _ctx;
+
+	return mpd_send_move_id(connection, ctx->ids[i],
+				ctx->to != NULL ? ctx->to[i] : i);
+}
+
+int
+mpd_run_move_id_multi(struct mpd_connection *connection,
+		      const unsigned *ids, const unsigned *to, unsigned n,
+		      bool *success_r)
+{
+	const struct move_id_ctx ctx = {
+		.ids = ids,
+		.to = to,
+	};
+
+	return mpd_run_multi(connection, n, send_move_id, &ctx,
+			     NULL, success_r);
+}
+
+struct prio_id_ctx {
+	const unsigned *ids;
+	unsigned priority;
+};
+
+static bool
+send_prio_id(struct mpd_connection *connection, const void *_ctx,
+	     unsigned i, mpd_unused unsigned nth)
+{
+	const struct prio_id_ctx *ctx = _ctx;
+
+	return mpd_send_prio_id(connection, ctx->priority, ctx->ids[i]);
+}
+
+int
+mpd_run_prio_id_multi(struct mpd_connection *connection, unsigned priority,
+		      const unsigned *ids, unsigned n, bool *success_r)
+{
+	const struct prio_id_ctx ctx = {
+		.ids = ids,
+		.priority = priority,
+	};
+
+	return mpd_run_multi(connection, n, send_prio_id, &ctx,
+			     NULL, success_r);
+}
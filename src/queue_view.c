@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include <mpd/queue_view.h>
+#include <mpd/list.h>
+#include <mpd/queue.h>
+#include <mpd/response.h>
+#include <mpd/song.h>
+#include <mpd/status.h>
+#include "internal.h"
+#include "run.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+
+struct mpd_queue_view {
+	unsigned margin;
+
+	/**
+	 * The range of positions the application displays.
+	 */
+	unsigned visible_start, visible_end;
+
+	/**
+	 * The queue version and length as of the last update.
+	 */
+	unsigned version, length;
+
+	/**
+	 * Has mpd_queue_view_update() completed at least once?
+	 */
+	bool synchronized;
+
+	/**
+	 * The cached range of positions: songs[i] is the song at
+	 * position start+i, or NULL if it has not been fetched yet.
+	 */
+	unsigned start, end;
+	struct mpd_song **songs;
+};
+
+struct mpd_queue_view *
+mpd_queue_view_new(unsigned margin)
+{
+	struct mpd_queue_view *view = calloc(1, sizeof(*view));
+	if (view == NULL)
+		return NULL;
+
+	view->margin = margin;
+	return view;
+}
+
+/**
+ * Frees all cached songs.
+ */
+static void
+queue_view_clear(struct mpd_queue_view *view)
+{
+	for (unsigned i = 0; i < view->end - view->start; ++i)
+		if (view->songs[i] != NULL)
+			mpd_song_free(view->songs[i]);
+
+	free(view->songs);
+	view->songs = NULL;
+	view->start = view->end = 0;
+}
+
+void
+mpd_queue_view_free(struct mpd_queue_view *view)
+{
+	assert(view != NULL);
+
+	queue_view_clear(view);
+	free(view);
+}
+
+/**
+ * Determines the window: the visible range plus the margin, clipped
+ * to the given queue length.
+ */
+static void
+queue_view_get_window(const struct mpd_queue_view *view, unsigned length,
+		      unsigned *start_r, unsigned *end_r)
+{
+	unsigned start = view->visible_start > view->margin
+		? view->visible_start - view->margin
+		: 0;
+	unsigned end = view->visible_end < UINT_MAX - view->margin
+		? view->visible_end + view->margin
+		: UINT_MAX;
+
+	if (end > length)
+		end = length;
+	if (start > end)
+		start = end;
+
+	*start_r = start;
+	*end_r = end;
+}
+
+/**
+ * Moves the window; songs which remain in it are kept, the others are
+ * freed.
+ *
+ * @return false on out of memory (the view is unmodified)
+ */
+static bool
+queue_view_move(struct mpd_queue_view *view, unsigned start, unsigned end)
+{
+	if (start == view->start && end == view->end)
+		return true;
+
+	struct mpd_song **songs = NULL;
+	if (end > start) {
+		songs = calloc(end - start, sizeof(*songs));
+		if (songs == NULL)
+			return false;
+	}
+
+	for (unsigned position = view->start; position < view->end;
+	     ++position) {
+		struct mpd_song *song = view->songs[position - view->start];
+		if (song == NULL)
+			continue;
+
+		if (position >= start && position < end)
+			songs[position - start] = song;
+		else
+			mpd_song_free(song);
+	}
+
+	free(view->songs);
+	view->songs = songs;
+	view->start = start;
+	view->end = end;
+	return true;
+}
+
+/**
+ * Stores a received song at its position, replacing the old one;
+ * songs outside of the window are freed.
+ */
+static void
+queue_view_put(struct mpd_queue_view *view, struct mpd_song *song)
+{
+	const unsigned position = mpd_song_get_pos(song);
+	if (position < view->start || position >= view->end) {
+		mpd_song_free(song);
+		return;
+	}
+
+	struct mpd_song **slot = &view->songs[position - view->start];
+	if (*slot != NULL)
+		mpd_song_free(*slot);
+	*slot = song;
+}
+
+static bool
+queue_view_receive(struct mpd_queue_view *view,
+		   struct mpd_connection *connection)
+{
+	struct mpd_song *song;
+	while ((song = mpd_recv_song(connection)) != NULL)
+		queue_view_put(view, song);
+
+	return !mpd_error_is_defined(&connection->error);
+}
+
+/**
+ * Discards the cache after a failed update, so the next update
+ * fetches the whole window again.
+ */
+static void
+queue_view_invalidate(struct mpd_queue_view *view)
+{
+	queue_view_clear(view);
+	view->version = 0;
+	view->synchronized = false;
+}
+
+/**
+ * Fetches all rows of the window which are not cached, with one
+ * "playlistinfo" per gap in one command list.  Usually, these are
+ * the rows which have just been scrolled into the window.
+ */
+static bool
+queue_view_fill(struct mpd_queue_view *view,
+		struct mpd_connection *connection)
+{
+	bool sending = false;
+
+	for (unsigned position = view->start; position < view->end;) {
+		if (view->songs[position - view->start] != NULL) {
+			++position;
+			continue;
+		}
+
+		unsigned gap_end = position + 1;
+		while (gap_end < view->end &&
+		       view->songs[gap_end - view->start] == NULL)
+			++gap_end;
+
+		if (!sending) {
+			if (!mpd_command_list_begin(connection, false))
+				return false;
+			sending = true;
+		}
+
+		if (!mpd_send_list_queue_range_meta(connection,
+						    position, gap_end))
+			return false;
+
+		position = gap_end;
+	}
+
+	if (!sending)
+		return true;
+
+	return mpd_command_list_end(connection) &&
+		queue_view_receive(view, connection) &&
+		mpd_response_finish(connection);
+}
+
+bool
+mpd_queue_view_set_visible(struct mpd_queue_view *view,
+			   struct mpd_connection *connection,
+			   unsigned start, unsigned end)
+{
+	assert(view != NULL);
+	assert(connection != NULL);
+
+	view->visible_start = start;
+	view->visible_end = end > start ? end : start;
+
+	if (!mpd_run_check(connection))
+		return false;
+
+	if (!view->synchronized)
+		return mpd_queue_view_update(view, connection);
+
+	unsigned window_start, window_end;
+	queue_view_get_window(view, view->length, &window_start, &window_end);
+	if (!queue_view_move(view, window_start, window_end)) {
+		mpd_error_code(&connection->error, MPD_ERROR_OOM);
+		return false;
+	}
+
+	return queue_view_fill(view, connection);
+}
+
+bool
+mpd_queue_view_update(struct mpd_queue_view *view,
+		      struct mpd_connection *connection)
+{
+	assert(view != NULL);
+	assert(connection != NULL);
+
+	if (!mpd_run_check(connection))
+		return false;
+
+	/* the new queue length is not known yet, so ask for the
+	   unclipped window; MPD clips "plchanges" ranges itself */
+	unsigned start, end;
+	queue_view_get_window(view, UINT_MAX, &start, &end);
+
+	/* version 0 lists all songs, i.e. fills the whole window */
+	const unsigned version = view->synchronized ? view->version : 0;
+
+	if (!mpd_command_list_begin(connection, true) ||
+	    !mpd_send_status(connection) ||
+	    (start < end &&
+	     !mpd_send_queue_changes_meta_range(connection, version,
+						start, end)) ||
+	    !mpd_command_list_end(connection))
+		return false;
+
+	/* the new version is committed only after all changes have
+	   been received; after an error, the cache may be partially
+	   updated and is discarded */
+	struct mpd_status *status = mpd_recv_status(connection);
+	if (status == NULL) {
+		queue_view_invalidate(view);
+		return false;
+	}
+
+	const unsigned new_length = mpd_status_get_queue_length(status);
+	const unsigned new_version = mpd_status_get_queue_version(status);
+	mpd_status_free(status);
+
+	if (!mpd_response_next(connection)) {
+		queue_view_invalidate(view);
+		return false;
+	}
+
+	/* rows beyond the new end of the queue are dropped here; all
+	   rows which have changed or moved are in the response */
+	queue_view_get_window(view, new_length, &start, &end);
+	if (!queue_view_move(view, start, end)) {
+		mpd_error_code(&connection->error, MPD_ERROR_OOM);
+		queue_view_invalidate(view);
+		return false;
+	}
+
+	if (!queue_view_receive(view, connection) ||
+	    !mpd_response_finish(connection)) {
+		queue_view_invalidate(view);
+		return false;
+	}
+
+	view->length = new_length;
+	view->version = new_version;
+	view->synchronized = true;
+
+	/* gaps are left only if an earlier call has failed */
+	return queue_view_fill(view, connection);
+}
+
+unsigned
+mpd_queue_view_get_length(const struct mpd_queue_view *view)
+{
+	assert(view != NULL);
+
+	return view->length;
+}
+
+unsigned
+mpd_queue_view_get_version(const struct mpd_queue_view *view)
+{
+	assert(view != NULL);
+
+	return view->version;
+}
+
+const struct mpd_song *
+mpd_queue_view_get_song(const struct mpd_queue_view *view,
+			unsigned position)
+{
+	assert(view != NULL);
+
+	if (position < view->start || position >= view->end)
+		return NULL;
+
+	return view->songs[position - view->start];
+}
@@ -7,6 +7,10 @@
 #include "internal.h"
 #include "iasync.h"
 #include "sync.h"
+#include "imetrics.h"
+#include "itag.h"
+#include "irecv.h"
+#include "probe.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -53,11 +57,16 @@ mpd_recv_binary(struct mpd_connection *connection, void *data, size_t length)
 	return true;
 }
 
-struct mpd_pair *
-mpd_recv_pair(struct mpd_connection *connection)
+/**
+ * Implementation of mpd_recv_pair() which also returns the length
+ * of the value.
+ */
+static struct mpd_pair *
+mpd_recv_pair_n(struct mpd_connection *connection, size_t *value_length_r)
 {
 	struct mpd_pair *pair;
 	char *line;
+	size_t line_length;
 	enum mpd_parser_result result;
 	const char *msg;
 
@@ -79,6 +88,7 @@ mpd_recv_pair(struct mpd_connection *connection)
 		/* dequeue the pair from mpd_enqueue_pair() */
 		pair = &connection->pair;
 		connection->pair_state = PAIR_STATE_FLOATING;
+		*value_length_r = strlen(pair->value);
 		return pair;
 	}
 
@@ -94,8 +104,9 @@ mpd_recv_pair(struct mpd_connection *connection)
 		return NULL;
 	}
 
-	line = mpd_sync_recv_line(connection->async,
-				  mpd_connection_timeout(connection));
+	line = mpd_sync_recv_line_n(connection->async,
+				    mpd_connection_timeout(connection),
+				    &line_length);
 	if (line == NULL) {
 		connection->receiving = false;
 		connection->sending_command_list = false;
@@ -105,6 +116,7 @@ mpd_recv_pair(struct mpd_connection *connection)
 	}
 
 	result = mpd_parser_feed(connection->parser, line);
+	MPD_PROBE1(line_parsed, result);
 	switch (result) {
 	case MPD_PARSER_MALFORMED:
 		mpd_error_code(&connection->error, MPD_ERROR_MALFORMED);
@@ -127,6 +139,12 @@ mpd_recv_pair(struct mpd_connection *connection)
 			connection->receiving = false;
 			connection->sending_command_list = false;
 			connection->discrete_finished = false;
+			connection->projecting = false;
+
+			if (connection->metrics != NULL)
+				mpd_metrics_end_command(connection->metrics);
+
+			MPD_PROBE1(response_end, true);
 		} else {
 			if (!connection->sending_command_list ||
 			    connection->command_list_remaining == 0) {
@@ -145,6 +163,19 @@ mpd_recv_pair(struct mpd_connection *connection)
 	case MPD_PARSER_ERROR:
 		connection->receiving = false;
 		connection->sending_command_list = false;
+
+		if (connection->projecting) {
+			/* MPD has skipped the "tagtypes" command which
+			   was supposed to restore the tag types */
+			connection->projecting = false;
+			connection->tag_types_dirty = true;
+		}
+
+		if (connection->metrics != NULL)
+			mpd_metrics_end_command(connection->metrics);
+
+		MPD_PROBE1(response_end, false);
+
 		mpd_error_server(&connection->error,
 				 mpd_parser_get_server_error(connection->parser),
 				 mpd_parser_get_at(connection->parser));
@@ -158,6 +189,7 @@ mpd_recv_pair(struct mpd_connection *connection)
 		pair = &connection->pair;
 		pair->name = mpd_parser_get_name(connection->parser);
 		pair->value = mpd_parser_get_value(connection->parser);
+		*value_length_r = line_length - (pair->value - line);
 
 		connection->pair_state = PAIR_STATE_FLOATING;
 		return pair;
@@ -168,6 +200,85 @@ mpd_recv_pair(struct mpd_connection *connection)
 	return NULL;
 }
 
+struct mpd_pair *
+mpd_recv_pair(struct mpd_connection *connection)
+{
+	size_t value_length;
+	return mpd_recv_pair_n(connection, &value_length);
+}
+
+_Static_assert((int)MPD_TAG_COUNT <= (int)MPD_PAIR_TOKEN_FILE,
+	       "pair tokens overlap with tag types");
+
+/**
+ * The names of #mpd_pair_token values, indexed by token minus
+ * #MPD_PAIR_TOKEN_FILE.
+ */
+static const struct {
+	const char *name;
+	size_t length;
+} mpd_pair_token_names[] = {
+#define MPD_PAIR_TOKEN_NAME(s) { s, sizeof(s) - 1 }
+	MPD_PAIR_TOKEN_NAME("file"),
+	MPD_PAIR_TOKEN_NAME("directory"),
+	MPD_PAIR_TOKEN_NAME("playlist"),
+	MPD_PAIR_TOKEN_NAME("Last-Modified"),
+	MPD_PAIR_TOKEN_NAME("Added"),
+	MPD_PAIR_TOKEN_NAME("Time"),
+	MPD_PAIR_TOKEN_NAME("duration"),
+	MPD_PAIR_TOKEN_NAME("Range"),
+	MPD_PAIR_TOKEN_NAME("Format"),
+	MPD_PAIR_TOKEN_NAME("Pos"),
+	MPD_PAIR_TOKEN_NAME("Id"),
+	MPD_PAIR_TOKEN_NAME("Prio"),
+#undef MPD_PAIR_TOKEN_NAME
+};
+
+_Static_assert(MPD_PAIR_TOKEN_FILE + sizeof(mpd_pair_token_names) /
+	       sizeof(mpd_pair_token_names[0]) <= MPD_PAIR_TOKEN_OTHER,
+	       "too many pair tokens");
+
+int
+mpd_pair_token_parse(const char *name, size_t length)
+{
+	for (unsigned i = 0; i < sizeof(mpd_pair_token_names) /
+		     sizeof(mpd_pair_token_names[0]); ++i)
+		if (mpd_pair_token_names[i].length == length &&
+		    memcmp(mpd_pair_token_names[i].name, name, length) == 0)
+			return MPD_PAIR_TOKEN_FILE + (int)i;
+
+	const enum mpd_tag_type tag = mpd_tag_name_parse_n(name, length);
+	return tag != MPD_TAG_UNKNOWN ? (int)tag : MPD_PAIR_TOKEN_OTHER;
+}
+
+bool
+mpd_recv_pairs(struct mpd_connection *connection,
+	       mpd_pair_handler handler, void *ctx)
+{
+	assert(connection != NULL);
+	assert(handler != NULL);
+
+	struct mpd_pair *pair;
+	size_t value_length;
+	while ((pair = mpd_recv_pair_n(connection, &value_length)) != NULL) {
+		/* the parser has replaced the colon after the name
+		   with a null byte */
+		const size_t name_length = pair->value - 2 - pair->name;
+		const int token = mpd_pair_token_parse(pair->name,
+						       name_length);
+
+		const bool proceed = handler(pair->name, name_length,
+					     pair->value, value_length,
+					     token, ctx);
+		mpd_return_pair(connection, pair);
+
+		if (!proceed)
+			break;
+	}
+
+	return !mpd_error_is_defined(&connection->error);
+}
+
 struct mpd_pair *
 mpd_recv_pair_named(struct mpd_connection *connection, const char *name)
 {
@@ -2,9 +2,12 @@
 // Copyright The Music Player Daemon Project
 
 #include "resolver.h"
+#include "clock.h"
+#include "spinlock.h"
 #include "config.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,6 +25,72 @@
 #endif
 #endif
 
+#if defined(ENABLE_TCP) && defined(HAVE_GETADDRINFO)
+
+enum {
+	/**
+	 * The maximum number of addresses per host name; more are
+	 * ignored.
+	 */
+	RESOLVER_MAX_ADDRESSES = 8,
+
+	/**
+	 * The number of host names in the cache.
+	 */
+	RESOLVER_CACHE_SIZE = 8,
+};
+
+/**
+ * How long is a getaddrinfo() result cached?  getaddrinfo() does not
+ * reveal the DNS TTL, so this is a fixed compromise between reconnect
+ * speed and following address changes.
+ */
+static const uint64_t resolver_cache_ttl_us = 60 * 1000 * 1000;
+
+/**
+ * A copy of one "struct addrinfo" which does not point to other
+ * memory.
+ */
+struct resolver_entry {
+	int family;
+	int protocol;
+	size_t addrlen;
+	struct sockaddr_storage addr;
+};
+
+struct resolver_cache_item {
+	/**
+	 * The host name (allocated with malloc()), or NULL if this
+	 * item is unused.
+	 */
+	char *host;
+
+	unsigned port;
+
+	/**
+	 * The mpd_clock_now() time stamp after which this item is
+	 * stale.
+	 */
+	uint64_t expires;
+
+	unsigned n_entries;
+	struct resolver_entry entries[RESOLVER_MAX_ADDRESSES];
+};
+
+/**
+ * A process-wide cache of getaddrinfo() results, protected by
+ * #resolver_cache_lock.
+ */
+static struct resolver_cache_item resolver_cache[RESOLVER_CACHE_SIZE];
+
+/**
+ * A spinlock protecting #resolver_cache.  It is only held while
+ * copying a few addresses, never during getaddrinfo().
+ */
+static atomic_flag resolver_cache_lock = ATOMIC_FLAG_INIT;
+
+#endif
+
 struct resolver {
 	enum {
 		TYPE_ZERO, TYPE_ONE, TYPE_ANY
@@ -29,8 +98,15 @@ struct resolver {
 
 #ifdef ENABLE_TCP
 #ifdef HAVE_GETADDRINFO
-	struct addrinfo *ai;
-	const struct addrinfo *next;
+	/**
+	 * The host name passed to resolver_new(); owned by the
+	 * caller.
+	 */
+	const char *host;
+	unsigned port;
+
+	unsigned n_entries, next;
+	struct resolver_entry entries[RESOLVER_MAX_ADDRESSES];
 #else
 	struct sockaddr_in sin;
 #endif
@@ -43,6 +119,186 @@ struct resolver {
 #endif
 };
 
+#if defined(ENABLE_TCP) && defined(HAVE_GETADDRINFO)
+
+/**
+ * Finds a cache item, even a stale one.  The caller must hold the
+ * lock.
+ */
+static struct resolver_cache_item *
+resolver_cache_find(const char *host, unsigned port)
+{
+	for (unsigned i = 0; i < RESOLVER_CACHE_SIZE; ++i) {
+		struct resolver_cache_item *item = &resolver_cache[i];
+		if (item->host != NULL && item->port == port &&
+		    strcmp(item->host, host) == 0)
+			return item;
+	}
+
+	return NULL;
+}
+
+/**
+ * Copies the addresses of a fresh cache item into the resolver.
+ *
+ * @return true if a fresh item was found
+ */
+static bool
+resolver_cache_lookup(struct resolver *resolver)
+{
+	const uint64_t now = mpd_clock_now();
+	bool found = false;
+
+	mpd_spin_lock(&resolver_cache_lock);
+
+	const struct resolver_cache_item *item =
+		resolver_cache_find(resolver->host, resolver->port);
+	if (item != NULL && now < item->expires) {
+		resolver->n_entries = item->n_entries;
+		memcpy(resolver->entries, item->entries,
+		       item->n_entries * sizeof(item->entries[0]));
+		found = true;
+	}
+
+	mpd_spin_unlock(&resolver_cache_lock);
+	return found;
+}
+
+/**
+ * Stores the addresses of the resolver in the cache, replacing the
+ * old item for this host, or else an unused item, or else the one
+ * which expires first.
+ */
+static void
+resolver_cache_store(const struct resolver *resolver)
+{
+	char *host = strdup(resolver->host);
+	if (host == NULL)
+		return;
+
+	mpd_spin_lock(&resolver_cache_lock);
+
+	struct resolver_cache_item *item =
+		resolver_cache_find(resolver->host, resolver->port);
+	if (item == NULL) {
+		item = &resolver_cache[0];
+		for (unsigned i = 0; i < RESOLVER_CACHE_SIZE; ++i) {
+			struct resolver_cache_item *candidate =
+				&resolver_cache[i];
+			if (candidate->host == NULL) {
+				item = candidate;
+				break;
+			}
+
+			if (candidate->expires < item->expires)
+				item = candidate;
+		}
+	}
+
+	free(item->host);
+	item->host = host;
+	item->port = resolver->port;
+	item->expires = mpd_clock_now() + resolver_cache_ttl_us;
+	item->n_entries = resolver->n_entries;
+	memcpy(item->entries, resolver->entries,
+	       resolver->n_entries * sizeof(resolver->entries[0]));
+
+	mpd_spin_unlock(&resolver_cache_lock);
+}
+
+/**
+ * Reorders the addresses so address families alternate, starting
+ * with the family getaddrinfo() preferred (RFC 8305 section 4).
+ * This way, a broken IPv6 route delays the first IPv4 attempt by
+ * only one connection attempt.
+ */
+static void
+resolver_interleave(struct resolver *resolver)
+{
+	if (resolver->n_entries < 3)
+		return;
+
+	struct resolver_entry sorted[RESOLVER_MAX_ADDRESSES];
+	bool taken[RESOLVER_MAX_ADDRESSES] = {false};
+	int family = resolver->entries[0].family;
+
+	for (unsigned n = 0; n < resolver->n_entries; ++n) {
+		/* the next address of the wanted family, or else the
+		   next one of any family */
+		unsigned i = resolver->n_entries, fallback = i;
+		for (unsigned j = 0; j < resolver->n_entries; ++j) {
+			if (taken[j])
+				continue;
+
+			if (fallback == resolver->n_entries)
+				fallback = j;
+
+			if (resolver->entries[j].family == family) {
+				i = j;
+				break;
+			}
+		}
+
+		if (i == resolver->n_entries)
+			i = fallback;
+
+		taken[i] = true;
+		sorted[n] = resolver->entries[i];
+		family = family == AF_INET6 ? AF_INET : AF_INET6;
+	}
+
+	memcpy(resolver->entries, sorted,
+	       resolver->n_entries * sizeof(sorted[0]));
+}
+
+/**
+ * Resolves the host name with getaddrinfo() and stores the result in
+ * the cache.
+ */
+static bool
+resolver_getaddrinfo(struct resolver *resolver)
+{
+	struct addrinfo hints;
+	char service[20];
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = PF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	snprintf(service, sizeof(service), "%u", resolver->port);
+
+	struct addrinfo *ai;
+	if (getaddrinfo(resolver->host, service, &hints, &ai) != 0)
+		return false;
+
+	resolver->n_entries = 0;
+	for (const struct addrinfo *i = ai;
+	     i != NULL && resolver->n_entries < RESOLVER_MAX_ADDRESSES;
+	     i = i->ai_next) {
+		if ((size_t)i->ai_addrlen > sizeof(struct sockaddr_storage))
+			continue;
+
+		struct resolver_entry *entry =
+			&resolver->entries[resolver->n_entries++];
+		entry->family = i->ai_family;
+		entry->protocol = i->ai_protocol;
+		entry->addrlen = i->ai_addrlen;
+		memcpy(&entry->addr, i->ai_addr, i->ai_addrlen);
+	}
+
+	freeaddrinfo(ai);
+
+	if (resolver->n_entries == 0)
+		return false;
+
+	resolver_interleave(resolver);
+	resolver_cache_store(resolver);
+	return true;
+}
+
+#endif
+
 struct resolver *
 resolver_new(const char *host, unsigned port)
 {
@@ -84,24 +340,16 @@ resolver_new(const char *host, unsigned port)
 	} else {
 #ifdef ENABLE_TCP
 #ifdef HAVE_GETADDRINFO
-		struct addrinfo hints;
-		char service[20];
-		int ret;
+		resolver->host = host;
+		resolver->port = port;
+		resolver->next = 0;
 
-		memset(&hints, 0, sizeof(hints));
-		hints.ai_family = PF_UNSPEC;
-		hints.ai_socktype = SOCK_STREAM;
-		hints.ai_protocol = IPPROTO_TCP;
-
-		snprintf(service, sizeof(service), "%d", port);
-
-		ret = getaddrinfo(host, service, &hints, &resolver->ai);
-		if (ret != 0) {
+		if (!resolver_cache_lookup(resolver) &&
+		    !resolver_getaddrinfo(resolver)) {
 			free(resolver);
 			return NULL;
 		}
 
-		resolver->next = resolver->ai;
 		resolver->type = TYPE_ANY;
 #else
 		const struct hostent *he;
@@ -143,12 +391,51 @@ resolver_new(const char *host, unsigned port)
 
 void
 resolver_free(struct resolver *resolver)
+{
+	free(resolver);
+}
+
+void
+resolver_invalidate(const struct resolver *resolver)
 {
 #if defined(ENABLE_TCP) && defined(HAVE_GETADDRINFO)
-	if (resolver->type == TYPE_ANY)
-		freeaddrinfo(resolver->ai);
+	if (resolver->type != TYPE_ANY)
+		return;
+
+	mpd_spin_lock(&resolver_cache_lock);
+
+	struct resolver_cache_item *item =
+		resolver_cache_find(resolver->host, resolver->port);
+	if (item != NULL) {
+		free(item->host);
+		item->host = NULL;
+	}
+
+	mpd_spin_unlock(&resolver_cache_lock);
+#else
+	(void)resolver;
+#endif
+}
+
+unsigned
+resolver_remaining(const struct resolver *resolver)
+{
+	switch (resolver->type) {
+	case TYPE_ZERO:
+		return 0;
+
+	case TYPE_ONE:
+		return 1;
+
+	case TYPE_ANY:
+		break;
+	}
+
+#if defined(ENABLE_TCP) && defined(HAVE_GETADDRINFO)
+	return resolver->n_entries - resolver->next;
+#else
+	return 0;
 #endif
-	free(resolver);
 }
 
 const struct resolver_address *
@@ -163,15 +450,16 @@ resolver_next(struct resolver *resolver)
 	}
 
 #if defined(ENABLE_TCP) && defined(HAVE_GETADDRINFO)
-	if (resolver->next == NULL)
+	if (resolver->next >= resolver->n_entries)
 		return NULL;
 
-	resolver->current.family = resolver->next->ai_family;
-	resolver->current.protocol = resolver->next->ai_protocol;
-	resolver->current.addrlen = resolver->next->ai_addrlen;
-	resolver->current.addr = resolver->next->ai_addr;
+	const struct resolver_entry *entry =
+		&resolver->entries[resolver->next++];
 
-	resolver->next = resolver->next->ai_next;
+	resolver->current.family = entry->family;
+	resolver->current.protocol = entry->protocol;
+	resolver->current.addrlen = entry->addrlen;
+	resolver->current.addr = (const struct sockaddr *)&entry->addr;
 
 	return &resolver->current;
 #else
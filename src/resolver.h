@@ -15,12 +15,35 @@ struct resolver_address {
 	const struct sockaddr *addr;
 };
 
+/**
+ * Resolves a host name or a local socket path.  Results of
+ * getaddrinfo() are cached process-wide for a while, and their
+ * address families are interleaved for staggered connection attempts
+ * (RFC 8305).
+ *
+ * @param host the host name; must remain valid until
+ * resolver_free() is called
+ */
 struct resolver *
 resolver_new(const char *host, unsigned port);
 
 void
 resolver_free(struct resolver *resolver);
 
+/**
+ * Removes this resolver's host name from the cache, e.g. because
+ * none of its addresses could be connected.
+ */
+void
+resolver_invalidate(const struct resolver *resolver);
+
+/**
+ * Returns the number of addresses which resolver_next() has not
+ * returned yet.
+ */
+unsigned
+resolver_remaining(const struct resolver *resolver);
+
 const struct resolver_address *
 resolver_next(struct resolver *resolver);
 
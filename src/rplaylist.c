@@ -4,6 +4,7 @@
 #include <mpd/playlist.h>
 #include <mpd/recv.h>
 #include "internal.h"
+#include "imetrics.h"
 
 #include <errno.h>
 
@@ -24,6 +25,8 @@ mpd_recv_playlist(struct mpd_connection *connection)
 		return NULL;
 	}
 
+	mpd_metrics_add(connection->metrics, MPD_METRIC_OBJECTS, 1);
+
 	while ((pair = mpd_recv_pair(connection)) != NULL &&
 	       mpd_playlist_feed(playlist, pair))
 		mpd_return_pair(connection, pair);
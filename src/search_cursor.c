@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include <mpd/search_cursor.h>
+#include <mpd/search.h>
+#include <mpd/song.h>
+#include <mpd/pair.h>
+#include <mpd/recv.h>
+#include <mpd/response.h>
+#include "internal.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of pages kept in the cache.
+ */
+enum {
+	MPD_SEARCH_CURSOR_PAGES = 8,
+};
+
+/**
+ * Marks an unused cache slot, and means "no prefetch pending".
+ */
+static const unsigned NO_PAGE = UINT_MAX;
+
+struct mpd_search_page {
+	/**
+	 * The page number, or #NO_PAGE if this slot is unused.
+	 */
+	unsigned index;
+
+	unsigned length;
+
+	/**
+	 * The value of mpd_search_cursor.clock when this page was
+	 * last used; the least recently used page is evicted first.
+	 */
+	unsigned last_used;
+
+	/**
+	 * An array of page_size songs, allocated on first use.
+	 */
+	struct mpd_song **songs;
+};
+
+struct mpd_search_cursor {
+	char *expression;
+
+	/**
+	 * The sort tag name, or NULL.
+	 */
+	char *sort;
+
+	bool descending;
+
+	bool exact;
+
+	unsigned page_size;
+
+	/**
+	 * The total number of songs, or -1 if not yet known.
+	 */
+	int total;
+
+	/**
+	 * The page whose request has been sent, but whose response
+	 * has not yet been read, or #NO_PAGE.
+	 */
+	unsigned pending;
+
+	unsigned clock;
+
+	struct mpd_search_page pages[MPD_SEARCH_CURSOR_PAGES];
+};
+
+struct mpd_search_cursor *
+mpd_search_cursor_new(bool exact, const char *expression,
+		      const char *sort, bool descending,
+		      unsigned page_size)
+{
+	assert(expression != NULL);
+	assert(page_size > 0);
+
+	struct mpd_search_cursor *cursor = malloc(sizeof(*cursor));
+	if (cursor == NULL)
+		return NULL;
+
+	cursor->expression = strdup(expression);
+	if (cursor->expression == NULL) {
+		free(cursor);
+		return NULL;
+	}
+
+	if (sort != NULL) {
+		cursor->sort = strdup(sort);
+		if (cursor->sort == NULL) {
+			free(cursor->expression);
+			free(cursor);
+			return NULL;
+		}
+	} else
+		cursor->sort = NULL;
+
+	cursor->descending = descending;
+	cursor->exact = exact;
+	cursor->page_size = page_size;
+	cursor->total = -1;
+	cursor->pending = NO_PAGE;
+	cursor->clock = 0;
+
+	for (unsigned i = 0; i < MPD_SEARCH_CURSOR_PAGES; ++i) {
+		cursor->pages[i].index = NO_PAGE;
+		cursor->pages[i].length = 0;
+		cursor->pages[i].last_used = 0;
+		cursor->pages[i].songs = NULL;
+	}
+
+	return cursor;
+}
+
+static void
+mpd_search_page_clear(struct mpd_search_page *page)
+{
+	for (unsigned i = 0; i < page->length; ++i)
+		mpd_song_free(page->songs[i]);
+
+	page->index = NO_PAGE;
+	page->length = 0;
+}
+
+void
+mpd_search_cursor_free(struct mpd_search_cursor *cursor)
+{
+	assert(cursor != NULL);
+
+	for (unsigned i = 0; i < MPD_SEARCH_CURSOR_PAGES; ++i) {
+		mpd_search_page_clear(&cursor->pages[i]);
+		free(cursor->pages[i].songs);
+	}
+
+	free(cursor->sort);
+	free(cursor->expression);
+	free(cursor);
+}
+
+static struct mpd_search_page *
+mpd_search_cursor_lookup(struct mpd_search_cursor *cursor, unsigned index)
+{
+	for (unsigned i = 0; i < MPD_SEARCH_CURSOR_PAGES; ++i)
+		if (cursor->pages[i].index == index)
+			return &cursor->pages[i];
+
+	return NULL;
+}
+
+/**
+ * Returns an empty slot for a new page, evicting the least recently
+ * used one if necessary.
+ */
+static struct mpd_search_page *
+mpd_search_cursor_evict(struct mpd_search_cursor *cursor)
+{
+	struct mpd_search_page *victim = &cursor->pages[0];
+
+	for (unsigned i = 0; i < MPD_SEARCH_CURSOR_PAGES; ++i) {
+		struct mpd_search_page *page = &cursor->pages[i];
+		if (page->index == NO_PAGE) {
+			victim = page;
+			break;
+		}
+
+		if (page->last_used < victim->last_used)
+			victim = page;
+	}
+
+	mpd_search_page_clear(victim);
+	return victim;
+}
+
+static bool
+mpd_search_cursor_send(struct mpd_search_cursor *cursor,
+		       struct mpd_connection *connection,
+		       unsigned index)
+{
+	assert(cursor->pending == NO_PAGE);
+
+	const unsigned start = index * cursor->page_size;
+
+	if (!mpd_search_db_songs(connection, cursor->exact) ||
+	    !mpd_search_add_expression(connection, cursor->expression) ||
+	    (cursor->sort != NULL &&
+	     !mpd_search_add_sort_name(connection, cursor->sort,
+				       cursor->descending)) ||
+	    !mpd_search_add_window(connection, start,
+				   start + cursor->page_size) ||
+	    !mpd_search_commit(connection)) {
+		mpd_search_cancel(connection);
+		return false;
+	}
+
+	cursor->pending = index;
+	return true;
+}
+
+/**
+ * Reads the response of the pending request into a cache slot.
+ *
+ * @return the page, or NULL on error
+ */
+static struct mpd_search_page *
+mpd_search_cursor_receive(struct mpd_search_cursor *cursor,
+			  struct mpd_connection *connection)
+{
+	assert(cursor->pending != NO_PAGE);
+
+	struct mpd_search_page *page = mpd_search_cursor_evict(cursor);
+	if (page->songs == NULL) {
+		page->songs = malloc(cursor->page_size *
+				     sizeof(page->songs[0]));
+		if (page->songs == NULL) {
+			mpd_error_code(&connection->error, MPD_ERROR_OOM);
+			return NULL;
+		}
+	}
+
+	const unsigned index = cursor->pending;
+	cursor->pending = NO_PAGE;
+
+	struct mpd_song *song;
+	while ((song = mpd_recv_song(connection)) != NULL) {
+		if (page->length < cursor->page_size)
+			page->songs[page->length++] = song;
+		else
+			/* the server ignored the window */
+			mpd_song_free(song);
+	}
+
+	if (!mpd_response_finish(connection)) {
+		mpd_search_page_clear(page);
+		return NULL;
+	}
+
+	page->index = index;
+	page->last_used = ++cursor->clock;
+	return page;
+}
+
+bool
+mpd_search_cursor_sync(struct mpd_search_cursor *cursor,
+		       struct mpd_connection *connection)
+{
+	assert(cursor != NULL);
+	assert(connection != NULL);
+
+	return cursor->pending == NO_PAGE ||
+		mpd_search_cursor_receive(cursor, connection) != NULL;
+}
+
+/**
+ * Does the page after this one exist?
+ */
+static bool
+mpd_search_cursor_has_next(const struct mpd_search_cursor *cursor,
+			   const struct mpd_search_page *page)
+{
+	if (page->length < cursor->page_size)
+		return false;
+
+	const unsigned next = page->index + 1;
+	if (next >= UINT_MAX / cursor->page_size)
+		return false;
+
+	return cursor->total < 0 ||
+		next * cursor->page_size < (unsigned)cursor->total;
+}
+
+struct mpd_song *const *
+mpd_search_cursor_get_page(struct mpd_search_cursor *cursor,
+			   struct mpd_connection *connection,
+			   unsigned index, unsigned *length_r)
+{
+	assert(cursor != NULL);
+	assert(connection != NULL);
+	assert(index < UINT_MAX / cursor->page_size);
+	assert(length_r != NULL);
+
+	struct mpd_search_page *page =
+		mpd_search_cursor_lookup(cursor, index);
+	if (page == NULL) {
+		if (cursor->pending != index &&
+		    (!mpd_search_cursor_sync(cursor, connection) ||
+		     !mpd_search_cursor_send(cursor, connection, index)))
+			return NULL;
+
+		page = mpd_search_cursor_receive(cursor, connection);
+		if (page == NULL)
+			return NULL;
+	} else
+		page->last_used = ++cursor->clock;
+
+	/* send the request for the next page now; its response will
+	   be read by the next call */
+	if (cursor->pending == NO_PAGE &&
+	    mpd_search_cursor_has_next(cursor, page) &&
+	    mpd_search_cursor_lookup(cursor, index + 1) == NULL &&
+	    !mpd_search_cursor_send(cursor, connection, index + 1))
+		return NULL;
+
+	*length_r = page->length;
+	return page->songs;
+}
+
+int
+mpd_search_cursor_get_total(struct mpd_search_cursor *cursor,
+			    struct mpd_connection *connection)
+{
+	assert(cursor != NULL);
+	assert(connection != NULL);
+
+	if (cursor->total >= 0)
+		return cursor->total;
+
+	if (!mpd_search_cursor_sync(cursor, connection))
+		return -1;
+
+	if (!(cursor->exact
+	      ? mpd_count_db_songs(connection)
+	      : mpd_searchcount_db_songs(connection)) ||
+	    !mpd_search_add_expression(connection, cursor->expression) ||
+	    !mpd_search_commit(connection)) {
+		mpd_search_cancel(connection);
+		return -1;
+	}
+
+	struct mpd_pair *pair = mpd_recv_pair_named(connection, "songs");
+	if (pair != NULL) {
+		cursor->total = (int)strtoul(pair->value, NULL, 10);
+		mpd_return_pair(connection, pair);
+	} else if (!mpd_error_is_defined(&connection->error)) {
+		mpd_error_code(&connection->error, MPD_ERROR_MALFORMED);
+		mpd_error_message(&connection->error,
+				  "No song count in response");
+	}
+
+	if (!mpd_response_finish(connection))
+		return -1;
+
+	return cursor->total;
+}
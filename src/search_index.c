@@ -0,0 +1,1031 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include <mpd/search_index.h>
+#include <mpd/song.h>
+#include "fold.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Separates the values of a multi-value tag in the folded text.  MPD
+ * never sends it inside a value.
+ */
+#define SEARCH_INDEX_SEPARATOR '\n'
+
+struct search_index_song {
+	/**
+	 * Heap offset of the (unfolded) URI.
+	 */
+	uint32_t uri;
+
+	/**
+	 * The update generation in which this song was last added.
+	 */
+	uint32_t generation;
+
+	bool removed;
+};
+
+/**
+ * The posting list of one trigram: the ids of all songs containing
+ * it, in ascending order.
+ */
+struct search_index_trigram {
+	/**
+	 * The three folded bytes plus bit 24, so 0 marks an empty
+	 * hash slot.
+	 */
+	uint32_t key;
+
+	unsigned n, capacity;
+	uint32_t *ids;
+};
+
+/**
+ * One tag value in a prefix array.
+ */
+struct search_index_prefix {
+	const char *value;
+	uint32_t id;
+};
+
+struct mpd_search_index {
+	unsigned n_columns;
+	enum mpd_tag_type column_tags[MPD_TAG_COUNT];
+	signed char tag_column[MPD_TAG_COUNT];
+
+	struct search_index_song *songs;
+	unsigned n_songs, songs_capacity, n_removed;
+
+	/**
+	 * For each song and column: the heap offset of the folded
+	 * values, joined with #SEARCH_INDEX_SEPARATOR, or 0 if the
+	 * song has no such tag.
+	 */
+	uint32_t *texts;
+
+	/**
+	 * Per song, used to remove duplicates from query results.
+	 */
+	uint32_t *stamps;
+	uint32_t stamp;
+
+	char *heap;
+	size_t heap_length, heap_capacity;
+
+	/**
+	 * Hash set of song ids + 1, keyed by URI.
+	 */
+	uint32_t *uri_slots;
+	size_t uri_capacity;
+
+	struct search_index_trigram *trigrams;
+	size_t n_trigrams, trigram_capacity;
+
+	/**
+	 * 32 minus the base-2 logarithm of #trigram_capacity.
+	 */
+	unsigned trigram_shift;
+
+	/**
+	 * Per column: all values sorted, or NULL if they need to be
+	 * rebuilt.
+	 */
+	struct search_index_prefix *prefixes[MPD_TAG_COUNT];
+	unsigned n_prefixes[MPD_TAG_COUNT];
+
+	uint32_t generation;
+
+	/**
+	 * Scratch buffer for the folded texts of the song being added.
+	 */
+	char *scratch;
+	size_t scratch_capacity;
+};
+
+/**
+ * Returns the slot of a trigram key in a table of 2^(32-shift)
+ * slots.  This is Fibonacci hashing; the high bits of the product
+ * are used, because its low bits depend only on the low bits of the
+ * key (i.e. the last characters of the trigram).
+ */
+static size_t
+search_index_trigram_slot(uint32_t key, unsigned shift)
+{
+	return (key * 2654435761u) >> shift;
+}
+
+struct mpd_search_index *
+mpd_search_index_new(const enum mpd_tag_type *tags, unsigned n)
+{
+	assert(tags != NULL || n == 0);
+
+	struct mpd_search_index *index = calloc(1, sizeof(*index));
+	if (index == NULL)
+		return NULL;
+
+	memset(index->tag_column, -1, sizeof(index->tag_column));
+	for (unsigned i = 0; i < n; ++i) {
+		if ((int)tags[i] < 0 || tags[i] >= MPD_TAG_COUNT ||
+		    index->tag_column[tags[i]] >= 0)
+			continue;
+
+		index->tag_column[tags[i]] = (signed char)index->n_columns;
+		index->column_tags[index->n_columns++] = tags[i];
+	}
+
+	/* offset 0 means "no value" */
+	index->heap = malloc(4096);
+	if (index->heap == NULL) {
+		free(index);
+		return NULL;
+	}
+
+	index->heap[0] = 0;
+	index->heap_length = 1;
+	index->heap_capacity = 4096;
+	return index;
+}
+
+static void
+search_index_invalidate_prefixes(struct mpd_search_index *index)
+{
+	for (unsigned i = 0; i < index->n_columns; ++i) {
+		free(index->prefixes[i]);
+		index->prefixes[i] = NULL;
+	}
+}
+
+void
+mpd_search_index_free(struct mpd_search_index *index)
+{
+	assert(index != NULL);
+
+	search_index_invalidate_prefixes(index);
+
+	for (size_t i = 0; i < index->trigram_capacity; ++i)
+		free(index->trigrams[i].ids);
+	free(index->trigrams);
+
+	free(index->uri_slots);
+	free(index->songs);
+	free(index->texts);
+	free(index->stamps);
+	free(index->heap);
+	free(index->scratch);
+	free(index);
+}
+
+unsigned
+mpd_search_index_get_length(const struct mpd_search_index *index)
+{
+	assert(index != NULL);
+
+	return index->n_songs - index->n_removed;
+}
+
+static bool
+search_index_reserve_heap(struct mpd_search_index *index, size_t length)
+{
+	const size_t needed = index->heap_length + length;
+	if (needed > UINT32_MAX)
+		return false;
+
+	if (needed <= index->heap_capacity)
+		return true;
+
+	size_t capacity = index->heap_capacity * 2;
+	while (capacity < needed)
+		capacity *= 2;
+
+	char *heap = realloc(index->heap, capacity);
+	if (heap == NULL)
+		return false;
+
+	index->heap = heap;
+	index->heap_capacity = capacity;
+
+	/* the prefix arrays point into the heap */
+	search_index_invalidate_prefixes(index);
+	return true;
+}
+
+/**
+ * Appends a string (plus null terminator) to the heap, which must
+ * have been reserved already.
+ */
+static uint32_t
+search_index_append(struct mpd_search_index *index,
+		    const char *s, size_t length)
+{
+	assert(index->heap_length + length + 1 <= index->heap_capacity);
+
+	const uint32_t offset = (uint32_t)index->heap_length;
+	memcpy(index->heap + offset, s, length);
+	index->heap[offset + length] = 0;
+	index->heap_length += length + 1;
+	return offset;
+}
+
+static bool
+search_index_reserve_song(struct mpd_search_index *index)
+{
+	if (index->n_songs < index->songs_capacity)
+		return true;
+
+	const unsigned capacity = index->songs_capacity > 0
+		? index->songs_capacity * 2
+		: 1024;
+
+	struct search_index_song *songs =
+		realloc(index->songs, capacity * sizeof(*songs));
+	if (songs == NULL)
+		return false;
+	index->songs = songs;
+
+	uint32_t *stamps = realloc(index->stamps, capacity * sizeof(*stamps));
+	if (stamps == NULL)
+		return false;
+	index->stamps = stamps;
+
+	if (index->n_columns > 0) {
+		uint32_t *texts = realloc(index->texts,
+					  (size_t)capacity * index->n_columns *
+					  sizeof(*texts));
+		if (texts == NULL)
+			return false;
+		index->texts = texts;
+	}
+
+	index->songs_capacity = capacity;
+	return true;
+}
+
+/*
+ * URI hash set
+ *
+ */
+
+/**
+ * Returns the slot of the song with this URI, or the empty slot
+ * where it would be inserted.
+ */
+static size_t
+search_index_find_uri(const struct mpd_search_index *index, const char *uri)
+{
+	assert(index->uri_capacity > 0);
+
+	const size_t mask = index->uri_capacity - 1;
+	size_t slot = mpd_hash_string(uri, strlen(uri)) & mask;
+	uint32_t value;
+	while ((value = index->uri_slots[slot]) != 0) {
+		const struct search_index_song *song =
+			&index->songs[value - 1];
+		if (strcmp(index->heap + song->uri, uri) == 0)
+			return slot;
+
+		slot = (slot + 1) & mask;
+	}
+
+	return slot;
+}
+
+static bool
+search_index_grow_uris(struct mpd_search_index *index)
+{
+	const size_t capacity = index->uri_capacity > 0
+		? index->uri_capacity * 2
+		: 2048;
+	uint32_t *slots = calloc(capacity, sizeof(*slots));
+	if (slots == NULL)
+		return false;
+
+	uint32_t *old = index->uri_slots;
+	const size_t old_capacity = index->uri_capacity;
+	index->uri_slots = slots;
+	index->uri_capacity = capacity;
+
+	for (size_t i = 0; i < old_capacity; ++i) {
+		if (old[i] == 0)
+			continue;
+
+		const char *uri = index->heap + index->songs[old[i] - 1].uri;
+		slots[search_index_find_uri(index, uri)] = old[i];
+	}
+
+	free(old);
+	return true;
+}
+
+/*
+ * Trigram index
+ *
+ */
+
+static uint32_t
+search_index_trigram_key(const char *p)
+{
+	return (1u << 24) | ((uint32_t)(unsigned char)p[0] << 16) |
+		((uint32_t)(unsigned char)p[1] << 8) |
+		(uint32_t)(unsigned char)p[2];
+}
+
+static struct search_index_trigram *
+search_index_find_trigram(const struct mpd_search_index *index, uint32_t key)
+{
+	if (index->trigram_capacity == 0)
+		return NULL;
+
+	const size_t mask = index->trigram_capacity - 1;
+	size_t slot = search_index_trigram_slot(key, index->trigram_shift);
+	while (index->trigrams[slot].key != 0) {
+		if (index->trigrams[slot].key == key)
+			return &index->trigrams[slot];
+
+		slot = (slot + 1) & mask;
+	}
+
+	return NULL;
+}
+
+static bool
+search_index_grow_trigrams(struct mpd_search_index *index)
+{
+	const size_t capacity = index->trigram_capacity > 0
+		? index->trigram_capacity * 2
+		: 4096;
+	const unsigned shift = index->trigram_capacity > 0
+		? index->trigram_shift - 1
+		: 32 - 12;
+	struct search_index_trigram *trigrams =
+		calloc(capacity, sizeof(*trigrams));
+	if (trigrams == NULL)
+		return false;
+
+	for (size_t i = 0; i < index->trigram_capacity; ++i) {
+		const struct search_index_trigram *t = &index->trigrams[i];
+		if (t->key == 0)
+			continue;
+
+		size_t slot = search_index_trigram_slot(t->key, shift);
+		while (trigrams[slot].key != 0)
+			slot = (slot + 1) & (capacity - 1);
+		trigrams[slot] = *t;
+	}
+
+	free(index->trigrams);
+	index->trigrams = trigrams;
+	index->trigram_capacity = capacity;
+	index->trigram_shift = shift;
+	return true;
+}
+
+static bool
+search_index_add_trigram(struct mpd_search_index *index,
+			 uint32_t key, uint32_t id)
+{
+	if ((index->n_trigrams + 1) * 2 > index->trigram_capacity &&
+	    !search_index_grow_trigrams(index))
+		return false;
+
+	const size_t mask = index->trigram_capacity - 1;
+	size_t slot = search_index_trigram_slot(key, index->trigram_shift);
+	while (index->trigrams[slot].key != 0 &&
+	       index->trigrams[slot].key != key)
+		slot = (slot + 1) & mask;
+
+	struct search_index_trigram *t = &index->trigrams[slot];
+	if (t->key == 0) {
+		t->key = key;
+		++index->n_trigrams;
+	}
+
+	if (t->n > 0 && t->ids[t->n - 1] == id)
+		/* already listed */
+		return true;
+
+	if (t->n == t->capacity) {
+		const unsigned capacity = t->capacity > 0 ? t->capacity * 2 : 4;
+		uint32_t *ids = realloc(t->ids, capacity * sizeof(*ids));
+		if (ids == NULL)
+			return false;
+
+		t->ids = ids;
+		t->capacity = capacity;
+	}
+
+	t->ids[t->n++] = id;
+	return true;
+}
+
+static bool
+search_index_add_trigrams(struct mpd_search_index *index,
+			  const char *text, uint32_t id)
+{
+	const size_t length = strlen(text);
+	for (size_t i = 0; i + 3 <= length; ++i) {
+		if (text[i] == SEARCH_INDEX_SEPARATOR ||
+		    text[i + 1] == SEARCH_INDEX_SEPARATOR ||
+		    text[i + 2] == SEARCH_INDEX_SEPARATOR)
+			continue;
+
+		if (!search_index_add_trigram(index,
+					      search_index_trigram_key(text + i),
+					      id))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Modification
+ *
+ */
+
+static bool
+search_index_reserve_scratch(struct mpd_search_index *index, size_t size)
+{
+	if (size <= index->scratch_capacity)
+		return true;
+
+	char *scratch = realloc(index->scratch, size);
+	if (scratch == NULL)
+		return false;
+
+	index->scratch = scratch;
+	index->scratch_capacity = size;
+	return true;
+}
+
+/**
+ * Folds all indexed tags of the song into the scratch buffer: one
+ * null-terminated string per column, empty if the song does not
+ * have the tag.
+ *
+ * @param size_r receives the total size of all strings
+ * @return false on out of memory
+ */
+static bool
+search_index_fold_song(struct mpd_search_index *index,
+		       const struct mpd_song *song, size_t *size_r)
+{
+	size_t size = 0;
+	for (unsigned c = 0; c < index->n_columns; ++c) {
+		const char *value;
+
+		/* one separator or null terminator per value, and
+		   one for columns without a value */
+		size += 1;
+		for (unsigned i = 0;
+		     (value = mpd_song_get_tag(song, index->column_tags[c],
+					       i)) != NULL;
+		     ++i)
+			size += strlen(value) + 1;
+	}
+
+	if (!search_index_reserve_scratch(index, size))
+		return false;
+
+	char *p = index->scratch;
+	for (unsigned c = 0; c < index->n_columns; ++c) {
+		const char *value;
+		for (unsigned i = 0;
+		     (value = mpd_song_get_tag(song, index->column_tags[c],
+					       i)) != NULL;
+		     ++i) {
+			if (i > 0)
+				*p++ = SEARCH_INDEX_SEPARATOR;
+
+			const size_t length = strlen(value);
+			mpd_fold_copy(p, value, length);
+			p += length;
+		}
+
+		*p++ = 0;
+	}
+
+	*size_r = (size_t)(p - index->scratch);
+	return true;
+}
+
+/**
+ * Does the song already have exactly these folded texts?
+ */
+static bool
+search_index_same_texts(const struct mpd_search_index *index, uint32_t id)
+{
+	const char *p = index->scratch;
+	for (unsigned c = 0; c < index->n_columns; ++c) {
+		const uint32_t offset = index->texts[id * index->n_columns + c];
+		if (strcmp(index->heap + offset, p) != 0)
+			return false;
+
+		p += strlen(p) + 1;
+	}
+
+	return true;
+}
+
+static void
+search_index_remove_id(struct mpd_search_index *index, uint32_t id)
+{
+	assert(!index->songs[id].removed);
+
+	index->songs[id].removed = true;
+	++index->n_removed;
+	search_index_invalidate_prefixes(index);
+}
+
+/**
+ * Inserts a new song from the folded texts in the scratch buffer.
+ */
+static bool
+search_index_insert(struct mpd_search_index *index, const char *uri,
+		    size_t texts_size, size_t slot)
+{
+	const size_t uri_length = strlen(uri);
+	if (!search_index_reserve_song(index) ||
+	    !search_index_reserve_heap(index, uri_length + 1 + texts_size))
+		return false;
+
+	const uint32_t id = index->n_songs;
+	struct search_index_song *song = &index->songs[id];
+	song->uri = search_index_append(index, uri, uri_length);
+	song->generation = index->generation;
+	song->removed = false;
+	index->stamps[id] = 0;
+
+	const char *p = index->scratch;
+	for (unsigned c = 0; c < index->n_columns; ++c) {
+		const size_t length = strlen(p);
+		index->texts[id * index->n_columns + c] = length > 0
+			? search_index_append(index, p, length)
+			: 0;
+		p += length + 1;
+	}
+
+	/* commit the song before indexing, so a failure below
+	   leaves a consistent (if incompletely indexed) song */
+	++index->n_songs;
+	index->uri_slots[slot] = id + 1;
+	search_index_invalidate_prefixes(index);
+
+	for (unsigned c = 0; c < index->n_columns; ++c) {
+		const uint32_t offset = index->texts[id * index->n_columns + c];
+		if (offset != 0 &&
+		    !search_index_add_trigrams(index, index->heap + offset, id))
+			return false;
+	}
+
+	return true;
+}
+
+bool
+mpd_search_index_add(struct mpd_search_index *index,
+		     const struct mpd_song *song)
+{
+	assert(index != NULL);
+	assert(song != NULL);
+
+	const char *uri = mpd_song_get_uri(song);
+
+	if ((index->n_songs + 1) * 2 > index->uri_capacity &&
+	    !search_index_grow_uris(index))
+		return false;
+
+	size_t texts_size;
+	if (!search_index_fold_song(index, song, &texts_size))
+		return false;
+
+	size_t slot = search_index_find_uri(index, uri);
+	if (index->uri_slots[slot] != 0) {
+		const uint32_t id = index->uri_slots[slot] - 1;
+		if (index->songs[id].removed) {
+			/* left over from a replacement which failed
+			   with out of memory; the slot is reused */
+		} else if (search_index_same_texts(index, id)) {
+			/* unchanged; this is the common case during
+			   an update */
+			index->songs[id].generation = index->generation;
+			return true;
+		} else {
+			/* the ids must stay in insertion order, so a
+			   modified song gets a new id; the URI slot is
+			   reused */
+			search_index_remove_id(index, id);
+		}
+	}
+
+	return search_index_insert(index, uri, texts_size, slot);
+}
+
+/**
+ * Removes the song in this URI slot, keeping the hash set
+ * consistent (backward shift deletion).
+ */
+static void
+search_index_clear_uri_slot(struct mpd_search_index *index, size_t slot)
+{
+	const size_t mask = index->uri_capacity - 1;
+
+	index->uri_slots[slot] = 0;
+	for (size_t next = (slot + 1) & mask; index->uri_slots[next] != 0;
+	     next = (next + 1) & mask) {
+		const uint32_t value = index->uri_slots[next];
+		const char *uri = index->heap + index->songs[value - 1].uri;
+
+		index->uri_slots[next] = 0;
+		index->uri_slots[search_index_find_uri(index, uri)] = value;
+	}
+}
+
+bool
+mpd_search_index_remove(struct mpd_search_index *index, const char *uri)
+{
+	assert(index != NULL);
+	assert(uri != NULL);
+
+	if (index->uri_capacity == 0)
+		return false;
+
+	const size_t slot = search_index_find_uri(index, uri);
+	if (index->uri_slots[slot] == 0)
+		return false;
+
+	const uint32_t id = index->uri_slots[slot] - 1;
+	const bool found = !index->songs[id].removed;
+	if (found)
+		search_index_remove_id(index, id);
+
+	search_index_clear_uri_slot(index, slot);
+	return found;
+}
+
+/**
+ * Rebuilds the index without the removed songs, whose ids, texts and
+ * posting list entries are otherwise kept forever.  On out of
+ * memory, the index is left as it is.
+ */
+static void
+search_index_compact(struct mpd_search_index *index)
+{
+	struct mpd_search_index *fresh =
+		mpd_search_index_new(index->column_tags, index->n_columns);
+	if (fresh == NULL)
+		return;
+
+	fresh->generation = index->generation;
+
+	for (uint32_t id = 0; id < index->n_songs; ++id) {
+		const struct search_index_song *song = &index->songs[id];
+		if (song->removed)
+			continue;
+
+		size_t size = 0;
+		for (unsigned c = 0; c < index->n_columns; ++c)
+			size += strlen(index->heap +
+				       index->texts[id * index->n_columns + c]) + 1;
+
+		if (!search_index_reserve_scratch(fresh, size) ||
+		    ((fresh->n_songs + 1) * 2 > fresh->uri_capacity &&
+		     !search_index_grow_uris(fresh))) {
+			mpd_search_index_free(fresh);
+			return;
+		}
+
+		char *p = fresh->scratch;
+		for (unsigned c = 0; c < index->n_columns; ++c) {
+			const char *text = index->heap +
+				index->texts[id * index->n_columns + c];
+			const size_t length = strlen(text) + 1;
+			memcpy(p, text, length);
+			p += length;
+		}
+
+		const char *uri = index->heap + song->uri;
+		if (!search_index_insert(fresh, uri, size,
+					 search_index_find_uri(fresh, uri))) {
+			mpd_search_index_free(fresh);
+			return;
+		}
+
+		fresh->songs[fresh->n_songs - 1].generation = song->generation;
+	}
+
+	const struct mpd_search_index tmp = *index;
+	*index = *fresh;
+	*fresh = tmp;
+	mpd_search_index_free(fresh);
+}
+
+void
+mpd_search_index_begin_update(struct mpd_search_index *index)
+{
+	assert(index != NULL);
+
+	++index->generation;
+}
+
+void
+mpd_search_index_end_update(struct mpd_search_index *index)
+{
+	assert(index != NULL);
+
+	for (uint32_t id = 0; id < index->n_songs; ++id) {
+		const struct search_index_song *song = &index->songs[id];
+		if (!song->removed && song->generation != index->generation)
+			mpd_search_index_remove(index,
+						index->heap + song->uri);
+	}
+
+	if (index->n_removed > 1024 && index->n_removed > index->n_songs / 2)
+		search_index_compact(index);
+}
+
+/*
+ * Queries
+ *
+ */
+
+/**
+ * Compares two values in the folded text, each terminated by a null
+ * byte or #SEARCH_INDEX_SEPARATOR.
+ */
+static int
+search_index_compare_values(const char *a, const char *b)
+{
+	while (true) {
+		const unsigned char ca = *a == SEARCH_INDEX_SEPARATOR ? 0 : *a;
+		const unsigned char cb = *b == SEARCH_INDEX_SEPARATOR ? 0 : *b;
+		if (ca != cb || ca == 0)
+			return (int)ca - (int)cb;
+
+		++a;
+		++b;
+	}
+}
+
+static int
+search_index_compare_prefixes(const void *_a, const void *_b)
+{
+	const struct search_index_prefix *a = _a, *b = _b;
+	const int result = search_index_compare_values(a->value, b->value);
+	if (result != 0)
+		return result;
+
+	return a->id < b->id ? -1 : a->id > b->id;
+}
+
+static bool
+search_index_build_prefixes(struct mpd_search_index *index, unsigned column)
+{
+	unsigned n = 0;
+	for (uint32_t id = 0; id < index->n_songs; ++id) {
+		const uint32_t offset = index->texts[id * index->n_columns + column];
+		if (index->songs[id].removed || offset == 0)
+			continue;
+
+		++n;
+		for (const char *p = index->heap + offset; *p != 0; ++p)
+			if (*p == SEARCH_INDEX_SEPARATOR)
+				++n;
+	}
+
+	struct search_index_prefix *prefixes =
+		malloc((n > 0 ? n : 1) * sizeof(*prefixes));
+	if (prefixes == NULL)
+		return false;
+
+	n = 0;
+	for (uint32_t id = 0; id < index->n_songs; ++id) {
+		const uint32_t offset = index->texts[id * index->n_columns + column];
+		if (index->songs[id].removed || offset == 0)
+			continue;
+
+		const char *p = index->heap + offset;
+		prefixes[n++] = (struct search_index_prefix){ p, id };
+		for (; *p != 0; ++p)
+			if (*p == SEARCH_INDEX_SEPARATOR)
+				prefixes[n++] =
+					(struct search_index_prefix){ p + 1, id };
+	}
+
+	qsort(prefixes, n, sizeof(*prefixes), search_index_compare_prefixes);
+	index->prefixes[column] = prefixes;
+	index->n_prefixes[column] = n;
+	return true;
+}
+
+/**
+ * Starts a new query: returns a stamp which no song has yet.
+ */
+static uint32_t
+search_index_new_stamp(struct mpd_search_index *index)
+{
+	if (++index->stamp == 0) {
+		memset(index->stamps, 0, index->n_songs * sizeof(*index->stamps));
+		index->stamp = 1;
+	}
+
+	return index->stamp;
+}
+
+/**
+ * Adds a song to the result unless it is already there.
+ */
+static void
+search_index_emit(struct mpd_search_index *index, uint32_t id,
+		  const char **uris, unsigned *n_r)
+{
+	if (index->stamps[id] == index->stamp)
+		return;
+
+	index->stamps[id] = index->stamp;
+	uris[(*n_r)++] = index->heap + index->songs[id].uri;
+}
+
+static unsigned
+search_index_query_prefix(struct mpd_search_index *index,
+			  unsigned first, unsigned last,
+			  const char *query, size_t length,
+			  const char **uris, unsigned max)
+{
+	unsigned n = 0;
+
+	for (unsigned c = first; c < last && n < max; ++c) {
+		if (index->prefixes[c] == NULL &&
+		    !search_index_build_prefixes(index, c))
+			break;
+
+		const struct search_index_prefix *prefixes = index->prefixes[c];
+
+		/* binary search for the first value >= query */
+		unsigned lo = 0, hi = index->n_prefixes[c];
+		while (lo < hi) {
+			const unsigned mid = lo + (hi - lo) / 2;
+			if (search_index_compare_values(prefixes[mid].value,
+							query) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		for (unsigned i = lo; i < index->n_prefixes[c] && n < max &&
+			     strncmp(prefixes[i].value, query, length) == 0;
+		     ++i)
+			search_index_emit(index, prefixes[i].id, uris, &n);
+	}
+
+	return n;
+}
+
+/**
+ * Does the song contain the query in one of the columns?
+ */
+static bool
+search_index_contains(const struct mpd_search_index *index, uint32_t id,
+		      unsigned first, unsigned last, const char *query)
+{
+	for (unsigned c = first; c < last; ++c) {
+		const uint32_t offset = index->texts[id * index->n_columns + c];
+		if (offset != 0 && strstr(index->heap + offset, query) != NULL)
+			return true;
+	}
+
+	return false;
+}
+
+static bool
+search_index_list_contains(const struct search_index_trigram *t, uint32_t id)
+{
+	unsigned lo = 0, hi = t->n;
+	while (lo < hi) {
+		const unsigned mid = lo + (hi - lo) / 2;
+		if (t->ids[mid] < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo < t->n && t->ids[lo] == id;
+}
+
+static unsigned
+search_index_query_contains(struct mpd_search_index *index,
+			    unsigned first, unsigned last,
+			    const char *query, size_t length,
+			    const char **uris, unsigned max)
+{
+	unsigned n = 0;
+
+	if (length < 3) {
+		/* too short for the trigram index; scan all songs */
+		for (uint32_t id = 0; id < index->n_songs && n < max; ++id)
+			if (!index->songs[id].removed &&
+			    search_index_contains(index, id, first, last, query))
+				search_index_emit(index, id, uris, &n);
+		return n;
+	}
+
+	/* look up the posting lists of all trigrams of the query;
+	   the shortest one drives the scan, the others filter */
+	enum { MAX_LISTS = 16 };
+	const struct search_index_trigram *lists[MAX_LISTS];
+	unsigned n_lists = 0;
+
+	for (size_t i = 0; i + 3 <= length; ++i) {
+		const struct search_index_trigram *t =
+			search_index_find_trigram(index,
+						  search_index_trigram_key(query + i));
+		if (t == NULL)
+			/* no song contains this trigram */
+			return 0;
+
+		if (n_lists < MAX_LISTS) {
+			lists[n_lists++] = t;
+		} else {
+			/* keep the shortest lists */
+			unsigned longest = 0;
+			for (unsigned j = 1; j < MAX_LISTS; ++j)
+				if (lists[j]->n > lists[longest]->n)
+					longest = j;
+			if (t->n < lists[longest]->n)
+				lists[longest] = t;
+		}
+	}
+
+	/* sort by length (insertion sort, there are only a few), so
+	   the most selective lists reject candidates first */
+	for (unsigned i = 1; i < n_lists; ++i) {
+		const struct search_index_trigram *t = lists[i];
+		unsigned j = i;
+		for (; j > 0 && lists[j - 1]->n > t->n; --j)
+			lists[j] = lists[j - 1];
+		lists[j] = t;
+	}
+
+	const struct search_index_trigram *driver = lists[0];
+	for (unsigned i = 0; i < driver->n && n < max; ++i) {
+		const uint32_t id = driver->ids[i];
+		if (index->songs[id].removed)
+			continue;
+
+		bool candidate = true;
+		for (unsigned j = 1; j < n_lists && candidate; ++j)
+			candidate = search_index_list_contains(lists[j], id);
+
+		/* the trigrams may be in a different column or in
+		   a different order; verify */
+		if (candidate &&
+		    search_index_contains(index, id, first, last, query))
+			search_index_emit(index, id, uris, &n);
+	}
+
+	return n;
+}
+
+unsigned
+mpd_search_index_query(struct mpd_search_index *index,
+		       enum mpd_tag_type tag,
+		       enum mpd_search_index_mode mode,
+		       const char *query,
+		       const char **uris, unsigned max)
+{
+	assert(index != NULL);
+	assert(query != NULL);
+	assert(uris != NULL || max == 0);
+
+	unsigned first = 0, last = index->n_columns;
+	if (tag != MPD_TAG_UNKNOWN) {
+		if ((int)tag < 0 || tag >= MPD_TAG_COUNT ||
+		    index->tag_column[tag] < 0)
+			return 0;
+
+		first = (unsigned)index->tag_column[tag];
+		last = first + 1;
+	}
+
+	const size_t length = strlen(query);
+	char *folded = malloc(length + 1);
+	if (folded == NULL)
+		return 0;
+
+	mpd_fold_copy(folded, query, length);
+	folded[length] = 0;
+
+	search_index_new_stamp(index);
+
+	const unsigned n = mode == MPD_SEARCH_INDEX_STARTS_WITH
+		? search_index_query_prefix(index, first, last,
+					    folded, length, uris, max)
+		: search_index_query_contains(index, first, last,
+					      folded, length, uris, max);
+	free(folded);
+	return n;
+}
@@ -0,0 +1,544 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include <mpd/server_capabilities.h>
+#include <mpd/capabilities.h>
+#include <mpd/connection.h>
+#include <mpd/list.h>
+#include <mpd/recv.h>
+#include <mpd/response.h>
+#include <mpd/settings.h>
+#include "internal.h"
+#include "iprojection.h"
+#include "spinlock.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+	/**
+	 * The number of servers in the cache.
+	 */
+	MPD_CAPABILITIES_CACHE_SIZE = 8,
+};
+
+/**
+ * A sorted array of strings allocated with malloc().
+ */
+struct mpd_string_list {
+	char **items;
+	unsigned n, capacity;
+};
+
+struct mpd_server_capabilities {
+	atomic_uint refs;
+
+	struct mpd_string_list commands;
+	struct mpd_string_list disallowed_commands;
+	struct mpd_string_list url_schemes;
+
+	bool tag_types[MPD_TAG_COUNT];
+	bool features[MPD_FEATURE_COUNT];
+	bool normalizations[MPD_STRINGNORMALIZATION_COUNT];
+};
+
+struct mpd_capabilities_cache_item {
+	/**
+	 * The host name (allocated with malloc()), or NULL if this
+	 * item is unused.
+	 */
+	char *host;
+
+	unsigned port;
+
+	/**
+	 * The password (allocated with malloc()) or NULL; it is part
+	 * of the key because it determines which commands are
+	 * allowed.
+	 */
+	char *password;
+
+	unsigned version[3];
+
+	/**
+	 * The cache's reference.
+	 */
+	struct mpd_server_capabilities *capabilities;
+};
+
+static struct mpd_capabilities_cache_item
+mpd_capabilities_cache[MPD_CAPABILITIES_CACHE_SIZE];
+
+/**
+ * Which item to evict next when the cache is full.
+ */
+static unsigned mpd_capabilities_cache_victim;
+
+static atomic_flag mpd_capabilities_cache_lock = ATOMIC_FLAG_INIT;
+
+static void
+mpd_string_list_deinit(struct mpd_string_list *list)
+{
+	for (unsigned i = 0; i < list->n; ++i)
+		free(list->items[i]);
+	free(list->items);
+}
+
+static bool
+mpd_string_list_add(struct mpd_string_list *list, const char *value)
+{
+	if (list->n == list->capacity) {
+		const unsigned capacity = list->capacity > 0
+			? list->capacity * 2
+			: 64;
+		char **items = realloc(list->items,
+				       capacity * sizeof(*items));
+		if (items == NULL)
+			return false;
+
+		list->items = items;
+		list->capacity = capacity;
+	}
+
+	char *copy = strdup(value);
+	if (copy == NULL)
+		return false;
+
+	list->items[list->n++] = copy;
+	return true;
+}
+
+static int
+mpd_string_compare(const void *a, const void *b)
+{
+	const char *const *x = a, *const *y = b;
+	return strcmp(*x, *y);
+}
+
+static void
+mpd_string_list_sort(struct mpd_string_list *list)
+{
+	if (list->n > 1)
+		qsort(list->items, list->n, sizeof(list->items[0]),
+		      mpd_string_compare);
+}
+
+static bool
+mpd_string_list_contains(const struct mpd_string_list *list,
+			 const char *value)
+{
+	return list->n > 0 &&
+		bsearch(&value, list->items, list->n, sizeof(list->items[0]),
+			mpd_string_compare) != NULL;
+}
+
+static void
+mpd_server_capabilities_free(struct mpd_server_capabilities *capabilities)
+{
+	mpd_string_list_deinit(&capabilities->commands);
+	mpd_string_list_deinit(&capabilities->disallowed_commands);
+	mpd_string_list_deinit(&capabilities->url_schemes);
+	free(capabilities);
+}
+
+void
+mpd_server_capabilities_unref(struct mpd_server_capabilities *capabilities)
+{
+	assert(capabilities != NULL);
+
+	if (atomic_fetch_sub_explicit(&capabilities->refs, 1,
+				      memory_order_acq_rel) == 1)
+		mpd_server_capabilities_free(capabilities);
+}
+
+static struct mpd_server_capabilities *
+mpd_server_capabilities_ref(struct mpd_server_capabilities *capabilities)
+{
+	atomic_fetch_add_explicit(&capabilities->refs, 1,
+				  memory_order_relaxed);
+	return capabilities;
+}
+
+/**
+ * Receives one response of the command list into a string list.
+ */
+static bool
+mpd_server_capabilities_recv_list(struct mpd_connection *connection,
+				  const char *name,
+				  struct mpd_string_list *list)
+{
+	struct mpd_pair *pair;
+	while ((pair = mpd_recv_pair_named(connection, name)) != NULL) {
+		const bool success = mpd_string_list_add(list, pair->value);
+		mpd_return_pair(connection, pair);
+
+		if (!success) {
+			mpd_error_code(&connection->error, MPD_ERROR_OOM);
+			return false;
+		}
+	}
+
+	mpd_string_list_sort(list);
+	return mpd_response_next(connection);
+}
+
+/**
+ * Receives one response of the command list into a bool array,
+ * indexed by the value returned by the parse function.
+ */
+static bool
+mpd_server_capabilities_recv_flags(struct mpd_connection *connection,
+				   const char *name,
+				   int (*parse)(const char *value),
+				   bool *flags, int n_flags)
+{
+	struct mpd_pair *pair;
+	while ((pair = mpd_recv_pair_named(connection, name)) != NULL) {
+		const int i = parse(pair->value);
+		if (i >= 0 && i < n_flags)
+			flags[i] = true;
+
+		mpd_return_pair(connection, pair);
+	}
+
+	return mpd_response_next(connection);
+}
+
+static int
+mpd_tag_name_parse_int(const char *name)
+{
+	return (int)mpd_tag_name_iparse(name);
+}
+
+static int
+mpd_feature_name_parse_int(const char *name)
+{
+	return (int)mpd_feature_name_parse(name);
+}
+
+static int
+mpd_stringnormalization_name_parse_int(const char *name)
+{
+	return (int)mpd_stringnormalization_name_parse(name);
+}
+
+/**
+ * Queries all capabilities with one command list.
+ */
+static struct mpd_server_capabilities *
+mpd_server_capabilities_query(struct mpd_connection *connection)
+{
+	const bool mpd_0_24 =
+		mpd_connection_cmp_server_version(connection, 0, 24, 0) >= 0;
+	const bool mpd_0_25 =
+		mpd_connection_cmp_server_version(connection, 0, 25, 0) >= 0;
+
+	if (!mpd_command_list_begin(connection, true) ||
+	    !mpd_send_allowed_commands(connection) ||
+	    !mpd_send_disallowed_commands(connection) ||
+	    !mpd_send_list_url_schemes(connection) ||
+	    !(mpd_0_24
+	      ? mpd_send_list_tag_types_available(connection)
+	      : mpd_send_list_tag_types(connection)) ||
+	    (mpd_0_24 &&
+	     !mpd_send_list_protocol_features_available(connection)) ||
+	    (mpd_0_25 &&
+	     !mpd_send_list_stringnormalization_available(connection)) ||
+	    !mpd_command_list_end(connection))
+		return NULL;
+
+	struct mpd_server_capabilities *capabilities =
+		calloc(1, sizeof(*capabilities));
+	if (capabilities == NULL) {
+		mpd_error_code(&connection->error, MPD_ERROR_OOM);
+		return NULL;
+	}
+
+	atomic_init(&capabilities->refs, 1);
+
+	if (!mpd_server_capabilities_recv_list(connection, "command",
+					       &capabilities->commands) ||
+	    !mpd_server_capabilities_recv_list(connection, "command",
+					       &capabilities->disallowed_commands) ||
+	    !mpd_server_capabilities_recv_list(connection, "handler",
+					       &capabilities->url_schemes) ||
+	    !mpd_server_capabilities_recv_flags(connection, "tagtype",
+						mpd_tag_name_parse_int,
+						capabilities->tag_types,
+						MPD_TAG_COUNT) ||
+	    (mpd_0_24 &&
+	     !mpd_server_capabilities_recv_flags(connection, "feature",
+						 mpd_feature_name_parse_int,
+						 capabilities->features,
+						 MPD_FEATURE_COUNT)) ||
+	    (mpd_0_25 &&
+	     !mpd_server_capabilities_recv_flags(connection,
+						 "stringnormalization",
+						 mpd_stringnormalization_name_parse_int,
+						 capabilities->normalizations,
+						 MPD_STRINGNORMALIZATION_COUNT)) ||
+	    !mpd_response_finish(connection)) {
+		mpd_server_capabilities_free(capabilities);
+		return NULL;
+	}
+
+	return capabilities;
+}
+
+static bool
+mpd_optional_str_equals(const char *a, const char *b)
+{
+	return a == NULL ? b == NULL : b != NULL && strcmp(a, b) == 0;
+}
+
+/**
+ * Finds the cache item for the specified server.  The caller must
+ * hold the lock.
+ */
+static struct mpd_capabilities_cache_item *
+mpd_capabilities_cache_find(const char *host, unsigned port,
+			    const char *password)
+{
+	for (unsigned i = 0; i < MPD_CAPABILITIES_CACHE_SIZE; ++i) {
+		struct mpd_capabilities_cache_item *item =
+			&mpd_capabilities_cache[i];
+		if (item->host != NULL && item->port == port &&
+		    strcmp(item->host, host) == 0 &&
+		    mpd_optional_str_equals(item->password, password))
+			return item;
+	}
+
+	return NULL;
+}
+
+/**
+ * Returns a new reference to the cached capabilities of the server,
+ * or NULL if there are none for this server version.
+ */
+static struct mpd_server_capabilities *
+mpd_capabilities_cache_lookup(const struct mpd_settings *settings,
+			      const unsigned *version)
+{
+	struct mpd_server_capabilities *capabilities = NULL;
+
+	mpd_spin_lock(&mpd_capabilities_cache_lock);
+
+	const struct mpd_capabilities_cache_item *item =
+		mpd_capabilities_cache_find(mpd_settings_get_host(settings),
+					    mpd_settings_get_port(settings),
+					    mpd_settings_get_password(settings));
+	if (item != NULL &&
+	    memcmp(item->version, version, sizeof(item->version)) == 0)
+		capabilities = mpd_server_capabilities_ref(item->capabilities);
+
+	mpd_spin_unlock(&mpd_capabilities_cache_lock);
+	return capabilities;
+}
+
+/**
+ * Adds the capabilities to the cache, replacing the old snapshot of
+ * this server (e.g. of an older server version).  Errors are
+ * ignored; the capabilities are just not cached then.
+ */
+static void
+mpd_capabilities_cache_store(const struct mpd_settings *settings,
+			     const unsigned *version,
+			     struct mpd_server_capabilities *capabilities)
+{
+	const char *host = mpd_settings_get_host(settings);
+	const unsigned port = mpd_settings_get_port(settings);
+	const char *password = mpd_settings_get_password(settings);
+
+	char *host_copy = strdup(host);
+	char *password_copy = password != NULL ? strdup(password) : NULL;
+	if (host_copy == NULL || (password != NULL && password_copy == NULL)) {
+		free(host_copy);
+		free(password_copy);
+		return;
+	}
+
+	mpd_spin_lock(&mpd_capabilities_cache_lock);
+
+	struct mpd_capabilities_cache_item *item =
+		mpd_capabilities_cache_find(host, port, password);
+	if (item == NULL) {
+		for (unsigned i = 0; i < MPD_CAPABILITIES_CACHE_SIZE; ++i) {
+			if (mpd_capabilities_cache[i].host == NULL) {
+				item = &mpd_capabilities_cache[i];
+				break;
+			}
+		}
+	}
+
+	if (item == NULL) {
+		item = &mpd_capabilities_cache[mpd_capabilities_cache_victim];
+		mpd_capabilities_cache_victim =
+			(mpd_capabilities_cache_victim + 1) %
+			MPD_CAPABILITIES_CACHE_SIZE;
+	}
+
+	/* swap with the old contents, which are freed after the lock
+	   has been released */
+	struct mpd_capabilities_cache_item old = *item;
+
+	item->host = host_copy;
+	item->port = port;
+	item->password = password_copy;
+	memcpy(item->version, version, sizeof(item->version));
+	item->capabilities = mpd_server_capabilities_ref(capabilities);
+
+	mpd_spin_unlock(&mpd_capabilities_cache_lock);
+
+	if (old.host != NULL) {
+		free(old.host);
+		free(old.password);
+		mpd_server_capabilities_unref(old.capabilities);
+	}
+}
+
+struct mpd_server_capabilities *
+mpd_server_capabilities_get(struct mpd_connection *connection)
+{
+	assert(connection != NULL);
+
+	if (mpd_error_is_defined(&connection->error))
+		return NULL;
+
+	const struct mpd_settings *settings =
+		mpd_connection_get_settings(connection);
+	const unsigned *version =
+		mpd_connection_get_server_version(connection);
+
+	/* after mpd_run_password(), the permissions are not the ones
+	   of the settings' password, so the cache is not used */
+	if (connection->password_sent)
+		settings = NULL;
+
+	/* before MPD 0.24, there is no "tagtypes available", and the
+	   snapshot contains only the tag types enabled on this
+	   connection; that is only the server's set if all are
+	   enabled */
+	if (mpd_connection_cmp_server_version(connection, 0, 24, 0) < 0 &&
+	    (connection->tag_types != MPD_TAG_MASK_ALL ||
+	     connection->tag_types_dirty))
+		settings = NULL;
+
+	if (settings != NULL) {
+		struct mpd_server_capabilities *capabilities =
+			mpd_capabilities_cache_lookup(settings, version);
+		if (capabilities != NULL)
+			return capabilities;
+	}
+
+	struct mpd_server_capabilities *capabilities =
+		mpd_server_capabilities_query(connection);
+	if (capabilities != NULL && settings != NULL)
+		mpd_capabilities_cache_store(settings, version, capabilities);
+
+	return capabilities;
+}
+
+void
+mpd_server_capabilities_flush(void)
+{
+	struct mpd_capabilities_cache_item items[MPD_CAPABILITIES_CACHE_SIZE];
+
+	mpd_spin_lock(&mpd_capabilities_cache_lock);
+	memcpy(items, mpd_capabilities_cache, sizeof(items));
+	memset(mpd_capabilities_cache, 0, sizeof(mpd_capabilities_cache));
+	mpd_spin_unlock(&mpd_capabilities_cache_lock);
+
+	for (unsigned i = 0; i < MPD_CAPABILITIES_CACHE_SIZE; ++i) {
+		if (items[i].host == NULL)
+			continue;
+
+		free(items[i].host);
+		free(items[i].password);
+		mpd_server_capabilities_unref(items[i].capabilities);
+	}
+}
+
+const char *const *
+mpd_server_capabilities_get_commands(const struct mpd_server_capabilities *capabilities,
+				     unsigned *n_r)
+{
+	assert(capabilities != NULL);
+	assert(n_r != NULL);
+
+	*n_r = capabilities->commands.n;
+	return (const char *const *)capabilities->commands.items;
+}
+
+const char *const *
+mpd_server_capabilities_get_disallowed_commands(const struct mpd_server_capabilities *capabilities,
+						unsigned *n_r)
+{
+	assert(capabilities != NULL);
+	assert(n_r != NULL);
+
+	*n_r = capabilities->disallowed_commands.n;
+	return (const char *const *)capabilities->disallowed_commands.items;
+}
+
+const char *const *
+mpd_server_capabilities_get_url_schemes(const struct mpd_server_capabilities *capabilities,
+					unsigned *n_r)
+{
+	assert(capabilities != NULL);
+	assert(n_r != NULL);
+
+	*n_r = capabilities->url_schemes.n;
+	return (const char *const *)capabilities->url_schemes.items;
+}
+
+bool
+mpd_server_capabilities_has_command(const struct mpd_server_capabilities *capabilities,
+				    const char *command)
+{
+	assert(capabilities != NULL);
+	assert(command != NULL);
+
+	return mpd_string_list_contains(&capabilities->commands, command);
+}
+
+bool
+mpd_server_capabilities_has_url_scheme(const struct mpd_server_capabilities *capabilities,
+				       const char *scheme)
+{
+	assert(capabilities != NULL);
+	assert(scheme != NULL);
+
+	return mpd_string_list_contains(&capabilities->url_schemes, scheme);
+}
+
+bool
+mpd_server_capabilities_has_tag_type(const struct mpd_server_capabilities *capabilities,
+				     enum mpd_tag_type type)
+{
+	assert(capabilities != NULL);
+
+	return type >= 0 && type < MPD_TAG_COUNT &&
+		capabilities->tag_types[type];
+}
+
+bool
+mpd_server_capabilities_has_protocol_feature(const struct mpd_server_capabilities *capabilities,
+					     enum mpd_protocol_feature feature)
+{
+	assert(capabilities != NULL);
+
+	return feature >= 0 && feature < MPD_FEATURE_COUNT &&
+		capabilities->features[feature];
+}
+
+bool
+mpd_server_capabilities_has_stringnormalization(const struct mpd_server_capabilities *capabilities,
+						enum mpd_stringnormalization_option option)
+{
+	assert(capabilities != NULL);
+
+	return option >= 0 && option < MPD_STRINGNORMALIZATION_COUNT &&
+		capabilities->normalizations[option];
+}
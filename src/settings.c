@@ -39,6 +39,36 @@ struct mpd_settings {
 	 */
 	char *password;
 
+	/**
+	 * The tag types of the setup profile, or NULL if they are not
+	 * part of it.
+	 */
+	enum mpd_tag_type *tag_types;
+	unsigned n_tag_types;
+
+	/**
+	 * The protocol features of the setup profile, or NULL if they
+	 * are not part of it.
+	 */
+	enum mpd_protocol_feature *features;
+	unsigned n_features;
+
+	/**
+	 * The "binarylimit" of the setup profile; 0 if not set.
+	 */
+	unsigned binary_limit;
+
+	/**
+	 * Shall the setup profile request "status" and
+	 * "currentsong"?
+	 */
+	bool initial_state;
+
+	/**
+	 * Use TCP Fast Open?
+	 */
+	bool fast_open;
+
 	/**
 	 * A pointer to the next alternative set of settings to try, if any.
 	 * Null indicates there are no (more) alternatives to try.
@@ -168,6 +198,13 @@ mpd_settings_new(const char *host, unsigned port, unsigned timeout_ms,
 		return settings;
 
 	settings->next = NULL;
+	settings->tag_types = NULL;
+	settings->n_tag_types = 0;
+	settings->features = NULL;
+	settings->n_features = 0;
+	settings->binary_limit = 0;
+	settings->initial_state = false;
+	settings->fast_open = false;
 
 	if (host != NULL) {
 		settings->host = strdup(host);
@@ -241,6 +278,8 @@ mpd_settings_free(struct mpd_settings *settings)
 		mpd_settings_free(settings->next);
 	free(settings->host);
 	free(settings->password);
+	free(settings->tag_types);
+	free(settings->features);
 	free(settings);
 }
 
@@ -273,3 +312,143 @@ mpd_settings_get_next(const struct mpd_settings *settings)
 {
 	return settings->next;
 }
+
+/**
+ * Duplicates an array of #n elements of #size bytes each.  The copy
+ * is never NULL, not even if the array is empty.
+ *
+ * @return the copy, or NULL if out of memory
+ */
+static void *
+mpd_settings_dup_array(const void *src, unsigned n, size_t size)
+{
+	void *dest = malloc(n > 0 ? n * size : 1);
+	if (dest != NULL && n > 0)
+		memcpy(dest, src, n * size);
+	return dest;
+}
+
+bool
+mpd_settings_set_tag_types(struct mpd_settings *settings,
+			   const enum mpd_tag_type *types, unsigned n)
+{
+	assert(settings != NULL);
+	assert(types != NULL || n == 0);
+
+	for (; settings != NULL; settings = settings->next) {
+		enum mpd_tag_type *copy =
+			mpd_settings_dup_array(types, n, sizeof(*types));
+		if (copy == NULL)
+			return false;
+
+		free(settings->tag_types);
+		settings->tag_types = copy;
+		settings->n_tag_types = n;
+	}
+
+	return true;
+}
+
+const enum mpd_tag_type *
+mpd_settings_get_tag_types(const struct mpd_settings *settings, unsigned *n_r)
+{
+	assert(settings != NULL);
+	assert(n_r != NULL);
+
+	*n_r = settings->n_tag_types;
+	return settings->tag_types;
+}
+
+bool
+mpd_settings_set_protocol_features(struct mpd_settings *settings,
+				   const enum mpd_protocol_feature *features,
+				   unsigned n)
+{
+	assert(settings != NULL);
+	assert(features != NULL || n == 0);
+
+	for (; settings != NULL; settings = settings->next) {
+		enum mpd_protocol_feature *copy =
+			mpd_settings_dup_array(features, n,
+					       sizeof(*features));
+		if (copy == NULL)
+			return false;
+
+		free(settings->features);
+		settings->features = copy;
+		settings->n_features = n;
+	}
+
+	return true;
+}
+
+const enum mpd_protocol_feature *
+mpd_settings_get_protocol_features(const struct mpd_settings *settings,
+				   unsigned *n_r)
+{
+	assert(settings != NULL);
+	assert(n_r != NULL);
+
+	*n_r = settings->n_features;
+	return settings->features;
+}
+
+void
+mpd_settings_set_binary_limit(struct mpd_settings *settings, unsigned limit)
+{
+	assert(settings != NULL);
+
+	for (; settings != NULL; settings = settings->next)
+		settings->binary_limit = limit;
+}
+
+unsigned
+mpd_settings_get_binary_limit(const struct mpd_settings *settings)
+{
+	assert(settings != NULL);
+
+	return settings->binary_limit;
+}
+
+void
+mpd_settings_set_initial_state(struct mpd_settings *settings, bool enable)
+{
+	assert(settings != NULL);
+
+	for (; settings != NULL; settings = settings->next)
+		settings->initial_state = enable;
+}
+
+bool
+mpd_settings_get_initial_state(const struct mpd_settings *settings)
+{
+	assert(settings != NULL);
+
+	return settings->initial_state;
+}
+
+void
+mpd_settings_set_fast_open(struct mpd_settings *settings, bool enable)
+{
+	assert(settings != NULL);
+
+	for (; settings != NULL; settings = settings->next)
+		settings->fast_open = enable;
+}
+
+bool
+mpd_settings_get_fast_open(const struct mpd_settings *settings)
+{
+	assert(settings != NULL);
+
+	return settings->fast_open;
+}
+
+bool
+mpd_settings_has_profile(const struct mpd_settings *settings)
+{
+	assert(settings != NULL);
+
+	return settings->tag_types != NULL || settings->features != NULL ||
+		settings->binary_limit > 0 || settings->initial_state;
+}
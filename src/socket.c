@@ -4,9 +4,11 @@
 #include "socket.h"
 #include "fd_util.h"
 #include "resolver.h"
+#include "clock.h"
 #include "ierror.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <fcntl.h>
@@ -16,6 +18,7 @@
 #  include <ws2tcpip.h>
 #else
 #  include <netinet/in.h>
+#  include <netinet/tcp.h>
 #  include <arpa/inet.h>
 #  include <sys/select.h>
 #  include <sys/socket.h>
@@ -50,62 +53,101 @@ mpd_socket_global_init(struct mpd_error_info *error)
 
 #endif
 
+enum {
+	/**
+	 * The maximum number of concurrent connection attempts.
+	 */
+	MPD_SOCKET_MAX_ATTEMPTS = 8,
+};
+
+/**
+ * How long to wait for a connection attempt before starting the next
+ * one in parallel; this is the "Connection Attempt Delay" recommended
+ * by RFC 8305.
+ */
+static const uint64_t mpd_socket_attempt_delay_us = 250 * 1000;
+
 /**
- * Wait for the socket to become writable.
+ * Check the result of a non-blocking connect() after the socket has
+ * become writable.  Returns 0 on success, an errno value on error.
  */
 static int
-mpd_socket_wait_writable(int fd, struct timeval *tv)
+mpd_socket_connect_result(mpd_socket_t fd)
 {
-	fd_set fds;
-	int ret;
+	int s_err = 0;
+	socklen_t s_err_size = sizeof(s_err);
 
-	while (1) {
-		FD_ZERO(&fds);
-		FD_SET(fd, &fds);
+	if (getsockopt(fd, SOL_SOCKET, SO_ERROR,
+		       (char*)&s_err, &s_err_size) < 0)
+		return mpd_socket_errno();
 
-		ret = select(fd + 1, NULL, &fds, NULL, tv);
-		if (ret > 0)
-			return 0;
+	return s_err;
+}
 
-		if (ret == 0 || !mpd_socket_ignore_errno(mpd_socket_errno()))
-			return -1;
-	}
+/**
+ * Enables TCP Fast Open on a socket which is not yet connected.
+ * Errors are ignored; the socket is then connected without it.
+ */
+static void
+mpd_socket_enable_fast_open(mpd_socket_t fd, int family)
+{
+#ifdef TCP_FASTOPEN_CONNECT
+	if (family != AF_INET && family != AF_INET6)
+		return;
+
+	const int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &one, sizeof(one));
+#else
+	(void)fd;
+	(void)family;
+#endif
 }
 
 /**
- * Wait until the socket is connected and check its result.  Returns 1
- * on success, 0 on timeout, -errno on error.
+ * Creates a socket and starts connecting it.
+ *
+ * @param connected_r set to true if the socket is already connected
+ * @return the socket, or #MPD_INVALID_SOCKET on error
  */
-static int
-mpd_socket_wait_connected(mpd_socket_t fd, struct timeval *tv)
+static mpd_socket_t
+mpd_socket_start(const struct resolver_address *address, bool fast_open,
+		 bool *connected_r, struct mpd_error_info *error)
 {
-	int ret;
-	int s_err = 0;
-	socklen_t s_err_size = sizeof(s_err);
+	mpd_socket_t fd = socket_cloexec_nonblock(address->family,
+						  SOCK_STREAM,
+						  address->protocol);
+	if (fd == MPD_INVALID_SOCKET) {
+		mpd_error_clear(error);
+		mpd_error_errno(error);
+		return MPD_INVALID_SOCKET;
+	}
 
-	ret = mpd_socket_wait_writable(fd, tv);
-	if (ret < 0)
-		return 0;
+	if (fast_open)
+		mpd_socket_enable_fast_open(fd, address->family);
 
-	ret = getsockopt(fd, SOL_SOCKET, SO_ERROR,
-			 (char*)&s_err, &s_err_size);
-	if (ret < 0)
-		return -mpd_socket_errno();
+	if (connect(fd, address->addr, address->addrlen) == 0) {
+		*connected_r = true;
+		return fd;
+	}
 
-	if (s_err != 0)
-		return -s_err;
+	if (!mpd_socket_ignore_errno(mpd_socket_errno())) {
+		mpd_error_clear(error);
+		mpd_error_errno(error);
 
-	return 1;
+		mpd_socket_close(fd);
+		return MPD_INVALID_SOCKET;
+	}
+
+	*connected_r = false;
+	return fd;
 }
 
 mpd_socket_t
-mpd_socket_connect(const char *host, unsigned port, const struct timeval *tv0,
-		   struct mpd_error_info *error)
+mpd_socket_connect(const char *host, unsigned port, const struct timeval *tv,
+		   bool fast_open, struct mpd_error_info *error)
 {
-	struct timeval tv = *tv0;
 	struct resolver *resolver;
 	const struct resolver_address *address;
-	int ret;
 
 	resolver = resolver_new(host, port);
 	if (resolver == NULL) {
@@ -116,52 +158,130 @@ mpd_socket_connect(const char *host, unsigned port, const struct timeval *tv0,
 
 	assert(!mpd_error_is_defined(error));
 
-	while ((address = resolver_next(resolver)) != NULL) {
-		mpd_socket_t fd = socket_cloexec_nonblock(address->family,
-							  SOCK_STREAM,
-							  address->protocol);
-		if (fd == MPD_INVALID_SOCKET) {
+	const uint64_t deadline = mpd_clock_now() +
+		(uint64_t)tv->tv_sec * 1000000 + (uint64_t)tv->tv_usec;
+
+	/* with TCP Fast Open, connect() succeeds right away without
+	   having talked to the server, so the first address would
+	   always win; it is therefore only used if there is no other
+	   address to try */
+	if (resolver_remaining(resolver) > 1)
+		fast_open = false;
+
+	/* RFC 8305 "Happy Eyeballs": start one attempt after another,
+	   each one after the previous has failed or after
+	   mpd_socket_attempt_delay_us, and take the first one which
+	   succeeds */
+	mpd_socket_t pending[MPD_SOCKET_MAX_ATTEMPTS];
+	unsigned n_pending = 0;
+	uint64_t next_attempt = 0;
+	mpd_socket_t result = MPD_INVALID_SOCKET;
+
+	address = resolver_next(resolver);
+	while (address != NULL || n_pending > 0) {
+		const uint64_t now = mpd_clock_now();
+		if (now >= deadline) {
 			mpd_error_clear(error);
-			mpd_error_errno(error);
-			continue;
+			mpd_error_code(error, MPD_ERROR_TIMEOUT);
+			mpd_error_message(error, "Timeout while connecting");
+			break;
 		}
 
-		ret = connect(fd, address->addr, address->addrlen);
-		if (ret == 0) {
-			resolver_free(resolver);
-			mpd_error_clear(error);
-			return fd;
-		}
+		const bool can_start = address != NULL &&
+			n_pending < MPD_SOCKET_MAX_ATTEMPTS;
 
-		if (!mpd_socket_ignore_errno(mpd_socket_errno())) {
-			mpd_error_clear(error);
-			mpd_error_errno(error);
+		if (can_start && now >= next_attempt) {
+			bool connected;
+			mpd_socket_t fd = mpd_socket_start(address, fast_open,
+							   &connected, error);
+			address = resolver_next(resolver);
 
-			mpd_socket_close(fd);
+			if (fd == MPD_INVALID_SOCKET)
+				continue;
+
+			if (connected) {
+				result = fd;
+				break;
+			}
+
+			pending[n_pending++] = fd;
+			next_attempt = now + mpd_socket_attempt_delay_us;
 			continue;
 		}
 
-		ret = mpd_socket_wait_connected(fd, &tv);
-		if (ret > 0) {
-			resolver_free(resolver);
-			mpd_error_clear(error);
-			return fd;
+		const uint64_t wait_until = can_start && next_attempt < deadline
+			? next_attempt
+			: deadline;
+		struct timeval timeout = {
+			.tv_sec = (long)((wait_until - now) / 1000000),
+			.tv_usec = (long)((wait_until - now) % 1000000),
+		};
+
+		fd_set fds;
+		FD_ZERO(&fds);
+		mpd_socket_t max_fd = 0;
+		for (unsigned i = 0; i < n_pending; ++i) {
+			FD_SET(pending[i], &fds);
+			if (pending[i] > max_fd)
+				max_fd = pending[i];
 		}
 
-		if (ret == 0) {
+		const int ret = select((int)max_fd + 1, NULL, &fds, NULL,
+				       &timeout);
+		if (ret < 0) {
+			if (mpd_socket_ignore_errno(mpd_socket_errno()))
+				continue;
+
 			mpd_error_clear(error);
-			mpd_error_code(error, MPD_ERROR_TIMEOUT);
-			mpd_error_message(error, "Timeout while connecting");
-		} else if (ret < 0) {
+			mpd_error_errno(error);
+			break;
+		}
+
+		for (unsigned i = 0; i < n_pending;) {
+			const mpd_socket_t fd = pending[i];
+			if (!FD_ISSET(fd, &fds)) {
+				++i;
+				continue;
+			}
+
+			pending[i] = pending[--n_pending];
+
+			const int s_err = mpd_socket_connect_result(fd);
+			if (s_err == 0) {
+				result = fd;
+				break;
+			}
+
 			mpd_error_clear(error);
-			mpd_error_system_message(error, -ret);
+			mpd_error_system_message(error, s_err);
+			mpd_socket_close(fd);
+
+			/* a failed attempt starts the next one right
+			   away */
+			next_attempt = 0;
 		}
 
-		mpd_socket_close(fd);
+		if (result != MPD_INVALID_SOCKET)
+			break;
+	}
+
+	for (unsigned i = 0; i < n_pending; ++i)
+		mpd_socket_close(pending[i]);
+
+	if (result != MPD_INVALID_SOCKET) {
+		mpd_error_clear(error);
+	} else {
+		/* the cached addresses may be outdated */
+		resolver_invalidate(resolver);
+
+		if (!mpd_error_is_defined(error)) {
+			mpd_error_code(error, MPD_ERROR_RESOLVER);
+			mpd_error_message(error, "No address to connect to");
+		}
 	}
 
 	resolver_free(resolver);
-	return -1;
+	return result;
 }
 
 int
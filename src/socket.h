@@ -53,13 +53,22 @@ mpd_socket_ignore_errno(int e)
 }
 
 /**
- * Connects the socket to the specified host and port.
+ * Connects the socket to the specified host and port.  If the host
+ * name resolves to several addresses, the connection attempts are
+ * staggered and run in parallel (RFC 8305), and the first one which
+ * succeeds wins.
  *
+ * @param tv the timeout for the whole operation
+ * @param fast_open use TCP Fast Open if available; then connect()
+ * returns immediately, and the SYN is sent together with the first
+ * data.  This is ignored if the host name resolves to more than one
+ * address, because the staggered attempts need connect() to report
+ * which address is reachable.
  * @return the socket file descriptor, or -1 on failure
  */
 mpd_socket_t
 mpd_socket_connect(const char *host, unsigned port, const struct timeval *tv,
-		   struct mpd_error_info *error);
+		   bool fast_open, struct mpd_error_info *error);
 
 /**
  * Closes a socket descriptor.  This is a wrapper for close() or
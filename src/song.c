@@ -6,11 +6,13 @@
 #include <mpd/pair.h>
 #include <mpd/recv.h>
 #include "internal.h"
+#include "imetrics.h"
 #include "iso8601.h"
 #include "uri.h"
 #include "iaf.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -629,6 +631,8 @@ mpd_recv_song(struct mpd_connection *connection)
 		return NULL;
 	}
 
+	mpd_metrics_add(connection->metrics, MPD_METRIC_OBJECTS, 1);
+
 	while ((pair = mpd_recv_pair(connection)) != NULL &&
 	       mpd_song_feed(song, pair))
 		mpd_return_pair(connection, pair);
@@ -643,3 +647,383 @@ mpd_recv_song(struct mpd_connection *connection)
 
 	return song;
 }
+
+/**
+ * The first four bytes of a song batch: "MPDS" in host byte order.
+ * On a host with a different byte order, it reads "SDPM", and the
+ * batch is rejected.
+ */
+#define MPD_SONG_BATCH_MAGIC 0x5344504du
+
+/**
+ * Increment this whenever the layout of the structs below changes.
+ */
+#define MPD_SONG_BATCH_VERSION 1
+
+/**
+ * The header of a song batch.  It is followed by one 32 bit offset
+ * per song (relative to the beginning of the batch), padding to 8
+ * bytes, and then the song records.
+ */
+struct mpd_song_batch_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t n_songs;
+
+	/**
+	 * The total size of the batch in bytes.
+	 */
+	uint32_t size;
+};
+
+/**
+ * The fixed-size part of a serialized #mpd_song.  It is followed by
+ * #n_tags #mpd_song_record_tag structs and the null-terminated
+ * strings.  All string references are offsets relative to the
+ * beginning of the record.
+ */
+struct mpd_song_record {
+	/**
+	 * The size of this record including all strings, padded to
+	 * 8 bytes.
+	 */
+	uint32_t size;
+
+	uint32_t uri;
+
+	/**
+	 * 0 if the song has no "real" URI.
+	 */
+	uint32_t real_uri;
+
+	uint32_t n_tags;
+
+	uint32_t duration, duration_ms;
+	uint32_t start, start_ms;
+	uint32_t end, end_ms;
+	uint32_t pos, id, prio;
+
+	uint32_t sample_rate;
+	uint8_t bits, channels;
+	uint16_t reserved0;
+	uint32_t reserved1;
+
+	int64_t last_modified, added;
+};
+
+struct mpd_song_record_tag {
+	uint32_t type;
+	uint32_t value;
+};
+
+_Static_assert(sizeof(struct mpd_song_batch_header) == 16,
+	       "unexpected padding");
+_Static_assert(sizeof(struct mpd_song_record) == 80,
+	       "unexpected padding");
+
+static size_t
+mpd_song_align(size_t size)
+{
+	return (size + 7) & ~(size_t)7;
+}
+
+static size_t
+mpd_song_batch_index_size(unsigned n)
+{
+	return mpd_song_align(sizeof(struct mpd_song_batch_header) +
+			      (size_t)n * sizeof(uint32_t));
+}
+
+static size_t
+mpd_song_record_size(const struct mpd_song *song)
+{
+	size_t size = sizeof(struct mpd_song_record) + strlen(song->uri) + 1;
+
+	if (song->real_uri != NULL)
+		size += strlen(song->real_uri) + 1;
+
+	for (unsigned i = 0; i < MPD_TAG_COUNT; ++i) {
+		if (song->tags[i].value == NULL)
+			continue;
+
+		for (const struct mpd_tag_value *tag = &song->tags[i];
+		     tag != NULL; tag = tag->next)
+			size += sizeof(struct mpd_song_record_tag) +
+				strlen(tag->value) + 1;
+	}
+
+	return mpd_song_align(size);
+}
+
+static uint32_t
+mpd_song_record_append(char *record, size_t *position_r, const char *value)
+{
+	const size_t position = *position_r;
+	const size_t length = strlen(value) + 1;
+
+	memcpy(record + position, value, length);
+	*position_r = position + length;
+	return (uint32_t)position;
+}
+
+/**
+ * Writes one record into a zero-filled buffer which was sized with
+ * mpd_song_record_size().
+ */
+static void
+mpd_song_record_write(const struct mpd_song *song, char *dest)
+{
+	struct mpd_song_record *record = (struct mpd_song_record *)dest;
+	struct mpd_song_record_tag *tags =
+		(struct mpd_song_record_tag *)(record + 1);
+
+	unsigned n_tags = 0;
+	for (unsigned i = 0; i < MPD_TAG_COUNT; ++i) {
+		if (song->tags[i].value == NULL)
+			continue;
+
+		for (const struct mpd_tag_value *tag = &song->tags[i];
+		     tag != NULL; tag = tag->next)
+			++n_tags;
+	}
+
+	size_t position = sizeof(*record) + n_tags * sizeof(*tags);
+
+	record->uri = mpd_song_record_append(dest, &position, song->uri);
+	if (song->real_uri != NULL)
+		record->real_uri = mpd_song_record_append(dest, &position,
+							  song->real_uri);
+
+	n_tags = 0;
+	for (unsigned i = 0; i < MPD_TAG_COUNT; ++i) {
+		if (song->tags[i].value == NULL)
+			continue;
+
+		for (const struct mpd_tag_value *tag = &song->tags[i];
+		     tag != NULL; tag = tag->next) {
+			tags[n_tags].type = i;
+			tags[n_tags].value =
+				mpd_song_record_append(dest, &position,
+						       tag->value);
+			++n_tags;
+		}
+	}
+
+	record->size = (uint32_t)mpd_song_align(position);
+	record->n_tags = n_tags;
+	record->duration = song->duration;
+	record->duration_ms = song->duration_ms;
+	record->start = song->start;
+	record->start_ms = song->start_ms;
+	record->end = song->end;
+	record->end_ms = song->end_ms;
+	record->pos = song->pos;
+	record->id = song->id;
+	record->prio = song->prio;
+	record->sample_rate = song->audio_format.sample_rate;
+	record->bits = song->audio_format.bits;
+	record->channels = song->audio_format.channels;
+	record->last_modified = song->last_modified;
+	record->added = song->added;
+}
+
+size_t
+mpd_song_serialize_batch(const struct mpd_song *const *songs, unsigned n,
+			 void *buffer, size_t size)
+{
+	assert(songs != NULL || n == 0);
+
+	size_t total = mpd_song_batch_index_size(n);
+	for (unsigned i = 0; i < n; ++i) {
+		total += mpd_song_record_size(songs[i]);
+		if (total > UINT32_MAX)
+			return 0;
+	}
+
+	if (total > size)
+		return total;
+
+	assert(buffer != NULL);
+	assert(((uintptr_t)buffer & 7) == 0);
+
+	char *p = buffer;
+	memset(p, 0, total);
+
+	struct mpd_song_batch_header *header =
+		(struct mpd_song_batch_header *)p;
+	header->magic = MPD_SONG_BATCH_MAGIC;
+	header->version = MPD_SONG_BATCH_VERSION;
+	header->n_songs = n;
+	header->size = (uint32_t)total;
+
+	uint32_t *offsets = (uint32_t *)(header + 1);
+	size_t offset = mpd_song_batch_index_size(n);
+	for (unsigned i = 0; i < n; ++i) {
+		offsets[i] = (uint32_t)offset;
+		mpd_song_record_write(songs[i], p + offset);
+		offset += ((const struct mpd_song_record *)(p + offset))->size;
+	}
+
+	assert(offset == total);
+	return total;
+}
+
+/**
+ * Checks whether a string offset points to a null-terminated string
+ * within the given range of the record.
+ */
+static bool
+mpd_song_record_check_string(const char *record, size_t begin, size_t end,
+			     uint32_t offset)
+{
+	return offset >= begin && offset < end &&
+		memchr(record + offset, 0, end - offset) != NULL;
+}
+
+static bool
+mpd_song_record_check(const char *p, size_t available)
+{
+	const struct mpd_song_record *record =
+		(const struct mpd_song_record *)p;
+
+	if (available < sizeof(*record) ||
+	    record->size < sizeof(*record) || record->size > available ||
+	    (record->size & 7) != 0)
+		return false;
+
+	const size_t end = record->size;
+	if (record->n_tags > (end - sizeof(*record)) /
+	    sizeof(struct mpd_song_record_tag))
+		return false;
+
+	const struct mpd_song_record_tag *tags =
+		(const struct mpd_song_record_tag *)(record + 1);
+	const size_t strings = sizeof(*record) +
+		record->n_tags * sizeof(*tags);
+
+	if (!mpd_song_record_check_string(p, strings, end, record->uri) ||
+	    !mpd_verify_uri(p + record->uri))
+		return false;
+
+	if (record->real_uri != 0 &&
+	    !mpd_song_record_check_string(p, strings, end, record->real_uri))
+		return false;
+
+	for (unsigned i = 0; i < record->n_tags; ++i)
+		if (tags[i].type >= MPD_TAG_COUNT ||
+		    !mpd_song_record_check_string(p, strings, end,
+						  tags[i].value))
+			return false;
+
+	return true;
+}
+
+bool
+mpd_song_batch_check(const void *buffer, size_t size, unsigned *n_r)
+{
+	assert(buffer != NULL || size == 0);
+	assert(n_r != NULL);
+
+	const struct mpd_song_batch_header *header = buffer;
+	if (((uintptr_t)buffer & 7) != 0 || size < sizeof(*header) ||
+	    header->magic != MPD_SONG_BATCH_MAGIC ||
+	    header->version != MPD_SONG_BATCH_VERSION ||
+	    header->size < sizeof(*header) || header->size > size)
+		return false;
+
+	size = header->size;
+	if (header->n_songs > (size - sizeof(*header)) / sizeof(uint32_t))
+		return false;
+
+	const size_t index_size = mpd_song_batch_index_size(header->n_songs);
+	if (index_size > size)
+		return false;
+
+	const char *p = buffer;
+	const uint32_t *offsets = (const uint32_t *)(header + 1);
+	for (unsigned i = 0; i < header->n_songs; ++i)
+		if (offsets[i] < index_size || offsets[i] > size ||
+		    (offsets[i] & 7) != 0 ||
+		    !mpd_song_record_check(p + offsets[i], size - offsets[i]))
+			return false;
+
+	*n_r = header->n_songs;
+	return true;
+}
+
+struct mpd_song *
+mpd_song_batch_get(const void *buffer, unsigned i)
+{
+	assert(buffer != NULL);
+
+	const struct mpd_song_batch_header *header = buffer;
+	assert(header->magic == MPD_SONG_BATCH_MAGIC);
+	assert(i < header->n_songs);
+
+	const uint32_t *offsets = (const uint32_t *)(header + 1);
+	const char *p = (const char *)buffer + offsets[i];
+	const struct mpd_song_record *record =
+		(const struct mpd_song_record *)p;
+	const struct mpd_song_record_tag *tags =
+		(const struct mpd_song_record_tag *)(record + 1);
+
+	struct mpd_song *song = mpd_song_new(p + record->uri);
+	if (song == NULL)
+		return NULL;
+
+	for (unsigned j = 0; j < record->n_tags; ++j) {
+		if (!mpd_song_add_tag(song, (enum mpd_tag_type)tags[j].type,
+				      p + tags[j].value)) {
+			mpd_song_free(song);
+			return NULL;
+		}
+	}
+
+	if (record->real_uri != 0) {
+		song->real_uri = strdup(p + record->real_uri);
+		if (song->real_uri == NULL) {
+			mpd_song_free(song);
+			return NULL;
+		}
+	}
+
+	song->duration = record->duration;
+	song->duration_ms = record->duration_ms;
+	song->start = record->start;
+	song->start_ms = record->start_ms;
+	song->end = record->end;
+	song->end_ms = record->end_ms;
+	song->last_modified = (time_t)record->last_modified;
+	song->added = (time_t)record->added;
+	song->pos = record->pos;
+	song->id = record->id;
+	song->prio = record->prio;
+	song->audio_format.sample_rate = record->sample_rate;
+	song->audio_format.bits = record->bits;
+	song->audio_format.channels = record->channels;
+
+#ifndef NDEBUG
+	song->finished = true;
+#endif
+
+	return song;
+}
+
+size_t
+mpd_song_serialize(const struct mpd_song *song, void *buffer, size_t size)
+{
+	assert(song != NULL);
+
+	return mpd_song_serialize_batch(&song, 1, buffer, size);
+}
+
+struct mpd_song *
+mpd_song_deserialize(const void *buffer, size_t size)
+{
+	unsigned n;
+	if (!mpd_song_batch_check(buffer, size, &n) || n != 1)
+		return NULL;
+
+	return mpd_song_batch_get(buffer, 0);
+}
@@ -0,0 +1,838 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "config.h"
+#include <mpd/song_sort.h>
+#include <mpd/song.h>
+#include "collate.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+enum {
+	/**
+	 * Arrays smaller than this are not worth a thread.
+	 */
+	SONG_SORT_MIN_PER_THREAD = 16384,
+
+	/**
+	 * The length of the runs which are sorted with insertion sort
+	 * before merging.
+	 */
+	SONG_SORT_RUN = 16,
+
+	/**
+	 * The initial size of the hash table of distinct values.
+	 */
+	SONG_SORT_DICT_INITIAL_SLOTS = 256,
+};
+
+/**
+ * The distinct values of one sort key.  Only these are converted to
+ * collation keys and sorted; the songs are then sorted by the rank
+ * of their value.
+ */
+struct song_sort_dict {
+	/**
+	 * The distinct values, indexed by their id; they point into
+	 * the songs.
+	 */
+	const char **values;
+	unsigned n_values, capacity;
+
+	/**
+	 * The sum of their lengths including the null terminators.
+	 */
+	size_t size;
+
+	/**
+	 * An open-addressing hash table of ids plus one; 0 marks an
+	 * empty slot.  The number of slots is a power of two.
+	 */
+	uint32_t *slots;
+	size_t n_slots;
+
+	/**
+	 * Maps each id to the final rank of its value.
+	 */
+	uint32_t *ranks;
+};
+
+/**
+ * The state of one sort key.
+ */
+struct song_sort_column {
+	/**
+	 * The distinct values of all songs (unused for numeric
+	 * keys).
+	 */
+	struct song_sort_dict dict;
+
+	/**
+	 * The largest rank (or number).
+	 */
+	uint32_t max;
+
+	/**
+	 * The number of bits needed for a rank.
+	 */
+	unsigned bits;
+};
+
+struct song_sort {
+	struct mpd_song *const *songs;
+
+	const struct mpd_song_sort_key *keys;
+	unsigned n_keys;
+
+	struct song_sort_column *columns;
+
+	/**
+	 * n_keys values per song: first numbers and value ids, then
+	 * final ranks.
+	 */
+	uint32_t *rows;
+
+	/**
+	 * The number of leading keys which are packed into
+	 * song_sort_item.key; the others are compared in #rows.
+	 */
+	unsigned n_packed;
+};
+
+/**
+ * The element being sorted.
+ */
+struct song_sort_item {
+	/**
+	 * The ranks of the first n_packed keys, the most significant
+	 * one in the highest bits.
+	 */
+	uint64_t key;
+
+	/**
+	 * The index of the song.
+	 */
+	uint32_t index;
+};
+
+struct song_sort_task {
+	void (*run)(struct song_sort_task *task);
+
+	struct song_sort *sort;
+
+	/**
+	 * The songs of this task's range; for lookups, the values of
+	 * these songs go into one dictionary per key.
+	 */
+	size_t begin, middle, end;
+	struct song_sort_dict *dicts;
+	bool oom;
+
+	/**
+	 * For sorting and merging.
+	 */
+	struct song_sort_item *src, *dest;
+};
+
+static enum mpd_tag_type
+song_sort_variant(enum mpd_tag_type type)
+{
+	switch (type) {
+	case MPD_TAG_ARTIST:
+		return MPD_TAG_ARTIST_SORT;
+
+	case MPD_TAG_ALBUM_ARTIST:
+		return MPD_TAG_ALBUM_ARTIST_SORT;
+
+	case MPD_TAG_ALBUM:
+		return MPD_TAG_ALBUM_SORT;
+
+	case MPD_TAG_COMPOSER:
+		return MPD_TAG_COMPOSER_SORT;
+
+	case MPD_TAG_TITLE:
+		return MPD_TAG_TITLE_SORT;
+
+	default:
+		return MPD_TAG_UNKNOWN;
+	}
+}
+
+static enum mpd_tag_type
+song_sort_fallback(enum mpd_tag_type type)
+{
+	switch (type) {
+	case MPD_TAG_ALBUM_ARTIST:
+	case MPD_TAG_ARTIST_SORT:
+		return MPD_TAG_ARTIST;
+
+	case MPD_TAG_ALBUM_ARTIST_SORT:
+		return MPD_TAG_ALBUM_ARTIST;
+
+	case MPD_TAG_ALBUM_SORT:
+		return MPD_TAG_ALBUM;
+
+	case MPD_TAG_COMPOSER_SORT:
+		return MPD_TAG_COMPOSER;
+
+	case MPD_TAG_TITLE_SORT:
+		return MPD_TAG_TITLE;
+
+	default:
+		return MPD_TAG_UNKNOWN;
+	}
+}
+
+static bool
+song_sort_is_numeric(enum mpd_tag_type type)
+{
+	return type == MPD_TAG_TRACK || type == MPD_TAG_DISC;
+}
+
+/**
+ * Returns the value to sort by: the "*Sort" variant, the tag itself
+ * or its fallback.
+ */
+static const char *
+song_sort_get_value(const struct mpd_song *song, enum mpd_tag_type type)
+{
+	if (type == MPD_TAG_UNKNOWN)
+		return mpd_song_get_uri(song);
+
+	do {
+		const enum mpd_tag_type variant = song_sort_variant(type);
+		const char *value;
+		if ((variant != MPD_TAG_UNKNOWN &&
+		     (value = mpd_song_get_tag(song, variant, 0)) != NULL) ||
+		    (value = mpd_song_get_tag(song, type, 0)) != NULL)
+			return value;
+
+		type = song_sort_fallback(type);
+	} while (type != MPD_TAG_UNKNOWN);
+
+	return "";
+}
+
+static bool
+song_sort_dict_init(struct song_sort_dict *d)
+{
+	d->values = NULL;
+	d->n_values = d->capacity = 0;
+	d->size = 0;
+	d->n_slots = SONG_SORT_DICT_INITIAL_SLOTS;
+	d->slots = calloc(d->n_slots, sizeof(*d->slots));
+	d->ranks = NULL;
+	return d->slots != NULL;
+}
+
+static void
+song_sort_dict_deinit(struct song_sort_dict *d)
+{
+	free(d->values);
+	free(d->slots);
+	free(d->ranks);
+}
+
+static bool
+song_sort_dict_grow(struct song_sort_dict *d)
+{
+	const size_t n_slots = d->n_slots * 2;
+	uint32_t *slots = calloc(n_slots, sizeof(*slots));
+	if (slots == NULL)
+		return false;
+
+	for (unsigned id = 0; id < d->n_values; ++id) {
+		const char *value = d->values[id];
+		size_t slot = mpd_hash_string(value, strlen(value)) &
+			(n_slots - 1);
+		while (slots[slot] != 0)
+			slot = (slot + 1) & (n_slots - 1);
+		slots[slot] = id + 1;
+	}
+
+	free(d->slots);
+	d->slots = slots;
+	d->n_slots = n_slots;
+	return true;
+}
+
+/**
+ * Looks up a value, adding it if it is new.
+ *
+ * @return the id of the value, or UINT32_MAX on out of memory
+ */
+static uint32_t
+song_sort_dict_add(struct song_sort_dict *d, const char *value)
+{
+	/* keep the load factor below 1/2 */
+	if (((size_t)d->n_values + 1) * 2 > d->n_slots &&
+	    !song_sort_dict_grow(d))
+		return UINT32_MAX;
+
+	const size_t length = strlen(value);
+	const size_t mask = d->n_slots - 1;
+	size_t slot = mpd_hash_string(value, length) & mask;
+	uint32_t id;
+	while ((id = d->slots[slot]) != 0) {
+		if (strcmp(d->values[id - 1], value) == 0)
+			return id - 1;
+
+		slot = (slot + 1) & mask;
+	}
+
+	if (d->n_values == d->capacity) {
+		const unsigned capacity = d->capacity > 0
+			? d->capacity * 2
+			: 64;
+		const char **values = realloc(d->values,
+					      capacity * sizeof(*values));
+		if (values == NULL)
+			return UINT32_MAX;
+
+		d->values = values;
+		d->capacity = capacity;
+	}
+
+	d->values[d->n_values] = value;
+	d->slots[slot] = d->n_values + 1;
+	d->size += length + 1;
+	return d->n_values++;
+}
+
+/**
+ * A distinct value with its collation key.
+ */
+struct song_sort_unique {
+	/**
+	 * The first 8 bytes of the collation key in big-endian order
+	 * (padded with zeroes), which decide most comparisons.
+	 */
+	uint64_t prefix;
+
+	const char *key;
+
+	uint32_t id;
+};
+
+static uint64_t
+song_sort_prefix(const char *key, size_t length)
+{
+	uint64_t prefix = 0;
+	for (size_t i = 0; i < 8; ++i)
+		prefix = (prefix << 8) |
+			(i < length ? (unsigned char)key[i] : 0);
+	return prefix;
+}
+
+static int
+song_sort_unique_compare(const void *_a, const void *_b)
+{
+	const struct song_sort_unique *a = _a, *b = _b;
+
+	if (a->prefix != b->prefix)
+		return a->prefix < b->prefix ? -1 : 1;
+
+	return strcmp(a->key, b->key);
+}
+
+/**
+ * Sorts the distinct values by their collation keys and fills
+ * #ranks; values with equal collation keys get the same rank.
+ *
+ * @param max_r receives the largest rank
+ * @return false on out of memory
+ */
+static bool
+song_sort_dict_rank(struct song_sort_dict *d, uint32_t *max_r)
+{
+	assert(d->n_values > 0);
+
+	char *buffer = malloc(d->size);
+	struct song_sort_unique *uniques =
+		malloc(d->n_values * sizeof(*uniques));
+	d->ranks = malloc(d->n_values * sizeof(*d->ranks));
+	if (buffer == NULL || uniques == NULL || d->ranks == NULL) {
+		free(buffer);
+		free(uniques);
+		return false;
+	}
+
+	char *p = buffer;
+	for (unsigned id = 0; id < d->n_values; ++id) {
+		const size_t length = mpd_collate_key(p, d->values[id]);
+		uniques[id].prefix = song_sort_prefix(p, length);
+		uniques[id].key = p;
+		uniques[id].id = id;
+		p += length + 1;
+	}
+
+	qsort(uniques, d->n_values, sizeof(*uniques),
+	      song_sort_unique_compare);
+
+	uint32_t rank = 0;
+	for (unsigned i = 0; i < d->n_values; ++i) {
+		if (i > 0 &&
+		    song_sort_unique_compare(&uniques[i - 1],
+					     &uniques[i]) != 0)
+			++rank;
+		d->ranks[uniques[i].id] = rank;
+	}
+
+	*max_r = rank;
+	free(buffer);
+	free(uniques);
+	return true;
+}
+
+/**
+ * Collects the values of the songs in the task's range; numbers are
+ * stored in the rows directly, strings as the id of the distinct
+ * value in the task's dictionary.
+ */
+static void
+song_sort_task_lookup(struct song_sort_task *task)
+{
+	const struct song_sort *sort = task->sort;
+
+	for (size_t i = task->begin; i < task->end; ++i) {
+		uint32_t *row = sort->rows + i * sort->n_keys;
+		for (unsigned k = 0; k < sort->n_keys; ++k) {
+			const enum mpd_tag_type tag = sort->keys[k].tag;
+			const char *value =
+				song_sort_get_value(sort->songs[i], tag);
+
+			if (song_sort_is_numeric(tag))
+				row[k] = mpd_collate_number(value);
+			else if ((row[k] = song_sort_dict_add(&task->dicts[k],
+							      value)) ==
+				 UINT32_MAX) {
+				task->oom = true;
+				return;
+			}
+		}
+	}
+}
+
+/**
+ * Replaces the value ids with final ranks and fills the items of the
+ * task's range.
+ */
+static void
+song_sort_task_pack(struct song_sort_task *task)
+{
+	const struct song_sort *sort = task->sort;
+
+	for (size_t i = task->begin; i < task->end; ++i) {
+		uint32_t *row = sort->rows + i * sort->n_keys;
+		uint64_t key = 0;
+
+		for (unsigned k = 0; k < sort->n_keys; ++k) {
+			const struct song_sort_column *column =
+				&sort->columns[k];
+			uint32_t value = song_sort_is_numeric(sort->keys[k].tag)
+				? row[k]
+				: task->dicts[k].ranks[row[k]];
+			if (sort->keys[k].descending)
+				value = column->max - value;
+
+			row[k] = value;
+			if (k < sort->n_packed)
+				key = (key << column->bits) | value;
+		}
+
+		task->src[i].key = key;
+		task->src[i].index = (uint32_t)i;
+	}
+}
+
+static int
+song_sort_compare(const struct song_sort *sort,
+		  const struct song_sort_item *a,
+		  const struct song_sort_item *b)
+{
+	if (a->key != b->key)
+		return a->key < b->key ? -1 : 1;
+
+	/* the keys which did not fit into the packed key */
+	const uint32_t *ra = sort->rows + (size_t)a->index * sort->n_keys;
+	const uint32_t *rb = sort->rows + (size_t)b->index * sort->n_keys;
+	for (unsigned k = sort->n_packed; k < sort->n_keys; ++k)
+		if (ra[k] != rb[k])
+			return ra[k] < rb[k] ? -1 : 1;
+
+	return 0;
+}
+
+static void
+song_sort_insertion(const struct song_sort *sort,
+		    struct song_sort_item *a, size_t n)
+{
+	for (size_t i = 1; i < n; ++i) {
+		const struct song_sort_item x = a[i];
+		size_t j = i;
+		while (j > 0 && song_sort_compare(sort, &x, &a[j - 1]) < 0) {
+			a[j] = a[j - 1];
+			--j;
+		}
+
+		a[j] = x;
+	}
+}
+
+/**
+ * Merges two sorted arrays; on equal keys, the left one comes
+ * first.
+ */
+static void
+song_sort_merge(const struct song_sort *sort,
+		const struct song_sort_item *left, size_t n_left,
+		const struct song_sort_item *right, size_t n_right,
+		struct song_sort_item *dest)
+{
+	size_t i = 0, j = 0;
+	while (i < n_left && j < n_right) {
+		if (song_sort_compare(sort, &right[j], &left[i]) < 0)
+			*dest++ = right[j++];
+		else
+			*dest++ = left[i++];
+	}
+
+	memcpy(dest, left + i, (n_left - i) * sizeof(*dest));
+	dest += n_left - i;
+	memcpy(dest, right + j, (n_right - j) * sizeof(*dest));
+}
+
+/**
+ * Bottom-up merge sort; the result is in #a, #tmp is scratch space
+ * of the same size.
+ */
+static void
+song_sort_range(const struct song_sort *sort,
+		struct song_sort_item *a, struct song_sort_item *tmp,
+		size_t n)
+{
+	for (size_t i = 0; i < n; i += SONG_SORT_RUN) {
+		const size_t length = n - i < SONG_SORT_RUN
+			? n - i
+			: SONG_SORT_RUN;
+		song_sort_insertion(sort, a + i, length);
+	}
+
+	struct song_sort_item *src = a, *dest = tmp;
+	for (size_t width = SONG_SORT_RUN; width < n; width *= 2) {
+		for (size_t i = 0; i < n; i += 2 * width) {
+			const size_t middle = i + width < n ? i + width : n;
+			const size_t end = middle + width < n
+				? middle + width
+				: n;
+			song_sort_merge(sort, src + i, middle - i,
+					src + middle, end - middle, dest + i);
+		}
+
+		struct song_sort_item *swap = src;
+		src = dest;
+		dest = swap;
+	}
+
+	if (src != a)
+		memcpy(a, src, n * sizeof(*a));
+}
+
+static void
+song_sort_task_sort(struct song_sort_task *task)
+{
+	song_sort_range(task->sort, task->src + task->begin,
+			task->dest + task->begin, task->end - task->begin);
+}
+
+static void
+song_sort_task_merge(struct song_sort_task *task)
+{
+	song_sort_merge(task->sort,
+			task->src + task->begin, task->middle - task->begin,
+			task->src + task->middle, task->end - task->middle,
+			task->dest + task->begin);
+}
+
+#ifdef HAVE_PTHREAD
+
+static void *
+song_sort_thread(void *ctx)
+{
+	struct song_sort_task *task = ctx;
+	task->run(task);
+	return NULL;
+}
+
+#endif
+
+/**
+ * Runs the tasks, one per thread; the calling thread runs the first
+ * one and all whose thread could not be started.
+ */
+static void
+song_sort_run_tasks(struct song_sort_task *tasks, unsigned n_tasks)
+{
+#ifdef HAVE_PTHREAD
+	pthread_t *threads = n_tasks > 1
+		? malloc((n_tasks - 1) * sizeof(*threads))
+		: NULL;
+	unsigned n_started = 0;
+	if (threads != NULL)
+		while (n_started < n_tasks - 1 &&
+		       pthread_create(&threads[n_started], NULL,
+				      song_sort_thread,
+				      &tasks[n_started + 1]) == 0)
+			++n_started;
+#else
+	const unsigned n_started = 0;
+#endif
+
+	tasks[0].run(&tasks[0]);
+	for (unsigned i = n_started + 1; i < n_tasks; ++i)
+		tasks[i].run(&tasks[i]);
+
+#ifdef HAVE_PTHREAD
+	for (unsigned i = 0; i < n_started; ++i)
+		pthread_join(threads[i], NULL);
+	free(threads);
+#endif
+}
+
+/**
+ * Merges the per-task dictionaries of one key into the column's
+ * dictionary, ranks the distinct values and maps each task's ids to
+ * the ranks.
+ *
+ * @return false on out of memory
+ */
+static bool
+song_sort_rank_column(struct song_sort *sort, unsigned k,
+		      struct song_sort_task *tasks, unsigned n_tasks)
+{
+	struct song_sort_column *column = &sort->columns[k];
+
+	if (song_sort_is_numeric(sort->keys[k].tag)) {
+		column->max = 0;
+		for (size_t i = 0; i < tasks[n_tasks - 1].end; ++i) {
+			const uint32_t value = sort->rows[i * sort->n_keys + k];
+			if (value > column->max)
+				column->max = value;
+		}
+
+		return true;
+	}
+
+	struct song_sort_dict *dict = &column->dict;
+	if (!song_sort_dict_init(dict))
+		return false;
+
+	for (unsigned t = 0; t < n_tasks; ++t) {
+		struct song_sort_dict *local = &tasks[t].dicts[k];
+		local->ranks = malloc(local->n_values * sizeof(*local->ranks));
+		if (local->ranks == NULL)
+			return false;
+
+		for (unsigned id = 0; id < local->n_values; ++id) {
+			local->ranks[id] =
+				song_sort_dict_add(dict, local->values[id]);
+			if (local->ranks[id] == UINT32_MAX)
+				return false;
+		}
+	}
+
+	if (!song_sort_dict_rank(dict, &column->max))
+		return false;
+
+	for (unsigned t = 0; t < n_tasks; ++t) {
+		struct song_sort_dict *local = &tasks[t].dicts[k];
+		for (unsigned id = 0; id < local->n_values; ++id)
+			local->ranks[id] = dict->ranks[local->ranks[id]];
+	}
+
+	return true;
+}
+
+/**
+ * Sorts the items, splitting the work into #n_tasks ranges which are
+ * sorted in parallel and then merged pairwise.
+ *
+ * @param bounds an array of #n_tasks + 1 range boundaries
+ * @return the buffer containing the result (#items or #tmp)
+ */
+static struct song_sort_item *
+song_sort_items(struct song_sort_item *items, struct song_sort_item *tmp,
+		struct song_sort_task *tasks, unsigned n_tasks,
+		size_t *bounds)
+{
+	for (unsigned i = 0; i < n_tasks; ++i) {
+		tasks[i].run = song_sort_task_sort;
+		tasks[i].src = items;
+		tasks[i].dest = tmp;
+		bounds[i] = tasks[i].begin;
+	}
+
+	bounds[n_tasks] = tasks[n_tasks - 1].end;
+	song_sort_run_tasks(tasks, n_tasks);
+
+	struct song_sort_item *src = items, *dest = tmp;
+	for (unsigned n_ranges = n_tasks; n_ranges > 1;) {
+		unsigned n_merges = 0;
+		for (unsigned r = 0; r < n_ranges; r += 2) {
+			/* an odd range at the end is merged with an
+			   empty one, i.e. copied */
+			struct song_sort_task *task = &tasks[n_merges++];
+			task->run = song_sort_task_merge;
+			task->src = src;
+			task->dest = dest;
+			task->begin = bounds[r];
+			task->middle = bounds[r + 1];
+			task->end = r + 2 <= n_ranges
+				? bounds[r + 2]
+				: bounds[r + 1];
+		}
+
+		song_sort_run_tasks(tasks, n_merges);
+
+		for (unsigned i = 0; i < n_merges; ++i)
+			bounds[i + 1] = tasks[i].end;
+		n_ranges = n_merges;
+
+		struct song_sort_item *swap = src;
+		src = dest;
+		dest = swap;
+	}
+
+	return src;
+}
+
+bool
+mpd_song_sort(struct mpd_song **songs, unsigned n,
+	      const struct mpd_song_sort_key *keys, unsigned n_keys,
+	      unsigned n_threads)
+{
+	assert(songs != NULL || n == 0);
+	assert(keys != NULL || n_keys == 0);
+
+	if (n < 2 || n_keys == 0)
+		return true;
+
+#ifndef HAVE_PTHREAD
+	n_threads = 1;
+#endif
+	if (n_threads > n / SONG_SORT_MIN_PER_THREAD)
+		n_threads = n / SONG_SORT_MIN_PER_THREAD;
+	if (n_threads < 1)
+		n_threads = 1;
+
+	struct song_sort sort = {
+		.songs = songs,
+		.keys = keys,
+		.n_keys = n_keys,
+		.columns = calloc(n_keys, sizeof(*sort.columns)),
+		.rows = malloc((size_t)n * n_keys * sizeof(*sort.rows)),
+	};
+
+	struct song_sort_task *tasks = calloc(n_threads, sizeof(*tasks));
+	struct song_sort_dict *dicts =
+		calloc((size_t)n_threads * n_keys, sizeof(*dicts));
+	size_t *bounds = malloc((n_threads + 1) * sizeof(*bounds));
+	struct song_sort_item *items = malloc(n * sizeof(*items));
+	struct song_sort_item *tmp = malloc(n * sizeof(*tmp));
+	struct mpd_song **sorted = malloc(n * sizeof(*sorted));
+
+	bool success = sort.columns != NULL && sort.rows != NULL &&
+		tasks != NULL && dicts != NULL && bounds != NULL &&
+		items != NULL && tmp != NULL && sorted != NULL;
+
+	for (unsigned t = 0; success && t < n_threads; ++t) {
+		struct song_sort_task *task = &tasks[t];
+		task->run = song_sort_task_lookup;
+		task->sort = &sort;
+		task->begin = (size_t)n * t / n_threads;
+		task->end = (size_t)n * (t + 1) / n_threads;
+		task->dicts = dicts + (size_t)t * n_keys;
+		task->oom = false;
+
+		for (unsigned k = 0; k < n_keys; ++k)
+			if (!song_sort_is_numeric(keys[k].tag) &&
+			    !song_sort_dict_init(&task->dicts[k]))
+				success = false;
+	}
+
+	/* collect the values (the part which walks through all
+	   songs) in parallel */
+	if (success) {
+		song_sort_run_tasks(tasks, n_threads);
+
+		for (unsigned t = 0; t < n_threads; ++t)
+			if (tasks[t].oom)
+				success = false;
+	}
+
+	/* rank the distinct values of each key, and pack the
+	   leading keys into 64 bits */
+	unsigned bits = 0;
+	for (unsigned k = 0; success && k < n_keys; ++k) {
+		if (!song_sort_rank_column(&sort, k, tasks, n_threads)) {
+			success = false;
+			break;
+		}
+
+		struct song_sort_column *column = &sort.columns[k];
+		column->bits = 0;
+		while (column->bits < 32 && (column->max >> column->bits) != 0)
+			++column->bits;
+
+		if (sort.n_packed == k && bits + column->bits <= 64) {
+			bits += column->bits;
+			++sort.n_packed;
+		}
+	}
+
+	if (success) {
+		for (unsigned t = 0; t < n_threads; ++t) {
+			tasks[t].run = song_sort_task_pack;
+			tasks[t].src = items;
+		}
+
+		song_sort_run_tasks(tasks, n_threads);
+
+		const struct song_sort_item *result =
+			song_sort_items(items, tmp, tasks, n_threads, bounds);
+
+		for (unsigned i = 0; i < n; ++i)
+			sorted[i] = songs[result[i].index];
+		memcpy(songs, sorted, n * sizeof(*songs));
+	}
+
+	if (dicts != NULL) {
+		for (size_t i = 0; i < (size_t)n_threads * n_keys; ++i)
+			if (dicts[i].slots != NULL)
+				song_sort_dict_deinit(&dicts[i]);
+		free(dicts);
+	}
+
+	if (sort.columns != NULL) {
+		for (unsigned k = 0; k < n_keys; ++k)
+			if (sort.columns[k].dict.slots != NULL)
+				song_sort_dict_deinit(&sort.columns[k].dict);
+		free(sort.columns);
+	}
+
+	free(sort.rows);
+	free(tasks);
+	free(bounds);
+	free(items);
+	free(tmp);
+	free(sorted);
+	return success;
+}
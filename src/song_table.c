@@ -0,0 +1,453 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include <mpd/song_table.h>
+#include <mpd/recv.h>
+#include "isong_table.h"
+#include "internal.h"
+#include "string_heap.h"
+#include "iso8601.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The initial number of rows, heap bytes and intern slots.
+ */
+enum {
+	SONG_TABLE_INITIAL_ROWS = 256,
+	SONG_TABLE_INITIAL_HEAP = 16384,
+	SONG_TABLE_INITIAL_INTERN = 1024,
+};
+
+struct mpd_song_table {
+	/**
+	 * The number of rows, and the number of rows allocated in
+	 * each column.
+	 */
+	unsigned length, capacity;
+
+	/**
+	 * Maps each tag type to its index in #tags, or -1.
+	 */
+	signed char tag_column[MPD_TAG_COUNT];
+
+	/**
+	 * The number of tag columns.
+	 */
+	unsigned n_tags;
+
+	/**
+	 * The tag columns; n_tags arrays with #capacity elements.
+	 */
+	uint32_t **tags;
+
+	uint32_t *uris;
+	uint32_t *durations_ms;
+	int64_t *last_modified, *added;
+	uint32_t *positions, *ids, *priorities;
+
+	/**
+	 * The URIs and the interned tag values.
+	 */
+	struct mpd_string_heap strings;
+};
+
+struct mpd_song_table *
+mpd_song_table_new(const enum mpd_tag_type *tags, unsigned n)
+{
+	assert(tags != NULL || n == 0);
+
+	struct mpd_song_table *table = calloc(1, sizeof(*table));
+	if (table == NULL)
+		return NULL;
+
+	memset(table->tag_column, -1, sizeof(table->tag_column));
+	for (unsigned i = 0; i < n; ++i) {
+		if (tags[i] < 0 || tags[i] >= MPD_TAG_COUNT ||
+		    table->tag_column[tags[i]] >= 0)
+			continue;
+
+		table->tag_column[tags[i]] = (signed char)table->n_tags++;
+	}
+
+	if (table->n_tags > 0)
+		table->tags = calloc(table->n_tags, sizeof(*table->tags));
+	if (!mpd_string_heap_init(&table->strings, SONG_TABLE_INITIAL_HEAP,
+				  SONG_TABLE_INITIAL_INTERN) ||
+	    (table->n_tags > 0 && table->tags == NULL)) {
+		mpd_song_table_free(table);
+		return NULL;
+	}
+
+	return table;
+}
+
+void
+mpd_song_table_free(struct mpd_song_table *table)
+{
+	assert(table != NULL);
+
+	if (table->tags != NULL)
+		for (unsigned i = 0; i < table->n_tags; ++i)
+			free(table->tags[i]);
+	free(table->tags);
+
+	free(table->uris);
+	free(table->durations_ms);
+	free(table->last_modified);
+	free(table->added);
+	free(table->positions);
+	free(table->ids);
+	free(table->priorities);
+	mpd_string_heap_deinit(&table->strings);
+	free(table);
+}
+
+void
+mpd_song_table_clear(struct mpd_song_table *table)
+{
+	assert(table != NULL);
+
+	table->length = 0;
+	mpd_string_heap_clear(&table->strings);
+}
+
+static bool
+song_table_realloc(void **p, size_t n, size_t size)
+{
+	void *q = realloc(*p, n * size);
+	if (q == NULL)
+		return false;
+
+	*p = q;
+	return true;
+}
+
+/**
+ * Makes room for one more row.  On failure, the columns which were
+ * already grown stay valid; #capacity is only updated when all of
+ * them succeeded.
+ */
+static bool
+song_table_reserve_row(struct mpd_song_table *table)
+{
+	if (table->length < table->capacity)
+		return true;
+
+	const size_t n = table->capacity > 0
+		? (size_t)table->capacity * 2
+		: SONG_TABLE_INITIAL_ROWS;
+	if (n > UINT32_MAX)
+		return false;
+
+	for (unsigned i = 0; i < table->n_tags; ++i)
+		if (!song_table_realloc((void **)&table->tags[i], n,
+					sizeof(uint32_t)))
+			return false;
+
+	if (!song_table_realloc((void **)&table->uris, n, sizeof(uint32_t)) ||
+	    !song_table_realloc((void **)&table->durations_ms, n,
+				sizeof(uint32_t)) ||
+	    !song_table_realloc((void **)&table->last_modified, n,
+				sizeof(int64_t)) ||
+	    !song_table_realloc((void **)&table->added, n,
+				sizeof(int64_t)) ||
+	    !song_table_realloc((void **)&table->positions, n,
+				sizeof(uint32_t)) ||
+	    !song_table_realloc((void **)&table->ids, n, sizeof(uint32_t)) ||
+	    !song_table_realloc((void **)&table->priorities, n,
+				sizeof(uint32_t)))
+		return false;
+
+	table->capacity = (unsigned)n;
+	return true;
+}
+
+static bool
+song_table_begin_row(struct mpd_song_table_receiver *r,
+		     const char *uri, size_t uri_length)
+{
+	struct mpd_song_table *table = r->table;
+
+	if (!song_table_reserve_row(table))
+		return false;
+
+	const uint32_t offset =
+		mpd_string_heap_store(&table->strings, uri, uri_length);
+	if (offset == 0)
+		return false;
+
+	const unsigned row = table->length++;
+	for (unsigned i = 0; i < table->n_tags; ++i)
+		table->tags[i][row] = 0;
+
+	table->uris[row] = offset;
+	table->durations_ms[row] = 0;
+	table->last_modified[row] = 0;
+	table->added[row] = 0;
+	table->positions[row] = 0;
+	table->ids[row] = 0;
+	table->priorities[row] = 0;
+
+	r->in_song = true;
+	r->precise_duration = false;
+	return true;
+}
+
+bool
+mpd_song_table_receive_pair(mpd_unused const char *name,
+			    mpd_unused size_t name_length,
+			    const char *value, size_t value_length,
+			    int token, void *ctx)
+{
+	struct mpd_song_table_receiver *r = ctx;
+	struct mpd_song_table *table = r->table;
+
+	switch (token) {
+	case MPD_PAIR_TOKEN_FILE:
+		if (!song_table_begin_row(r, value, value_length)) {
+			r->oom = true;
+			return false;
+		}
+
+		return true;
+
+	case MPD_PAIR_TOKEN_DIRECTORY:
+	case MPD_PAIR_TOKEN_PLAYLIST:
+		r->in_song = false;
+		return true;
+	}
+
+	if (!r->in_song || value_length == 0)
+		return true;
+
+	const unsigned row = table->length - 1;
+
+	if (token >= 0 && token < MPD_TAG_COUNT) {
+		const int column = table->tag_column[token];
+		if (column < 0 || table->tags[column][row] != 0)
+			/* not requested, or not the first value */
+			return true;
+
+		const uint32_t offset =
+			mpd_string_heap_intern(&table->strings,
+					       value, value_length);
+		if (offset == 0) {
+			r->oom = true;
+			return false;
+		}
+
+		table->tags[column][row] = offset;
+		return true;
+	}
+
+	switch (token) {
+	case MPD_PAIR_TOKEN_TIME:
+		if (!r->precise_duration)
+			table->durations_ms[row] =
+				(uint32_t)strtoul(value, NULL, 10) * 1000;
+		break;
+
+	case MPD_PAIR_TOKEN_DURATION:
+		table->durations_ms[row] =
+			(uint32_t)(1000 * atof(value));
+		r->precise_duration = true;
+		break;
+
+	case MPD_PAIR_TOKEN_LAST_MODIFIED:
+		table->last_modified[row] = iso8601_datetime_parse(value);
+		break;
+
+	case MPD_PAIR_TOKEN_ADDED:
+		table->added[row] = iso8601_datetime_parse(value);
+		break;
+
+	case MPD_PAIR_TOKEN_POS:
+		table->positions[row] = strtoul(value, NULL, 10);
+		break;
+
+	case MPD_PAIR_TOKEN_ID:
+		table->ids[row] = strtoul(value, NULL, 10);
+		break;
+
+	case MPD_PAIR_TOKEN_PRIO:
+		table->priorities[row] = strtoul(value, NULL, 10);
+		break;
+	}
+
+	return true;
+}
+
+bool
+mpd_recv_song_table(struct mpd_connection *connection,
+		    struct mpd_song_table *table)
+{
+	assert(connection != NULL);
+	assert(table != NULL);
+
+	struct mpd_song_table_receiver r;
+	mpd_song_table_receiver_init(&r, table);
+
+	if (!mpd_recv_pairs(connection, mpd_song_table_receive_pair, &r))
+		return false;
+
+	if (r.oom) {
+		mpd_error_code(&connection->error, MPD_ERROR_OOM);
+		return false;
+	}
+
+	return true;
+}
+
+unsigned
+mpd_song_table_copy_tag_types(const struct mpd_song_table *table,
+			      enum mpd_tag_type *tags)
+{
+	/* in column order, so a table created from this list has
+	   the same layout */
+	for (unsigned i = 0; i < MPD_TAG_COUNT; ++i)
+		if (table->tag_column[i] >= 0)
+			tags[table->tag_column[i]] = (enum mpd_tag_type)i;
+
+	return table->n_tags;
+}
+
+struct mpd_song_table *
+mpd_song_table_new_like(const struct mpd_song_table *table)
+{
+	enum mpd_tag_type tags[MPD_TAG_COUNT];
+	const unsigned n = mpd_song_table_copy_tag_types(table, tags);
+
+	return mpd_song_table_new(tags, n);
+}
+
+bool
+mpd_song_table_append(struct mpd_song_table *dest,
+		      const struct mpd_song_table *src,
+		      unsigned begin, unsigned end)
+{
+	assert(memcmp(dest->tag_column, src->tag_column,
+		      sizeof(dest->tag_column)) == 0);
+	assert(begin <= end && end <= src->length);
+
+	/* neighbouring rows often share values (e.g. the album of
+	   the songs in a directory), so remember the last lookup in
+	   each column */
+	uint32_t last_src[MPD_TAG_COUNT], last_dest[MPD_TAG_COUNT];
+	for (unsigned i = 0; i < src->n_tags; ++i)
+		last_src[i] = last_dest[i] = 0;
+
+	for (unsigned row = begin; row < end; ++row) {
+		if (!song_table_reserve_row(dest))
+			return false;
+
+		const char *uri =
+			mpd_string_heap_get(&src->strings, src->uris[row]);
+		const uint32_t uri_offset =
+			mpd_string_heap_store(&dest->strings,
+					      uri, strlen(uri));
+		if (uri_offset == 0)
+			return false;
+
+		const unsigned d = dest->length;
+		for (unsigned i = 0; i < src->n_tags; ++i) {
+			const uint32_t offset = src->tags[i][row];
+			if (offset != last_src[i] && offset != 0) {
+				const char *value =
+					mpd_string_heap_get(&src->strings,
+							    offset);
+				last_dest[i] =
+					mpd_string_heap_intern(&dest->strings,
+							       value,
+							       strlen(value));
+				if (last_dest[i] == 0)
+					return false;
+
+				last_src[i] = offset;
+			}
+
+			dest->tags[i][d] = offset != 0 ? last_dest[i] : 0;
+		}
+
+		dest->uris[d] = uri_offset;
+		dest->durations_ms[d] = src->durations_ms[row];
+		dest->last_modified[d] = src->last_modified[row];
+		dest->added[d] = src->added[row];
+		dest->positions[d] = src->positions[row];
+		dest->ids[d] = src->ids[row];
+		dest->priorities[d] = src->priorities[row];
+		++dest->length;
+	}
+
+	return true;
+}
+
+unsigned
+mpd_song_table_get_length(const struct mpd_song_table *table)
+{
+	return table->length;
+}
+
+const char *
+mpd_song_table_get_heap(const struct mpd_song_table *table)
+{
+	return table->strings.data;
+}
+
+const uint32_t *
+mpd_song_table_get_uris(const struct mpd_song_table *table)
+{
+	return table->uris;
+}
+
+const uint32_t *
+mpd_song_table_get_tags(const struct mpd_song_table *table,
+			enum mpd_tag_type type)
+{
+	if (type < 0 || type >= MPD_TAG_COUNT)
+		return NULL;
+
+	const int column = table->tag_column[type];
+	if (column < 0)
+		return NULL;
+
+	return table->tags[column];
+}
+
+const uint32_t *
+mpd_song_table_get_durations_ms(const struct mpd_song_table *table)
+{
+	return table->durations_ms;
+}
+
+const int64_t *
+mpd_song_table_get_last_modified(const struct mpd_song_table *table)
+{
+	return table->last_modified;
+}
+
+const int64_t *
+mpd_song_table_get_added(const struct mpd_song_table *table)
+{
+	return table->added;
+}
+
+const uint32_t *
+mpd_song_table_get_positions(const struct mpd_song_table *table)
+{
+	return table->positions;
+}
+
+const uint32_t *
+mpd_song_table_get_ids(const struct mpd_song_table *table)
+{
+	return table->ids;
+}
+
+const uint32_t *
+mpd_song_table_get_priorities(const struct mpd_song_table *table)
+{
+	return table->priorities;
+}
@@ -0,0 +1,325 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "config.h"
+#include <mpd/song_table.h>
+#include <mpd/recv.h>
+#include "isong_table.h"
+#include "irecv.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+enum {
+	/**
+	 * Buffers are split into chunks of at least this size;
+	 * smaller ones are not worth a thread.
+	 */
+	SONG_TABLE_PARSE_MIN_CHUNK = 256 * 1024,
+
+	/**
+	 * The number of chunks per thread.  More chunks than threads
+	 * balance the load when chunks take different times to parse.
+	 */
+	SONG_TABLE_PARSE_CHUNKS_PER_THREAD = 4,
+
+	/**
+	 * The maximum length of a numeric or time stamp value.
+	 */
+	SONG_TABLE_PARSE_MAX_NUMBER = 64,
+};
+
+struct song_table_chunk {
+	const char *begin, *end;
+
+	/**
+	 * The table receiving the songs of this chunk.
+	 */
+	struct mpd_song_table *table;
+
+	/**
+	 * 0 or an errno value.
+	 */
+	int error;
+};
+
+/**
+ * Shared by all threads parsing one buffer.
+ */
+struct song_table_parse {
+	struct song_table_chunk *chunks;
+	unsigned n_chunks;
+
+	/**
+	 * The index of the next chunk to be parsed.
+	 */
+	atomic_uint next;
+};
+
+static bool
+song_table_is_record_start(const char *p, size_t length)
+{
+	return (length >= 6 && memcmp(p, "file: ", 6) == 0) ||
+		(length >= 11 && memcmp(p, "directory: ", 11) == 0) ||
+		(length >= 10 && memcmp(p, "playlist: ", 10) == 0);
+}
+
+/**
+ * Finds the first record which begins at or after #offset.
+ *
+ * @return the offset of the record, or #length if there is none
+ */
+static size_t
+song_table_find_record(const char *data, size_t length, size_t offset)
+{
+	if (offset == 0)
+		return 0;
+
+	/* memchr() is vectorized by the C library; only line starts
+	   are examined */
+	size_t position = offset - 1;
+	while (position < length) {
+		const char *newline = memchr(data + position, '\n',
+					     length - position);
+		if (newline == NULL)
+			break;
+
+		const size_t start = (size_t)(newline + 1 - data);
+		if (song_table_is_record_start(data + start, length - start))
+			return start;
+
+		position = start;
+	}
+
+	return length;
+}
+
+/**
+ * Is this a token whose value mpd_song_table_receive_pair() parses
+ * as a number or a time stamp?
+ */
+static bool
+song_table_parse_is_number(int token)
+{
+	switch (token) {
+	case MPD_PAIR_TOKEN_LAST_MODIFIED:
+	case MPD_PAIR_TOKEN_ADDED:
+	case MPD_PAIR_TOKEN_TIME:
+	case MPD_PAIR_TOKEN_DURATION:
+	case MPD_PAIR_TOKEN_POS:
+	case MPD_PAIR_TOKEN_ID:
+	case MPD_PAIR_TOKEN_PRIO:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/**
+ * Parses one chunk into its table.
+ *
+ * @return 0 or an errno value
+ */
+static int
+song_table_parse_chunk(const struct song_table_chunk *chunk)
+{
+	struct mpd_song_table_receiver r;
+	mpd_song_table_receiver_init(&r, chunk->table);
+
+	const char *p = chunk->begin, *const end = chunk->end;
+	while (p < end) {
+		const char *newline = memchr(p, '\n', (size_t)(end - p));
+		const char *eol = newline != NULL ? newline : end;
+		const size_t line_length = (size_t)(eol - p);
+		const char *line = p;
+		p = eol + 1;
+
+		if (line_length == 0)
+			continue;
+
+		if ((line_length == 2 && memcmp(line, "OK", 2) == 0) ||
+		    (line_length == 7 && memcmp(line, "list_OK", 7) == 0)) {
+			r.in_song = false;
+			continue;
+		}
+
+		if (line_length >= 3 && memcmp(line, "ACK", 3) == 0)
+			return EINVAL;
+
+		const char *colon = memchr(line, ':', line_length);
+		if (colon == NULL || colon + 1 == eol || colon[1] != ' ')
+			return EINVAL;
+
+		const size_t name_length = (size_t)(colon - line);
+		const char *value = colon + 2;
+		size_t value_length = (size_t)(eol - value);
+		const int token = mpd_pair_token_parse(line, name_length);
+
+		/* numbers and time stamps are parsed by functions
+		   which need a null terminator */
+		char buffer[SONG_TABLE_PARSE_MAX_NUMBER];
+		if (song_table_parse_is_number(token)) {
+			if (value_length >= sizeof(buffer))
+				value_length = sizeof(buffer) - 1;
+			memcpy(buffer, value, value_length);
+			buffer[value_length] = 0;
+			value = buffer;
+		}
+
+		if (!mpd_song_table_receive_pair(line, name_length,
+						 value, value_length,
+						 token, &r))
+			return ENOMEM;
+	}
+
+	return 0;
+}
+
+static void
+song_table_parse_run(struct song_table_parse *parse)
+{
+	unsigned i;
+	while ((i = atomic_fetch_add_explicit(&parse->next, 1,
+					      memory_order_relaxed)) <
+	       parse->n_chunks) {
+		struct song_table_chunk *chunk = &parse->chunks[i];
+		chunk->error = song_table_parse_chunk(chunk);
+	}
+}
+
+#ifdef HAVE_PTHREAD
+
+static void *
+song_table_parse_thread(void *ctx)
+{
+	song_table_parse_run(ctx);
+	return NULL;
+}
+
+#endif
+
+bool
+mpd_song_table_parse(struct mpd_song_table *table,
+		     const char *data, size_t length,
+		     unsigned n_threads)
+{
+	assert(table != NULL);
+	assert(data != NULL || length == 0);
+
+#ifndef HAVE_PTHREAD
+	n_threads = 1;
+#endif
+	if (n_threads < 1)
+		n_threads = 1;
+	if (n_threads > length / SONG_TABLE_PARSE_MIN_CHUNK)
+		n_threads = (unsigned)(length / SONG_TABLE_PARSE_MIN_CHUNK);
+
+	if (n_threads <= 1) {
+		const struct song_table_chunk chunk = {
+			.begin = data,
+			.end = data + length,
+			.table = table,
+		};
+
+		const int error = song_table_parse_chunk(&chunk);
+		if (error != 0) {
+			errno = error;
+			return false;
+		}
+
+		return true;
+	}
+
+	unsigned n_chunks = n_threads * SONG_TABLE_PARSE_CHUNKS_PER_THREAD;
+	if (n_chunks > length / SONG_TABLE_PARSE_MIN_CHUNK)
+		n_chunks = (unsigned)(length / SONG_TABLE_PARSE_MIN_CHUNK);
+
+	struct song_table_parse parse = {
+		.chunks = calloc(n_chunks, sizeof(*parse.chunks)),
+		.n_chunks = n_chunks,
+	};
+	atomic_init(&parse.next, 0);
+	if (parse.chunks == NULL) {
+		errno = ENOMEM;
+		return false;
+	}
+
+	/* split at record boundaries near equally spaced offsets;
+	   the first chunk is parsed directly into the destination
+	   table */
+	bool success = true;
+	size_t offset = 0;
+	for (unsigned i = 0; i < n_chunks; ++i) {
+		struct song_table_chunk *chunk = &parse.chunks[i];
+		const size_t next = i + 1 < n_chunks
+			? song_table_find_record(data, length,
+						 length / n_chunks * (i + 1))
+			: length;
+
+		chunk->begin = data + offset;
+		chunk->end = data + (next > offset ? next : offset);
+		offset = chunk->end - data;
+
+		chunk->table = i == 0
+			? table
+			: mpd_song_table_new_like(table);
+		if (chunk->table == NULL)
+			success = false;
+	}
+
+	if (success) {
+#ifdef HAVE_PTHREAD
+		pthread_t *threads =
+			malloc((n_threads - 1) * sizeof(*threads));
+		unsigned n_started = 0;
+		if (threads != NULL)
+			while (n_started < n_threads - 1 &&
+			       pthread_create(&threads[n_started], NULL,
+					      song_table_parse_thread,
+					      &parse) == 0)
+				++n_started;
+#endif
+
+		song_table_parse_run(&parse);
+
+#ifdef HAVE_PTHREAD
+		for (unsigned i = 0; i < n_started; ++i)
+			pthread_join(threads[i], NULL);
+		free(threads);
+#endif
+	} else
+		errno = ENOMEM;
+
+	/* stitch the chunks together in their original order */
+	for (unsigned i = 0; i < n_chunks; ++i) {
+		struct song_table_chunk *chunk = &parse.chunks[i];
+
+		if (success && chunk->error != 0) {
+			errno = chunk->error;
+			success = false;
+		}
+
+		if (i == 0 || chunk->table == NULL)
+			continue;
+
+		const unsigned n = mpd_song_table_get_length(chunk->table);
+		if (success &&
+		    !mpd_song_table_append(table, chunk->table, 0, n)) {
+			errno = ENOMEM;
+			success = false;
+		}
+
+		mpd_song_table_free(chunk->table);
+	}
+
+	free(parse.chunks);
+	return success;
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_SPINLOCK_H
+#define MPD_SPINLOCK_H
+
+#include <stdatomic.h>
+
+/*
+ * A minimal lock for process-wide caches.  It must only be held for a
+ * few memory operations, never while doing I/O.
+ */
+
+static inline void
+mpd_spin_lock(atomic_flag *lock)
+{
+	while (atomic_flag_test_and_set_explicit(lock, memory_order_acquire)) {
+	}
+}
+
+static inline void
+mpd_spin_unlock(atomic_flag *lock)
+{
+	atomic_flag_clear_explicit(lock, memory_order_release);
+}
+
+#endif
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "string_heap.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool
+mpd_string_heap_init(struct mpd_string_heap *heap,
+		     size_t capacity, size_t intern_capacity)
+{
+	assert(capacity > 0);
+	assert(intern_capacity > 0);
+	assert((intern_capacity & (intern_capacity - 1)) == 0);
+
+	heap->data = malloc(capacity);
+	heap->intern = calloc(intern_capacity, sizeof(*heap->intern));
+	if (heap->data == NULL || heap->intern == NULL) {
+		free(heap->data);
+		free(heap->intern);
+		heap->data = NULL;
+		heap->intern = NULL;
+		return false;
+	}
+
+	heap->data[0] = 0;
+	heap->length = 1;
+	heap->capacity = capacity;
+	heap->intern_length = 0;
+	heap->intern_capacity = intern_capacity;
+	return true;
+}
+
+void
+mpd_string_heap_deinit(struct mpd_string_heap *heap)
+{
+	free(heap->data);
+	free(heap->intern);
+}
+
+void
+mpd_string_heap_clear(struct mpd_string_heap *heap)
+{
+	assert(heap->intern != NULL);
+
+	heap->length = 1;
+	heap->intern_length = 0;
+	memset(heap->intern, 0,
+	       heap->intern_capacity * sizeof(*heap->intern));
+}
+
+void
+mpd_string_heap_compact(struct mpd_string_heap *heap)
+{
+	free(heap->intern);
+	heap->intern = NULL;
+	heap->intern_length = heap->intern_capacity = 0;
+
+	char *data = realloc(heap->data, heap->length);
+	if (data != NULL) {
+		heap->data = data;
+		heap->capacity = heap->length;
+	}
+}
+
+uint32_t
+mpd_string_heap_store(struct mpd_string_heap *heap,
+		      const char *value, size_t length)
+{
+	const size_t needed = heap->length + length + 1;
+	if (needed > UINT32_MAX)
+		return 0;
+
+	if (needed > heap->capacity) {
+		size_t capacity = heap->capacity * 2;
+		while (capacity < needed)
+			capacity *= 2;
+
+		char *data = realloc(heap->data, capacity);
+		if (data == NULL)
+			return 0;
+
+		heap->data = data;
+		heap->capacity = capacity;
+	}
+
+	const uint32_t offset = (uint32_t)heap->length;
+	memcpy(heap->data + offset, value, length);
+	heap->data[offset + length] = 0;
+	heap->length = needed;
+	return offset;
+}
+
+static bool
+string_heap_grow_intern(struct mpd_string_heap *heap)
+{
+	const size_t capacity = heap->intern_capacity * 2;
+	uint32_t *intern = calloc(capacity, sizeof(*intern));
+	if (intern == NULL)
+		return false;
+
+	for (size_t i = 0; i < heap->intern_capacity; ++i) {
+		const uint32_t offset = heap->intern[i];
+		if (offset == 0)
+			continue;
+
+		const char *s = heap->data + offset;
+		size_t slot = mpd_hash_string(s, strlen(s)) & (capacity - 1);
+		while (intern[slot] != 0)
+			slot = (slot + 1) & (capacity - 1);
+		intern[slot] = offset;
+	}
+
+	free(heap->intern);
+	heap->intern = intern;
+	heap->intern_capacity = capacity;
+	return true;
+}
+
+uint32_t
+mpd_string_heap_intern(struct mpd_string_heap *heap,
+		       const char *value, size_t length)
+{
+	assert(heap->intern != NULL);
+
+	/* keep the load factor below 1/2 */
+	if ((heap->intern_length + 1) * 2 > heap->intern_capacity &&
+	    !string_heap_grow_intern(heap))
+		return 0;
+
+	const size_t mask = heap->intern_capacity - 1;
+	size_t slot = mpd_hash_string(value, length) & mask;
+	uint32_t offset;
+	while ((offset = heap->intern[slot]) != 0) {
+		const char *s = heap->data + offset;
+		if (strncmp(s, value, length) == 0 && s[length] == 0)
+			return offset;
+
+		slot = (slot + 1) & mask;
+	}
+
+	offset = mpd_string_heap_store(heap, value, length);
+	if (offset == 0)
+		return 0;
+
+	heap->intern[slot] = offset;
+	++heap->intern_length;
+	return offset;
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_STRING_HEAP_H
+#define MPD_STRING_HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A growing buffer of null-terminated strings which are referred to
+ * by their 32 bit offset, with an optional hash set for interning
+ * (deduplicating) them.  This is the storage of the client-side
+ * tables such as #mpd_song_table and #mpd_tag_tree.
+ */
+struct mpd_string_heap {
+	/**
+	 * The strings.  It always begins with a null byte, so offset
+	 * 0 is the empty string.
+	 */
+	char *data;
+	size_t length, capacity;
+
+	/**
+	 * An open-addressing hash set of interned string offsets; 0
+	 * marks an empty slot.  The capacity is a power of two.
+	 */
+	uint32_t *intern;
+	size_t intern_length, intern_capacity;
+};
+
+/**
+ * @param capacity the initial number of bytes
+ * @param intern_capacity the initial number of hash set slots (a
+ * power of two)
+ * @return false on out of memory
+ */
+bool
+mpd_string_heap_init(struct mpd_string_heap *heap,
+		     size_t capacity, size_t intern_capacity);
+
+void
+mpd_string_heap_deinit(struct mpd_string_heap *heap);
+
+/**
+ * Removes all strings, but keeps the allocated memory.
+ */
+void
+mpd_string_heap_clear(struct mpd_string_heap *heap);
+
+/**
+ * Frees the hash set and the unused part of the buffer, once no
+ * more strings will be added.
+ */
+void
+mpd_string_heap_compact(struct mpd_string_heap *heap);
+
+static inline const char *
+mpd_string_heap_get(const struct mpd_string_heap *heap, uint32_t offset)
+{
+	return heap->data + offset;
+}
+
+/**
+ * Copies a string to the heap.
+ *
+ * @return the offset, or 0 on out of memory
+ */
+uint32_t
+mpd_string_heap_store(struct mpd_string_heap *heap,
+		      const char *value, size_t length);
+
+/**
+ * Returns the offset of an interned copy of the value, adding it to
+ * the heap if it is not there yet.
+ *
+ * @return the offset, or 0 on out of memory
+ */
+uint32_t
+mpd_string_heap_intern(struct mpd_string_heap *heap,
+		       const char *value, size_t length);
+
+#endif
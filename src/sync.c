@@ -3,6 +3,8 @@
 
 #include "sync.h"
 #include "iasync.h"
+#include "imetrics.h"
+#include "probe.h"
 #include "socket.h"
 
 #include <mpd/async.h>
@@ -42,7 +44,11 @@ mpd_sync_poll(struct mpd_async *async, struct timeval *tv)
 		if (events & (MPD_ASYNC_EVENT_HUP|MPD_ASYNC_EVENT_ERROR))
 			FD_SET(fd, &efds);
 
+		MPD_PROBE1(io_wait_begin, events);
 		ret = select(fd + 1, &rfds, &wfds, &efds, tv);
+		MPD_PROBE1(io_wait_end, ret);
+		mpd_metrics_add(mpd_async_get_metrics(async),
+				MPD_METRIC_SELECT_CALLS, 1);
 		if (ret > 0) {
 			if (!FD_ISSET(fd, &rfds))
 				events &= ~MPD_ASYNC_EVENT_READ;
@@ -108,6 +114,34 @@ mpd_sync_send_command_v(struct mpd_async *async, const struct timeval *tv0,
 	}
 }
 
+bool
+mpd_sync_send_args(struct mpd_async *async, const struct timeval *tv0,
+		   const char *command, const struct mpd_arg *args, unsigned n)
+{
+	struct timeval tv, *tvp;
+
+	if (tv0 != NULL) {
+		tv = *tv0;
+		tvp = &tv;
+	} else
+		tvp = NULL;
+
+	while (true) {
+		if (mpd_async_send_args(async, command, args, n))
+			return true;
+
+		/* see mpd_sync_send_command_v() */
+		if ((mpd_async_events(async) & MPD_ASYNC_EVENT_WRITE) == 0) {
+			mpd_async_set_error(async, MPD_ERROR_ARGUMENT,
+					    "Not enough buffer space for message");
+			return false;
+		}
+
+		if (!mpd_sync_io(async, tvp))
+			return false;
+	}
+}
+
 bool
 mpd_sync_send_command(struct mpd_async *async, const struct timeval *tv,
 		      const char *command, ...)
@@ -149,6 +183,14 @@ mpd_sync_flush(struct mpd_async *async, const struct timeval *tv0)
 
 char *
 mpd_sync_recv_line(struct mpd_async *async, const struct timeval *tv0)
+{
+	size_t length;
+	return mpd_sync_recv_line_n(async, tv0, &length);
+}
+
+char *
+mpd_sync_recv_line_n(struct mpd_async *async, const struct timeval *tv0,
+		     size_t *length_r)
 {
 	struct timeval tv, *tvp;
 	char *line;
@@ -160,7 +202,7 @@ mpd_sync_recv_line(struct mpd_async *async, const struct timeval *tv0)
 		tvp = NULL;
 
 	while (true) {
-		line = mpd_async_recv_line(async);
+		line = mpd_async_recv_line_n(async, length_r);
 		if (line != NULL)
 			return line;
 
@@ -19,6 +19,7 @@
 
 struct timeval;
 struct mpd_async;
+struct mpd_arg;
 
 /**
  * Synchronous wrapper for mpd_async_send_command_v().
@@ -35,6 +36,13 @@ bool
 mpd_sync_send_command(struct mpd_async *async, const struct timeval *tv,
 		      const char *command, ...);
 
+/**
+ * Synchronous wrapper for mpd_async_send_args().
+ */
+bool
+mpd_sync_send_args(struct mpd_async *async, const struct timeval *tv,
+		   const char *command, const struct mpd_arg *args, unsigned n);
+
 /**
  * Sends all pending data from the output buffer to MPD.
  */
@@ -47,6 +55,13 @@ mpd_sync_flush(struct mpd_async *async, const struct timeval *tv);
 char *
 mpd_sync_recv_line(struct mpd_async *async, const struct timeval *tv);
 
+/**
+ * Synchronous wrapper for mpd_async_recv_line_n().
+ */
+char *
+mpd_sync_recv_line_n(struct mpd_async *async, const struct timeval *tv,
+		     size_t *length_r);
+
 /**
  * Synchronous wrapper for mpd_async_recv_raw() which waits until at
  * least one byte was received (or an error has occurred).
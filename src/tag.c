@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include <mpd/tag.h>
+#include "itag.h"
 
 #include <assert.h>
 #include <string.h>
@@ -72,6 +73,27 @@ mpd_tag_name_parse(const char *name)
 	return MPD_TAG_UNKNOWN;
 }
 
+enum mpd_tag_type
+mpd_tag_name_parse_n(const char *name, size_t length)
+{
+	assert(name != NULL);
+
+	if (length == 0)
+		return MPD_TAG_UNKNOWN;
+
+	for (unsigned i = 0; i < MPD_TAG_COUNT; ++i) {
+		const char *t = mpd_tag_type_names[i];
+
+		/* the first character rules out almost all names
+		   before strncmp() is called */
+		if (t[0] == name[0] && strncmp(t, name, length) == 0 &&
+		    t[length] == 0)
+			return (enum mpd_tag_type)i;
+	}
+
+	return MPD_TAG_UNKNOWN;
+}
+
 /**
  * This implementation is limited to ASCII letters.  Cheap, and good
  * enough for us: all valid tag names are hard-coded above.
@@ -0,0 +1,515 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include <mpd/tag_tree.h>
+#include <mpd/recv.h>
+#include "internal.h"
+#include "string_heap.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The initial number of nodes per level, heap bytes and intern
+ * slots.
+ */
+enum {
+	TAG_TREE_INITIAL_NODES = 64,
+	TAG_TREE_INITIAL_HEAP = 4096,
+	TAG_TREE_INITIAL_INTERN = 256,
+};
+
+struct tag_tree_level {
+	enum mpd_tag_type type;
+
+	unsigned length, capacity;
+
+	/**
+	 * The value of each node (a heap offset).
+	 */
+	uint32_t *values;
+
+	/**
+	 * The index of each node's parent on the previous level (0 on
+	 * level 0).
+	 */
+	uint32_t *parents;
+
+	/**
+	 * length+1 elements: the children of node i are
+	 * [children[i], children[i+1]) on the next level.  All zero
+	 * on the last level.
+	 */
+	uint32_t *children;
+};
+
+struct mpd_tag_tree {
+	struct tag_tree_level levels[MPD_TAG_COUNT];
+	unsigned depth;
+
+	/**
+	 * Maps each tag type to its level, or -1.
+	 */
+	signed char level_of[MPD_TAG_COUNT];
+
+	/**
+	 * The array which #values, #parents and #children of all
+	 * levels point into; NULL while the tree is being received
+	 * (then each level has its own #values and #parents arrays).
+	 */
+	uint32_t *nodes;
+
+	/**
+	 * The interned values.  Its hash set is freed when the tree
+	 * is complete.
+	 */
+	struct mpd_string_heap strings;
+};
+
+static struct mpd_tag_tree *
+tag_tree_new(void)
+{
+	struct mpd_tag_tree *tree = calloc(1, sizeof(*tree));
+	if (tree == NULL)
+		return NULL;
+
+	memset(tree->level_of, -1, sizeof(tree->level_of));
+
+	if (!mpd_string_heap_init(&tree->strings, TAG_TREE_INITIAL_HEAP,
+				  TAG_TREE_INITIAL_INTERN)) {
+		mpd_tag_tree_free(tree);
+		return NULL;
+	}
+
+	return tree;
+}
+
+void
+mpd_tag_tree_free(struct mpd_tag_tree *tree)
+{
+	assert(tree != NULL);
+
+	if (tree->nodes == NULL) {
+		for (unsigned i = 0; i < tree->depth; ++i) {
+			free(tree->levels[i].values);
+			free(tree->levels[i].parents);
+		}
+	}
+
+	free(tree->nodes);
+	mpd_string_heap_deinit(&tree->strings);
+	free(tree);
+}
+
+/**
+ * Returns the offset of an interned copy of the value.  The empty
+ * string is always at offset 0.
+ *
+ * @return the offset, or UINT32_MAX on out of memory
+ */
+static uint32_t
+tag_tree_intern(struct mpd_tag_tree *tree, const char *value, size_t length)
+{
+	if (length == 0)
+		return 0;
+
+	const uint32_t offset =
+		mpd_string_heap_intern(&tree->strings, value, length);
+	return offset > 0 ? offset : UINT32_MAX;
+}
+
+static bool
+tag_tree_append(struct tag_tree_level *level, uint32_t value, uint32_t parent)
+{
+	if (level->length == level->capacity) {
+		const unsigned capacity = level->capacity > 0
+			? level->capacity * 2
+			: TAG_TREE_INITIAL_NODES;
+
+		uint32_t *values = realloc(level->values,
+					   capacity * sizeof(*values));
+		if (values == NULL)
+			return false;
+		level->values = values;
+
+		uint32_t *parents = realloc(level->parents,
+					    capacity * sizeof(*parents));
+		if (parents == NULL)
+			return false;
+		level->parents = parents;
+
+		level->capacity = capacity;
+	}
+
+	level->values[level->length] = value;
+	level->parents[level->length] = parent;
+	++level->length;
+	return true;
+}
+
+struct tag_tree_receiver {
+	struct mpd_tag_tree *tree;
+
+	/**
+	 * The number of levels which have a current node, i.e. the
+	 * deepest level the next tag may be on.
+	 */
+	unsigned active;
+
+	bool malformed, oom;
+};
+
+static bool
+tag_tree_receive_pair(const char *name, size_t name_length,
+		      const char *value, size_t value_length,
+		      int token, void *ctx)
+{
+	struct tag_tree_receiver *r = ctx;
+	struct mpd_tag_tree *tree = r->tree;
+
+	(void)name;
+	(void)name_length;
+
+	if (token < 0 || token >= MPD_TAG_COUNT)
+		return true;
+
+	unsigned level;
+	if (tree->level_of[token] >= 0) {
+		level = (unsigned)tree->level_of[token];
+		if (level > r->active) {
+			/* a child without a parent */
+			r->malformed = true;
+			return false;
+		}
+	} else {
+		/* a tag type which was not seen yet: the next level
+		   below the deepest one */
+		if (r->active != tree->depth) {
+			r->malformed = true;
+			return false;
+		}
+
+		level = tree->depth++;
+		tree->level_of[token] = (signed char)level;
+		tree->levels[level].type = (enum mpd_tag_type)token;
+	}
+
+	const uint32_t offset = tag_tree_intern(tree, value, value_length);
+	const uint32_t parent = level > 0
+		? tree->levels[level - 1].length - 1
+		: 0;
+	if (offset == UINT32_MAX ||
+	    !tag_tree_append(&tree->levels[level], offset, parent)) {
+		r->oom = true;
+		return false;
+	}
+
+	r->active = level + 1;
+	return true;
+}
+
+/**
+ * A node being sorted by its (new) parent and its value.
+ */
+struct tag_tree_sort_node {
+	uint32_t parent;
+	const char *value;
+	uint32_t offset;
+	uint32_t index;
+};
+
+static int
+tag_tree_sort_node_compare(const void *_a, const void *_b)
+{
+	const struct tag_tree_sort_node *a = _a, *b = _b;
+
+	if (a->parent != b->parent)
+		return a->parent < b->parent ? -1 : 1;
+
+	const int result = strcmp(a->value, b->value);
+	if (result != 0)
+		return result;
+
+	/* keep the order of duplicates, so the first one wins */
+	return a->index < b->index ? -1 : (a->index > b->index);
+}
+
+static bool
+tag_tree_level_is_sorted(const struct mpd_tag_tree *tree,
+			 const struct tag_tree_level *level)
+{
+	for (unsigned i = 1; i < level->length; ++i) {
+		if (level->parents[i - 1] != level->parents[i]) {
+			if (level->parents[i - 1] > level->parents[i])
+				return false;
+		} else if (strcmp(mpd_string_heap_get(&tree->strings,
+						      level->values[i - 1]),
+				  mpd_string_heap_get(&tree->strings,
+						      level->values[i])) >= 0)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Sorts the nodes of a level by parent and value and merges
+ * duplicates.  MPD sends grouped responses in this order already, so
+ * this usually finds nothing to do.
+ *
+ * @param map_r receives an array mapping each old index to the new
+ * one (to be freed by the caller), or NULL if nothing was changed
+ * @return false on out of memory
+ */
+static bool
+tag_tree_sort_level(const struct mpd_tag_tree *tree,
+		    struct tag_tree_level *level, uint32_t **map_r)
+{
+	*map_r = NULL;
+	if (tag_tree_level_is_sorted(tree, level))
+		return true;
+
+	struct tag_tree_sort_node *nodes =
+		malloc(level->length * sizeof(*nodes));
+	uint32_t *map = malloc(level->length * sizeof(*map));
+	if (nodes == NULL || map == NULL) {
+		free(nodes);
+		free(map);
+		return false;
+	}
+
+	for (unsigned i = 0; i < level->length; ++i) {
+		nodes[i].parent = level->parents[i];
+		nodes[i].value = mpd_string_heap_get(&tree->strings,
+						     level->values[i]);
+		nodes[i].offset = level->values[i];
+		nodes[i].index = i;
+	}
+
+	qsort(nodes, level->length, sizeof(*nodes),
+	      tag_tree_sort_node_compare);
+
+	unsigned length = 0;
+	for (unsigned i = 0; i < level->length; ++i) {
+		/* interned: equal values have equal offsets */
+		if (length == 0 ||
+		    level->parents[length - 1] != nodes[i].parent ||
+		    level->values[length - 1] != nodes[i].offset) {
+			level->parents[length] = nodes[i].parent;
+			level->values[length] = nodes[i].offset;
+			++length;
+		}
+
+		map[nodes[i].index] = length - 1;
+	}
+
+	level->length = length;
+	free(nodes);
+	*map_r = map;
+	return true;
+}
+
+/**
+ * Sorts all levels and moves the nodes into one array.
+ *
+ * @return false on out of memory
+ */
+static bool
+tag_tree_finish(struct mpd_tag_tree *tree)
+{
+	for (unsigned i = 0; i < tree->depth; ++i) {
+		uint32_t *map;
+		if (!tag_tree_sort_level(tree, &tree->levels[i], &map))
+			return false;
+
+		if (map != NULL && i + 1 < tree->depth) {
+			struct tag_tree_level *next = &tree->levels[i + 1];
+			for (unsigned j = 0; j < next->length; ++j)
+				next->parents[j] = map[next->parents[j]];
+		}
+
+		free(map);
+	}
+
+	size_t n = 0;
+	for (unsigned i = 0; i < tree->depth; ++i)
+		n += (size_t)tree->levels[i].length * 3 + 1;
+
+	uint32_t *nodes = malloc((n > 0 ? n : 1) * sizeof(*nodes));
+	if (nodes == NULL)
+		return false;
+
+	uint32_t *p = nodes;
+	for (unsigned i = 0; i < tree->depth; ++i) {
+		struct tag_tree_level *level = &tree->levels[i];
+
+		memcpy(p, level->values, level->length * sizeof(*p));
+		free(level->values);
+		level->values = p;
+		p += level->length;
+
+		memcpy(p, level->parents, level->length * sizeof(*p));
+		free(level->parents);
+		level->parents = p;
+		p += level->length;
+
+		level->children = p;
+		p += level->length + 1;
+	}
+
+	/* the children of each node are contiguous because the next
+	   level is sorted by parent */
+	for (unsigned i = 0; i < tree->depth; ++i) {
+		struct tag_tree_level *level = &tree->levels[i];
+		const struct tag_tree_level *next = i + 1 < tree->depth
+			? &tree->levels[i + 1]
+			: NULL;
+
+		unsigned child = 0;
+		for (unsigned j = 0; j <= level->length; ++j) {
+			level->children[j] = child;
+			while (next != NULL && child < next->length &&
+			       next->parents[child] == j)
+				++child;
+		}
+	}
+
+	tree->nodes = nodes;
+
+	/* lookups are binary searches; the hash set is not needed
+	   anymore */
+	mpd_string_heap_compact(&tree->strings);
+
+	return true;
+}
+
+struct mpd_tag_tree *
+mpd_recv_tag_tree(struct mpd_connection *connection)
+{
+	assert(connection != NULL);
+
+	struct tag_tree_receiver r = {
+		.tree = tag_tree_new(),
+	};
+	if (r.tree == NULL) {
+		mpd_error_code(&connection->error, MPD_ERROR_OOM);
+		return NULL;
+	}
+
+	if (!mpd_recv_pairs(connection, tag_tree_receive_pair, &r)) {
+		mpd_tag_tree_free(r.tree);
+		return NULL;
+	}
+
+	if (r.malformed) {
+		mpd_error_code(&connection->error, MPD_ERROR_MALFORMED);
+		mpd_error_message(&connection->error,
+				  "Unexpected tag in grouped list");
+		mpd_tag_tree_free(r.tree);
+		return NULL;
+	}
+
+	if (r.oom || !tag_tree_finish(r.tree)) {
+		mpd_error_code(&connection->error, MPD_ERROR_OOM);
+		mpd_tag_tree_free(r.tree);
+		return NULL;
+	}
+
+	return r.tree;
+}
+
+unsigned
+mpd_tag_tree_get_depth(const struct mpd_tag_tree *tree)
+{
+	assert(tree != NULL);
+
+	return tree->depth;
+}
+
+enum mpd_tag_type
+mpd_tag_tree_get_tag(const struct mpd_tag_tree *tree, unsigned level)
+{
+	assert(tree != NULL);
+	assert(level < tree->depth);
+
+	return tree->levels[level].type;
+}
+
+unsigned
+mpd_tag_tree_get_length(const struct mpd_tag_tree *tree, unsigned level)
+{
+	assert(tree != NULL);
+	assert(level < tree->depth);
+
+	return tree->levels[level].length;
+}
+
+const char *
+mpd_tag_tree_get_value(const struct mpd_tag_tree *tree,
+		       unsigned level, unsigned node)
+{
+	assert(tree != NULL);
+	assert(level < tree->depth);
+	assert(node < tree->levels[level].length);
+
+	return mpd_string_heap_get(&tree->strings,
+				   tree->levels[level].values[node]);
+}
+
+unsigned
+mpd_tag_tree_get_parent(const struct mpd_tag_tree *tree,
+			unsigned level, unsigned node)
+{
+	assert(tree != NULL);
+	assert(level > 0 && level < tree->depth);
+	assert(node < tree->levels[level].length);
+
+	return tree->levels[level].parents[node];
+}
+
+unsigned
+mpd_tag_tree_get_children(const struct mpd_tag_tree *tree,
+			  unsigned level, unsigned node, unsigned *end_r)
+{
+	assert(tree != NULL);
+	assert(level < tree->depth);
+	assert(node < tree->levels[level].length);
+	assert(end_r != NULL);
+
+	const uint32_t *children = tree->levels[level].children;
+	*end_r = children[node + 1];
+	return children[node];
+}
+
+int
+mpd_tag_tree_find(const struct mpd_tag_tree *tree, unsigned level,
+		  unsigned parent, const char *value)
+{
+	assert(tree != NULL);
+	assert(level < tree->depth);
+	assert(value != NULL);
+
+	unsigned begin = 0, end = tree->levels[level].length;
+	if (level > 0)
+		begin = mpd_tag_tree_get_children(tree, level - 1, parent,
+						  &end);
+
+	const uint32_t *values = tree->levels[level].values;
+	while (begin < end) {
+		const unsigned middle = begin + (end - begin) / 2;
+		const int result =
+			strcmp(mpd_string_heap_get(&tree->strings,
+						   values[middle]), value);
+		if (result == 0)
+			return (int)middle;
+
+		if (result < 0)
+			begin = middle + 1;
+		else
+			end = middle;
+	}
+
+	return -1;
+}
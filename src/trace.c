@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "itrace.h"
+#include "clock.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct mpd_trace {
+	FILE *file;
+
+	/**
+	 * The time stamp of the previous record.
+	 */
+	uint64_t last;
+};
+
+struct mpd_trace *
+mpd_trace_open(const char *path)
+{
+	assert(path != NULL);
+
+	struct mpd_trace *trace = malloc(sizeof(*trace));
+	if (trace == NULL)
+		return NULL;
+
+	trace->file = fopen(path, "wb");
+	if (trace->file == NULL) {
+		free(trace);
+		return NULL;
+	}
+
+	fputs(MPD_TRACE_MAGIC, trace->file);
+	trace->last = mpd_clock_now();
+	return trace;
+}
+
+void
+mpd_trace_close(struct mpd_trace *trace)
+{
+	assert(trace != NULL);
+
+	fclose(trace->file);
+	free(trace);
+}
+
+static void
+mpd_trace_write_varint(struct mpd_trace *trace, uint64_t value)
+{
+	unsigned char buffer[10], *p = buffer;
+
+	while (value >= 0x80) {
+		*p++ = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+
+	*p++ = (unsigned char)value;
+	fwrite(buffer, 1, (size_t)(p - buffer), trace->file);
+}
+
+void
+mpd_trace_begin(struct mpd_trace *trace, enum mpd_trace_direction direction,
+		size_t length)
+{
+	assert(trace != NULL);
+
+	const uint64_t now = mpd_clock_now();
+
+	putc((int)direction, trace->file);
+	mpd_trace_write_varint(trace, now - trace->last);
+	mpd_trace_write_varint(trace, length);
+
+	trace->last = now;
+}
+
+void
+mpd_trace_append(struct mpd_trace *trace, const void *data, size_t length)
+{
+	assert(trace != NULL);
+
+	fwrite(data, 1, length, trace->file);
+}
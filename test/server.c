@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct test_server_connection {
+	struct test_server *server;
+	int fd;
+};
+
+static bool
+write_full(int fd, const char *data, size_t length)
+{
+	while (length > 0) {
+		const ssize_t nbytes = write(fd, data, length);
+		if (nbytes <= 0)
+			return false;
+
+		data += nbytes;
+		length -= (size_t)nbytes;
+	}
+
+	return true;
+}
+
+static bool
+test_server_respond(struct test_server *s, int fd, const char *request)
+{
+	pthread_mutex_lock(&s->mutex);
+
+	const size_t length = strlen(request);
+	if (s->received_length + length < sizeof(s->received)) {
+		memcpy(s->received + s->received_length, request, length + 1);
+		s->received_length += length;
+	}
+
+	++s->n_requests;
+
+	const char *response = s->handler(request, s->ctx);
+	if (response == NULL)
+		response = "OK\n";
+
+	pthread_mutex_unlock(&s->mutex);
+
+	return write_full(fd, response, strlen(response));
+}
+
+static void *
+test_server_connection_run(void *arg)
+{
+	struct test_server_connection *c = arg;
+	struct test_server *s = c->server;
+	const int fd = c->fd;
+	free(c);
+
+	char welcome[64];
+	snprintf(welcome, sizeof(welcome), "%s\n", s->welcome);
+
+	/* the current request; a command list is collected until
+	   "command_list_end" */
+	char request[4096];
+	size_t request_length = 0;
+	bool in_list = false;
+
+	char input[4096];
+	size_t input_length = 0;
+
+	if (!write_full(fd, welcome, strlen(welcome)))
+		goto out;
+
+	while (true) {
+		const ssize_t nbytes = read(fd, input + input_length,
+					    sizeof(input) - input_length);
+		if (nbytes <= 0)
+			break;
+
+		input_length += (size_t)nbytes;
+
+		char *line = input, *newline;
+		while ((newline = memchr(line, '\n',
+					 input + input_length - line)) != NULL) {
+			const size_t line_length = newline + 1 - line;
+			if (request_length + line_length >= sizeof(request))
+				goto out;
+
+			memcpy(request + request_length, line, line_length);
+			request_length += line_length;
+			request[request_length] = 0;
+
+			*newline = 0;
+			if (strcmp(line, "close") == 0)
+				goto out;
+
+			if (strncmp(line, "command_list_", 13) == 0)
+				in_list = strcmp(line, "command_list_end") != 0;
+
+			line = newline + 1;
+
+			if (!in_list) {
+				if (!test_server_respond(s, fd, request))
+					goto out;
+
+				request_length = 0;
+			}
+		}
+
+		input_length -= line - input;
+		memmove(input, line, input_length);
+	}
+
+out:
+	close(fd);
+	return NULL;
+}
+
+static void *
+test_server_run(void *arg)
+{
+	struct test_server *s = arg;
+
+	while (true) {
+		const int fd = accept(s->fd, NULL, NULL);
+		if (fd < 0)
+			/* test_server_stop() was called */
+			break;
+
+		struct test_server_connection *c = malloc(sizeof(*c));
+		if (c == NULL ||
+		    s->n_connections >= TEST_SERVER_MAX_CONNECTIONS) {
+			free(c);
+			close(fd);
+			continue;
+		}
+
+		c->server = s;
+		c->fd = fd;
+
+		if (pthread_create(&s->connections[s->n_connections], NULL,
+				   test_server_connection_run, c) != 0) {
+			free(c);
+			close(fd);
+			continue;
+		}
+
+		++s->n_connections;
+	}
+
+	return NULL;
+}
+
+bool
+test_server_start(struct test_server *s, const char *welcome,
+		  test_server_handler handler, void *ctx)
+{
+	static unsigned n;
+	snprintf(s->path, sizeof(s->path), "/tmp/libmpdclient-test-%d-%u",
+		 (int)getpid(), n++);
+	unlink(s->path);
+
+	s->welcome = welcome;
+	s->handler = handler;
+	s->ctx = ctx;
+	s->n_connections = 0;
+	s->n_requests = 0;
+	s->received[0] = 0;
+	s->received_length = 0;
+
+	s->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s->fd < 0) {
+		perror("socket() failed");
+		return false;
+	}
+
+	struct sockaddr_un address = {
+		.sun_family = AF_UNIX,
+	};
+	strcpy(address.sun_path, s->path);
+
+	if (bind(s->fd, (const struct sockaddr *)&address,
+		 sizeof(address)) < 0 ||
+	    listen(s->fd, TEST_SERVER_MAX_CONNECTIONS) < 0) {
+		perror("bind() failed");
+		close(s->fd);
+		return false;
+	}
+
+	pthread_mutex_init(&s->mutex, NULL);
+
+	if (pthread_create(&s->thread, NULL, test_server_run, s) != 0) {
+		pthread_mutex_destroy(&s->mutex);
+		close(s->fd);
+		unlink(s->path);
+		return false;
+	}
+
+	return true;
+}
+
+void
+test_server_stop(struct test_server *s)
+{
+	/* wakes up accept() */
+	shutdown(s->fd, SHUT_RDWR);
+	pthread_join(s->thread, NULL);
+	close(s->fd);
+	unlink(s->path);
+
+	for (unsigned i = 0; i < s->n_connections; ++i)
+		pthread_join(s->connections[i], NULL);
+
+	pthread_mutex_destroy(&s->mutex);
+}
+
+const char *
+test_server_script(const char *request, void *ctx)
+{
+	const char *const **cursor = ctx;
+
+	(void)request;
+
+	if (**cursor == NULL)
+		return NULL;
+
+	return *(*cursor)++;
+}
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#ifndef TEST_SERVER_H
+#define TEST_SERVER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+enum {
+	TEST_SERVER_MAX_CONNECTIONS = 16,
+};
+
+/**
+ * Returns the response to one request: a single command line or a
+ * whole command list, each line terminated with a newline.  NULL
+ * means "OK".  It is called with the server's mutex held.
+ */
+typedef const char *
+(*test_server_handler)(const char *request, void *ctx);
+
+/**
+ * A fake MPD listening on a local socket, for tests which need a
+ * connection created by mpd_connection_new_settings().  Each
+ * connection is served by its own thread.
+ */
+struct test_server {
+	/**
+	 * The socket path, which can be passed to mpd_settings_new().
+	 */
+	char path[64];
+
+	const char *welcome;
+
+	test_server_handler handler;
+	void *ctx;
+
+	int fd;
+	pthread_t thread;
+
+	pthread_mutex_t mutex;
+
+	unsigned n_connections;
+	pthread_t connections[TEST_SERVER_MAX_CONNECTIONS];
+
+	/**
+	 * The number of requests received so far.
+	 */
+	unsigned n_requests;
+
+	/**
+	 * All requests received so far.
+	 */
+	char received[8192];
+	size_t received_length;
+};
+
+/**
+ * Starts listening.
+ *
+ * @param welcome the welcome line without the newline, e.g.
+ * "OK MPD 0.21.0"
+ */
+bool
+test_server_start(struct test_server *s, const char *welcome,
+		  test_server_handler handler, void *ctx);
+
+/**
+ * Stops listening and waits until all clients have disconnected.
+ * Afterwards, #received and #n_requests may be inspected.
+ */
+void
+test_server_stop(struct test_server *s);
+
+/**
+ * A #test_server_handler which sends the responses of a
+ * NULL-terminated array in order.
+ */
+const char *
+test_server_script(const char *request, void *ctx);
+
+#endif
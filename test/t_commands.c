@@ -1,18 +1,41 @@
 #include "capture.h"
 #include "config.h"
 #include <mpd/connection.h>
+#include <mpd/async.h>
+#include <mpd/decoder.h>
+#include <mpd/entity.h>
 #include <mpd/response.h>
 #include <mpd/capabilities.h>
+#include <mpd/server_capabilities.h>
 #include <mpd/queue.h>
+#include <mpd/queue_view.h>
 #include <mpd/playlist.h>
 #include <mpd/database.h>
+#include <mpd/crawl.h>
 #include <mpd/search.h>
+#include <mpd/search_cursor.h>
+#include <mpd/filter.h>
+#include <mpd/search_index.h>
+#include <mpd/tag_tree.h>
+#include <mpd/song.h>
+#include <mpd/audio_format.h>
+#include <mpd/song_sort.h>
+#include <mpd/song_table.h>
 #include <mpd/player.h>
 #include <mpd/mount.h>
+#include <mpd/metrics.h>
+#include <mpd/stats.h>
+#include <mpd/status.h>
+#include <mpd/pair.h>
+#include <mpd/password.h>
+#include <mpd/pipeline.h>
+#include <mpd/recv.h>
 
 #include <check.h>
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <time.h>
 
@@ -20,6 +43,12 @@
 #include <locale.h>
 #endif
 
+#ifdef HAVE_PTHREAD
+#include "server.h"
+
+#include <mpd/settings.h>
+#endif
+
 static void
 abort_command(struct test_capture *capture,
 	      struct mpd_connection *connection)
@@ -73,6 +102,117 @@ START_TEST(test_capabilities_commands)
 }
 END_TEST
 
+START_TEST(test_server_capabilities)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	test_capture_send(&capture,
+			  "command: status\ncommand: add\nlist_OK\n"
+			  "command: kill\nlist_OK\n"
+			  "handler: http://\nlist_OK\n"
+			  "tagtype: Artist\ntagtype: Title\nlist_OK\n"
+			  "OK\n");
+
+	struct mpd_server_capabilities *capabilities =
+		mpd_server_capabilities_get(c);
+	ck_assert(capabilities != NULL);
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_ok_begin\n"
+			 "commands\n"
+			 "notcommands\n"
+			 "urlhandlers\n"
+			 "tagtypes\n"
+			 "command_list_end\n");
+
+	unsigned n;
+	const char *const *commands =
+		mpd_server_capabilities_get_commands(capabilities, &n);
+	ck_assert_uint_eq(n, 2);
+	ck_assert_str_eq(commands[0], "add");
+	ck_assert_str_eq(commands[1], "status");
+
+	ck_assert(mpd_server_capabilities_has_command(capabilities, "status"));
+	ck_assert(!mpd_server_capabilities_has_command(capabilities, "kill"));
+	mpd_server_capabilities_get_disallowed_commands(capabilities, &n);
+	ck_assert_uint_eq(n, 1);
+	ck_assert(mpd_server_capabilities_has_url_scheme(capabilities, "http://"));
+	ck_assert(mpd_server_capabilities_has_tag_type(capabilities, MPD_TAG_TITLE));
+	ck_assert(!mpd_server_capabilities_has_tag_type(capabilities, MPD_TAG_ALBUM));
+	ck_assert(!mpd_server_capabilities_has_protocol_feature(capabilities,
+								MPD_FEATURE_HIDE_PLAYLISTS_IN_ROOT));
+
+	mpd_server_capabilities_unref(capabilities);
+
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
+START_TEST(test_tag_projection)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	static const enum mpd_tag_type types[] = {
+		MPD_TAG_ARTIST,
+		MPD_TAG_TITLE,
+	};
+
+	ck_assert(mpd_set_tag_projection(c, types, 2));
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_begin\n"
+			 "tagtypes \"clear\"\n"
+			 "tagtypes \"enable\" \"Artist\" \"Title\"\n"
+			 "playlistinfo\n"
+			 "tagtypes \"all\"\n"
+			 "command_list_end\n");
+	test_capture_send(&capture, "OK\n");
+	ck_assert(mpd_response_finish(c));
+
+	/* the projection applies to one command only */
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture), "playlistinfo\n");
+	test_capture_send(&capture, "OK\n");
+	ck_assert(mpd_response_finish(c));
+
+	/* a projection which equals the current tag types is a no-op */
+	ck_assert(mpd_send_clear_tag_types(c));
+	ck_assert_str_eq(test_capture_receive(&capture), "tagtypes \"clear\"\n");
+	test_capture_send(&capture, "OK\n");
+	ck_assert(mpd_response_finish(c));
+	ck_assert(mpd_set_tag_projection(c, NULL, 0));
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture), "playlistinfo\n");
+	abort_command(&capture, c);
+
+	/* after a failed projected command, the next command restores
+	   the tag types */
+	ck_assert(mpd_set_tag_projection(c, types, 1));
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_begin\n"
+			 "tagtypes \"clear\"\n"
+			 "tagtypes \"enable\" \"Artist\"\n"
+			 "playlistinfo\n"
+			 "tagtypes \"clear\"\n"
+			 "command_list_end\n");
+	abort_command(&capture, c);
+
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_begin\n"
+			 "tagtypes \"clear\"\n"
+			 "playlistinfo\n"
+			 "command_list_end\n");
+	abort_command(&capture, c);
+
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
 START_TEST(test_queue_commands)
 {
 	struct test_capture capture;
@@ -135,6 +275,572 @@ START_TEST(test_queue_commands)
 }
 END_TEST
 
+START_TEST(test_queue_multi)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	static const char *const uris[] = { "a.mp3", "b.mp3", "c.mp3" };
+	int ids[3];
+
+	test_capture_send(&capture, "Id: 10\nlist_OK\n"
+			  "ACK [50@1] {addid} No such directory\n"
+			  "Id: 11\nlist_OK\nOK\n");
+	ck_assert_int_eq(mpd_run_add_id_multi_to(c, uris, 3, 5, ids), 2);
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_ok_begin\n"
+			 "addid \"a.mp3\" \"5\"\n"
+			 "addid \"b.mp3\" \"6\"\n"
+			 "addid \"c.mp3\" \"7\"\n"
+			 "command_list_end\n"
+			 "command_list_ok_begin\n"
+			 "addid \"c.mp3\" \"6\"\n"
+			 "command_list_end\n");
+	ck_assert_int_eq(ids[0], 10);
+	ck_assert_int_eq(ids[1], -1);
+	ck_assert_int_eq(ids[2], 11);
+
+	static const unsigned song_ids[] = { 11, 10 };
+	bool success[2];
+
+	test_capture_send(&capture, "list_OK\nlist_OK\nOK\n");
+	ck_assert_int_eq(mpd_run_move_id_multi(c, song_ids, NULL, 2,
+					       success), 2);
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_ok_begin\n"
+			 "moveid \"11\" \"0\"\n"
+			 "moveid \"10\" \"1\"\n"
+			 "command_list_end\n");
+	ck_assert(success[0] && success[1]);
+
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
+struct pair_counts {
+	unsigned files, titles, other, value_length;
+};
+
+static bool
+count_pairs(const char *name, size_t name_length,
+	    const char *value, size_t value_length,
+	    int token, void *ctx)
+{
+	struct pair_counts *counts = ctx;
+
+	ck_assert_uint_eq(name_length, strlen(name));
+	ck_assert_uint_eq(value_length, strlen(value));
+	counts->value_length += value_length;
+
+	if (token == MPD_PAIR_TOKEN_FILE)
+		++counts->files;
+	else if (token == MPD_TAG_TITLE)
+		++counts->titles;
+	else if (token == MPD_PAIR_TOKEN_OTHER)
+		++counts->other;
+
+	/* stop at the third song */
+	return counts->files < 3;
+}
+
+START_TEST(test_queue_view)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	struct mpd_queue_view *view = mpd_queue_view_new(1);
+	ck_assert(view != NULL);
+
+	/* the first call fills the window with "plchanges 0" */
+	test_capture_send(&capture,
+			  "playlistlength: 5\nplaylist: 7\nlist_OK\n"
+			  "file: a\nPos: 0\nId: 1\nfile: b\nPos: 1\nId: 2\n"
+			  "file: c\nPos: 2\nId: 3\nlist_OK\nOK\n");
+	ck_assert(mpd_queue_view_set_visible(view, c, 0, 2));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_ok_begin\n"
+			 "status\n"
+			 "plchanges \"0\" \"0:3\"\n"
+			 "command_list_end\n");
+	ck_assert_uint_eq(mpd_queue_view_get_length(view), 5);
+	ck_assert_uint_eq(mpd_queue_view_get_version(view), 7);
+	ck_assert_str_eq(mpd_song_get_uri(mpd_queue_view_get_song(view, 2)),
+			 "c");
+	ck_assert(mpd_queue_view_get_song(view, 3) == NULL);
+
+	/* scrolling fetches only the new rows */
+	test_capture_send(&capture,
+			  "file: d\nPos: 3\nId: 4\nfile: e\nPos: 4\nId: 5\n"
+			  "OK\n");
+	ck_assert(mpd_queue_view_set_visible(view, c, 2, 4));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_begin\n"
+			 "playlistinfo \"3:5\"\n"
+			 "command_list_end\n");
+	ck_assert(mpd_queue_view_get_song(view, 0) == NULL);
+	ck_assert_str_eq(mpd_song_get_uri(mpd_queue_view_get_song(view, 1)),
+			 "b");
+	ck_assert_str_eq(mpd_song_get_uri(mpd_queue_view_get_song(view, 4)),
+			 "e");
+
+	/* "c" was replaced, the last song was deleted */
+	test_capture_send(&capture,
+			  "playlistlength: 4\nplaylist: 8\nlist_OK\n"
+			  "file: x\nPos: 2\nId: 9\nlist_OK\nOK\n");
+	ck_assert(mpd_queue_view_update(view, c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_ok_begin\n"
+			 "status\n"
+			 "plchanges \"7\" \"1:5\"\n"
+			 "command_list_end\n");
+	ck_assert_uint_eq(mpd_queue_view_get_length(view), 4);
+	ck_assert_str_eq(mpd_song_get_uri(mpd_queue_view_get_song(view, 1)),
+			 "b");
+	ck_assert_str_eq(mpd_song_get_uri(mpd_queue_view_get_song(view, 2)),
+			 "x");
+	ck_assert(mpd_queue_view_get_song(view, 4) == NULL);
+
+	/* a failed "plchanges" must not commit the new version, and
+	   discards the cache */
+	test_capture_send(&capture,
+			  "playlistlength: 4\nplaylist: 9\nlist_OK\n"
+			  "ACK [50@1] {plchanges} failed\n");
+	ck_assert(!mpd_queue_view_update(view, c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_ok_begin\n"
+			 "status\n"
+			 "plchanges \"8\" \"1:5\"\n"
+			 "command_list_end\n");
+	ck_assert_int_eq(mpd_connection_get_error(c), MPD_ERROR_SERVER);
+	ck_assert(mpd_connection_clear_error(c));
+	ck_assert_uint_eq(mpd_queue_view_get_version(view), 0);
+	ck_assert(mpd_queue_view_get_song(view, 1) == NULL);
+
+	/* so the next update fetches the whole window again */
+	test_capture_send(&capture,
+			  "playlistlength: 4\nplaylist: 9\nlist_OK\n"
+			  "file: b\nPos: 1\nId: 2\nfile: y\nPos: 2\nId: 10\n"
+			  "file: d\nPos: 3\nId: 4\nlist_OK\nOK\n");
+	ck_assert(mpd_queue_view_update(view, c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_ok_begin\n"
+			 "status\n"
+			 "plchanges \"0\" \"1:5\"\n"
+			 "command_list_end\n");
+	ck_assert_uint_eq(mpd_queue_view_get_version(view), 9);
+	ck_assert_str_eq(mpd_song_get_uri(mpd_queue_view_get_song(view, 2)),
+			 "y");
+
+	mpd_queue_view_free(view);
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
+START_TEST(test_recv_pairs)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture), "playlistinfo\n");
+	test_capture_send(&capture,
+			  "file: a.flac\nTitle: A\nPos: 0\n"
+			  "file: b.flac\nTitle: Bb\nX-Foo: bar\n"
+			  "file: c.flac\nTitle: C\n"
+			  "OK\n");
+
+	struct pair_counts counts = {0, 0, 0, 0};
+	ck_assert(mpd_recv_pairs(c, count_pairs, &counts));
+	ck_assert_uint_eq(counts.files, 3);
+	ck_assert_uint_eq(counts.titles, 2);
+	ck_assert_uint_eq(counts.other, 1);
+	ck_assert_uint_eq(counts.value_length, 6 + 1 + 1 + 6 + 2 + 3 + 6);
+	ck_assert(mpd_response_finish(c));
+
+	/* part of the ABI: must not depend on MPD_TAG_COUNT */
+	ck_assert_int_eq(MPD_PAIR_TOKEN_FILE, 0x1000);
+	ck_assert_int_eq(MPD_PAIR_TOKEN_OTHER, 0x1fff);
+
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
+START_TEST(test_song_table)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	static const enum mpd_tag_type tags[] = {
+		MPD_TAG_ARTIST, MPD_TAG_TITLE,
+	};
+	struct mpd_song_table *table = mpd_song_table_new(tags, 2);
+	ck_assert(table != NULL);
+
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture), "playlistinfo\n");
+	test_capture_send(&capture,
+			  "file: a.flac\nArtist: X\nArtist: Y\nTitle: A\n"
+			  "Time: 3\nduration: 2.500\nPos: 0\nId: 7\n"
+			  "directory: d\nTitle: ignored\n"
+			  "file: b.flac\nArtist: X\nAlbum: ignored\nTime: 4\n"
+			  "Pos: 1\nId: 8\nPrio: 3\n"
+			  "OK\n");
+	ck_assert(mpd_recv_song_table(c, table));
+	ck_assert(mpd_response_finish(c));
+
+	ck_assert_uint_eq(mpd_song_table_get_length(table), 2);
+	ck_assert(mpd_song_table_get_tags(table, MPD_TAG_ALBUM) == NULL);
+
+	const char *heap = mpd_song_table_get_heap(table);
+	const uint32_t *uris = mpd_song_table_get_uris(table);
+	ck_assert_str_eq(heap + uris[0], "a.flac");
+	ck_assert_str_eq(heap + uris[1], "b.flac");
+
+	const uint32_t *artists =
+		mpd_song_table_get_tags(table, MPD_TAG_ARTIST);
+	ck_assert_str_eq(heap + artists[0], "X");
+	ck_assert_uint_eq(artists[0], artists[1]);
+
+	const uint32_t *titles = mpd_song_table_get_tags(table, MPD_TAG_TITLE);
+	ck_assert_str_eq(heap + titles[0], "A");
+	ck_assert_uint_eq(titles[1], 0);
+
+	ck_assert_uint_eq(mpd_song_table_get_durations_ms(table)[0], 2500);
+	ck_assert_uint_eq(mpd_song_table_get_durations_ms(table)[1], 4000);
+	ck_assert_uint_eq(mpd_song_table_get_positions(table)[1], 1);
+	ck_assert_uint_eq(mpd_song_table_get_ids(table)[0], 7);
+	ck_assert_uint_eq(mpd_song_table_get_priorities(table)[0], 0);
+	ck_assert_uint_eq(mpd_song_table_get_priorities(table)[1], 3);
+
+	mpd_song_table_clear(table);
+	ck_assert_uint_eq(mpd_song_table_get_length(table), 0);
+
+	/* a buffered response */
+	static const char response[] =
+		"directory: d\nfile: d/a.flac\nTitle: A\nTime: 5\n"
+		"playlist: p.m3u\nfile: d/b.flac\nId: 9\nOK\n";
+	ck_assert(mpd_song_table_parse(table, response,
+				       sizeof(response) - 1, 4));
+	ck_assert_uint_eq(mpd_song_table_get_length(table), 2);
+	heap = mpd_song_table_get_heap(table);
+	uris = mpd_song_table_get_uris(table);
+	titles = mpd_song_table_get_tags(table, MPD_TAG_TITLE);
+	ck_assert_str_eq(heap + uris[1], "d/b.flac");
+	ck_assert_str_eq(heap + titles[0], "A");
+	ck_assert_uint_eq(mpd_song_table_get_durations_ms(table)[0], 5000);
+	ck_assert_uint_eq(mpd_song_table_get_ids(table)[1], 9);
+
+	ck_assert(!mpd_song_table_parse(table, "file: x\nbogus\n", 14, 1));
+	ck_assert(!mpd_song_table_parse(table, "ACK [50@0] {} x\n", 16, 1));
+
+	mpd_song_table_free(table);
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
+/**
+ * Asserts that two string columns refer to equal strings.
+ */
+static void
+assert_same_strings(const char *heap_a, const uint32_t *a,
+		    const char *heap_b, const uint32_t *b, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		ck_assert_int_eq(a[i] == 0, b[i] == 0);
+		ck_assert_str_eq(heap_a + a[i], heap_b + b[i]);
+	}
+}
+
+START_TEST(test_song_table_parse_threads)
+{
+	/* several SONG_TABLE_PARSE_MIN_CHUNK (256 kB), so the buffer
+	   is split into chunks parsed by different threads */
+	enum { N = 12000, SIZE = 2 * 1024 * 1024 };
+
+	char *response = malloc(SIZE);
+	ck_assert(response != NULL);
+
+	size_t length = 0;
+	for (unsigned i = 0; i < N; ++i) {
+		if (i % 100 == 0)
+			length += sprintf(response + length,
+					  "directory: d%u\n", i / 100);
+
+		length += sprintf(response + length,
+				  "file: d%u/%05u.flac\n"
+				  "Artist: artist %u\n"
+				  "%s"
+				  "duration: %u.%03u\n"
+				  "Last-Modified: 2024-03-%02uT12:00:00Z\n"
+				  "Pos: %u\nId: %u\nPrio: %u\n",
+				  i / 100, i, i % 37,
+				  i % 5 == 0 ? "" : "Title: some title\n",
+				  i % 600, i % 1000, 1 + i % 28,
+				  i, 1000 + i, i % 7);
+	}
+
+	length += sprintf(response + length, "OK\n");
+	ck_assert(length < SIZE);
+	ck_assert(length > 4 * 256 * 1024);
+
+	static const enum mpd_tag_type tags[] = {
+		MPD_TAG_ARTIST, MPD_TAG_TITLE,
+	};
+	struct mpd_song_table *a = mpd_song_table_new(tags, 2);
+	ck_assert(a != NULL);
+	struct mpd_song_table *b = mpd_song_table_new(tags, 2);
+	ck_assert(b != NULL);
+
+	ck_assert(mpd_song_table_parse(a, response, length, 1));
+	ck_assert(mpd_song_table_parse(b, response, length, 4));
+
+	ck_assert_uint_eq(mpd_song_table_get_length(a), N);
+	ck_assert_uint_eq(mpd_song_table_get_length(b), N);
+
+	const char *heap_a = mpd_song_table_get_heap(a);
+	const char *heap_b = mpd_song_table_get_heap(b);
+	assert_same_strings(heap_a, mpd_song_table_get_uris(a),
+			    heap_b, mpd_song_table_get_uris(b), N);
+	for (unsigned i = 0; i < 2; ++i)
+		assert_same_strings(heap_a,
+				    mpd_song_table_get_tags(a, tags[i]),
+				    heap_b,
+				    mpd_song_table_get_tags(b, tags[i]), N);
+
+	ck_assert(memcmp(mpd_song_table_get_durations_ms(a),
+			 mpd_song_table_get_durations_ms(b),
+			 N * sizeof(uint32_t)) == 0);
+	ck_assert(memcmp(mpd_song_table_get_last_modified(a),
+			 mpd_song_table_get_last_modified(b),
+			 N * sizeof(int64_t)) == 0);
+	ck_assert(memcmp(mpd_song_table_get_positions(a),
+			 mpd_song_table_get_positions(b),
+			 N * sizeof(uint32_t)) == 0);
+	ck_assert(memcmp(mpd_song_table_get_ids(a),
+			 mpd_song_table_get_ids(b),
+			 N * sizeof(uint32_t)) == 0);
+	ck_assert(memcmp(mpd_song_table_get_priorities(a),
+			 mpd_song_table_get_priorities(b),
+			 N * sizeof(uint32_t)) == 0);
+
+	/* spot checks of the last row, which came from the last
+	   chunk */
+	ck_assert_str_eq(heap_b + mpd_song_table_get_uris(b)[N - 1],
+			 "d119/11999.flac");
+	ck_assert_uint_eq(mpd_song_table_get_ids(b)[N - 1], 1000 + N - 1);
+	ck_assert_uint_eq(mpd_song_table_get_durations_ms(b)[N - 1],
+			  (N - 1) % 600 * 1000 + (N - 1) % 1000);
+
+	mpd_song_table_free(b);
+	mpd_song_table_free(a);
+	free(response);
+}
+END_TEST
+
+START_TEST(test_song_sort)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture), "playlistinfo\n");
+	test_capture_send(&capture,
+			  "file: 0\nArtist: b\nAlbum: X\nTrack: 10\n"
+			  "file: 1\nArtist: The B\nArtistSort: B\n"
+			  "Album: X\nTrack: 9/12\n"
+			  "file: 2\nArtist: \xc3\x89mile\nAlbum: Y\n"
+			  "file: 3\nAlbum: Z\n"
+			  "file: 4\nArtist: a\nAlbum: X\nTrack: 2\n"
+			  "OK\n");
+
+	struct mpd_song *songs[5];
+	for (unsigned i = 0; i < 5; ++i) {
+		songs[i] = mpd_recv_song(c);
+		ck_assert(songs[i] != NULL);
+	}
+	ck_assert(mpd_response_finish(c));
+
+	static const struct mpd_song_sort_key keys[] = {
+		{ MPD_TAG_ARTIST, false },
+		{ MPD_TAG_TRACK, false },
+	};
+
+	/* "ArtistSort" wins, case and diacritics are ignored, tracks
+	   are numbers, missing artists come first */
+	ck_assert(mpd_song_sort(songs, 5, keys, 2, 4));
+	ck_assert_str_eq(mpd_song_get_uri(songs[0]), "3");
+	ck_assert_str_eq(mpd_song_get_uri(songs[1]), "4");
+	ck_assert_str_eq(mpd_song_get_uri(songs[2]), "1");
+	ck_assert_str_eq(mpd_song_get_uri(songs[3]), "0");
+	ck_assert_str_eq(mpd_song_get_uri(songs[4]), "2");
+
+	/* descending, and stable on equal keys */
+	static const struct mpd_song_sort_key album[] = {
+		{ MPD_TAG_ALBUM, true },
+	};
+	ck_assert(mpd_song_sort(songs, 5, album, 1, 1));
+	ck_assert_str_eq(mpd_song_get_uri(songs[0]), "3");
+	ck_assert_str_eq(mpd_song_get_uri(songs[1]), "2");
+	ck_assert_str_eq(mpd_song_get_uri(songs[2]), "4");
+	ck_assert_str_eq(mpd_song_get_uri(songs[3]), "1");
+	ck_assert_str_eq(mpd_song_get_uri(songs[4]), "0");
+
+	for (unsigned i = 0; i < 5; ++i)
+		mpd_song_free(songs[i]);
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
+/**
+ * Creates a song without a connection.
+ */
+static struct mpd_song *
+make_song(unsigned uri, unsigned artist, unsigned track)
+{
+	char value[32];
+	snprintf(value, sizeof(value), "%u", uri);
+	struct mpd_pair pair = { "file", value };
+	struct mpd_song *song = mpd_song_begin(&pair);
+	ck_assert(song != NULL);
+
+	/* differently cased spellings of the same artist */
+	snprintf(value, sizeof(value), uri % 2 ? "Artist %03u" : "artist %03u",
+		 artist);
+	pair.name = "Artist";
+	ck_assert(mpd_song_feed(song, &pair));
+
+	snprintf(value, sizeof(value), "%u/30", track);
+	pair.name = "Track";
+	ck_assert(mpd_song_feed(song, &pair));
+	return song;
+}
+
+START_TEST(test_song_sort_threads)
+{
+	/* more than two chunks of SONG_SORT_MIN_PER_THREAD, so the
+	   threaded merge is really used */
+	enum { N = 40000, N_ARTISTS = 300 };
+
+	static unsigned artists[N], tracks[N];
+	static struct mpd_song *a[N], *b[N];
+
+	unsigned seed = 1;
+	for (unsigned i = 0; i < N; ++i) {
+		seed = seed * 1103515245u + 12345u;
+		artists[i] = (seed >> 16) % N_ARTISTS;
+		tracks[i] = 1 + (seed >> 8) % 30;
+		a[i] = b[i] = make_song(i, artists[i], tracks[i]);
+	}
+
+	static const struct mpd_song_sort_key keys[] = {
+		{ MPD_TAG_ARTIST, false },
+		{ MPD_TAG_TRACK, false },
+	};
+
+	ck_assert(mpd_song_sort(a, N, keys, 2, 1));
+	ck_assert(mpd_song_sort(b, N, keys, 2, 4));
+
+	unsigned previous = (unsigned)atoi(mpd_song_get_uri(a[0]));
+	ck_assert(a[0] == b[0]);
+	for (unsigned i = 1; i < N; ++i) {
+		ck_assert(a[i] == b[i]);
+
+		/* sorted by artist and track, stable on ties */
+		const unsigned current = (unsigned)atoi(mpd_song_get_uri(a[i]));
+		ck_assert(artists[previous] <= artists[current]);
+		if (artists[previous] == artists[current]) {
+			ck_assert(tracks[previous] <= tracks[current]);
+			if (tracks[previous] == tracks[current])
+				ck_assert(previous < current);
+		}
+
+		previous = current;
+	}
+
+	for (unsigned i = 0; i < N; ++i)
+		mpd_song_free(a[i]);
+}
+END_TEST
+
+START_TEST(test_song_serialize)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture), "playlistinfo\n");
+	test_capture_send(&capture,
+			  "file: a.flac\nArtist: X\nArtist: Y\nTitle: A\n"
+			  "Last-Modified: 2024-03-01T12:00:00Z\n"
+			  "Format: 44100:24:2\nduration: 2.500\n"
+			  "Pos: 0\nId: 7\n"
+			  "file: b.flac\nRealUri: http://x/b.flac\nPrio: 3\n"
+			  "OK\n");
+
+	struct mpd_song *a = mpd_recv_song(c);
+	ck_assert(a != NULL);
+	struct mpd_song *b = mpd_recv_song(c);
+	ck_assert(b != NULL);
+	ck_assert(mpd_response_finish(c));
+
+	const struct mpd_song *const songs[] = { a, b };
+
+	const size_t size = mpd_song_serialize_batch(songs, 2, NULL, 0);
+	ck_assert(size > 0);
+
+	uint64_t *buffer = malloc(size);
+	ck_assert_uint_eq(mpd_song_serialize_batch(songs, 2, buffer, size),
+			  size);
+
+	unsigned n;
+	ck_assert(mpd_song_batch_check(buffer, size, &n));
+	ck_assert_uint_eq(n, 2);
+	ck_assert(!mpd_song_batch_check(buffer, size - 8, &n));
+
+	struct mpd_song *song = mpd_song_batch_get(buffer, 0);
+	ck_assert(song != NULL);
+	ck_assert_str_eq(mpd_song_get_uri(song), "a.flac");
+	ck_assert_str_eq(mpd_song_get_tag(song, MPD_TAG_ARTIST, 0), "X");
+	ck_assert_str_eq(mpd_song_get_tag(song, MPD_TAG_ARTIST, 1), "Y");
+	ck_assert(mpd_song_get_tag(song, MPD_TAG_ARTIST, 2) == NULL);
+	ck_assert_str_eq(mpd_song_get_tag(song, MPD_TAG_TITLE, 0), "A");
+	ck_assert_int_eq(mpd_song_get_last_modified(song), 1709294400);
+	ck_assert_uint_eq(mpd_song_get_duration_ms(song), 2500);
+	ck_assert_uint_eq(mpd_song_get_id(song), 7);
+	ck_assert_uint_eq(mpd_song_get_audio_format(song)->bits, 24);
+	ck_assert(mpd_song_get_real_uri(song) == NULL);
+	mpd_song_free(song);
+
+	song = mpd_song_batch_get(buffer, 1);
+	ck_assert(song != NULL);
+	ck_assert_str_eq(mpd_song_get_real_uri(song), "http://x/b.flac");
+	ck_assert_uint_eq(mpd_song_get_prio(song), 3);
+	ck_assert(mpd_song_get_audio_format(song) == NULL);
+	mpd_song_free(song);
+
+	/* a batch with two songs is not a single song */
+	ck_assert(mpd_song_deserialize(buffer, size) == NULL);
+	free(buffer);
+
+	uint64_t one[64];
+	ck_assert(mpd_song_serialize(b, one, sizeof(one)) <= sizeof(one));
+	song = mpd_song_deserialize(one, sizeof(one));
+	ck_assert(song != NULL);
+	ck_assert_str_eq(mpd_song_get_uri(song), "b.flac");
+	mpd_song_free(song);
+
+	mpd_song_free(a);
+	mpd_song_free(b);
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
 START_TEST(test_playlist_commands)
 {
 	struct test_capture capture;
@@ -195,6 +901,54 @@ START_TEST(test_database_commands)
 }
 END_TEST
 
+START_TEST(test_crawl)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	static const enum mpd_tag_type tags[] = {
+		MPD_TAG_TITLE, MPD_TAG_ARTIST,
+	};
+	struct mpd_song_table *table = mpd_song_table_new(tags, 2);
+	ck_assert(table != NULL);
+
+	/* this connection has no settings, so no additional
+	   connections are opened and the directories are fetched
+	   one after another */
+	test_capture_send(&capture,
+			  "file: r.flac\nTitle: R\n"
+			  "directory: a\nLast-Modified: 2024-01-01T00:00:00Z\n"
+			  "directory: b\nplaylist: p.m3u\nOK\n"
+			  "directory: a/x\nfile: a/x/1.flac\nArtist: X\n"
+			  "Title: A1\nOK\n"
+			  "file: b/1.flac\nTitle: B1\nfile: b/2.flac\nOK\n");
+	ck_assert(mpd_crawl_database(c, 4, table));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "lsinfo\nlistallinfo \"a\"\nlistallinfo \"b\"\n");
+
+	ck_assert_uint_eq(mpd_song_table_get_length(table), 4);
+
+	const char *heap = mpd_song_table_get_heap(table);
+	const uint32_t *uris = mpd_song_table_get_uris(table);
+	ck_assert_str_eq(heap + uris[0], "r.flac");
+	ck_assert_str_eq(heap + uris[1], "a/x/1.flac");
+	ck_assert_str_eq(heap + uris[2], "b/1.flac");
+	ck_assert_str_eq(heap + uris[3], "b/2.flac");
+
+	const uint32_t *titles = mpd_song_table_get_tags(table, MPD_TAG_TITLE);
+	const uint32_t *artists =
+		mpd_song_table_get_tags(table, MPD_TAG_ARTIST);
+	ck_assert_str_eq(heap + titles[1], "A1");
+	ck_assert_str_eq(heap + artists[1], "X");
+	ck_assert_str_eq(heap + titles[2], "B1");
+	ck_assert_uint_eq(titles[3], 0);
+
+	mpd_song_table_free(table);
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
 START_TEST(test_search)
 {
 	struct test_capture capture;
@@ -284,6 +1038,87 @@ START_TEST(test_list)
 }
 END_TEST
 
+START_TEST(test_tag_tree)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	ck_assert(mpd_search_db_tags(c, MPD_TAG_DATE));
+	ck_assert(mpd_search_add_group_tag(c, MPD_TAG_ALBUM));
+	ck_assert(mpd_search_add_group_tag(c, MPD_TAG_ALBUM_ARTIST));
+	ck_assert(mpd_search_commit(c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "list Date group Album group AlbumArtist\n");
+
+	/* unsorted, so the tree has to sort it */
+	test_capture_send(&capture,
+			  "AlbumArtist: B\nAlbum: Y\nDate: 2001\n"
+			  "AlbumArtist: A\nAlbum: X\nDate: \nDate: 1999\n"
+			  "Album: W\nDate: 1999\n"
+			  "OK\n");
+	struct mpd_tag_tree *tree = mpd_recv_tag_tree(c);
+	ck_assert(tree != NULL);
+	ck_assert(mpd_response_finish(c));
+
+	ck_assert_uint_eq(mpd_tag_tree_get_depth(tree), 3);
+	ck_assert_int_eq(mpd_tag_tree_get_tag(tree, 0), MPD_TAG_ALBUM_ARTIST);
+	ck_assert_int_eq(mpd_tag_tree_get_tag(tree, 2), MPD_TAG_DATE);
+	ck_assert_uint_eq(mpd_tag_tree_get_length(tree, 0), 2);
+	ck_assert_uint_eq(mpd_tag_tree_get_length(tree, 1), 3);
+	ck_assert_str_eq(mpd_tag_tree_get_value(tree, 0, 0), "A");
+	ck_assert_int_eq(mpd_tag_tree_find(tree, 0, 0, "B"), 1);
+	ck_assert_int_eq(mpd_tag_tree_find(tree, 0, 0, "C"), -1);
+
+	unsigned end;
+	ck_assert_uint_eq(mpd_tag_tree_get_children(tree, 0, 0, &end), 0);
+	ck_assert_uint_eq(end, 2);
+	ck_assert_str_eq(mpd_tag_tree_get_value(tree, 1, 0), "W");
+	ck_assert_int_eq(mpd_tag_tree_find(tree, 1, 0, "X"), 1);
+	ck_assert_int_eq(mpd_tag_tree_find(tree, 1, 1, "X"), -1);
+	ck_assert_uint_eq(mpd_tag_tree_get_parent(tree, 1, 2), 1);
+
+	const unsigned x = mpd_tag_tree_get_children(tree, 1, 1, &end);
+	ck_assert_uint_eq(end - x, 2);
+	ck_assert_str_eq(mpd_tag_tree_get_value(tree, 2, x), "");
+	ck_assert(mpd_tag_tree_get_value(tree, 2, x + 1) ==
+		  mpd_tag_tree_get_value(tree, 2, 0));
+	ck_assert_uint_eq(mpd_tag_tree_get_children(tree, 2, x, &end), end);
+	mpd_tag_tree_free(tree);
+
+	/* a new tag type which does not follow the deepest level */
+	ck_assert(mpd_search_db_tags(c, MPD_TAG_DATE));
+	ck_assert(mpd_search_add_group_tag(c, MPD_TAG_ALBUM));
+	ck_assert(mpd_search_commit(c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "list Date group Album\n");
+	test_capture_send(&capture, "Album: X\nDate: 1\nAlbum: Y\n"
+			  "Artist: Z\nOK\n");
+	ck_assert(mpd_recv_tag_tree(c) == NULL);
+	ck_assert_int_eq(mpd_connection_get_error(c), MPD_ERROR_MALFORMED);
+
+	/* MPD_ERROR_MALFORMED is fatal */
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+	c = test_capture_init(&capture);
+
+	/* a child without a parent: "Date" skips the "Album" level
+	   below the new "AlbumArtist" */
+	ck_assert(mpd_search_db_tags(c, MPD_TAG_DATE));
+	ck_assert(mpd_search_add_group_tag(c, MPD_TAG_ALBUM));
+	ck_assert(mpd_search_add_group_tag(c, MPD_TAG_ALBUM_ARTIST));
+	ck_assert(mpd_search_commit(c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "list Date group Album group AlbumArtist\n");
+	test_capture_send(&capture, "AlbumArtist: A\nAlbum: X\nDate: 1\n"
+			  "AlbumArtist: B\nDate: 2\nOK\n");
+	ck_assert(mpd_recv_tag_tree(c) == NULL);
+	ck_assert_int_eq(mpd_connection_get_error(c), MPD_ERROR_MALFORMED);
+
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
 START_TEST(test_count)
 {
 	struct test_capture capture;
@@ -309,6 +1144,234 @@ START_TEST(test_count)
 }
 END_TEST
 
+START_TEST(test_search_cursor)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+	struct mpd_search_cursor *cursor =
+		mpd_search_cursor_new(true, "(Artist == \"x\")",
+				      "Title", false, 2);
+	ck_assert(cursor != NULL);
+
+	/* the first page is full, so the second one is prefetched */
+	test_capture_send(&capture, "file: a\nfile: b\nOK\nfile: c\nOK\n");
+	unsigned length;
+	struct mpd_song *const *songs =
+		mpd_search_cursor_get_page(cursor, c, 0, &length);
+	ck_assert(songs != NULL);
+	ck_assert_int_eq(length, 2);
+	ck_assert_str_eq(mpd_song_get_uri(songs[1]), "b");
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "find \"(Artist == \\\"x\\\")\" sort Title window 0:2\n"
+			 "find \"(Artist == \\\"x\\\")\" sort Title window 2:4\n");
+
+	songs = mpd_search_cursor_get_page(cursor, c, 1, &length);
+	ck_assert(songs != NULL);
+	ck_assert_int_eq(length, 1);
+	ck_assert_str_eq(mpd_song_get_uri(songs[0]), "c");
+
+	/* cached */
+	songs = mpd_search_cursor_get_page(cursor, c, 0, &length);
+	ck_assert(songs != NULL);
+	ck_assert_int_eq(length, 2);
+
+	test_capture_send(&capture, "songs: 3\nplaytime: 600\nOK\n");
+	ck_assert_int_eq(mpd_search_cursor_get_total(cursor, c), 3);
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "count \"(Artist == \\\"x\\\")\"\n");
+
+	mpd_search_cursor_free(cursor);
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
+START_TEST(test_filter)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	static const char *const response =
+		"file: a/1.flac\nArtist: Foo\nTitle: Hello World\n"
+		"Last-Modified: 2024-03-01T12:00:00Z\n"
+		"file: a/2.flac\nArtist: Bar\nAlbumArtist: Foo\nTitle: Bye\n"
+		"Last-Modified: 2020-01-01T00:00:00Z\n"
+		"file: ab/3.flac\nArtist: Baz\nTitle: hello again\n"
+		"OK\n";
+
+	static const enum mpd_tag_type tags[] = {
+		MPD_TAG_ARTIST, MPD_TAG_ALBUM_ARTIST, MPD_TAG_TITLE,
+	};
+	struct mpd_song_table *table = mpd_song_table_new(tags, 3);
+	ck_assert(table != NULL);
+
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture), "playlistinfo\n");
+	test_capture_send(&capture, response);
+	ck_assert(mpd_recv_song_table(c, table));
+	ck_assert(mpd_response_finish(c));
+
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture), "playlistinfo\n");
+	test_capture_send(&capture, response);
+	struct mpd_song *songs[3];
+	for (unsigned i = 0; i < 3; ++i) {
+		songs[i] = mpd_recv_song(c);
+		ck_assert(songs[i] != NULL);
+	}
+	ck_assert(mpd_response_finish(c));
+
+	static const struct {
+		const char *expression;
+		bool fold_case;
+		unsigned mask;
+	} cases[] = {
+		{ "(Artist == 'Foo')", false, 0x1 },
+		{ "(Artist == 'foo')", false, 0x0 },
+		{ "(Artist == 'foo')", true, 0x1 },
+		{ "(Artist eq_ci 'foo')", false, 0x1 },
+		{ "(Artist != 'Foo')", false, 0x6 },
+		{ "(AlbumArtist == 'Foo')", false, 0x3 },
+		{ "(Title contains 'HELLO')", true, 0x5 },
+		{ "(Title contains_cs 'hello')", true, 0x4 },
+		{ "(Title !starts_with 'hello')", true, 0x2 },
+		{ "(Title =~ '^h.*n$')", false, 0x4 },
+		{ "(any == 'bye')", true, 0x2 },
+		{ "(file starts_with 'a/')", false, 0x3 },
+		{ "(base 'a')", false, 0x3 },
+		{ "(modified-since '2023-01-01T00:00:00Z')", false, 0x1 },
+		{ "(modified-since '1577836800')", false, 0x3 },
+		{ "((Artist starts_with 'B') AND (!(Title == 'Bye')))", false, 0x4 },
+		{ "(Genre == '')", false, 0x7 },
+	};
+
+	uint32_t rows[3];
+	for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		struct mpd_filter *filter =
+			mpd_filter_new(cases[i].expression, cases[i].fold_case);
+		ck_assert(filter != NULL);
+
+		unsigned mask = 0;
+		for (unsigned j = 0; j < 3; ++j)
+			if (mpd_filter_match(filter, songs[j]))
+				mask |= 1u << j;
+		ck_assert_uint_eq(mask, cases[i].mask);
+
+		const unsigned n = mpd_filter_scan(filter, table, rows, 4);
+		mask = 0;
+		for (unsigned j = 0; j < n; ++j)
+			mask |= 1u << rows[j];
+		ck_assert_uint_eq(mask, cases[i].mask);
+
+		mpd_filter_free(filter);
+	}
+
+	ck_assert(mpd_filter_new("Artist == 'Foo'", false) == NULL);
+	ck_assert(mpd_filter_new("(Artist == 'Foo'", false) == NULL);
+	ck_assert(mpd_filter_new("(Artist like 'Foo')", false) == NULL);
+	ck_assert(mpd_filter_new("(Nonsense == 'Foo')", false) == NULL);
+	ck_assert(mpd_filter_new("(Artist == 'Foo') x", false) == NULL);
+
+	for (unsigned i = 0; i < 3; ++i)
+		mpd_song_free(songs[i]);
+	mpd_song_table_free(table);
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
+START_TEST(test_search_index)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	static const enum mpd_tag_type tags[] = {
+		MPD_TAG_ARTIST, MPD_TAG_TITLE,
+	};
+	struct mpd_search_index *index = mpd_search_index_new(tags, 2);
+	ck_assert(index != NULL);
+
+	ck_assert(mpd_send_list_queue_meta(c));
+	ck_assert_str_eq(test_capture_receive(&capture), "playlistinfo\n");
+	test_capture_send(&capture,
+			  "file: a.flac\nArtist: The Beatles\nTitle: Help\n"
+			  "file: b.flac\nArtist: Foo\nArtist: Beat Happening\n"
+			  "Title: Indian Summer\n"
+			  "file: c.flac\nArtist: Bar\nTitle: Beatbox\n"
+			  "OK\n");
+
+	struct mpd_song *songs[3];
+	for (unsigned i = 0; i < 3; ++i) {
+		songs[i] = mpd_recv_song(c);
+		ck_assert(songs[i] != NULL);
+		ck_assert(mpd_search_index_add(index, songs[i]));
+	}
+	ck_assert(mpd_response_finish(c));
+	ck_assert_uint_eq(mpd_search_index_get_length(index), 3);
+
+	const char *uris[4];
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_UNKNOWN,
+						 MPD_SEARCH_INDEX_CONTAINS,
+						 "BEAT", uris, 4), 3);
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_ARTIST,
+						 MPD_SEARCH_INDEX_CONTAINS,
+						 "beat", uris, 4), 2);
+	ck_assert_str_eq(uris[0], "a.flac");
+	ck_assert_str_eq(uris[1], "b.flac");
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_UNKNOWN,
+						 MPD_SEARCH_INDEX_CONTAINS,
+						 "eatles", uris, 4), 1);
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_UNKNOWN,
+						 MPD_SEARCH_INDEX_CONTAINS,
+						 "xyz", uris, 4), 0);
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_UNKNOWN,
+						 MPD_SEARCH_INDEX_CONTAINS,
+						 "he", uris, 4), 1);
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_ALBUM,
+						 MPD_SEARCH_INDEX_CONTAINS,
+						 "beat", uris, 4), 0);
+
+	/* prefix queries match the beginning of each value */
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_ARTIST,
+						 MPD_SEARCH_INDEX_STARTS_WITH,
+						 "beat", uris, 4), 1);
+	ck_assert_str_eq(uris[0], "b.flac");
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_UNKNOWN,
+						 MPD_SEARCH_INDEX_STARTS_WITH,
+						 "Be", uris, 4), 2);
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_UNKNOWN,
+						 MPD_SEARCH_INDEX_STARTS_WITH,
+						 "", uris, 4), 3);
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_UNKNOWN,
+						 MPD_SEARCH_INDEX_STARTS_WITH,
+						 "", uris, 2), 2);
+
+	/* an update which drops one song */
+	mpd_search_index_begin_update(index);
+	ck_assert(mpd_search_index_add(index, songs[0]));
+	ck_assert(mpd_search_index_add(index, songs[2]));
+	mpd_search_index_end_update(index);
+	ck_assert_uint_eq(mpd_search_index_get_length(index), 2);
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_UNKNOWN,
+						 MPD_SEARCH_INDEX_CONTAINS,
+						 "beat", uris, 4), 2);
+	ck_assert_str_eq(uris[1], "c.flac");
+
+	ck_assert(mpd_search_index_remove(index, "a.flac"));
+	ck_assert(!mpd_search_index_remove(index, "a.flac"));
+	ck_assert_uint_eq(mpd_search_index_query(index, MPD_TAG_UNKNOWN,
+						 MPD_SEARCH_INDEX_STARTS_WITH,
+						 "", uris, 4), 1);
+	ck_assert_str_eq(uris[0], "c.flac");
+
+	for (unsigned i = 0; i < 3; ++i)
+		mpd_song_free(songs[i]);
+	mpd_search_index_free(index);
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
 START_TEST(test_player_commands)
 {
 	struct test_capture capture;
@@ -343,6 +1406,283 @@ START_TEST(test_player_commands)
 }
 END_TEST
 
+/**
+ * Feeds a copy of the line, because the decoder modifies it.
+ */
+static enum mpd_decoder_result
+decoder_feed(struct mpd_decoder *decoder, const char *line)
+{
+	char buffer[256];
+	strcpy(buffer, line);
+	return mpd_decoder_feed(decoder, buffer);
+}
+
+START_TEST(test_decoder)
+{
+	struct mpd_decoder *decoder = mpd_decoder_new(MPD_DECODER_SONG);
+	ck_assert(decoder != NULL);
+
+	/* several songs; each one is ready when the next begins */
+	ck_assert_int_eq(decoder_feed(decoder, "file: a.flac"),
+			 MPD_DECODER_MORE);
+	ck_assert_int_eq(decoder_feed(decoder, "Title: A"), MPD_DECODER_MORE);
+	ck_assert(mpd_decoder_take_song(decoder) == NULL);
+	ck_assert_int_eq(decoder_feed(decoder, "file: b.flac"),
+			 MPD_DECODER_MORE);
+
+	struct mpd_song *song = mpd_decoder_take_song(decoder);
+	ck_assert(song != NULL);
+	ck_assert_str_eq(mpd_song_get_uri(song), "a.flac");
+	ck_assert_str_eq(mpd_song_get_tag(song, MPD_TAG_TITLE, 0), "A");
+	mpd_song_free(song);
+
+	ck_assert_int_eq(decoder_feed(decoder, "Pos: 3"), MPD_DECODER_MORE);
+	ck_assert_int_eq(decoder_feed(decoder, "OK"), MPD_DECODER_DONE);
+	song = mpd_decoder_take_song(decoder);
+	ck_assert(song != NULL);
+	ck_assert_str_eq(mpd_song_get_uri(song), "b.flac");
+	ck_assert_uint_eq(mpd_song_get_pos(song), 3);
+	mpd_song_free(song);
+	ck_assert(mpd_decoder_take_song(decoder) == NULL);
+
+	/* a command list: "status", "currentsong", "stats" */
+	mpd_decoder_begin(decoder, MPD_DECODER_STATUS);
+	ck_assert_int_eq(decoder_feed(decoder, "volume: 50"),
+			 MPD_DECODER_MORE);
+	ck_assert_int_eq(decoder_feed(decoder, "state: play"),
+			 MPD_DECODER_MORE);
+	ck_assert_int_eq(decoder_feed(decoder, "list_OK"), MPD_DECODER_NEXT);
+	struct mpd_status *status = mpd_decoder_take_status(decoder);
+	ck_assert(status != NULL);
+	ck_assert_int_eq(mpd_status_get_volume(status), 50);
+	ck_assert_int_eq(mpd_status_get_state(status), MPD_STATE_PLAY);
+	mpd_status_free(status);
+
+	mpd_decoder_begin(decoder, MPD_DECODER_SONG);
+	ck_assert_int_eq(decoder_feed(decoder, "file: c.flac"),
+			 MPD_DECODER_MORE);
+	ck_assert_int_eq(decoder_feed(decoder, "list_OK"), MPD_DECODER_NEXT);
+	song = mpd_decoder_take_song(decoder);
+	ck_assert(song != NULL);
+	ck_assert_str_eq(mpd_song_get_uri(song), "c.flac");
+	mpd_song_free(song);
+
+	mpd_decoder_begin(decoder, MPD_DECODER_STATS);
+	ck_assert_int_eq(decoder_feed(decoder, "artists: 3"),
+			 MPD_DECODER_MORE);
+	ck_assert_int_eq(decoder_feed(decoder, "list_OK"), MPD_DECODER_NEXT);
+	struct mpd_stats *stats = mpd_decoder_take_stats(decoder);
+	ck_assert(stats != NULL);
+	ck_assert_uint_eq(mpd_stats_get_number_of_artists(stats), 3);
+	mpd_stats_free(stats);
+	ck_assert_int_eq(decoder_feed(decoder, "OK"), MPD_DECODER_DONE);
+
+	/* an ACK in the middle of a response discards the incomplete
+	   object */
+	mpd_decoder_begin(decoder, MPD_DECODER_ENTITY);
+	ck_assert_int_eq(decoder_feed(decoder, "directory: d"),
+			 MPD_DECODER_MORE);
+	ck_assert_int_eq(decoder_feed(decoder, "file: d/x.flac"),
+			 MPD_DECODER_MORE);
+	struct mpd_entity *entity = mpd_decoder_take_entity(decoder);
+	ck_assert(entity != NULL);
+	ck_assert_int_eq(mpd_entity_get_type(entity),
+			 MPD_ENTITY_TYPE_DIRECTORY);
+	mpd_entity_free(entity);
+
+	ck_assert_int_eq(decoder_feed(decoder,
+				      "ACK [50@0] {lsinfo} No such directory"),
+			 MPD_DECODER_ERROR);
+	ck_assert(mpd_decoder_take_entity(decoder) == NULL);
+	ck_assert_int_eq(mpd_decoder_get_error(decoder), MPD_ERROR_SERVER);
+	ck_assert_str_eq(mpd_decoder_get_error_message(decoder),
+			 "No such directory");
+
+	/* a malformed line */
+	mpd_decoder_begin(decoder, MPD_DECODER_SONG);
+	ck_assert_int_eq(decoder_feed(decoder, "garbage"), MPD_DECODER_ERROR);
+	ck_assert_int_eq(mpd_decoder_get_error(decoder), MPD_ERROR_MALFORMED);
+
+	mpd_decoder_free(decoder);
+}
+END_TEST
+
+static void
+pipeline_callback(struct mpd_connection *connection, void *ctx)
+{
+	char *result = ctx;
+
+	if (mpd_connection_get_error(connection) != MPD_ERROR_SUCCESS) {
+		strcpy(result, "error");
+		return;
+	}
+
+	struct mpd_pair *pair = mpd_recv_pair(connection);
+	if (pair == NULL) {
+		strcpy(result, "empty");
+		return;
+	}
+
+	strcpy(result, pair->value);
+	mpd_return_pair(connection, pair);
+}
+
+START_TEST(test_pipeline)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+	struct mpd_pipeline *pipeline = mpd_pipeline_new();
+	ck_assert(pipeline != NULL);
+
+	char a[16] = "", b[16] = "", d[16] = "";
+	ck_assert(mpd_pipeline_submit(pipeline, pipeline_callback, a,
+				      "status", NULL));
+	ck_assert(mpd_pipeline_submit(pipeline, pipeline_callback, b,
+				      "play", "1", NULL));
+	ck_assert(mpd_pipeline_submit(pipeline, pipeline_callback, d,
+				      "find", "Artist \"x\"", NULL));
+
+	test_capture_send(&capture, "volume: 42\nlist_OK\nlist_OK\nlist_OK\nOK\n");
+	ck_assert(mpd_pipeline_run(pipeline, c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_ok_begin\n"
+			 "status\n"
+			 "play \"1\"\n"
+			 "find \"Artist \\\"x\\\"\"\n"
+			 "command_list_end\n");
+	ck_assert_str_eq(a, "42");
+	ck_assert_str_eq(b, "empty");
+	ck_assert_str_eq(d, "empty");
+
+	/* a failed command aborts the command list, and the rest is
+	   sent again */
+	ck_assert(mpd_pipeline_submit(pipeline, pipeline_callback, a,
+				      "status", NULL));
+	ck_assert(mpd_pipeline_submit(pipeline, pipeline_callback, b,
+				      "play", "99", NULL));
+	ck_assert(mpd_pipeline_submit(pipeline, pipeline_callback, d,
+				      "stats", NULL));
+
+	test_capture_send(&capture, "volume: 7\nlist_OK\n"
+			  "ACK [2@1] {play} Bad song index\n"
+			  "songs: 3\nlist_OK\nOK\n");
+	ck_assert(mpd_pipeline_run(pipeline, c));
+	ck_assert_str_eq(test_capture_receive(&capture),
+			 "command_list_ok_begin\n"
+			 "status\n"
+			 "play \"99\"\n"
+			 "stats\n"
+			 "command_list_end\n"
+			 "command_list_ok_begin\n"
+			 "stats\n"
+			 "command_list_end\n");
+	ck_assert_str_eq(a, "7");
+	ck_assert_str_eq(b, "error");
+	ck_assert_str_eq(d, "3");
+	ck_assert_int_eq(mpd_connection_get_error(c), MPD_ERROR_SUCCESS);
+
+	/* an empty pipeline does not send anything */
+	ck_assert(mpd_pipeline_run(pipeline, c));
+
+	mpd_pipeline_free(pipeline);
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
+START_TEST(test_metrics)
+{
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	ck_assert(mpd_connection_get_metrics(c) == NULL);
+	ck_assert(mpd_connection_enable_metrics(c));
+
+	test_capture_send(&capture, "volume: 42\nOK\n");
+	struct mpd_status *status = mpd_run_status(c);
+	ck_assert(status != NULL);
+	mpd_status_free(status);
+	ck_assert_str_eq(test_capture_receive(&capture), "status\n");
+
+	struct mpd_metrics *metrics = mpd_connection_get_metrics(c);
+	ck_assert(metrics != NULL);
+	ck_assert_int_eq(mpd_metrics_get(metrics, MPD_METRIC_BYTES_SENT), 7);
+	ck_assert_int_eq(mpd_metrics_get(metrics, MPD_METRIC_BYTES_RECEIVED),
+			 14);
+	ck_assert_int_eq(mpd_metrics_get(metrics, MPD_METRIC_LINES), 2);
+	ck_assert_int_eq(mpd_metrics_get(metrics, MPD_METRIC_OBJECTS), 1);
+	ck_assert_int_eq(mpd_metrics_get_num_commands(metrics), 1);
+	ck_assert_str_eq(mpd_metrics_get_command_name(metrics, 0), "status");
+	ck_assert_int_eq(mpd_metrics_get_command_count(metrics, 0), 1);
+	ck_assert(mpd_metrics_get_command_latency(metrics, 0, 50) <
+		  30 * 1000 * 1000);
+	mpd_metrics_free(metrics);
+
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+}
+END_TEST
+
+/**
+ * Checks the next record of a trace file and returns its payload
+ * length.
+ */
+static size_t
+check_trace_record(FILE *file, int direction)
+{
+	ck_assert_int_eq(getc(file), direction);
+
+	/* skip the time stamp */
+	int b;
+	while (((b = getc(file)) & 0x80) != 0)
+		ck_assert(b != EOF);
+
+	/* the length is small enough for one byte */
+	b = getc(file);
+	ck_assert(b >= 0 && b < 0x80);
+	return (size_t)b;
+}
+
+START_TEST(test_trace)
+{
+	static const char *const path = "t_commands.trace";
+
+	struct test_capture capture;
+	struct mpd_connection *c = test_capture_init(&capture);
+
+	ck_assert(mpd_async_trace_open(mpd_connection_get_async(c), path));
+
+	test_capture_send(&capture, "volume: 42\nOK\n");
+	struct mpd_status *status = mpd_run_status(c);
+	ck_assert(status != NULL);
+	mpd_status_free(status);
+	ck_assert_str_eq(test_capture_receive(&capture), "status\n");
+
+	mpd_async_trace_close(mpd_connection_get_async(c));
+	mpd_connection_free(c);
+	test_capture_deinit(&capture);
+
+	FILE *file = fopen(path, "rb");
+	ck_assert(file != NULL);
+
+	char buffer[64];
+	ck_assert_int_eq(fread(buffer, 1, 8, file), 8);
+	ck_assert(memcmp(buffer, "MPDTRC1\n", 8) == 0);
+
+	ck_assert_int_eq(check_trace_record(file, 'S'), 7);
+	ck_assert_int_eq(fread(buffer, 1, 7, file), 7);
+	ck_assert(memcmp(buffer, "status\n", 7) == 0);
+
+	ck_assert_int_eq(check_trace_record(file, 'R'), 14);
+	ck_assert_int_eq(fread(buffer, 1, 14, file), 14);
+	ck_assert(memcmp(buffer, "volume: 42\nOK\n", 14) == 0);
+
+	ck_assert_int_eq(getc(file), EOF);
+	fclose(file);
+	remove(path);
+}
+END_TEST
+
 START_TEST(test_mount_commands)
 {
 	struct test_capture capture;
@@ -365,6 +1705,430 @@ START_TEST(test_mount_commands)
 }
 END_TEST
 
+#ifdef HAVE_PTHREAD
+
+START_TEST(test_connection_settings)
+{
+	static const char *const responses[] = {
+		/* password, tagtypes clear/enable, protocol
+		   clear/enable, binarylimit, status, currentsong */
+		"list_OK\nlist_OK\nlist_OK\nlist_OK\nlist_OK\nlist_OK\n"
+		"state: play\nsong: 3\nlist_OK\n"
+		"file: a.flac\nTitle: A\nPos: 3\nlist_OK\n"
+		"OK\n",
+		"volume: 50\nOK\n",
+		NULL
+	};
+	const char *const *cursor = responses;
+
+	struct test_server server;
+	ck_assert(test_server_start(&server, "OK MPD 0.24.0",
+				    test_server_script, &cursor));
+
+	struct mpd_settings *settings =
+		mpd_settings_new(server.path, 0, 5000, NULL, "secret");
+	ck_assert(settings != NULL);
+
+	static const enum mpd_tag_type types[] = {
+		MPD_TAG_ARTIST, MPD_TAG_TITLE,
+	};
+	ck_assert(mpd_settings_set_tag_types(settings, types, 2));
+
+	static const enum mpd_protocol_feature features[] = {
+		MPD_FEATURE_HIDE_PLAYLISTS_IN_ROOT,
+	};
+	ck_assert(mpd_settings_set_protocol_features(settings, features, 1));
+	mpd_settings_set_binary_limit(settings, 65536);
+	mpd_settings_set_initial_state(settings, true);
+
+	struct mpd_connection *c = mpd_connection_new_settings(settings);
+	ck_assert(c != NULL);
+	ck_assert_int_eq(mpd_connection_get_error(c), MPD_ERROR_SUCCESS);
+	ck_assert_uint_eq(mpd_connection_get_server_version(c)[1], 24);
+
+	/* the responses to the profile were consumed */
+	struct mpd_status *status = mpd_connection_take_initial_status(c);
+	ck_assert(status != NULL);
+	ck_assert_int_eq(mpd_status_get_state(status), MPD_STATE_PLAY);
+	ck_assert_int_eq(mpd_status_get_song_pos(status), 3);
+	mpd_status_free(status);
+	ck_assert(mpd_connection_take_initial_status(c) == NULL);
+
+	struct mpd_song *song = mpd_connection_take_initial_song(c);
+	ck_assert(song != NULL);
+	ck_assert_str_eq(mpd_song_get_uri(song), "a.flac");
+	mpd_song_free(song);
+
+	/* the connection is ready for the next command */
+	status = mpd_run_status(c);
+	ck_assert(status != NULL);
+	ck_assert_int_eq(mpd_status_get_volume(status), 50);
+	mpd_status_free(status);
+
+	mpd_connection_free(c);
+	test_server_stop(&server);
+
+	/* all of the profile went into one command list */
+	ck_assert_uint_eq(server.n_requests, 2);
+	ck_assert_str_eq(server.received,
+			 "command_list_ok_begin\n"
+			 "password \"secret\"\n"
+			 "tagtypes \"clear\"\n"
+			 "tagtypes enable Artist Title\n"
+			 "protocol \"clear\"\n"
+			 "protocol enable hide_playlists_in_root\n"
+			 "binarylimit \"65536\"\n"
+			 "status\n"
+			 "currentsong\n"
+			 "command_list_end\n"
+			 "status\n");
+}
+END_TEST
+
+START_TEST(test_connection_settings_error)
+{
+	/* the server rejects "tagtypes clear", so the remaining
+	   commands of the profile are not executed */
+	static const char *const responses[] = {
+		"ACK [5@0] {tagtypes} unknown command\n",
+		NULL
+	};
+	const char *const *cursor = responses;
+
+	struct test_server server;
+	ck_assert(test_server_start(&server, "OK MPD 0.20.0",
+				    test_server_script, &cursor));
+
+	struct mpd_settings *settings =
+		mpd_settings_new(server.path, 0, 5000, NULL, NULL);
+	ck_assert(settings != NULL);
+	ck_assert(mpd_settings_set_tag_types(settings, NULL, 0));
+	mpd_settings_set_initial_state(settings, true);
+
+	struct mpd_connection *c = mpd_connection_new_settings(settings);
+	ck_assert(c != NULL);
+	ck_assert_int_eq(mpd_connection_get_error(c), MPD_ERROR_SERVER);
+	ck_assert_int_eq(mpd_connection_get_server_error(c),
+			 MPD_SERVER_ERROR_UNKNOWN_CMD);
+	ck_assert(mpd_connection_take_initial_status(c) == NULL);
+
+	mpd_connection_free(c);
+	test_server_stop(&server);
+
+	ck_assert_str_eq(server.received,
+			 "command_list_ok_begin\n"
+			 "tagtypes \"clear\"\n"
+			 "status\n"
+			 "currentsong\n"
+			 "command_list_end\n");
+}
+END_TEST
+
+static const char capabilities_response[] =
+	"command: status\nlist_OK\n"
+	"command: kill\nlist_OK\n"
+	"handler: http://\nlist_OK\n"
+	"tagtype: Artist\nlist_OK\n"
+	"OK\n";
+
+static const char capabilities_request[] =
+	"command_list_ok_begin\n"
+	"commands\n"
+	"notcommands\n"
+	"urlhandlers\n"
+	"tagtypes\n"
+	"command_list_end\n";
+
+static struct mpd_connection *
+connect_test_server(const struct test_server *server)
+{
+	struct mpd_settings *settings =
+		mpd_settings_new(server->path, 0, 5000, NULL, NULL);
+	ck_assert(settings != NULL);
+
+	struct mpd_connection *c = mpd_connection_new_settings(settings);
+	ck_assert(c != NULL);
+	ck_assert_int_eq(mpd_connection_get_error(c), MPD_ERROR_SUCCESS);
+	return c;
+}
+
+START_TEST(test_server_capabilities_cache)
+{
+	mpd_server_capabilities_flush();
+
+	static const char *const responses[] = {
+		capabilities_response,
+		/* "password" */
+		"OK\n",
+		capabilities_response,
+		NULL
+	};
+	const char *const *cursor = responses;
+
+	struct test_server server;
+	ck_assert(test_server_start(&server, "OK MPD 0.21.0",
+				    test_server_script, &cursor));
+
+	/* the first connection queries the server */
+	struct mpd_connection *a = connect_test_server(&server);
+	struct mpd_server_capabilities *ca = mpd_server_capabilities_get(a);
+	ck_assert(ca != NULL);
+	ck_assert(mpd_server_capabilities_has_command(ca, "status"));
+
+	/* the second one to the same server shares the snapshot */
+	struct mpd_connection *b = connect_test_server(&server);
+	struct mpd_server_capabilities *cb = mpd_server_capabilities_get(b);
+	ck_assert(cb == ca);
+	mpd_server_capabilities_unref(cb);
+
+	/* after another password, the permissions may differ, so the
+	   cache is bypassed */
+	ck_assert(mpd_run_password(b, "secret"));
+	cb = mpd_server_capabilities_get(b);
+	ck_assert(cb != NULL);
+	ck_assert(cb != ca);
+	mpd_server_capabilities_unref(cb);
+
+	/* the other connection still hits the cache */
+	cb = mpd_server_capabilities_get(a);
+	ck_assert(cb == ca);
+	mpd_server_capabilities_unref(cb);
+
+	mpd_connection_free(b);
+	mpd_connection_free(a);
+	test_server_stop(&server);
+
+	ck_assert_uint_eq(server.n_requests, 3);
+
+	/* a new server version at the same address invalidates the
+	   snapshot */
+	cursor = responses;
+	ck_assert(test_server_start(&server, "OK MPD 0.22.0",
+				    test_server_script, &cursor));
+	a = connect_test_server(&server);
+	cb = mpd_server_capabilities_get(a);
+	ck_assert(cb != NULL);
+	ck_assert(cb != ca);
+	mpd_server_capabilities_unref(cb);
+	mpd_connection_free(a);
+	test_server_stop(&server);
+
+	ck_assert_uint_eq(server.n_requests, 1);
+	ck_assert_str_eq(server.received, capabilities_request);
+
+	mpd_server_capabilities_unref(ca);
+	mpd_server_capabilities_flush();
+}
+END_TEST
+
+START_TEST(test_server_capabilities_cache_tag_types)
+{
+	mpd_server_capabilities_flush();
+
+	static const char *const responses[] = {
+		/* "tagtypes clear" */
+		"OK\n",
+		/* before MPD 0.24, "tagtypes" lists only the enabled
+		   ones */
+		"list_OK\nlist_OK\nlist_OK\nlist_OK\nOK\n",
+		capabilities_response,
+		NULL
+	};
+	const char *const *cursor = responses;
+
+	struct test_server server;
+	ck_assert(test_server_start(&server, "OK MPD 0.23.0",
+				    test_server_script, &cursor));
+
+	/* this snapshot is not stored in the cache */
+	struct mpd_connection *a = connect_test_server(&server);
+	ck_assert(mpd_run_clear_tag_types(a));
+	struct mpd_server_capabilities *ca = mpd_server_capabilities_get(a);
+	ck_assert(ca != NULL);
+	ck_assert(!mpd_server_capabilities_has_tag_type(ca, MPD_TAG_ARTIST));
+
+	/* so a connection with all tag types queries again */
+	struct mpd_connection *b = connect_test_server(&server);
+	struct mpd_server_capabilities *cb = mpd_server_capabilities_get(b);
+	ck_assert(cb != NULL);
+	ck_assert(cb != ca);
+	ck_assert(mpd_server_capabilities_has_tag_type(cb, MPD_TAG_ARTIST));
+
+	/* ... and its snapshot is shared */
+	struct mpd_connection *c = connect_test_server(&server);
+	struct mpd_server_capabilities *cc = mpd_server_capabilities_get(c);
+	ck_assert(cc == cb);
+
+	mpd_server_capabilities_unref(cc);
+	mpd_server_capabilities_unref(cb);
+	mpd_server_capabilities_unref(ca);
+	mpd_connection_free(c);
+	mpd_connection_free(b);
+	mpd_connection_free(a);
+	test_server_stop(&server);
+
+	ck_assert_uint_eq(server.n_requests, 3);
+
+	mpd_server_capabilities_flush();
+}
+END_TEST
+
+#define CRAWL_ROOT "file: r.flac\nTitle: R\n"
+#define CRAWL_A "directory: a/x\nfile: a/x/1.flac\nArtist: X\nTitle: A1\n" \
+	"file: a/2.flac\nTitle: A2\nTime: 7\n"
+#define CRAWL_B "file: b/1.flac\nTitle: B1\nArtist: Y\nfile: b/2.flac\n"
+#define CRAWL_C "file: c/1.flac\nArtist: Z\nTime: 5\n"
+
+struct crawl_server {
+	/**
+	 * The #test_server mutex, which is held while the handler
+	 * runs.
+	 */
+	pthread_mutex_t *mutex;
+
+	pthread_cond_t cond;
+
+	/**
+	 * The number of directories being fetched right now.
+	 */
+	unsigned n_fetching;
+
+	/**
+	 * Have two directories been fetched at the same time?
+	 */
+	bool parallel;
+};
+
+/**
+ * Holds back the response to the first "listallinfo" of a directory
+ * until another connection asks for one, so a crawl over several
+ * connections really runs in parallel.
+ */
+static void
+crawl_fetch_directory(struct crawl_server *cs)
+{
+	if (++cs->n_fetching > 1) {
+		cs->parallel = true;
+		pthread_cond_broadcast(&cs->cond);
+	}
+
+	struct timespec timeout;
+	clock_gettime(CLOCK_REALTIME, &timeout);
+	timeout.tv_sec += 5;
+
+	while (!cs->parallel)
+		if (pthread_cond_timedwait(&cs->cond, cs->mutex,
+					   &timeout) != 0)
+			/* no other connection; the test will fail */
+			break;
+
+	--cs->n_fetching;
+}
+
+/**
+ * A #test_server_handler for a database with the top-level
+ * directories "a", "b" and "c".
+ */
+static const char *
+crawl_handler(const char *request, void *ctx)
+{
+	struct crawl_server *cs = ctx;
+
+	if (strcmp(request, "lsinfo\n") == 0)
+		return CRAWL_ROOT "directory: a\ndirectory: b\n"
+			"playlist: p.m3u\ndirectory: c\nOK\n";
+	else if (strcmp(request, "listallinfo\n") == 0)
+		return CRAWL_ROOT "directory: a\n" CRAWL_A
+			"directory: b\n" CRAWL_B
+			"directory: c\n" CRAWL_C "OK\n";
+	else if (strncmp(request, "tagtypes ", 9) == 0)
+		return NULL;
+	else if (strncmp(request, "listallinfo \"", 13) != 0)
+		return "ACK [5@0] {} unknown command\n";
+
+	crawl_fetch_directory(cs);
+
+	switch (request[13]) {
+	case 'a':
+		return CRAWL_A "OK\n";
+	case 'b':
+		return CRAWL_B "OK\n";
+	case 'c':
+		return CRAWL_C "OK\n";
+	default:
+		return "ACK [50@0] {listallinfo} No such directory\n";
+	}
+}
+
+START_TEST(test_crawl_connections)
+{
+	struct test_server server;
+	struct crawl_server cs = {
+		.mutex = &server.mutex,
+		.n_fetching = 0,
+		.parallel = false,
+	};
+	pthread_cond_init(&cs.cond, NULL);
+	ck_assert(test_server_start(&server, "OK MPD 0.24.0",
+				    crawl_handler, &cs));
+
+	struct mpd_connection *c = connect_test_server(&server);
+
+	static const enum mpd_tag_type tags[] = {
+		MPD_TAG_TITLE, MPD_TAG_ARTIST,
+	};
+
+	/* one "listallinfo" on this connection, then the same
+	   database fetched over up to 4 connections */
+	static const unsigned n_connections[] = { 1, 4 };
+	struct mpd_song_table *tables[2];
+	for (unsigned i = 0; i < 2; ++i) {
+		tables[i] = mpd_song_table_new(tags, 2);
+		ck_assert(tables[i] != NULL);
+		ck_assert(mpd_crawl_database(c, n_connections[i], tables[i]));
+	}
+
+	mpd_connection_free(c);
+	test_server_stop(&server);
+
+	pthread_cond_destroy(&cs.cond);
+
+	/* three directories need only two additional connections,
+	   which enable just the table's tags */
+	ck_assert(cs.parallel);
+	ck_assert_uint_eq(server.n_connections, 3);
+	ck_assert_uint_eq(server.n_requests, 2 + 2 * 2 + 3);
+	ck_assert(strstr(server.received,
+			 "tagtypes enable Title Artist\n") != NULL);
+
+	const struct mpd_song_table *a = tables[0], *b = tables[1];
+	const unsigned n = mpd_song_table_get_length(a);
+	ck_assert_uint_eq(n, 6);
+	ck_assert_uint_eq(mpd_song_table_get_length(b), n);
+
+	const char *heap_a = mpd_song_table_get_heap(a);
+	const char *heap_b = mpd_song_table_get_heap(b);
+	assert_same_strings(heap_a, mpd_song_table_get_uris(a),
+			    heap_b, mpd_song_table_get_uris(b), n);
+	for (unsigned i = 0; i < 2; ++i)
+		assert_same_strings(heap_a,
+				    mpd_song_table_get_tags(a, tags[i]),
+				    heap_b,
+				    mpd_song_table_get_tags(b, tags[i]), n);
+	ck_assert(memcmp(mpd_song_table_get_durations_ms(a),
+			 mpd_song_table_get_durations_ms(b),
+			 n * sizeof(uint32_t)) == 0);
+
+	ck_assert_str_eq(heap_b + mpd_song_table_get_uris(b)[5],
+			 "c/1.flac");
+
+	mpd_song_table_free(tables[1]);
+	mpd_song_table_free(tables[0]);
+}
+END_TEST
+
+#endif // HAVE_PTHREAD
+
 #ifdef HAVE_SETLOCALE
 
 START_TEST(test_locale)
@@ -381,6 +2145,10 @@ START_TEST(test_locale)
 	ck_assert_str_eq(test_capture_receive(&capture), "seekcur \"-42.500\"\n");
 	abort_command(&capture, c);
 
+	ck_assert(mpd_send_seek_current(c, 0.0625, true));
+	ck_assert_str_eq(test_capture_receive(&capture), "seekcur \"+0.062\"\n");
+	abort_command(&capture, c);
+
 	mpd_connection_free(c);
 	test_capture_deinit(&capture);
 
@@ -397,10 +2165,20 @@ create_suite(void)
 
 	TCase *tc_capabilities = tcase_create("capabilities");
 	tcase_add_test(tc_capabilities, test_capabilities_commands);
+	tcase_add_test(tc_capabilities, test_server_capabilities);
+	tcase_add_test(tc_capabilities, test_tag_projection);
 	suite_add_tcase(s, tc_capabilities);
 
 	TCase *tc_queue = tcase_create("queue");
 	tcase_add_test(tc_queue, test_queue_commands);
+	tcase_add_test(tc_queue, test_queue_multi);
+	tcase_add_test(tc_queue, test_queue_view);
+	tcase_add_test(tc_queue, test_recv_pairs);
+	tcase_add_test(tc_queue, test_song_table);
+	tcase_add_test(tc_queue, test_song_serialize);
+	tcase_add_test(tc_queue, test_song_table_parse_threads);
+	tcase_add_test(tc_queue, test_song_sort);
+	tcase_add_test(tc_queue, test_song_sort_threads);
 	suite_add_tcase(s, tc_queue);
 
 	TCase *tc_playlist = tcase_create("playlist");
@@ -409,23 +2187,51 @@ create_suite(void)
 
 	TCase *tc_database = tcase_create("database");
 	tcase_add_test(tc_database, test_database_commands);
+	tcase_add_test(tc_database, test_crawl);
 	suite_add_tcase(s, tc_database);
 
 	TCase *tc_search = tcase_create("search");
 	tcase_add_test(tc_search, test_search);
 	tcase_add_test(tc_search, test_expression);
 	tcase_add_test(tc_search, test_list);
+	tcase_add_test(tc_search, test_tag_tree);
 	tcase_add_test(tc_search, test_count);
+	tcase_add_test(tc_search, test_search_cursor);
+	tcase_add_test(tc_search, test_filter);
+	tcase_add_test(tc_search, test_search_index);
 	suite_add_tcase(s, tc_search);
 
 	TCase *tc_player = tcase_create("player");
 	tcase_add_test(tc_player, test_player_commands);
 	suite_add_tcase(s, tc_player);
 
+	TCase *tc_metrics = tcase_create("metrics");
+	tcase_add_test(tc_metrics, test_metrics);
+	tcase_add_test(tc_metrics, test_trace);
+	suite_add_tcase(s, tc_metrics);
+
 	TCase *tc_mount = tcase_create("mount");
 	tcase_add_test(tc_mount, test_mount_commands);
 	suite_add_tcase(s, tc_mount);
 
+	TCase *tc_decoder = tcase_create("decoder");
+	tcase_add_test(tc_decoder, test_decoder);
+	suite_add_tcase(s, tc_decoder);
+
+	TCase *tc_pipeline = tcase_create("pipeline");
+	tcase_add_test(tc_pipeline, test_pipeline);
+	suite_add_tcase(s, tc_pipeline);
+
+#ifdef HAVE_PTHREAD
+	TCase *tc_connection = tcase_create("connection");
+	tcase_add_test(tc_connection, test_connection_settings);
+	tcase_add_test(tc_connection, test_connection_settings_error);
+	tcase_add_test(tc_connection, test_server_capabilities_cache);
+	tcase_add_test(tc_connection, test_server_capabilities_cache_tag_types);
+	tcase_add_test(tc_connection, test_crawl_connections);
+	suite_add_tcase(s, tc_connection);
+#endif // HAVE_PTHREAD
+
 #ifdef HAVE_SETLOCALE
 	TCase *tc_locale = tcase_create("locale");
 	tcase_add_test(tc_locale, test_locale);
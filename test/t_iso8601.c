@@ -18,6 +18,13 @@ START_TEST(test_iso8601)
 
 	t = iso8601_datetime_parse(buffer);
 	ck_assert_int_eq(t, now);
+
+	ck_assert_int_eq(iso8601_datetime_parse("1970-01-01T00:00:00Z"), 0);
+	ck_assert_int_eq(iso8601_datetime_parse("2000-02-29T23:59:59Z"),
+			 951868799);
+	ck_assert_int_eq(iso8601_datetime_parse("2024-03-01T12:00:00Z"),
+			 1709294400);
+	ck_assert_int_eq(iso8601_datetime_parse("2024-13-01T12:00:00Z"), 0);
 }
 END_TEST
 
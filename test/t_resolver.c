@@ -0,0 +1,359 @@
+#include "resolver.h"
+#include "socket.h"
+#include "clock.h"
+#include "ierror.h"
+
+#include <check.h>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Added to the real clock by mpd_clock_now(), to expire cache items
+ * without waiting.
+ */
+static uint64_t clock_offset_us;
+
+/**
+ * The NULL-terminated list of numeric addresses returned by the fake
+ * getaddrinfo().
+ */
+static const char *const *fake_addresses;
+
+static unsigned n_getaddrinfo;
+
+uint64_t
+mpd_clock_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000
+		+ clock_offset_us;
+}
+
+int
+getaddrinfo(const char *node, const char *service,
+	    const struct addrinfo *hints, struct addrinfo **res)
+{
+	(void)node;
+	(void)hints;
+
+	++n_getaddrinfo;
+
+	const uint16_t port = htons((uint16_t)atoi(service));
+	struct addrinfo *head = NULL, **tail = &head;
+
+	for (const char *const *i = fake_addresses; *i != NULL; ++i) {
+		struct addrinfo *ai = calloc(1, sizeof(*ai));
+		struct sockaddr_storage *ss = calloc(1, sizeof(*ss));
+		ck_assert(ai != NULL && ss != NULL);
+
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
+		struct sockaddr_in *sin = (struct sockaddr_in *)ss;
+		if (inet_pton(AF_INET6, *i, &sin6->sin6_addr) == 1) {
+			sin6->sin6_family = AF_INET6;
+			sin6->sin6_port = port;
+			ai->ai_addrlen = sizeof(*sin6);
+		} else {
+			ck_assert(inet_pton(AF_INET, *i, &sin->sin_addr) == 1);
+			sin->sin_family = AF_INET;
+			sin->sin_port = port;
+			ai->ai_addrlen = sizeof(*sin);
+		}
+
+		ai->ai_family = ss->ss_family;
+		ai->ai_socktype = SOCK_STREAM;
+		ai->ai_protocol = IPPROTO_TCP;
+		ai->ai_addr = (struct sockaddr *)ss;
+
+		*tail = ai;
+		tail = &ai->ai_next;
+	}
+
+	*res = head;
+	return head != NULL ? 0 : EAI_NONAME;
+}
+
+void
+freeaddrinfo(struct addrinfo *ai)
+{
+	while (ai != NULL) {
+		struct addrinfo *next = ai->ai_next;
+		free(ai->ai_addr);
+		free(ai);
+		ai = next;
+	}
+}
+
+/**
+ * Formats the address as a numeric string with inet_ntop().
+ */
+static const char *
+format_address(const struct sockaddr *address, char *buffer, size_t size)
+{
+	const void *src = address->sa_family == AF_INET6
+		? (const void *)&((const struct sockaddr_in6 *)address)->sin6_addr
+		: (const void *)&((const struct sockaddr_in *)address)->sin_addr;
+
+	return inet_ntop(address->sa_family, src, buffer, size);
+}
+
+/**
+ * Resolves the host name and expects one getaddrinfo() call if
+ * "miss" is true, or none if it is a cache hit.
+ */
+static void
+resolve(const char *host, unsigned port, bool miss)
+{
+	const unsigned before = n_getaddrinfo;
+
+	struct resolver *resolver = resolver_new(host, port);
+	ck_assert(resolver != NULL);
+	ck_assert_int_eq(n_getaddrinfo - before, miss);
+	resolver_free(resolver);
+}
+
+START_TEST(test_resolver_cache)
+{
+	static const char *const addresses[] = { "192.0.2.1", NULL };
+	fake_addresses = addresses;
+
+	resolve("cache.test", 6600, true);
+	resolve("cache.test", 6600, false);
+
+	/* a different port or host is a different item */
+	resolve("cache.test", 6601, true);
+	resolve("other.test", 6600, true);
+	resolve("cache.test", 6600, false);
+
+	/* items expire after one minute */
+	clock_offset_us += 59 * 1000 * 1000;
+	resolve("cache.test", 6600, false);
+	clock_offset_us += 2 * 1000 * 1000;
+	resolve("cache.test", 6600, true);
+	resolve("cache.test", 6600, false);
+	resolve("cache.test", 6601, true);
+
+	/* invalidating removes only this host's item */
+	struct resolver *resolver = resolver_new("cache.test", 6600);
+	ck_assert(resolver != NULL);
+	resolver_invalidate(resolver);
+	resolver_free(resolver);
+
+	resolve("cache.test", 6601, false);
+	resolve("cache.test", 6600, true);
+	resolve("cache.test", 6600, false);
+}
+END_TEST
+
+START_TEST(test_resolver_interleave)
+{
+	static const char *const addresses[] = {
+		"2001:db8::1", "2001:db8::2", "2001:db8::3",
+		"192.0.2.1", "192.0.2.2",
+		NULL
+	};
+	fake_addresses = addresses;
+
+	static const char *const expected[] = {
+		"2001:db8::1", "192.0.2.1",
+		"2001:db8::2", "192.0.2.2",
+		"2001:db8::3",
+	};
+
+	/* the second resolver gets the order from the cache */
+	for (unsigned pass = 0; pass < 2; ++pass) {
+		struct resolver *resolver =
+			resolver_new("interleave.test", 6600);
+		ck_assert(resolver != NULL);
+		ck_assert_uint_eq(resolver_remaining(resolver), 5);
+
+		for (unsigned i = 0; i < 5; ++i) {
+			const struct resolver_address *address =
+				resolver_next(resolver);
+			ck_assert(address != NULL);
+
+			char buffer[INET6_ADDRSTRLEN];
+			ck_assert_str_eq(format_address(address->addr, buffer,
+							sizeof(buffer)),
+					 expected[i]);
+		}
+
+		ck_assert_uint_eq(resolver_remaining(resolver), 0);
+		ck_assert(resolver_next(resolver) == NULL);
+		resolver_free(resolver);
+	}
+}
+END_TEST
+
+/**
+ * Creates a listening TCP socket on 127.0.0.1 and returns its port.
+ */
+static int
+listen_loopback(unsigned *port_r)
+{
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+	ck_assert(fd >= 0);
+
+	struct sockaddr_in sin = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t length = sizeof(sin);
+	ck_assert_int_eq(bind(fd, (const struct sockaddr *)&sin,
+			      sizeof(sin)), 0);
+	ck_assert_int_eq(listen(fd, 4), 0);
+	ck_assert_int_eq(getsockname(fd, (struct sockaddr *)&sin, &length),
+			 0);
+
+	*port_r = ntohs(sin.sin_port);
+	return fd;
+}
+
+START_TEST(test_socket_connect_invalidate)
+{
+	/* nothing listens on 127.0.0.2, so this is refused */
+	static const char *const addresses[] = { "127.0.0.2", NULL };
+	fake_addresses = addresses;
+
+	unsigned port;
+	const int listener = listen_loopback(&port);
+
+	const struct timeval tv = { .tv_sec = 5 };
+	struct mpd_error_info error;
+	mpd_error_init(&error);
+
+	ck_assert_int_eq(mpd_socket_connect("refused.test", port, &tv, false,
+					    &error), -1);
+	ck_assert(mpd_error_is_defined(&error));
+	mpd_error_deinit(&error);
+
+	/* the failure has removed the addresses from the cache */
+	resolve("refused.test", port, true);
+
+	close(listener);
+}
+END_TEST
+
+/**
+ * Was TCP Fast Open enabled on this socket?
+ *
+ * @return 1 or 0, or -1 if this is unknown
+ */
+static int
+get_fast_open(mpd_socket_t fd)
+{
+#ifdef TCP_FASTOPEN_CONNECT
+	int value;
+	socklen_t length = sizeof(value);
+	if (getsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT,
+		       &value, &length) < 0)
+		return -1;
+
+	return value != 0;
+#else
+	(void)fd;
+	return -1;
+#endif
+}
+
+/**
+ * Connects to a host name which resolves to a refused and a
+ * listening address, and checks that the latter has won.
+ */
+static void
+connect_second(bool fast_open)
+{
+	static const char *const addresses[] = {
+		"127.0.0.2", "127.0.0.1", NULL
+	};
+	fake_addresses = addresses;
+
+	unsigned port;
+	const int listener = listen_loopback(&port);
+
+	const struct timeval tv = { .tv_sec = 5 };
+	struct mpd_error_info error;
+	mpd_error_init(&error);
+
+	const mpd_socket_t fd = mpd_socket_connect("second.test", port, &tv,
+						   fast_open, &error);
+	ck_assert(fd >= 0);
+	ck_assert(!mpd_error_is_defined(&error));
+
+	struct sockaddr_in peer;
+	socklen_t length = sizeof(peer);
+	ck_assert_int_eq(getpeername(fd, (struct sockaddr *)&peer, &length),
+			 0);
+	ck_assert_uint_eq(ntohl(peer.sin_addr.s_addr), INADDR_LOOPBACK);
+
+	/* with Fast Open, connect() would succeed right away (if the
+	   kernel holds a cookie), and the refused address would win */
+	ck_assert_int_ne(get_fast_open(fd), 1);
+
+	mpd_socket_close(fd);
+	close(listener);
+}
+
+START_TEST(test_socket_connect_staggered)
+{
+	connect_second(false);
+	connect_second(true);
+}
+END_TEST
+
+START_TEST(test_socket_connect_fast_open)
+{
+	static const char *const addresses[] = { "127.0.0.1", NULL };
+	fake_addresses = addresses;
+
+	unsigned port;
+	const int listener = listen_loopback(&port);
+
+	const struct timeval tv = { .tv_sec = 5 };
+	struct mpd_error_info error;
+	mpd_error_init(&error);
+
+	/* with only one address, there is nothing to stagger */
+	const mpd_socket_t fd = mpd_socket_connect("single.test", port, &tv,
+						   true, &error);
+	ck_assert(fd >= 0);
+	ck_assert_int_ne(get_fast_open(fd), 0);
+
+	mpd_socket_close(fd);
+	close(listener);
+}
+END_TEST
+
+static Suite *
+create_suite(void)
+{
+	Suite *s = suite_create("resolver");
+	TCase *tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, test_resolver_cache);
+	tcase_add_test(tc_core, test_resolver_interleave);
+	tcase_add_test(tc_core, test_socket_connect_invalidate);
+	tcase_add_test(tc_core, test_socket_connect_staggered);
+	tcase_add_test(tc_core, test_socket_connect_fast_open);
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int
+main(void)
+{
+	Suite *s = create_suite();
+	SRunner *sr = srunner_create(s);
+	srunner_run_all(sr, CK_NORMAL);
+	int number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+	return number_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}